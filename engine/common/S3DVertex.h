@@ -1,6 +1,8 @@
 #pragma once
 
 #include <stdint.h>
+#include <string.h>
+#include <algorithm>
 #include "base.h"
 #include "SColor.h"
 #include "vector3d.h"
@@ -80,6 +82,113 @@ struct SVertex_PNT2WA
 	static E_VERTEX_TYPE TYPE() { return EVT_PNT2WA; }
 };
 
+inline uint16_t floatToHalf(float f)
+{
+	uint32_t x;
+	memcpy(&x, &f, sizeof(x));
+	const uint32_t sign = (x >> 16) & 0x8000;
+	x &= 0x7fffffff;
+	if (x >= 0x47800000)			//overflow, inf or nan
+		return (uint16_t)(sign | (x > 0x7f800000 ? 0x7e00 : 0x7c00));
+	if (x < 0x38800000)			//denormal
+	{
+		if (x < 0x33000000)
+			return (uint16_t)sign;
+		const uint32_t shift = 126 - (x >> 23);
+		const uint32_t m = (x & 0x7fffff) | 0x800000;
+		return (uint16_t)(sign | ((m + (1u << (shift - 1))) >> shift));
+	}
+	x += 0xc8000000;			//rebias exponent
+	x += 0xfff + ((x >> 13) & 1);			//round to nearest even
+	return (uint16_t)(sign | (x >> 13));
+}
+
+inline float halfToFloat(uint16_t h)
+{
+	const uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+	const uint32_t e = (h >> 10) & 0x1f;
+	const uint32_t m = h & 0x3ff;
+	uint32_t x;
+	if (e == 0)
+	{
+		const float f = m * (1.0f / 16777216.0f);
+		return sign ? -f : f;
+	}
+	else if (e == 31)
+		x = sign | 0x7f800000 | (m << 13);
+	else
+		x = sign | ((e + 112) << 23) | (m << 13);
+	float f;
+	memcpy(&f, &x, sizeof(f));
+	return f;
+}
+
+//unit vector on the octahedron folded to the square [-1, 1], stored as snorm16
+inline void encodeOctahedralNormal(const vector3df& n, int16_t* oct)
+{
+	const float l = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+	float u = l > 0 ? n.x / l : 0;
+	float v = l > 0 ? n.y / l : 0;
+	if (n.z < 0)
+	{
+		const float fu = (1.0f - fabsf(v)) * (u >= 0 ? 1.0f : -1.0f);
+		v = (1.0f - fabsf(u)) * (v >= 0 ? 1.0f : -1.0f);
+		u = fu;
+	}
+	oct[0] = (int16_t)round32_(clamp_(u, -1.0f, 1.0f) * 32767.0f);
+	oct[1] = (int16_t)round32_(clamp_(v, -1.0f, 1.0f) * 32767.0f);
+}
+
+inline vector3df decodeOctahedralNormal(const int16_t* oct)
+{
+	float u = std::max(oct[0] / 32767.0f, -1.0f);
+	float v = std::max(oct[1] / 32767.0f, -1.0f);
+	const float z = 1.0f - fabsf(u) - fabsf(v);
+	if (z < 0)
+	{
+		const float fu = (1.0f - fabsf(v)) * (u >= 0 ? 1.0f : -1.0f);
+		v = (1.0f - fabsf(u)) * (v >= 0 ? 1.0f : -1.0f);
+		u = fu;
+	}
+	vector3df n(u, v, z);
+	n.normalize();
+	return n;
+}
+
+//SVertex_PNT2WA in 32 bytes, weights and bone indices are already 8 bit
+struct SVertex_PNT2WA_Packed
+{
+	vector3df Pos;
+	int16_t		Normal[2];			//octahedral
+	uint16_t	TCoords0[2];			//half
+	uint16_t	TCoords1[2];
+	uint8_t		Weights[4];
+	uint8_t		BoneIndices[4];
+
+	void set(const SVertex_PNT2WA& v)
+	{
+		Pos = v.Pos;
+		encodeOctahedralNormal(v.Normal, Normal);
+		TCoords0[0] = floatToHalf(v.TCoords0.x); TCoords0[1] = floatToHalf(v.TCoords0.y);
+		TCoords1[0] = floatToHalf(v.TCoords1.x); TCoords1[1] = floatToHalf(v.TCoords1.y);
+		memcpy(Weights, v.Weights, sizeof(Weights));
+		memcpy(BoneIndices, v.BoneIndices, sizeof(BoneIndices));
+	}
+
+	static E_VERTEX_TYPE TYPE() { return EVT_PNT2WA_PACKED; }
+};
+
+//object to world matrix (the 16 floats of a matrix4) and color of one instance
+struct SVertex_Instance
+{
+	float	Transform[16];
+	SColor	Color;
+
+	void set(const float* m, SColor c) { memcpy(Transform, m, sizeof(Transform)); Color = c; }
+
+	static E_VERTEX_TYPE TYPE() { return EVT_INSTANCE; }
+};
+
 inline uint32_t getVertexPitchFromType(E_VERTEX_TYPE type)
 {
 	switch (type)
@@ -96,6 +205,10 @@ inline uint32_t getVertexPitchFromType(E_VERTEX_TYPE type)
 		return sizeof(SVertex_PNCT2);
 	case EVT_PNT2WA:
 		return sizeof(SVertex_PNT2WA);
+	case EVT_PNT2WA_PACKED:
+		return sizeof(SVertex_PNT2WA_Packed);
+	case EVT_INSTANCE:
+		return sizeof(SVertex_Instance);
 
 	default:
 		ASSERT(false);
@@ -130,6 +243,12 @@ inline void deleteVerticesFromType(E_VERTEX_TYPE type, void* vertices)
 	case EVT_PNT2WA:
 		DELETE_ARRAY(SVertex_PNT2WA, vertices);
 		break;
+	case EVT_PNT2WA_PACKED:
+		DELETE_ARRAY(SVertex_PNT2WA_Packed, vertices);
+		break;
+	case EVT_INSTANCE:
+		DELETE_ARRAY(SVertex_Instance, vertices);
+		break;
 	default:
 		ASSERT(false);
 		break;
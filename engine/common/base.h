@@ -125,6 +125,8 @@ enum E_VERTEX_TYPE : int32_t
 	EVT_PNCT,
 	EVT_PNCT2,
 	EVT_PNT2WA,						//fvf
+	EVT_PNT2WA_PACKED,				//fvf, octahedral normal, half uv
+	EVT_INSTANCE,					//per instance data of instanced draws, not drawn alone
 	EVT_COUNT,
 };
 
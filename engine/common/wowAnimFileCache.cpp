@@ -0,0 +1,231 @@
+#include "wowAnimFileCache.h"
+#include "CMemFile.h"
+#include "wowEnvironment.h"
+#include "wowM2File.h"
+
+wowAnimFileCache::wowAnimFileCache(const wowEnvironment* wowEnv, uint32_t maxBytes, bool async)
+	: WowEnvironment(wowEnv), MaxBytes(maxBytes), UsedBytes(0), NextSerial(0), Async(async), Quit(false)
+{
+	if (Async)
+	{
+		INIT_EVENT(&LoaderEvent);
+		INIT_THREAD(&LoaderThread, [this](void*) { return loaderThread(); }, nullptr);
+	}
+}
+
+wowAnimFileCache::~wowAnimFileCache()
+{
+	if (Async)
+	{
+		BEGIN_LOCK(&QueueLock);
+		Quit = true;
+		END_LOCK(&QueueLock);
+		SET_EVENT(&LoaderEvent);
+
+		WAIT_THREAD(&LoaderThread);
+		DESTROY_THREAD(&LoaderThread);
+		DESTROY_EVENT(&LoaderEvent);
+	}
+
+	for (const SLoadResult& result : Results)
+		delete result.memFile;
+	Results.clear();
+
+	for (wowM2File* m2File : M2Files)
+		m2File->setAnimFileCache(nullptr);
+}
+
+bool wowAnimFileCache::requestAnimation(wowM2File* m2File, uint32_t anim)
+{
+	if (!m2File->isAnimationExternal(anim))
+		return m2File->isAnimationLoaded(anim);
+
+	if (Async)
+		applyResults();
+
+	auto itr = EntryMap.find(T_EntryKey(m2File, anim));
+	if (itr != EntryMap.end())
+	{
+		SEntry& entry = *itr->second;
+		Entries.splice(Entries.begin(), Entries, itr->second);
+		if (entry.state == EES_FAILED && CSysChrono::getDurationMilliseconds(entry.failTime) >= ANIMFILE_RETRY_DELAY)
+			return queueLoad(entry);
+		return entry.state == EES_LOADED;
+	}
+
+	if (M2Files.insert(m2File).second)
+		m2File->setAnimFileCache(this);
+
+	SEntry entry;
+	entry.m2File = m2File;
+	entry.anim = anim;
+	entry.serial = 0;
+	entry.size = 0;
+	entry.state = EES_LOADING;
+	Entries.push_front(entry);
+	EntryMap[T_EntryKey(m2File, anim)] = Entries.begin();
+
+	return queueLoad(Entries.front());
+}
+
+bool wowAnimFileCache::queueLoad(SEntry& entry)
+{
+	entry.serial = NextSerial++;
+	entry.state = EES_LOADING;
+
+	const uint32_t fileId = entry.m2File->AnimFileIDs[entry.anim];
+	if (!Async)
+	{
+		apply(entry, WowEnvironment->openFileById(fileId));
+		evict(&entry);
+		return entry.state == EES_LOADED;
+	}
+
+	SLoadRequest request;
+	request.m2File = entry.m2File;
+	request.anim = entry.anim;
+	request.serial = entry.serial;
+	request.fileId = fileId;
+
+	BEGIN_LOCK(&QueueLock);
+	Requests.push_back(request);
+	END_LOCK(&QueueLock);
+	SET_EVENT(&LoaderEvent);
+
+	return false;
+}
+
+void wowAnimFileCache::removeM2File(wowM2File* m2File)
+{
+	if (M2Files.erase(m2File) == 0)
+		return;
+
+	for (auto itr = Entries.begin(); itr != Entries.end();)
+	{
+		if (itr->m2File == m2File)
+		{
+			UsedBytes -= itr->size;
+			EntryMap.erase(T_EntryKey(itr->m2File, itr->anim));
+			itr = Entries.erase(itr);
+		}
+		else
+		{
+			++itr;
+		}
+	}
+
+	//a file being read now is dropped by applyResults, the serial no longer matches
+	BEGIN_LOCK(&QueueLock);
+	for (auto itr = Requests.begin(); itr != Requests.end();)
+	{
+		if (itr->m2File == m2File)
+			itr = Requests.erase(itr);
+		else
+			++itr;
+	}
+	for (auto itr = Results.begin(); itr != Results.end();)
+	{
+		if (itr->m2File == m2File)
+		{
+			delete itr->memFile;
+			itr = Results.erase(itr);
+		}
+		else
+		{
+			++itr;
+		}
+	}
+	END_LOCK(&QueueLock);
+}
+
+void wowAnimFileCache::applyResults()
+{
+	std::vector<SLoadResult> results;
+	BEGIN_LOCK(&QueueLock);
+	results.swap(Results);
+	END_LOCK(&QueueLock);
+
+	if (results.empty())
+		return;
+
+	for (const SLoadResult& result : results)
+	{
+		auto itr = EntryMap.find(T_EntryKey(result.m2File, result.anim));
+		if (itr != EntryMap.end() && itr->second->serial == result.serial)
+			apply(*itr->second, result.memFile);
+		else
+			delete result.memFile;
+	}
+
+	evict(nullptr);
+}
+
+void wowAnimFileCache::apply(SEntry& entry, CMemFile* memFile)
+{
+	if (memFile && entry.m2File->loadAnimFile(entry.anim, memFile))
+	{
+		entry.state = EES_LOADED;
+		entry.size = entry.m2File->getAnimFileMemorySize(entry.anim);
+		UsedBytes += entry.size;
+	}
+	else
+	{
+		entry.state = EES_FAILED;
+		entry.failTime = CSysChrono::getTimePointNow();
+	}
+
+	delete memFile;
+}
+
+void wowAnimFileCache::evict(const SEntry* keep)
+{
+	auto itr = Entries.end();
+	while (UsedBytes > MaxBytes && itr != Entries.begin())
+	{
+		--itr;
+		if (&(*itr) == keep || itr->state == EES_LOADING)
+			continue;
+
+		itr->m2File->unloadAnimFile(itr->anim);
+		UsedBytes -= itr->size;
+		EntryMap.erase(T_EntryKey(itr->m2File, itr->anim));
+		itr = Entries.erase(itr);
+	}
+}
+
+int wowAnimFileCache::loaderThread()
+{
+	while (true)
+	{
+		WAIT_EVENT(&LoaderEvent);
+
+		while (true)
+		{
+			SLoadRequest request;
+			BEGIN_LOCK(&QueueLock);
+			if (Quit)
+			{
+				END_LOCK(&QueueLock);
+				return 0;
+			}
+			if (Requests.empty())
+			{
+				END_LOCK(&QueueLock);
+				break;
+			}
+			request = Requests.front();
+			Requests.pop_front();
+			END_LOCK(&QueueLock);
+
+			SLoadResult result;
+			result.m2File = request.m2File;
+			result.anim = request.anim;
+			result.serial = request.serial;
+			result.memFile = WowEnvironment->openFileById(request.fileId);
+
+			BEGIN_LOCK(&QueueLock);
+			Results.push_back(result);
+			END_LOCK(&QueueLock);
+		}
+	}
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stdint.h>
+#include <list>
+#include <map>
+#include <set>
+#include <deque>
+#include <vector>
+#include "CSysThread.h"
+#include "CSysSync.h"
+#include "CSysChrono.h"
+
+#define ANIMFILE_RETRY_DELAY	5000
+
+class wowEnvironment;
+class wowM2File;
+class CMemFile;
+
+//.anim files of external sequences, read on first request and kept in a LRU list bounded by maxBytes of decoded keys
+//a file that fails to load is requested again after ANIMFILE_RETRY_DELAY ms
+//with async the files are read on a loader thread, the keys are built by requestAnimation on the calling thread
+class wowAnimFileCache
+{
+public:
+	wowAnimFileCache(const wowEnvironment* wowEnv, uint32_t maxBytes, bool async = true);
+	~wowAnimFileCache();
+
+	wowAnimFileCache(const wowAnimFileCache&) = delete;
+	wowAnimFileCache& operator=(const wowAnimFileCache&) = delete;
+
+public:
+	//true if the keys of the sequence can be evaluated, otherwise its .anim file is queued
+	bool requestAnimation(wowM2File* m2File, uint32_t anim);
+
+	//called by the m2 file when it is destroyed
+	void removeM2File(wowM2File* m2File);
+
+	uint32_t getUsedBytes() const { return UsedBytes; }
+	uint32_t getMaxBytes() const { return MaxBytes; }
+	uint32_t getNumEntries() const { return (uint32_t)Entries.size(); }
+
+private:
+	enum E_ENTRY_STATE
+	{
+		EES_LOADING = 0,
+		EES_LOADED,
+		EES_FAILED,
+	};
+
+	struct SEntry
+	{
+		wowM2File*	m2File;
+		uint32_t	anim;
+		uint32_t	serial;
+		uint32_t	size;
+		E_ENTRY_STATE	state;
+		TIME_POINT	failTime;
+	};
+
+	struct SLoadRequest
+	{
+		wowM2File*	m2File;
+		uint32_t	anim;
+		uint32_t	serial;
+		uint32_t	fileId;
+	};
+
+	struct SLoadResult
+	{
+		wowM2File*	m2File;
+		uint32_t	anim;
+		uint32_t	serial;
+		CMemFile*	memFile;
+	};
+
+	using T_EntryList = std::list<SEntry>;
+	using T_EntryKey = std::pair<wowM2File*, uint32_t>;
+
+	bool queueLoad(SEntry& entry);
+	void applyResults();
+	void apply(SEntry& entry, CMemFile* memFile);
+	void evict(const SEntry* keep);
+	int loaderThread();
+
+private:
+	const wowEnvironment*	WowEnvironment;
+	uint32_t	MaxBytes;
+	uint32_t	UsedBytes;
+	uint32_t	NextSerial;
+	bool	Async;
+
+	T_EntryList	Entries;				//most recently requested first
+	std::map<T_EntryKey, T_EntryList::iterator>	EntryMap;
+	std::set<wowM2File*>	M2Files;
+
+	//loader thread
+	thread_type		LoaderThread;
+	event_type		LoaderEvent;
+	lock_type		QueueLock;
+	std::deque<SLoadRequest>	Requests;
+	std::vector<SLoadResult>	Results;
+	bool	Quit;
+};
@@ -1,7 +1,15 @@
 #pragma once
 
 #include "wowM2Struct.h"
+#include <float.h>
+#include <vector>
 
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define WOWANIMATION_USE_SSE
+#include <emmintrin.h>
+#endif
+
+//no data: keys are in the m2 file, or the .anim file is not loaded yet if size is set
 struct SAnimFile
 {
 	uint8_t* data;
@@ -39,6 +47,37 @@ enum Interpolations : int32_t
 	INTERPOLATION_HERMITE,
 };
 
+//layout of a cooked track: the track, an entry per animation, then the keys of the entries with keys
+struct SAnimationCookedTrack
+{
+	int16_t		type;
+	int16_t		reserved;
+	int32_t		seq;
+	uint32_t	numAnimations;
+};
+
+struct SAnimationCookedEntry
+{
+	uint32_t	numKeys;
+	uint32_t	layout;				//E_ANIMATION_KEY_LAYOUT
+	uint32_t	externalNumKeys;
+	uint32_t	externalTimesOfs;
+	uint32_t	externalValuesOfs;
+};
+
+enum E_ANIMATION_KEY_LAYOUT : uint32_t
+{
+	EAKL_VALUES = 0,
+	EAKL_HERMITE,
+	EAKL_PACKED,
+};
+
+inline void appendCookedData(std::vector<uint8_t>& data, const void* src, size_t size)
+{
+	if (size)
+		data.insert(data.end(), (const uint8_t*)src, (const uint8_t*)src + size);
+}
+
 template <class T>
 class Identity {
 public:
@@ -81,6 +120,96 @@ public:
 	}
 };
 
+//compressed tracks keep the raw keys of types that are smaller in the file
+template <class T, class D, class Conv>
+struct SAnimationPacking
+{
+	enum { Enabled = 0 };
+
+	static void decode(const D* p, T& v) { v = Conv::conv(*p); }
+	static void decodePair(const D* p, T& v0, T& v1) { v0 = Conv::conv(p[0]); v1 = Conv::conv(p[1]); }
+};
+
+template <>
+struct SAnimationPacking<quaternion, PACK_QUATERNION, Quat16ToMinusQuat32>
+{
+	enum { Enabled = 1 };
+
+	static void decode(const PACK_QUATERNION* p, quaternion& v) { v = Quat16ToMinusQuat32::conv(*p); }
+
+	//the keys of a linear segment are adjacent, both are decoded from one load
+	static void decodePair(const PACK_QUATERNION* p, quaternion& v0, quaternion& v1)
+	{
+#ifdef WOWANIMATION_USE_SSE
+		const __m128i raw = _mm_loadu_si128((const __m128i*)p);
+		const __m128i c0 = _mm_srai_epi32(_mm_unpacklo_epi16(raw, raw), 16);
+		const __m128i c1 = _mm_srai_epi32(_mm_unpackhi_epi16(raw, raw), 16);
+
+		//c < 0 ? c + 32768 : c - 32767
+		const __m128i base = _mm_set1_epi32(-32767);
+		const __m128i range = _mm_set1_epi32(65535);
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i i0 = _mm_add_epi32(c0, _mm_add_epi32(base, _mm_and_si128(_mm_cmplt_epi32(c0, zero), range)));
+		const __m128i i1 = _mm_add_epi32(c1, _mm_add_epi32(base, _mm_and_si128(_mm_cmplt_epi32(c1, zero), range)));
+
+		const __m128 scale = _mm_set1_ps(32767.0f);
+		const __m128 sign = _mm_set_ps(-0.0f, 0.0f, 0.0f, 0.0f);
+		__m128 f0 = _mm_div_ps(_mm_cvtepi32_ps(i0), scale);
+		__m128 f1 = _mm_div_ps(_mm_cvtepi32_ps(i1), scale);
+
+		//(x, z, y, -w)
+		f0 = _mm_xor_ps(_mm_shuffle_ps(f0, f0, _MM_SHUFFLE(3, 1, 2, 0)), sign);
+		f1 = _mm_xor_ps(_mm_shuffle_ps(f1, f1, _MM_SHUFFLE(3, 1, 2, 0)), sign);
+		_mm_storeu_ps(&v0.x, f0);
+		_mm_storeu_ps(&v1.x, f1);
+#else
+		v0 = Quat16ToMinusQuat32::conv(p[0]);
+		v1 = Quat16ToMinusQuat32::conv(p[1]);
+#endif
+	}
+};
+
+//difference of two keys checked against the compression tolerance, other types are not reduced
+template <class T>
+struct SAnimationKeyError
+{
+	static float error(const T& v0, const T& v1) { return FLT_MAX; }
+};
+
+template <>
+struct SAnimationKeyError<float>
+{
+	static float error(const float& v0, const float& v1) { return fabsf(v0 - v1); }
+};
+
+template <>
+struct SAnimationKeyError<vector3df>
+{
+	static float error(const vector3df& v0, const vector3df& v1) { return v0.getDistanceFrom(v1); }
+};
+
+template <>
+struct SAnimationKeyError<quaternion>
+{
+	//rotation angle between the keys, decoded and interpolated keys are not exactly unit length
+	static float error(const quaternion& v0, const quaternion& v1)
+	{
+		float len0 = sqrtf(v0.dotProduct(v0));
+		float len1 = sqrtf(v1.dotProduct(v1));
+		if (len0 == 0.0f || len1 == 0.0f)
+			return FLT_MAX;
+
+		//chord length instead of acos of the dot product, which is too coarse for small angles
+		float s1 = (v0.dotProduct(v1) < 0.0f ? -1.0f : 1.0f) / len1;
+		float dx = v0.x / len0 - v1.x * s1;
+		float dy = v0.y / len0 - v1.y * s1;
+		float dz = v0.z / len0 - v1.z * s1;
+		float dw = v0.w / len0 - v1.w * s1;
+		float chord = sqrtf(dx * dx + dy * dy + dz * dz + dw * dw) * 0.5f;
+		return 4.0f * asinf(chord < 1.0f ? chord : 1.0f);
+	}
+};
+
 //Ӧһanimation blockanimation blocktrack time&value 
 template <class T, class D = T, class Conv = Identity<T> >
 class SWowAnimation
@@ -88,25 +217,94 @@ class SWowAnimation
 public:
 	SWowAnimation()
 		: Type(INTERPOLATION_NONE), Seq(-1),
-		GlobalSeq(nullptr), NumGlobalSeq(0) { }
+		GlobalSeq(nullptr), NumGlobalSeq(0), Tolerance(-1.0f) { }
+
+	//before init, constant tracks are collapsed and linear keys within tolerance are removed, < 0 for raw tracks
+	void setCompression(float tolerance) { Tolerance = tolerance; }
 
 	void init(const M2::animblock* block, const uint8_t* fileData, int32_t* globalSeq, uint32_t numGlobalSeq);
 	void init(const M2::animblock* block, const uint8_t* m2FileData, SAnimFile* animFiles, int32_t* globalSeq, uint32_t numGlobalSeq);
 
+	//keys of an animation skipped by init, read from its .anim file data
+	bool loadAnimFile(uint32_t anim, const uint8_t* animFileData, uint32_t animFileSize);
+	void unloadAnimFile(uint32_t anim);
+
+	//keys as they are stored, converted and compressed, keys loaded from .anim files are not written
+	void cook(std::vector<uint8_t>& data) const;
+	//keys written by cook, instead of init, returns the end of the track or null if the data is truncated
+	const uint8_t* loadCooked(const uint8_t* data, const uint8_t* end, int32_t* globalSeq, uint32_t numGlobalSeq);
+
 public:
 	int32_t		getValue(uint32_t anim, uint32_t time, T& v, int32_t hint = 0) const;			//ڼĳʱĲֵ
 	uint32_t		getNumAnimations() const { return (uint32_t)Animations.size(); }
 	bool		hasAnimation(uint32_t anim) const { return anim < (uint32_t)Animations.size(); }
+	bool		hasKeys() const;			//in any animation, also the ones of .anim files not loaded yet
 	uint32_t		getGlobalSeq(uint32_t idx) const;
+	uint32_t		getMemorySize() const;
+	uint32_t		getAnimMemorySize(uint32_t anim) const;			//decoded keys of one animation
+
+	//first key >= time in [1, numKeys - 1], times[0] < time <= times[numKeys - 1]
+	static int32_t	findKey(const uint32_t* times, uint32_t numKeys, uint32_t time)
+	{
+		const uint32_t* base = times + 1;
+		uint32_t len = numKeys - 1;
+		while (len > 1)
+		{
+			uint32_t half = len / 2;
+			base = (base[half] < time) ? base + half : base;
+			len -= half;
+		}
+		return (int32_t)(base - times) + (*base < time);
+	}
 
 	int16_t		Type;
 private:
 	struct	SAnimationEntry				//animation
 	{
-		SAnimationEntry() : numKeys(0), times(nullptr), values(nullptr), values1(nullptr), values2(nullptr) { }
+		SAnimationEntry() : numKeys(0), times(nullptr), values(nullptr), values1(nullptr), values2(nullptr), packed(nullptr),
+			externalNumKeys(0), externalTimesOfs(0), externalValuesOfs(0) { }
 		~SAnimationEntry()
 		{
-			delete times;
+			delete[] (uint8_t*)times;
+		}
+
+		void set(int16_t type, const uint32_t* srcTimes, const D* srcValues, uint32_t num);
+		void setPacked(const uint32_t* srcTimes, const D* srcValues, uint32_t num);
+		void setCooked(uint32_t layout, const uint8_t* src, uint32_t num);
+		void clear();
+
+		//times and values are in one allocation
+		uint32_t getLayout() const { return packed ? EAKL_PACKED : (values1 ? EAKL_HERMITE : EAKL_VALUES); }
+		static uint32_t getDataSize(uint32_t layout, uint32_t num)
+		{
+			switch (layout)
+			{
+			case EAKL_VALUES: return (uint32_t)(sizeof(uint32_t) + sizeof(T)) * num;
+			case EAKL_HERMITE: return (uint32_t)(sizeof(uint32_t) + sizeof(T) * 3) * num;
+			case EAKL_PACKED: return (uint32_t)(sizeof(uint32_t) + sizeof(D)) * num;
+			default: return 0;
+			}
+		}
+
+		void getKey(uint32_t i, T& v) const
+		{
+			if (packed)
+				SAnimationPacking<T, D, Conv>::decode(packed + i, v);
+			else
+				v = values[i];
+		}
+
+		void getKeys(uint32_t i, T& v0, T& v1) const
+		{
+			if (packed)
+			{
+				SAnimationPacking<T, D, Conv>::decodePair(packed + i, v0, v1);
+			}
+			else
+			{
+				v0 = values[i];
+				v1 = values[i + 1];
+			}
 		}
 
 		uint32_t		numKeys;
@@ -114,6 +312,12 @@ private:
 		T*		values;
 		T*		values1;					//for hermite interpolation
 		T*		values2;
+		D*		packed;						//raw keys instead of values
+
+		//keys in the .anim file
+		uint32_t		externalNumKeys;
+		uint32_t		externalTimesOfs;
+		uint32_t		externalValuesOfs;
 	};
 
 	uint32_t		NumGlobalSeq;
@@ -121,6 +325,10 @@ private:
 	std::vector<SAnimationEntry>		Animations;
 
 	int32_t*		GlobalSeq;
+	float		Tolerance;
+
+private:
+	void setKeys(SAnimationEntry& entry, const uint32_t* srcTimes, const D* srcValues, uint32_t num);
 };
 
 template <class T, class D, class Conv>
@@ -163,40 +371,7 @@ void SWowAnimation<T, D, Conv>::init(const M2::animblock* block, const uint8_t*
 		uint32_t* times = (uint32_t*)(fileData + p->_SequencesOfs);
 		const D* values = reinterpret_cast<const D*>(fileData + v->_SequencesOfs);
 
-		switch (Type)
-		{
-		case INTERPOLATION_NONE:
-		case INTERPOLATION_LINEAR:
-		{
-			Animations[i].times = (uint32_t*)new uint8_t[sizeof(uint32_t) * num + sizeof(T) * num];
-			Animations[i].values = (T*)((uint8_t*)Animations[i].times + sizeof(uint32_t) * num);
-
-			Q_memcpy(Animations[i].times, sizeof(uint32_t)*num, times, sizeof(uint32_t)*num);
-			for (uint32_t j = 0; j < num; ++j)
-			{
-				Animations[i].values[j] = Conv::conv(values[j]);
-			}
-		}
-		break;
-		case INTERPOLATION_HERMITE:
-		{
-			Animations[i].times = (uint32_t*)new uint8_t[sizeof(uint32_t) * num + sizeof(T) * num + sizeof(T) * num + sizeof(T) * num];
-			Animations[i].values = (T*)((uint8_t*)Animations[i].times + sizeof(uint32_t) * num);
-			Animations[i].values1 = (T*)((uint8_t*)Animations[i].times + sizeof(uint32_t) * num + sizeof(T) * num);
-			Animations[i].values2 = (T*)((uint8_t*)Animations[i].times + sizeof(uint32_t) * num + sizeof(T) * num + sizeof(T) * num);
-
-			Q_memcpy(Animations[i].times, sizeof(uint32_t)*num, times, sizeof(uint32_t)*num);
-			for (uint32_t j = 0; j < num; ++j)
-			{
-				Animations[i].values[j] = Conv::conv(values[j * 3]);
-				Animations[i].values1[j] = Conv::conv(values[j * 3 + 1]);
-				Animations[i].values2[j] = Conv::conv(values[j * 3 + 2]);
-			}
-		}
-		break;
-		default:
-			ASSERT(false);
-		}
+		setKeys(Animations[i], times, values, num);
 	}
 }
 
@@ -225,6 +400,16 @@ void SWowAnimation<T, D, Conv>::init(const M2::animblock* block, const uint8_t*
 		if (Animations[i].numKeys == 0)
 			continue;
 
+		if (Seq < 0 && !animFiles[i].data && animFiles[i].size)
+		{
+			M2::sequence* v = (M2::sequence*)(m2FileData + block->_ValuesOfs + i * sizeof(M2::sequence));
+			Animations[i].externalNumKeys = Animations[i].numKeys;
+			Animations[i].externalTimesOfs = p->_SequencesOfs;
+			Animations[i].externalValuesOfs = v->_SequencesOfs;
+			Animations[i].numKeys = 0;
+			continue;
+		}
+
 		uint32_t num = Animations[i].numKeys;
 
 		uint32_t* times;
@@ -241,41 +426,311 @@ void SWowAnimation<T, D, Conv>::init(const M2::animblock* block, const uint8_t*
 		else
 			values = reinterpret_cast<const D*>(m2FileData + v->_SequencesOfs);
 
-		switch (Type)
-		{
-		case INTERPOLATION_NONE:
-		case INTERPOLATION_LINEAR:
+		setKeys(Animations[i], times, values, num);
+	}
+}
+
+template <class T, class D, class Conv>
+void SWowAnimation<T, D, Conv>::SAnimationEntry::set(int16_t type, const uint32_t* srcTimes, const D* srcValues, uint32_t num)
+{
+	switch (type)
+	{
+	case INTERPOLATION_NONE:
+	case INTERPOLATION_LINEAR:
+	{
+		times = (uint32_t*)new uint8_t[sizeof(uint32_t) * num + sizeof(T) * num];
+		values = (T*)((uint8_t*)times + sizeof(uint32_t) * num);
+
+		Q_memcpy(times, sizeof(uint32_t)*num, srcTimes, sizeof(uint32_t)*num);
+		for (uint32_t j = 0; j < num; ++j)
 		{
-			Animations[i].times = (uint32_t*)new uint8_t[sizeof(uint32_t) * num + sizeof(T) * num];
-			Animations[i].values = (T*)((uint8_t*)Animations[i].times + sizeof(uint32_t) * num);
+			values[j] = Conv::conv(srcValues[j]);
+		}
+	}
+	break;
+	case INTERPOLATION_HERMITE:
+	{
+		times = (uint32_t*)new uint8_t[sizeof(uint32_t) * num + sizeof(T) * num + sizeof(T) * num + sizeof(T) * num];
+		values = (T*)((uint8_t*)times + sizeof(uint32_t) * num);
+		values1 = (T*)((uint8_t*)times + sizeof(uint32_t) * num + sizeof(T) * num);
+		values2 = (T*)((uint8_t*)times + sizeof(uint32_t) * num + sizeof(T) * num + sizeof(T) * num);
 
-			Q_memcpy(Animations[i].times, sizeof(uint32_t)*num, times, sizeof(uint32_t)*num);
-			for (uint32_t j = 0; j < num; ++j)
-			{
-				Animations[i].values[j] = Conv::conv(values[j]);
-			}
+		Q_memcpy(times, sizeof(uint32_t)*num, srcTimes, sizeof(uint32_t)*num);
+		for (uint32_t j = 0; j < num; ++j)
+		{
+			values[j] = Conv::conv(srcValues[j * 3]);
+			values1[j] = Conv::conv(srcValues[j * 3 + 1]);
+			values2[j] = Conv::conv(srcValues[j * 3 + 2]);
 		}
+	}
+	break;
+	default:
+		ASSERT(false);
+	}
+}
+
+template <class T, class D, class Conv>
+void SWowAnimation<T, D, Conv>::SAnimationEntry::setPacked(const uint32_t* srcTimes, const D* srcValues, uint32_t num)
+{
+	times = (uint32_t*)new uint8_t[sizeof(uint32_t) * num + sizeof(D) * num];
+	packed = (D*)((uint8_t*)times + sizeof(uint32_t) * num);
+
+	Q_memcpy(times, sizeof(uint32_t)*num, srcTimes, sizeof(uint32_t)*num);
+	Q_memcpy(packed, sizeof(D)*num, srcValues, sizeof(D)*num);
+}
+
+template <class T, class D, class Conv>
+void SWowAnimation<T, D, Conv>::SAnimationEntry::setCooked(uint32_t layout, const uint8_t* src, uint32_t num)
+{
+	const uint32_t size = getDataSize(layout, num);
+	times = (uint32_t*)new uint8_t[size];
+	memcpy(times, src, size);
+
+	uint8_t* p = (uint8_t*)times + sizeof(uint32_t) * num;
+	switch (layout)
+	{
+	case EAKL_VALUES:
+		values = (T*)p;
 		break;
-		case INTERPOLATION_HERMITE:
+	case EAKL_HERMITE:
+		values = (T*)p;
+		values1 = (T*)(p + sizeof(T) * num);
+		values2 = (T*)(p + sizeof(T) * num * 2);
+		break;
+	case EAKL_PACKED:
+		packed = (D*)p;
+		break;
+	default:
+		ASSERT(false);
+	}
+	numKeys = num;
+}
+
+template <class T, class D, class Conv>
+void SWowAnimation<T, D, Conv>::SAnimationEntry::clear()
+{
+	numKeys = 0;
+	delete[] (uint8_t*)times;
+	times = nullptr;
+	values = values1 = values2 = nullptr;
+	packed = nullptr;
+}
+
+template <class T, class D, class Conv>
+void SWowAnimation<T, D, Conv>::setKeys(SAnimationEntry& entry, const uint32_t* srcTimes, const D* srcValues, uint32_t num)
+{
+	if (Tolerance < 0 || Type == INTERPOLATION_HERMITE || num < 2)
+	{
+		entry.set(Type, srcTimes, srcValues, num);
+		entry.numKeys = num;
+		return;
+	}
+
+	std::vector<T> decoded(num);
+	for (uint32_t j = 0; j < num; ++j)
+		decoded[j] = Conv::conv(srcValues[j]);
+
+	//kept keys, a constant track keeps the first one
+	std::vector<uint32_t> keys;
+	keys.push_back(0);
+
+	bool constant = true;
+	for (uint32_t j = 1; j < num && constant; ++j)
+		constant = SAnimationKeyError<T>::error(decoded[j], decoded[0]) <= Tolerance;
+
+	if (!constant)
+	{
+		uint32_t anchor = 0;
+		for (uint32_t j = 2; j < num; ++j)
 		{
-			Animations[i].times = (uint32_t*)new uint8_t[sizeof(uint32_t) * num + sizeof(T) * num + sizeof(T) * num + sizeof(T) * num];
-			Animations[i].values = (T*)((uint8_t*)Animations[i].times + sizeof(uint32_t) * num);
-			Animations[i].values1 = (T*)((uint8_t*)Animations[i].times + sizeof(uint32_t) * num + sizeof(T) * num);
-			Animations[i].values2 = (T*)((uint8_t*)Animations[i].times + sizeof(uint32_t) * num + sizeof(T) * num + sizeof(T) * num);
+			//keys between anchor and j must be reproduced by the segment anchor -> j
+			bool reduce = srcTimes[j] > srcTimes[anchor];
+			for (uint32_t k = anchor + 1; k < j && reduce; ++k)
+			{
+				T v;
+				if (Type == INTERPOLATION_LINEAR)
+				{
+					float r = (srcTimes[k] - srcTimes[anchor]) / (float)(srcTimes[j] - srcTimes[anchor]);
+					v = interpolate<T>(r, decoded[anchor], decoded[j]);
+				}
+				else
+				{
+					v = decoded[anchor];
+				}
+				reduce = SAnimationKeyError<T>::error(v, decoded[k]) <= Tolerance;
+			}
 
-			Q_memcpy(Animations[i].times, sizeof(uint32_t)*num, times, sizeof(uint32_t)*num);
-			for (uint32_t j = 0; j < num; ++j)
+			if (!reduce)
 			{
-				Animations[i].values[j] = Conv::conv(values[j * 3]);
-				Animations[i].values1[j] = Conv::conv(values[j * 3 + 1]);
-				Animations[i].values2[j] = Conv::conv(values[j * 3 + 2]);
+				anchor = j - 1;
+				keys.push_back(anchor);
 			}
 		}
-		break;
-		default:
-			ASSERT(false);
-		}
+		keys.push_back(num - 1);
 	}
+
+	const uint32_t numKeys = (uint32_t)keys.size();
+	std::vector<uint32_t> times(numKeys);
+	std::vector<D> values(numKeys);
+	for (uint32_t j = 0; j < numKeys; ++j)
+	{
+		times[j] = srcTimes[keys[j]];
+		values[j] = srcValues[keys[j]];
+	}
+
+	if (SAnimationPacking<T, D, Conv>::Enabled)
+		entry.setPacked(times.data(), values.data(), numKeys);
+	else
+		entry.set(Type, times.data(), values.data(), numKeys);
+	entry.numKeys = numKeys;
+}
+
+template <class T, class D, class Conv>
+bool SWowAnimation<T, D, Conv>::loadAnimFile(uint32_t anim, const uint8_t* animFileData, uint32_t animFileSize)
+{
+	if (anim >= (uint32_t)Animations.size())
+		return false;
+
+	SAnimationEntry& entry = Animations[anim];
+	const uint32_t num = entry.externalNumKeys;
+	if (num == 0 || entry.numKeys != 0)
+		return true;
+
+	const uint32_t numValues = Type == INTERPOLATION_HERMITE ? num * 3 : num;
+	if (entry.externalTimesOfs + sizeof(uint32_t) * num > animFileSize ||
+		entry.externalValuesOfs + sizeof(D) * numValues > animFileSize)
+	{
+		ASSERT(false);
+		return false;
+	}
+
+	setKeys(entry, (const uint32_t*)(animFileData + entry.externalTimesOfs), reinterpret_cast<const D*>(animFileData + entry.externalValuesOfs), num);
+	return true;
+}
+
+template <class T, class D, class Conv>
+void SWowAnimation<T, D, Conv>::unloadAnimFile(uint32_t anim)
+{
+	if (anim >= (uint32_t)Animations.size())
+		return;
+
+	SAnimationEntry& entry = Animations[anim];
+	if (entry.externalNumKeys == 0)
+		return;
+
+	entry.clear();
+}
+
+template <class T, class D, class Conv>
+void SWowAnimation<T, D, Conv>::cook(std::vector<uint8_t>& data) const
+{
+	SAnimationCookedTrack track;
+	track.type = Type;
+	track.reserved = 0;
+	track.seq = Seq;
+	track.numAnimations = (uint32_t)Animations.size();
+	appendCookedData(data, &track, sizeof(track));
+
+	for (const SAnimationEntry& entry : Animations)
+	{
+		SAnimationCookedEntry cooked;
+		cooked.numKeys = entry.externalNumKeys > 0 ? 0 : entry.numKeys;
+		cooked.layout = entry.getLayout();
+		cooked.externalNumKeys = entry.externalNumKeys;
+		cooked.externalTimesOfs = entry.externalTimesOfs;
+		cooked.externalValuesOfs = entry.externalValuesOfs;
+		appendCookedData(data, &cooked, sizeof(cooked));
+	}
+
+	for (const SAnimationEntry& entry : Animations)
+	{
+		if (entry.externalNumKeys == 0 && entry.numKeys > 0)
+			appendCookedData(data, entry.times, SAnimationEntry::getDataSize(entry.getLayout(), entry.numKeys));
+	}
+}
+
+template <class T, class D, class Conv>
+const uint8_t* SWowAnimation<T, D, Conv>::loadCooked(const uint8_t* data, const uint8_t* end, int32_t* globalSeq, uint32_t numGlobalSeq)
+{
+	SAnimationCookedTrack track;
+	if ((size_t)(end - data) < sizeof(track))
+		return nullptr;
+	memcpy(&track, data, sizeof(track));
+	data += sizeof(track);
+
+	Type = track.type;
+	Seq = track.seq;
+	GlobalSeq = globalSeq;
+	NumGlobalSeq = numGlobalSeq;
+
+	if ((size_t)(end - data) / sizeof(SAnimationCookedEntry) < track.numAnimations)
+		return nullptr;
+
+	const uint8_t* keys = data + sizeof(SAnimationCookedEntry) * track.numAnimations;
+	Animations.resize(track.numAnimations);
+	for (uint32_t i = 0; i < track.numAnimations; ++i)
+	{
+		SAnimationCookedEntry cooked;
+		memcpy(&cooked, data + sizeof(SAnimationCookedEntry) * i, sizeof(cooked));
+
+		SAnimationEntry& entry = Animations[i];
+		entry.externalNumKeys = cooked.externalNumKeys;
+		entry.externalTimesOfs = cooked.externalTimesOfs;
+		entry.externalValuesOfs = cooked.externalValuesOfs;
+		if (cooked.numKeys == 0)
+			continue;
+
+		if (cooked.numKeys > (size_t)(end - keys) / sizeof(uint32_t))
+			return nullptr;
+		const uint32_t size = SAnimationEntry::getDataSize(cooked.layout, cooked.numKeys);
+		if (size == 0 || (size_t)(end - keys) < size)
+			return nullptr;
+
+		entry.setCooked(cooked.layout, keys, cooked.numKeys);
+		keys += size;
+	}
+	return keys;
+}
+
+template <class T, class D, class Conv>
+bool SWowAnimation<T, D, Conv>::hasKeys() const
+{
+	for (const SAnimationEntry& entry : Animations)
+	{
+		if (entry.numKeys > 0 || entry.externalNumKeys > 0)
+			return true;
+	}
+	return false;
+}
+
+template <class T, class D, class Conv>
+uint32_t SWowAnimation<T, D, Conv>::getMemorySize() const
+{
+	uint32_t size = sizeof(*this) + (uint32_t)(Animations.capacity() * sizeof(SAnimationEntry));
+	for (const SAnimationEntry& entry : Animations)
+	{
+		if (!entry.times)
+			continue;
+
+		uint32_t num = entry.numKeys;
+		if (entry.packed)
+			size += (sizeof(uint32_t) + sizeof(D)) * num;
+		else if (entry.values1)
+			size += (sizeof(uint32_t) + sizeof(T) * 3) * num;
+		else
+			size += (sizeof(uint32_t) + sizeof(T)) * num;
+	}
+	return size;
+}
+
+template <class T, class D, class Conv>
+uint32_t SWowAnimation<T, D, Conv>::getAnimMemorySize(uint32_t anim) const
+{
+	if (anim >= (uint32_t)Animations.size() || !Animations[anim].times)
+		return 0;
+
+	const SAnimationEntry& entry = Animations[anim];
+	return SAnimationEntry::getDataSize(entry.getLayout(), entry.numKeys);
 }
 
 template <class T, class D, class Conv>
@@ -300,27 +755,23 @@ int32_t SWowAnimation<T, D, Conv>::getValue(uint32_t anim, uint32_t time, T& v,
 
 		if (time <= entry.times[0])			//СС֡
 		{
-			v = entry.values[0];
+			entry.getKey(0, v);
 			return 0;
 		}
 		else if (time >= entry.times[entry.numKeys - 1])		//֡
 		{
-			v = entry.values[entry.numKeys - 1];
+			entry.getKey(entry.numKeys - 1, v);
 			return (int32_t)entry.numKeys - 1;
 		}
 
-		uint32_t i = 1;
-		if (hint > 1 && time > entry.times[hint - 1])					//
-			i = hint;
-
-		for (; i < entry.numKeys; ++i)
-		{
-			if (time <= entry.times[i])
-			{
-				pos = i;
-				break;
-			}
-		}
+		//cursor from the last call, playback usually stays in the same key or moves to the next one
+		const uint32_t* times = entry.times;
+		if (hint > 0 && hint < (int32_t)entry.numKeys && time <= times[hint] && time > times[hint - 1])
+			pos = hint;
+		else if (hint > 0 && hint + 1 < (int32_t)entry.numKeys && time <= times[hint + 1] && time > times[hint])
+			pos = hint + 1;
+		else
+			pos = findKey(times, entry.numKeys, time);
 
 		if (pos != -1)
 		{
@@ -331,11 +782,15 @@ int32_t SWowAnimation<T, D, Conv>::getValue(uint32_t anim, uint32_t time, T& v,
 			switch (Type)
 			{
 			case INTERPOLATION_NONE:
-				v = entry.values[pos - 1];
+				entry.getKey(pos - 1, v);
 				break;
 			case INTERPOLATION_LINEAR:
-				v = interpolate<T>(r, entry.values[pos - 1], entry.values[pos]);
-				break;
+			{
+				T v0, v1;
+				entry.getKeys(pos - 1, v0, v1);
+				v = interpolate<T>(r, v0, v1);
+			}
+			break;
 			case INTERPOLATION_HERMITE:
 				v = interpolateHermite<T>(r, entry.values[pos - 1], entry.values[pos], entry.values1[pos - 1], entry.values2[pos - 1]);
 				break;
@@ -347,7 +802,7 @@ int32_t SWowAnimation<T, D, Conv>::getValue(uint32_t anim, uint32_t time, T& v,
 	}
 	else if (entry.numKeys == 1)
 	{
-		v = entry.values[0];
+		entry.getKey(0, v);
 		pos = 0;
 	}
 
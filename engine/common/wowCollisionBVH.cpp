@@ -0,0 +1,549 @@
+#include "wowCollisionBVH.h"
+
+#include <algorithm>
+#include <cfloat>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define COLLISIONBVH_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+#define BVH_LEAF_TRIANGLES		4
+#define BVH_MAX_LEAF_TRIANGLES		16
+#define BVH_SAH_BINS		16
+#define BVH_STACK_SIZE		64
+
+static float getHalfArea(const aabbox3df& box)
+{
+	const vector3df e = box.MaxEdge - box.MinEdge;
+	return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+static float getAxis(const vector3df& v, uint32_t axis)
+{
+	return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+//Moller-Trumbore, both sides
+bool wowCollisionBVH::intersectRayTriangle(const vector3df& start, const vector3df& dir, const vector3df* v, float& t)
+{
+	const vector3df e1 = v[1] - v[0];
+	const vector3df e2 = v[2] - v[0];
+	const vector3df p = dir.crossProduct(e2);
+	const float det = e1.dotProduct(p);
+	if (fabsf(det) < 1e-12f)
+		return false;
+
+	const float invDet = 1.0f / det;
+	const vector3df s = start - v[0];
+	const float u = s.dotProduct(p) * invDet;
+	if (u < 0.0f || u > 1.0f)
+		return false;
+
+	const vector3df q = s.crossProduct(e1);
+	const float w = dir.dotProduct(q) * invDet;
+	if (w < 0.0f || u + w > 1.0f)
+		return false;
+
+	t = e2.dotProduct(q) * invDet;
+	return true;
+}
+
+//Ericson, Real-Time Collision Detection 5.1.5
+vector3df wowCollisionBVH::getClosestPointOnTriangle(const vector3df& p, const vector3df* v)
+{
+	const vector3df ab = v[1] - v[0];
+	const vector3df ac = v[2] - v[0];
+	const vector3df ap = p - v[0];
+	const float d1 = ab.dotProduct(ap);
+	const float d2 = ac.dotProduct(ap);
+	if (d1 <= 0.0f && d2 <= 0.0f)
+		return v[0];
+
+	const vector3df bp = p - v[1];
+	const float d3 = ab.dotProduct(bp);
+	const float d4 = ac.dotProduct(bp);
+	if (d3 >= 0.0f && d4 <= d3)
+		return v[1];
+
+	const float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+		return v[0] + ab * (d1 / (d1 - d3));
+
+	const vector3df cp = p - v[2];
+	const float d5 = ab.dotProduct(cp);
+	const float d6 = ac.dotProduct(cp);
+	if (d6 >= 0.0f && d5 <= d6)
+		return v[2];
+
+	const float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+		return v[0] + ac * (d2 / (d2 - d6));
+
+	const float va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+		return v[1] + (v[2] - v[1]) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+	const float denom = 1.0f / (va + vb + vc);
+	return v[0] + ab * (vb * denom) + ac * (vc * denom);
+}
+
+//separating axis test of a triangle against the box center +- halfSize
+static bool intersectTriangleBox(const vector3df* tri, const vector3df& center, const vector3df& halfSize)
+{
+	const vector3df v[3] = { tri[0] - center, tri[1] - center, tri[2] - center };
+	const vector3df edges[3] = { v[1] - v[0], v[2] - v[1], v[0] - v[2] };
+	const vector3df axes[3] = { vector3df(1, 0, 0), vector3df(0, 1, 0), vector3df(0, 0, 1) };
+
+	auto separated = [&](const vector3df& axis)
+	{
+		const float p0 = v[0].dotProduct(axis);
+		const float p1 = v[1].dotProduct(axis);
+		const float p2 = v[2].dotProduct(axis);
+		const float r = halfSize.x * fabsf(axis.x) + halfSize.y * fabsf(axis.y) + halfSize.z * fabsf(axis.z);
+		return std::min(p0, std::min(p1, p2)) > r || std::max(p0, std::max(p1, p2)) < -r;
+	};
+
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		if (separated(axes[i]))
+			return false;
+	}
+
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		for (uint32_t j = 0; j < 3; ++j)
+		{
+			if (separated(axes[j].crossProduct(edges[i])))
+				return false;
+		}
+	}
+
+	return !separated(edges[0].crossProduct(edges[1]));
+}
+
+static float getDistanceSQToBox(const vector3df& p, const float* bmin, const float* bmax)
+{
+	float d = 0;
+	const float c[3] = { p.x, p.y, p.z };
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		if (c[i] < bmin[i])
+			d += (bmin[i] - c[i]) * (bmin[i] - c[i]);
+		else if (c[i] > bmax[i])
+			d += (c[i] - bmax[i]) * (c[i] - bmax[i]);
+	}
+	return d;
+}
+
+void wowCollisionBVH::build(const vector3df* vertices, uint32_t numVertices, const uint16_t* indices, uint32_t numIndices)
+{
+	clear();
+
+	std::vector<SBuildTriangle> triangles;
+	triangles.reserve(numIndices / 3);
+	for (uint32_t i = 0; i + 2 < numIndices; i += 3)
+	{
+		if (indices[i] >= numVertices || indices[i + 1] >= numVertices || indices[i + 2] >= numVertices)
+			continue;
+
+		SBuildTriangle tri;
+		tri.Box.clear();
+		for (uint32_t k = 0; k < 3; ++k)
+			tri.Box.addInternalPoint(vertices[indices[i + k]]);
+		tri.Center = tri.Box.getCenter();
+		tri.Index = i / 3;
+		triangles.push_back(tri);
+	}
+
+	if (triangles.empty())
+		return;
+
+	Nodes.reserve(triangles.size() * 2 / BVH_LEAF_TRIANGLES + 1);
+	Nodes.emplace_back();
+	buildNode(0, triangles, 0, (uint32_t)triangles.size(), 0);
+	Nodes.shrink_to_fit();
+
+	Vertices.resize(triangles.size() * 3);
+	TriangleIDs.resize(triangles.size());
+	for (uint32_t i = 0; i < (uint32_t)triangles.size(); ++i)
+	{
+		const uint32_t index = triangles[i].Index;
+		TriangleIDs[i] = index;
+		for (uint32_t k = 0; k < 3; ++k)
+			Vertices[i * 3 + k] = vertices[indices[index * 3 + k]];
+	}
+}
+
+void wowCollisionBVH::clear()
+{
+	Nodes.clear();
+	Vertices.clear();
+	TriangleIDs.clear();
+}
+
+aabbox3df wowCollisionBVH::getBoundingBox() const
+{
+	if (Nodes.empty())
+		return aabbox3df();
+
+	const SNode& root = Nodes[0];
+	return aabbox3df(root.Min[0], root.Min[1], root.Min[2], root.Max[0], root.Max[1], root.Max[2]);
+}
+
+void wowCollisionBVH::buildNode(uint32_t nodeIndex, std::vector<SBuildTriangle>& triangles, uint32_t begin, uint32_t end, uint32_t depth)
+{
+	aabbox3df box;
+	aabbox3df centerBox;
+	for (uint32_t i = begin; i < end; ++i)
+	{
+		box.addInternalBox(triangles[i].Box);
+		centerBox.addInternalPoint(triangles[i].Center);
+	}
+
+	{
+		SNode& node = Nodes[nodeIndex];
+		node.Min[0] = box.MinEdge.x; node.Min[1] = box.MinEdge.y; node.Min[2] = box.MinEdge.z;
+		node.Max[0] = box.MaxEdge.x; node.Max[1] = box.MaxEdge.y; node.Max[2] = box.MaxEdge.z;
+		node.Offset = begin;
+		node.Count = end - begin;
+	}
+
+	//the traversal stacks hold a node per level
+	const uint32_t count = end - begin;
+	if (count <= BVH_LEAF_TRIANGLES || depth + 2 >= BVH_STACK_SIZE)
+		return;
+
+	//binned SAH, cost of a triangle test is 1 and of a node visit 1
+	struct SBin
+	{
+		aabbox3df	Box;
+		uint32_t	Count;
+	};
+
+	float bestCost = FLT_MAX;
+	uint32_t bestAxis = 0;
+	uint32_t bestSplit = 0;
+	for (uint32_t axis = 0; axis < 3; ++axis)
+	{
+		const float cmin = getAxis(centerBox.MinEdge, axis);
+		const float extent = getAxis(centerBox.MaxEdge, axis) - cmin;
+		if (extent <= 1e-6f)
+			continue;
+
+		SBin bins[BVH_SAH_BINS];
+		for (SBin& bin : bins)
+			bin.Count = 0;
+
+		const float scale = BVH_SAH_BINS / extent;
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			const uint32_t b = std::min((uint32_t)((getAxis(triangles[i].Center, axis) - cmin) * scale), (uint32_t)BVH_SAH_BINS - 1);
+			bins[b].Box.addInternalBox(triangles[i].Box);
+			++bins[b].Count;
+		}
+
+		//right sweep, rightArea[k] covers bins k..
+		float rightArea[BVH_SAH_BINS];
+		uint32_t rightCount[BVH_SAH_BINS];
+		aabbox3df rightBox;
+		uint32_t n = 0;
+		for (int32_t k = BVH_SAH_BINS - 1; k > 0; --k)
+		{
+			if (bins[k].Count)
+				rightBox.addInternalBox(bins[k].Box);
+			n += bins[k].Count;
+			rightArea[k] = n ? getHalfArea(rightBox) : 0;
+			rightCount[k] = n;
+		}
+
+		aabbox3df leftBox;
+		n = 0;
+		for (uint32_t k = 1; k < BVH_SAH_BINS; ++k)
+		{
+			if (bins[k - 1].Count)
+				leftBox.addInternalBox(bins[k - 1].Box);
+			n += bins[k - 1].Count;
+			if (n == 0 || rightCount[k] == 0)
+				continue;
+
+			const float cost = n * getHalfArea(leftBox) + rightCount[k] * rightArea[k];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = k;
+			}
+		}
+	}
+
+	uint32_t mid;
+	const float area = getHalfArea(box);
+	if (bestCost < FLT_MAX)
+	{
+		const float splitCost = 1.0f + (area > 0 ? bestCost / area : 0);
+		if (splitCost >= (float)count && count <= BVH_MAX_LEAF_TRIANGLES)
+			return;
+
+		const float cmin = getAxis(centerBox.MinEdge, bestAxis);
+		const float scale = BVH_SAH_BINS / (getAxis(centerBox.MaxEdge, bestAxis) - cmin);
+		auto itr = std::partition(triangles.begin() + begin, triangles.begin() + end, [&](const SBuildTriangle& tri)
+		{
+			return std::min((uint32_t)((getAxis(tri.Center, bestAxis) - cmin) * scale), (uint32_t)BVH_SAH_BINS - 1) < bestSplit;
+		});
+		mid = (uint32_t)(itr - triangles.begin());
+	}
+	else
+	{
+		//all centers coincide, split in the middle to bound the leaf size
+		if (count <= BVH_MAX_LEAF_TRIANGLES)
+			return;
+		mid = begin + count / 2;
+	}
+
+	const uint32_t left = (uint32_t)Nodes.size();
+	Nodes.emplace_back();
+	buildNode(left, triangles, begin, mid, depth + 1);
+
+	const uint32_t right = (uint32_t)Nodes.size();
+	Nodes.emplace_back();
+	buildNode(right, triangles, mid, end, depth + 1);
+
+	Nodes[nodeIndex].Offset = right;
+	Nodes[nodeIndex].Count = 0;
+}
+
+namespace
+{
+	//slab test, lane 3 of the node loads is Offset or Count which stays finite
+	struct SRay
+	{
+#ifdef COLLISIONBVH_USE_SSE
+		__m128	Start;			//w 0
+		__m128	InvDir;			//w 0
+		__m128	Far;			//w is the max distance, the others 0
+#else
+		float	Start[3];
+		float	InvDir[3];
+		float	Far;
+#endif
+
+		SRay(const vector3df& start, const vector3df& dir, float maxDistance)
+		{
+#ifdef COLLISIONBVH_USE_SSE
+			Start = _mm_set_ps(0, start.z, start.y, start.x);
+			InvDir = _mm_set_ps(0, 1.0f / dir.z, 1.0f / dir.y, 1.0f / dir.x);
+			Far = _mm_set_ps(maxDistance, 0, 0, 0);
+#else
+			Start[0] = start.x; Start[1] = start.y; Start[2] = start.z;
+			InvDir[0] = 1.0f / dir.x; InvDir[1] = 1.0f / dir.y; InvDir[2] = 1.0f / dir.z;
+			Far = maxDistance;
+#endif
+		}
+
+		void setFar(float maxDistance)
+		{
+#ifdef COLLISIONBVH_USE_SSE
+			Far = _mm_set_ps(maxDistance, 0, 0, 0);
+#else
+			Far = maxDistance;
+#endif
+		}
+
+		//entry distance, FLT_MAX on a miss
+		float intersect(const float* bmin, const float* bmax) const
+		{
+#ifdef COLLISIONBVH_USE_SSE
+			const __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(bmin), Start), InvDir);
+			const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(bmax), Start), InvDir);
+			__m128 tnear = _mm_min_ps(t0, t1);			//w 0 clamps the entry at the start
+			__m128 tfar = _mm_add_ps(_mm_max_ps(t0, t1), Far);			//w becomes the max distance
+
+			tnear = _mm_max_ps(tnear, _mm_shuffle_ps(tnear, tnear, _MM_SHUFFLE(1, 0, 3, 2)));
+			tnear = _mm_max_ps(tnear, _mm_shuffle_ps(tnear, tnear, _MM_SHUFFLE(2, 3, 0, 1)));
+			tfar = _mm_min_ps(tfar, _mm_shuffle_ps(tfar, tfar, _MM_SHUFFLE(1, 0, 3, 2)));
+			tfar = _mm_min_ps(tfar, _mm_shuffle_ps(tfar, tfar, _MM_SHUFFLE(2, 3, 0, 1)));
+
+			const float n = _mm_cvtss_f32(tnear);
+			return n <= _mm_cvtss_f32(tfar) ? n : FLT_MAX;
+#else
+			float tnear = 0;
+			float tfar = Far;
+			for (uint32_t i = 0; i < 3; ++i)
+			{
+				const float t0 = (bmin[i] - Start[i]) * InvDir[i];
+				const float t1 = (bmax[i] - Start[i]) * InvDir[i];
+				tnear = std::max(tnear, std::min(t0, t1));
+				tfar = std::min(tfar, std::max(t0, t1));
+			}
+			return tnear <= tfar ? tnear : FLT_MAX;
+#endif
+		}
+	};
+}
+
+bool wowCollisionBVH::rayCast(const vector3df& start, const vector3df& dir, float maxDistance, SCollisionHit& hit) const
+{
+	if (Nodes.empty())
+		return false;
+
+	SRay ray(start, dir, maxDistance);
+	if (ray.intersect(Nodes[0].Min, Nodes[0].Max) == FLT_MAX)
+		return false;
+
+	float best = maxDistance;
+	bool found = false;
+
+	uint32_t stack[BVH_STACK_SIZE];
+	uint32_t top = 0;
+	uint32_t nodeIndex = 0;
+	for (;;)
+	{
+		const SNode& node = Nodes[nodeIndex];
+		if (node.Count)
+		{
+			for (uint32_t i = node.Offset; i < node.Offset + node.Count; ++i)
+			{
+				float t;
+				if (intersectRayTriangle(start, dir, &Vertices[i * 3], t) && t >= 0.0f && t <= best)
+				{
+					best = t;
+					hit.Distance = t;
+					hit.Triangle = TriangleIDs[i];
+					found = true;
+				}
+			}
+			if (found)
+				ray.setFar(best);
+		}
+		else
+		{
+			//nearer child first, the other is pushed
+			uint32_t first = nodeIndex + 1;
+			uint32_t second = node.Offset;
+			float tfirst = ray.intersect(Nodes[first].Min, Nodes[first].Max);
+			float tsecond = ray.intersect(Nodes[second].Min, Nodes[second].Max);
+			if (tsecond < tfirst)
+			{
+				std::swap(first, second);
+				std::swap(tfirst, tsecond);
+			}
+
+			if (tfirst != FLT_MAX)
+			{
+				if (tsecond != FLT_MAX)
+				{
+					ASSERT(top < BVH_STACK_SIZE);
+					stack[top++] = second;
+				}
+				nodeIndex = first;
+				continue;
+			}
+		}
+
+		if (top == 0)
+			break;
+		nodeIndex = stack[--top];
+	}
+
+	return found;
+}
+
+bool wowCollisionBVH::rayCastBruteForce(const vector3df& start, const vector3df& dir, float maxDistance, SCollisionHit& hit) const
+{
+	float best = maxDistance;
+	bool found = false;
+	for (uint32_t i = 0; i < (uint32_t)TriangleIDs.size(); ++i)
+	{
+		float t;
+		if (intersectRayTriangle(start, dir, &Vertices[i * 3], t) && t >= 0.0f && t <= best)
+		{
+			best = t;
+			hit.Distance = t;
+			hit.Triangle = TriangleIDs[i];
+			found = true;
+		}
+	}
+	return found;
+}
+
+template <class T>
+bool wowCollisionBVH::querySphere(const vector3df& center, float radius, T func) const
+{
+	if (Nodes.empty())
+		return false;
+
+	const float radiusSQ = radius * radius;
+	uint32_t stack[BVH_STACK_SIZE];
+	uint32_t top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const uint32_t nodeIndex = stack[--top];
+		const SNode& node = Nodes[nodeIndex];
+		if (getDistanceSQToBox(center, node.Min, node.Max) > radiusSQ)
+			continue;
+
+		if (node.Count)
+		{
+			for (uint32_t i = node.Offset; i < node.Offset + node.Count; ++i)
+			{
+				if (getClosestPointOnTriangle(center, &Vertices[i * 3]).getDistanceFromSQ(center) <= radiusSQ && !func(TriangleIDs[i]))
+					return true;
+			}
+		}
+		else
+		{
+			ASSERT(top + 2 <= BVH_STACK_SIZE);
+			stack[top++] = node.Offset;
+			stack[top++] = nodeIndex + 1;
+		}
+	}
+	return false;
+}
+
+bool wowCollisionBVH::intersectsSphere(const vector3df& center, float radius) const
+{
+	return querySphere(center, radius, [](uint32_t) { return false; });
+}
+
+void wowCollisionBVH::querySphere(const vector3df& center, float radius, std::vector<uint32_t>& triangles) const
+{
+	querySphere(center, radius, [&triangles](uint32_t index) { triangles.push_back(index); return true; });
+}
+
+void wowCollisionBVH::queryBox(const aabbox3df& box, std::vector<uint32_t>& triangles) const
+{
+	if (Nodes.empty())
+		return;
+
+	const vector3df center = box.getCenter();
+	const vector3df halfSize = (box.MaxEdge - box.MinEdge) * 0.5f;
+
+	uint32_t stack[BVH_STACK_SIZE];
+	uint32_t top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const uint32_t nodeIndex = stack[--top];
+		const SNode& node = Nodes[nodeIndex];
+		if (node.Min[0] > box.MaxEdge.x || node.Min[1] > box.MaxEdge.y || node.Min[2] > box.MaxEdge.z ||
+			node.Max[0] < box.MinEdge.x || node.Max[1] < box.MinEdge.y || node.Max[2] < box.MinEdge.z)
+			continue;
+
+		if (node.Count)
+		{
+			for (uint32_t i = node.Offset; i < node.Offset + node.Count; ++i)
+			{
+				if (intersectTriangleBox(&Vertices[i * 3], center, halfSize))
+					triangles.push_back(TriangleIDs[i]);
+			}
+		}
+		else
+		{
+			ASSERT(top + 2 <= BVH_STACK_SIZE);
+			stack[top++] = node.Offset;
+			stack[top++] = nodeIndex + 1;
+		}
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "vector3d.h"
+#include "aabbox3d.h"
+
+struct SCollisionHit
+{
+	float		Distance;			//in units of the ray direction
+	uint32_t	Triangle;			//index into the source triangle list
+};
+
+//bounding volume hierarchy over a triangle soup, SAH built and flattened depth first
+//triangles are two sided, queries are in the space of the source vertices
+class wowCollisionBVH
+{
+public:
+	wowCollisionBVH() {}
+
+public:
+	//triangles with an index out of range are skipped
+	void build(const vector3df* vertices, uint32_t numVertices, const uint16_t* indices, uint32_t numIndices);
+	void clear();
+
+	bool empty() const { return Nodes.empty(); }
+	uint32_t getNumNodes() const { return (uint32_t)Nodes.size(); }
+	uint32_t getNumTriangles() const { return (uint32_t)TriangleIDs.size(); }
+	aabbox3df getBoundingBox() const;
+
+	//nearest triangle hit by start + dir * t, 0 <= t <= maxDistance
+	bool rayCast(const vector3df& start, const vector3df& dir, float maxDistance, SCollisionHit& hit) const;
+	bool rayCastBruteForce(const vector3df& start, const vector3df& dir, float maxDistance, SCollisionHit& hit) const;
+
+	bool intersectsSphere(const vector3df& center, float radius) const;
+
+	//source indices of the triangles touching the volume are appended
+	void querySphere(const vector3df& center, float radius, std::vector<uint32_t>& triangles) const;
+	void queryBox(const aabbox3df& box, std::vector<uint32_t>& triangles) const;
+
+	//triangle tests, also used by the wmo bsp
+	static bool intersectRayTriangle(const vector3df& start, const vector3df& dir, const vector3df* v, float& t);
+	static vector3df getClosestPointOnTriangle(const vector3df& p, const vector3df* v);
+
+private:
+	//inner nodes have Count 0, the left child follows the node and Offset is the right child
+	//leaves have Count triangles from Offset
+	struct SNode
+	{
+		float		Min[3];
+		uint32_t	Offset;
+		float		Max[3];
+		uint32_t	Count;
+	};
+
+	struct SBuildTriangle
+	{
+		aabbox3df	Box;
+		vector3df	Center;
+		uint32_t	Index;
+	};
+
+	void buildNode(uint32_t nodeIndex, std::vector<SBuildTriangle>& triangles, uint32_t begin, uint32_t end, uint32_t depth);
+
+	template <class T>
+	bool querySphere(const vector3df& center, float radius, T func) const;
+
+private:
+	std::vector<SNode>		Nodes;
+	std::vector<vector3df>		Vertices;			//3 per triangle, in leaf order
+	std::vector<uint32_t>		TriangleIDs;			//source index per triangle, in leaf order
+};
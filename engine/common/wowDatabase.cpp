@@ -37,12 +37,12 @@ wowDatabase::wowDatabase(const wowEnvironment* env)
 }
 
 
-bool wowDatabase::init()
+bool wowDatabase::init(bool loadTables)
 {
 	if (!initFromXml())
 		return false;
 
-	if (!loadAllTables())
+	if (loadTables && !loadAllTables())
 		return false;
 
 	return true;
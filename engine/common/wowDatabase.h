@@ -47,16 +47,16 @@ public:
 	~wowDatabase() = default;
 
 public:
-	bool init();
+	bool init(bool loadTables = true);
 
 	const std::map<std::string, CTableStruct>& getDBStructMap() const { return DbStructureMap; }
 	const CTableStruct* getDBStruct(const char* name) const;
 
 	const DBFile* loadDBFile(const char* name) const;
+	CMemFile* loadDBMemFile(const char* name) const;
 
 private:
 	bool initFromXml();
-	CMemFile* loadDBMemFile(const char* name) const;
 	bool loadAllTables();
 
 public:		//ݲѯ
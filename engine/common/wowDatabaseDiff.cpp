@@ -0,0 +1,245 @@
+#include "wowDatabaseDiff.h"
+
+#include "wowDatabase.h"
+#include "CMemFile.h"
+#include "CFileSystem.h"
+#include <algorithm>
+#include <set>
+#include <cstring>
+
+#define FNV_OFFSET_BASIS	0xcbf29ce484222325ull
+#define FNV_PRIME			0x100000001b3ull
+
+static inline uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+{
+	const uint8_t* p = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= p[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+static uint64_t hashValue(uint64_t hash, const VAR_T& v)
+{
+	if (v.Is<std::string>())
+	{
+		const std::string& str = v.Get<std::string>();
+		hash = hashBytes(hash, str.c_str(), str.length() + 1);
+	}
+	else if (v.Is<float>())
+	{
+		float f = v.Get<float>();
+		hash = hashBytes(hash, &f, sizeof(f));
+	}
+	else
+	{
+		uint64_t n = 0;
+		if (v.Is<uint32_t>())
+			n = v.Get<uint32_t>();
+		else if (v.Is<uint64_t>())
+			n = v.Get<uint64_t>();
+		else if (v.Is<uint16_t>())
+			n = v.Get<uint16_t>();
+		else if (v.Is<int>())
+			n = (uint64_t)(int64_t)v.Get<int>();
+		hash = hashBytes(hash, &n, sizeof(n));
+	}
+	return hash;
+}
+
+static uint32_t getFieldValueCount(const CFieldStruct& field)
+{
+	return (field.isKey || field.isRelationshipData) ? 1 : field.arraySize;
+}
+
+wowDatabaseDiff::wowDatabaseDiff(const wowDatabase* oldDatabase, const wowDatabase* newDatabase)
+	: OldDatabase(oldDatabase), NewDatabase(newDatabase)
+{
+}
+
+bool wowDatabaseDiff::diffTable(const char* name, const DBDIFF_CALLBACK& callback, SDbDiffTableResult& result) const
+{
+	result.name = name;
+	result.identical = false;
+	result.layoutChanged = false;
+	result.layoutIncompatible = false;
+	result.numAdded = result.numRemoved = result.numChanged = 0;
+
+	const CTableStruct* oldTable = OldDatabase->getDBStruct(name);
+	const CTableStruct* newTable = NewDatabase->getDBStruct(name);
+	if (!oldTable && !newTable)
+		return false;
+
+	CMemFile* oldMemFile = oldTable ? OldDatabase->loadDBMemFile(name) : nullptr;
+	CMemFile* newMemFile = newTable ? NewDatabase->loadDBMemFile(name) : nullptr;
+	if (!oldMemFile && !newMemFile)
+		return false;
+
+	const DBFile* oldFile = oldMemFile ? DBFile::readDBFile(oldMemFile) : nullptr;
+	const DBFile* newFile = newMemFile ? DBFile::readDBFile(newMemFile) : nullptr;
+	if ((oldMemFile && !oldFile) || (newMemFile && !newFile))
+	{
+		delete oldFile;
+		delete newFile;
+		return false;
+	}
+
+	if (oldFile && newFile)
+	{
+		//files of two different tables, bad input
+		if (oldFile->getTableHash() != 0 && newFile->getTableHash() != 0 &&
+			oldFile->getTableHash() != newFile->getTableHash())
+		{
+			if (g_FileSystem)
+				g_FileSystem->writeLog(ELOG_RES, "wowDatabaseDiff: table hash of %s differs between builds", name);
+			delete oldFile;
+			delete newFile;
+			return false;
+		}
+		result.layoutChanged = oldFile->getLayoutHash() != newFile->getLayoutHash();
+
+		//same decoded content, skip without decoding
+		if (!result.layoutChanged && oldFile->getContentHash() == newFile->getContentHash())
+		{
+			delete oldFile;
+			delete newFile;
+			result.identical = true;
+			return true;
+		}
+	}
+
+	std::vector<SColumnMap> columns;
+	if (oldTable && newTable)
+	{
+		buildColumnMap(oldTable, newTable, columns);
+		result.layoutIncompatible = columns.empty();
+	}
+
+	std::vector<SRowKey> oldRows;
+	std::vector<SRowKey> newRows;
+	if (oldFile)
+		buildRowKeys(oldFile, oldTable, columns, true, oldRows);
+	if (newFile)
+		buildRowKeys(newFile, newTable, columns, false, newRows);
+
+	//merge by id
+	auto itOld = oldRows.begin();
+	auto itNew = newRows.begin();
+	while (itOld != oldRows.end() || itNew != newRows.end())
+	{
+		if (itNew == newRows.end() || (itOld != oldRows.end() && itOld->id < itNew->id))
+		{
+			++result.numRemoved;
+			if (callback)
+			{
+				std::vector<VAR_T> oldVal = oldFile->getRecordValue(itOld->index, oldTable);
+				callback(name, EDR_REMOVED, itOld->id, &oldVal, nullptr);
+			}
+			++itOld;
+		}
+		else if (itOld == oldRows.end() || itNew->id < itOld->id)
+		{
+			++result.numAdded;
+			if (callback)
+			{
+				std::vector<VAR_T> newVal = newFile->getRecordValue(itNew->index, newTable);
+				callback(name, EDR_ADDED, itNew->id, nullptr, &newVal);
+			}
+			++itNew;
+		}
+		else
+		{
+			if (!result.layoutIncompatible && itOld->hash != itNew->hash)
+			{
+				++result.numChanged;
+				if (callback)
+				{
+					std::vector<VAR_T> oldVal = oldFile->getRecordValue(itOld->index, oldTable);
+					std::vector<VAR_T> newVal = newFile->getRecordValue(itNew->index, newTable);
+					callback(name, EDR_CHANGED, itNew->id, &oldVal, &newVal);
+				}
+			}
+			++itOld;
+			++itNew;
+		}
+	}
+
+	delete oldFile;
+	delete newFile;
+	return true;
+}
+
+bool wowDatabaseDiff::diffAll(const DBDIFF_CALLBACK& callback, std::vector<SDbDiffTableResult>& results) const
+{
+	std::set<std::string> names;
+	for (const auto& kv : OldDatabase->getDBStructMap())
+		names.insert(kv.first);
+	for (const auto& kv : NewDatabase->getDBStructMap())
+		names.insert(kv.first);
+
+	results.clear();
+	bool success = true;
+	for (const auto& name : names)
+	{
+		SDbDiffTableResult result;
+		if (diffTable(name.c_str(), callback, result))
+			results.push_back(result);
+		else
+			success = false;
+	}
+	return success;
+}
+
+void wowDatabaseDiff::buildColumnMap(const CTableStruct* oldTable, const CTableStruct* newTable, std::vector<SColumnMap>& columns)
+{
+	columns.clear();
+
+	uint32_t newOffset = 0;
+	for (const auto& newField : newTable->fields)
+	{
+		uint32_t oldOffset = 0;
+		for (const auto& oldField : oldTable->fields)
+		{
+			if (oldField.name == newField.name && oldField.type == newField.type &&
+				getFieldValueCount(oldField) == getFieldValueCount(newField))
+			{
+				SColumnMap col;
+				col.oldOffset = oldOffset;
+				col.newOffset = newOffset;
+				col.count = getFieldValueCount(newField);
+				columns.push_back(col);
+				break;
+			}
+			oldOffset += getFieldValueCount(oldField);
+		}
+		newOffset += getFieldValueCount(newField);
+	}
+}
+
+void wowDatabaseDiff::buildRowKeys(const DBFile* file, const CTableStruct* table, const std::vector<SColumnMap>& columns, bool isOld, std::vector<SRowKey>& rows)
+{
+	rows.resize(file->getRecordCount());
+	for (uint32_t i = 0; i < file->getRecordCount(); ++i)
+	{
+		SRowKey& row = rows[i];
+		row.id = file->getRecordID(i);
+		row.index = i;
+		row.hash = FNV_OFFSET_BASIS;
+
+		//table only exists in one build or no shared fields, nothing to compare
+		if (columns.empty())
+			continue;
+
+		const std::vector<VAR_T>& val = file->getRecordValue(i, table);
+		for (const auto& col : columns)
+		{
+			uint32_t offset = isOld ? col.oldOffset : col.newOffset;
+			for (uint32_t k = 0; k < col.count && offset + k < (uint32_t)val.size(); ++k)
+				row.hash = hashValue(row.hash, val[offset + k]);
+		}
+	}
+
+	std::sort(rows.begin(), rows.end());
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "wowDbFile.h"
+#include <string>
+#include <vector>
+#include <functional>
+
+class wowDatabase;
+class CTableStruct;
+
+enum E_DBDIFF_ROW : int
+{
+	EDR_ADDED = 0,
+	EDR_REMOVED,
+	EDR_CHANGED,
+};
+
+struct SDbDiffTableResult
+{
+	std::string name;
+	bool identical;				//decoded content is the same by hash, rows are not decoded
+	bool layoutChanged;			//compared by the fields both builds share
+	bool layoutIncompatible;	//no shared fields, only added and removed rows are reported
+	uint32_t numAdded;
+	uint32_t numRemoved;
+	uint32_t numChanged;
+};
+
+//oldVal is null for added rows, newVal is null for removed rows
+using DBDIFF_CALLBACK = std::function<void(const char* table, E_DBDIFF_ROW type, uint32_t id, const std::vector<VAR_T>* oldVal, const std::vector<VAR_T>* newVal)>;
+
+//diff tables between two builds without loading RecordList
+//rows are merged by sorted ID and compared by a hash of the row values, only differing rows are decoded again
+class wowDatabaseDiff
+{
+public:
+	wowDatabaseDiff(const wowDatabase* oldDatabase, const wowDatabase* newDatabase);
+
+public:
+	bool diffTable(const char* name, const DBDIFF_CALLBACK& callback, SDbDiffTableResult& result) const;
+	bool diffAll(const DBDIFF_CALLBACK& callback, std::vector<SDbDiffTableResult>& results) const;
+
+private:
+	struct SColumnMap
+	{
+		uint32_t oldOffset;
+		uint32_t newOffset;
+		uint32_t count;
+	};
+
+	struct SRowKey
+	{
+		uint32_t id;
+		uint32_t index;
+		uint64_t hash;
+
+		bool operator<(const SRowKey& other) const
+		{
+			if (id != other.id)
+				return id < other.id;
+			return index < other.index;
+		}
+	};
+
+	static void buildColumnMap(const CTableStruct* oldTable, const CTableStruct* newTable, std::vector<SColumnMap>& columns);
+	static void buildRowKeys(const DBFile* file, const CTableStruct* table, const std::vector<SColumnMap>& columns, bool isOld, std::vector<SRowKey>& rows);
+
+private:
+	const wowDatabase* OldDatabase;
+	const wowDatabase* NewDatabase;
+};
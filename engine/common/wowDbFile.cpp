@@ -1,11 +1,73 @@
 #include "wowDbFile.h"
 
 #include "CMemFile.h"
+#include "wowWDBCFile.h"
 #include "wowWDB5File.h"
+#include "wowWDC1File.h"
 #include "wowWDC3File.h"
 #include "wowWDC2File.h"
 #include <cassert>
 
+VAR_T DBFile::makeValue(const std::string& type, uint64_t val)
+{
+	VAR_T v;
+	if (type == "float")
+	{
+		uint32_t bits = (uint32_t)val;
+		float f;
+		memcpy(&f, &bits, 4);
+		v = f;
+	}
+	else if (type == "int")
+		v = (int)(uint32_t)val;
+	else if (type == "uint16")
+		v = (uint16_t)(val & 0x0000FFFF);
+	else if (type == "byte")
+		v = (uint16_t)(val & 0x000000FF);
+	else if (type == "uint64")
+		v = val;
+	else
+		v = (uint32_t)val;
+	return v;
+}
+
+uint64_t DBFile::getContentHash() const
+{
+	std::vector<SDataRange> ranges;
+	getDecodedRanges(ranges);
+
+	//fnv-1a over 8 byte words, the tail byte by byte
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (const auto& range : ranges)
+	{
+		const uint8_t* p = range.data;
+		uint32_t size = range.size;
+		for (; size >= 8; size -= 8, p += 8)
+		{
+			uint64_t word;
+			memcpy(&word, p, 8);
+			hash ^= word;
+			hash *= 0x100000001b3ull;
+		}
+		for (; size > 0; --size, ++p)
+		{
+			hash ^= *p;
+			hash *= 0x100000001b3ull;
+		}
+		hash ^= range.size;
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+void DBFile::getDecodedRanges(std::vector<SDataRange>& ranges) const
+{
+	SDataRange range;
+	range.data = m_pMemFile->getBuffer();
+	range.size = m_pMemFile->getSize();
+	ranges.push_back(range);
+}
+
 const DBFile* DBFile::readDBFile(CMemFile * memFile)
 {
 	const char* magic = (const char*)memFile->getBuffer();
@@ -48,9 +110,43 @@ const DBFile* DBFile::readDBFile(CMemFile * memFile)
 		else
 			return file;
 	}
+	else if (dbType == WowDBType::WDC1)
+	{
+		WDC1File* file = new WDC1File(memFile);
+		if (!file->open())
+		{
+			delete file;
+			return nullptr;
+		}
+		else
+			return file;
+	}
+	else if (dbType == WowDBType::WDB5 || dbType == WowDBType::WDB6)
+	{
+		WDB5File* file = new WDB5File(memFile);
+		if (!file->open())
+		{
+			delete file;
+			return nullptr;
+		}
+		else
+			return file;
+	}
+	else if (dbType == WowDBType::WDBC || dbType == WowDBType::WDB2)
+	{
+		WDBCFile* file = new WDBCFile(memFile);
+		if (!file->open())
+		{
+			delete file;
+			return nullptr;
+		}
+		else
+			return file;
+	}
 	else
 	{
 		assert(false);
+		delete memFile;
 	}
 
 	return nullptr;
@@ -16,6 +16,7 @@ public:
 	explicit DBFile(CMemFile* memFile)
 		: m_pMemFile(memFile)
 		, recordSize(0), recordCount(0), fieldCount(0), stringSize(0)
+		, tableHash(0), layoutHash(0)
 		, data(nullptr), stringTable(nullptr)
 	{
 
@@ -29,9 +30,29 @@ public:
 	static const DBFile* readDBFile(CMemFile* memFile);
 
 public:
+	//one value per field element, an element that can't be decoded is an empty VAR_T
 	virtual std::vector<VAR_T> getRecordValue(uint32_t index, const CTableStruct* table) const = 0;
+	virtual uint32_t getRecordID(uint32_t index) const = 0;
 
 	uint32_t getRecordCount() const { return recordCount; }
+	uint32_t getTableHash() const { return tableHash; }
+	uint32_t getLayoutHash() const { return layoutHash; }
+
+	//hash of the bytes the rows are decoded from, files with the same layout and content hash have the same rows
+	uint64_t getContentHash() const;
+
+protected:
+	struct SDataRange
+	{
+		const uint8_t* data;
+		uint32_t size;
+	};
+
+	//the whole file by default, a format with sections leaves out the sections it never decodes
+	virtual void getDecodedRanges(std::vector<SDataRange>& ranges) const;
+
+	//decoded field value as the type in database.xml, text is read by each format
+	static VAR_T makeValue(const std::string& type, uint64_t val);
 
 protected:
 	CMemFile* m_pMemFile;
@@ -40,6 +61,8 @@ protected:
 	uint32_t recordCount;
 	uint32_t fieldCount;
 	uint32_t stringSize;
+	uint32_t tableHash;
+	uint32_t layoutHash;
 	const uint8_t* data;
 	const uint8_t* stringTable;
 };
\ No newline at end of file
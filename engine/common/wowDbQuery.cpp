@@ -0,0 +1,282 @@
+#include "wowDbQuery.h"
+
+#include "CSysThread.h"
+#include <algorithm>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define DBQUERY_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#define INVALID_COLUMN		0xffffffff
+
+static bool testValue(uint64_t v, E_DBQUERY_OP op, uint64_t value, bool isSigned)
+{
+	switch (op)
+	{
+	case EDQ_EQUAL:
+		return v == value;
+	case EDQ_NOTEQUAL:
+		return v != value;
+	case EDQ_LESS:
+		return isSigned ? (int64_t)v < (int64_t)value : v < value;
+	case EDQ_GREATER:
+		return isSigned ? (int64_t)v > (int64_t)value : v > value;
+	case EDQ_ANYBITS:
+		return (v & value) != 0;
+	case EDQ_ALLBITS:
+		return (v & value) == value;
+	default:
+		assert(false);
+		return false;
+	}
+}
+
+#ifdef DBQUERY_USE_SSE2
+
+//4 rows of a 32bit column
+static uint32_t testBlock32(const uint32_t* p, E_DBQUERY_OP op, uint32_t value, bool isSigned)
+{
+	__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+	__m128i k = _mm_set1_epi32((int)value);
+	__m128i r;
+
+	switch (op)
+	{
+	case EDQ_EQUAL:
+		r = _mm_cmpeq_epi32(v, k);
+		break;
+	case EDQ_NOTEQUAL:
+		r = _mm_cmpeq_epi32(v, k);
+		return ~(uint32_t)_mm_movemask_ps(_mm_castsi128_ps(r)) & 0xf;
+	case EDQ_LESS:
+	case EDQ_GREATER:
+		if (!isSigned)			//no unsigned compare in sse2, flip the sign bit
+		{
+			__m128i bias = _mm_set1_epi32((int)0x80000000);
+			v = _mm_xor_si128(v, bias);
+			k = _mm_xor_si128(k, bias);
+		}
+		r = op == EDQ_LESS ? _mm_cmplt_epi32(v, k) : _mm_cmpgt_epi32(v, k);
+		break;
+	case EDQ_ANYBITS:
+		r = _mm_cmpeq_epi32(_mm_and_si128(v, k), _mm_setzero_si128());
+		return ~(uint32_t)_mm_movemask_ps(_mm_castsi128_ps(r)) & 0xf;
+	case EDQ_ALLBITS:
+		r = _mm_cmpeq_epi32(_mm_and_si128(v, k), k);
+		break;
+	default:
+		assert(false);
+		return 0;
+	}
+
+	return (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(r));
+}
+
+//2 bits, set when both dwords of the qword are set
+static inline uint32_t movemask64(__m128i eq32)
+{
+	__m128i both = _mm_and_si128(eq32, _mm_shuffle_epi32(eq32, _MM_SHUFFLE(2, 3, 0, 1)));
+	return (uint32_t)_mm_movemask_pd(_mm_castsi128_pd(both));
+}
+
+//4 rows of a 64bit column
+static uint32_t testBlock64(const uint32_t* p, E_DBQUERY_OP op, uint64_t value, bool isSigned)
+{
+	__m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+	__m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 4));
+	__m128i k = _mm_set_epi32((int)(value >> 32), (int)value, (int)(value >> 32), (int)value);
+	__m128i zero = _mm_setzero_si128();
+
+	switch (op)
+	{
+	case EDQ_EQUAL:
+		return movemask64(_mm_cmpeq_epi32(v0, k)) | (movemask64(_mm_cmpeq_epi32(v1, k)) << 2);
+	case EDQ_NOTEQUAL:
+		return ~(movemask64(_mm_cmpeq_epi32(v0, k)) | (movemask64(_mm_cmpeq_epi32(v1, k)) << 2)) & 0xf;
+	case EDQ_ANYBITS:
+		return ~(movemask64(_mm_cmpeq_epi32(_mm_and_si128(v0, k), zero)) |
+			(movemask64(_mm_cmpeq_epi32(_mm_and_si128(v1, k), zero)) << 2)) & 0xf;
+	case EDQ_ALLBITS:
+		return movemask64(_mm_cmpeq_epi32(_mm_and_si128(v0, k), k)) |
+			(movemask64(_mm_cmpeq_epi32(_mm_and_si128(v1, k), k)) << 2);
+	default:			//no 64bit compare in sse2
+		{
+			uint32_t mask = 0;
+			for (uint32_t i = 0; i < 4; ++i)
+			{
+				uint64_t v = (uint64_t)p[i * 2] | ((uint64_t)p[i * 2 + 1] << 32);
+				if (testValue(v, op, value, isSigned))
+					mask |= (1 << i);
+			}
+			return mask;
+		}
+	}
+}
+
+#endif
+
+const CDbColumn* CDbQuery::getColumn(const char* name) const
+{
+	for (const auto& col : m_columns)
+	{
+		if (col.Name == name)
+			return &col;
+	}
+	return nullptr;
+}
+
+CDbQuery& CDbQuery::where(const char* column, E_DBQUERY_OP op, uint64_t value)
+{
+	SPredicate pred;
+	pred.column = INVALID_COLUMN;
+	pred.op = op;
+	pred.value = value;
+
+	for (uint32_t i = 0; i < (uint32_t)m_columns.size(); ++i)
+	{
+		if (m_columns[i].Name == column)
+		{
+			pred.column = i;
+			if (!m_columns[i].Is64Bit)
+				pred.value = m_columns[i].IsSigned ? (uint64_t)(int64_t)(int32_t)value : (uint32_t)value;
+			break;
+		}
+	}
+	ASSERT(pred.column != INVALID_COLUMN);
+
+	m_predicates.push_back(pred);
+	return *this;
+}
+
+void CDbQuery::execute(std::vector<uint32_t>& selection, uint32_t numThreads) const
+{
+	selection.clear();
+
+	for (const auto& pred : m_predicates)
+	{
+		if (pred.column == INVALID_COLUMN)
+			return;
+	}
+
+	if (numThreads == 0)
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	//small tables are not worth a thread
+	const uint32_t minRowsPerThread = 8192;
+	numThreads = std::min(numThreads, std::max(1u, m_numRows / minRowsPerThread));
+
+	if (numThreads <= 1)
+	{
+		scanRange(0, m_numRows, selection);
+		return;
+	}
+
+	//keep every range start 4 rows aligned
+	uint32_t rowsPerThread = (((m_numRows + numThreads - 1) / numThreads) + 3) & ~3u;
+
+	std::vector<std::vector<uint32_t>> results(numThreads);
+	std::vector<thread_type> threads(numThreads);
+	for (uint32_t t = 0; t < numThreads; ++t)
+	{
+		uint32_t rowStart = std::min(t * rowsPerThread, m_numRows);
+		uint32_t rowEnd = std::min(rowStart + rowsPerThread, m_numRows);
+		std::vector<uint32_t>* result = &results[t];
+
+		INIT_THREAD(&threads[t], [this, rowStart, rowEnd, result](void*)
+		{
+			scanRange(rowStart, rowEnd, *result);
+			return 0;
+		}, nullptr);
+	}
+
+	size_t total = 0;
+	for (uint32_t t = 0; t < numThreads; ++t)
+	{
+		WAIT_THREAD(&threads[t]);
+		DESTROY_THREAD(&threads[t]);
+		total += results[t].size();
+	}
+
+	selection.reserve(total);
+	for (const auto& result : results)
+		selection.insert(selection.end(), result.begin(), result.end());
+}
+
+void CDbQuery::executeScalar(std::vector<uint32_t>& selection) const
+{
+	selection.clear();
+
+	for (const auto& pred : m_predicates)
+	{
+		if (pred.column == INVALID_COLUMN)
+			return;
+	}
+
+	for (uint32_t row = 0; row < m_numRows; ++row)
+	{
+		if (testRow(row))
+			selection.push_back(row);
+	}
+}
+
+void CDbQuery::scanRange(uint32_t rowStart, uint32_t rowEnd, std::vector<uint32_t>& selection) const
+{
+	uint32_t row = rowStart;
+
+#ifdef DBQUERY_USE_SSE2
+	for (; row + 4 <= rowEnd; row += 4)
+	{
+		uint32_t mask = testBlock(row);
+		for (uint32_t i = 0; mask; ++i, mask >>= 1)
+		{
+			if (mask & 1)
+				selection.push_back(row + i);
+		}
+	}
+#endif
+
+	for (; row < rowEnd; ++row)
+	{
+		if (testRow(row))
+			selection.push_back(row);
+	}
+}
+
+bool CDbQuery::testRow(uint32_t row) const
+{
+	for (const auto& pred : m_predicates)
+	{
+		const CDbColumn& col = m_columns[pred.column];
+		if (!testValue(col.getValue(row), pred.op, pred.value, col.IsSigned))
+			return false;
+	}
+	return true;
+}
+
+uint32_t CDbQuery::testBlock(uint32_t row) const
+{
+	uint32_t mask = 0xf;
+
+#ifdef DBQUERY_USE_SSE2
+	for (const auto& pred : m_predicates)
+	{
+		const CDbColumn& col = m_columns[pred.column];
+		if (col.Is64Bit)
+			mask &= testBlock64(&col.Data[row * 2], pred.op, pred.value, col.IsSigned);
+		else
+			mask &= testBlock32(&col.Data[row], pred.op, (uint32_t)pred.value, col.IsSigned);
+
+		if (!mask)
+			break;
+	}
+#else
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		if (!testRow(row + i))
+			mask &= ~(1 << i);
+	}
+#endif
+
+	return mask;
+}
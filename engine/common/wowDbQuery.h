@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include <type_traits>
+#include <cassert>
+
+//columnar query over loaded table records
+//columns are projected from RecordList, predicates are evaluated 4 rows at a time (SSE2) and produce a selection vector of row indices
+
+enum E_DBQUERY_OP : int
+{
+	EDQ_EQUAL = 0,
+	EDQ_NOTEQUAL,
+	EDQ_LESS,
+	EDQ_GREATER,
+	EDQ_ANYBITS,			//(v & value) != 0
+	EDQ_ALLBITS,			//(v & value) == value
+};
+
+class CDbColumn
+{
+public:
+	CDbColumn() : Is64Bit(false), IsSigned(false) {}
+
+	//signed 32bit values come back sign extended
+	uint64_t getValue(uint32_t row) const
+	{
+		if (Is64Bit)
+			return (uint64_t)Data[row * 2] | ((uint64_t)Data[row * 2 + 1] << 32);
+		return IsSigned ? (uint64_t)(int64_t)(int32_t)Data[row] : Data[row];
+	}
+
+public:
+	std::string Name;
+	bool Is64Bit;
+	bool IsSigned;
+	std::vector<uint32_t> Data;			//64bit column is stored as (lo, hi) pairs, narrower signed fields are sign extended
+};
+
+class CDbQuery
+{
+public:
+	CDbQuery() : m_numRows(0) {}
+
+public:
+	template <class TRecord, class TField>
+	bool addColumn(const char* name, const std::vector<TRecord>& records, TField TRecord::* field)
+	{
+		static_assert(std::is_integral<TField>::value, "only integral columns are supported");
+
+		if (!m_columns.empty() && m_numRows != (uint32_t)records.size())
+		{
+			assert(false);
+			return false;
+		}
+		m_numRows = (uint32_t)records.size();
+
+		CDbColumn col;
+		col.Name = name;
+		col.Is64Bit = sizeof(TField) == 8;
+		col.IsSigned = std::is_signed<TField>::value;
+		col.Data.resize(m_numRows * (col.Is64Bit ? 2 : 1));
+		for (uint32_t i = 0; i < m_numRows; ++i)
+		{
+			const TField f = records[i].*field;
+			const uint64_t v = col.IsSigned ? (uint64_t)(int64_t)f : (uint64_t)f;
+			if (col.Is64Bit)
+			{
+				col.Data[i * 2] = (uint32_t)v;
+				col.Data[i * 2 + 1] = (uint32_t)(v >> 32);
+			}
+			else
+			{
+				col.Data[i] = (uint32_t)v;
+			}
+		}
+		m_columns.emplace_back(col);
+		return true;
+	}
+
+	const CDbColumn* getColumn(const char* name) const;
+	uint32_t getRowCount() const { return m_numRows; }
+
+	//value is truncated to the column width, signed columns compare as signed
+	CDbQuery& where(const char* column, E_DBQUERY_OP op, uint64_t value);
+	void clearPredicates() { m_predicates.clear(); }
+
+	//numThreads 0 uses hardware concurrency, rows in selection are ascending
+	void execute(std::vector<uint32_t>& selection, uint32_t numThreads = 0) const;
+	void executeScalar(std::vector<uint32_t>& selection) const;
+
+private:
+	struct SPredicate
+	{
+		uint32_t column;
+		E_DBQUERY_OP op;
+		uint64_t value;
+	};
+
+	void scanRange(uint32_t rowStart, uint32_t rowEnd, std::vector<uint32_t>& selection) const;
+	bool testRow(uint32_t row) const;
+	uint32_t testBlock(uint32_t row) const;
+
+private:
+	std::vector<CDbColumn> m_columns;
+	std::vector<SPredicate> m_predicates;
+	uint32_t m_numRows;
+};
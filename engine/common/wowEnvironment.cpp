@@ -138,79 +138,79 @@ CMemFile * wowEnvironment::openFile(const char* filename) const
 	normalizeFileName(filename, realfilename, QMAX_PATH);
 	Q_strlwr(realfilename);
 
-	if (!CascOpenFile(hStorage, realfilename, Config.casclocale, 0, &hFile))
 	{
-		auto itr = FileName2IdMap.find(realfilename);
-		if (itr != FileName2IdMap.end())
+		CLock lock(CascLock);
+
+		if (!CascOpenFile(hStorage, realfilename, Config.casclocale, 0, &hFile))
 		{
-			uint32_t fildId = itr->second;
-			if (!CascOpenFile(hStorage, CASC_FILE_DATA_ID(fildId), Config.casclocale, CASC_OPEN_BY_FILEID, &hFile))
+			auto itr = FileName2IdMap.find(realfilename);
+			if (itr != FileName2IdMap.end())
+			{
+				uint32_t fildId = itr->second;
+				if (!CascOpenFile(hStorage, CASC_FILE_DATA_ID(fildId), Config.casclocale, CASC_OPEN_BY_FILEID, &hFile))
+				{
+					return nullptr;
+				}
+			}
+			else
 			{
 				return nullptr;
 			}
 		}
-		else
-		{
-			return nullptr;
-		}
-	}
-
-	DWORD dwHigh;
-	uint32_t size = CascGetFileSize(hFile, &dwHigh);
-
-	// HACK: in patch.mpq some files don't want to open and give 1 for filesize
-	if (size <= 1 || size == 0xffffffff) {
-		CascCloseFile(hFile);
-		return nullptr;
 	}
 
-	uint8_t* buffer = new uint8_t[size];
-
-	bool ret = CascReadFile(hFile, buffer, (DWORD)size, nullptr);
-	if (!ret)
-	{
-		delete[] buffer;
-
-		CascCloseFile(hFile);
-		return nullptr;
-	}
-
-	CascCloseFile(hFile);
-
-	return new CMemFile(buffer, size);
+	return readFile(hFile);
 }
 
 CMemFile* wowEnvironment::openFileById(uint32_t fileid) const
 {
 	HANDLE hFile;
 
-	if (!CascOpenFile(hStorage, CASC_FILE_DATA_ID(fileid), Config.casclocale, CASC_OPEN_BY_FILEID, &hFile))
 	{
-		return nullptr;
+		CLock lock(CascLock);
+
+		if (!CascOpenFile(hStorage, CASC_FILE_DATA_ID(fileid), Config.casclocale, CASC_OPEN_BY_FILEID, &hFile))
+		{
+			return nullptr;
+		}
 	}
 
+	return readFile(hFile);
+}
+
+//CascGetFileSize loads the frames of the file and opens its data file, which changes the storage
+//CascReadFile then decodes the frames with positioned reads of the data file and only changes the file handle,
+//it runs outside of the lock so that files are decompressed on several threads at once
+CMemFile* wowEnvironment::readFile(HANDLE hFile) const
+{
 	DWORD dwHigh;
-	uint32_t size = CascGetFileSize(hFile, &dwHigh);
+	uint32_t size;
+	{
+		CLock lock(CascLock);
+		size = CascGetFileSize(hFile, &dwHigh);
 
-	// HACK: in patch.mpq some files don't want to open and give 1 for filesize
-	if (size <= 1 || size == 0xffffffff) {
-		CascCloseFile(hFile);
-		return nullptr;
+		// HACK: in patch.mpq some files don't want to open and give 1 for filesize
+		if (size <= 1 || size == 0xffffffff) {
+			CascCloseFile(hFile);
+			return nullptr;
+		}
 	}
 
 	uint8_t* buffer = new uint8_t[size];
 
 	bool ret = CascReadFile(hFile, buffer, (DWORD)size, nullptr);
+
+	{
+		CLock lock(CascLock);
+		CascCloseFile(hFile);
+	}
+
 	if (!ret)
 	{
 		delete[] buffer;
-
-		CascCloseFile(hFile);
 		return nullptr;
 	}
 
-	CascCloseFile(hFile);
-
 	return new CMemFile(buffer, size);
 }
 
@@ -219,6 +219,8 @@ bool wowEnvironment::exists(const char * filename) const
 	if (strlen(filename) == 0)
 		return false;
 
+	CLock lock(CascLock);
+
 	HANDLE hFile;
 	if (!CascOpenFile(hStorage, filename, Config.casclocale, 0, &hFile))
 		return false;
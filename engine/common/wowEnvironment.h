@@ -8,6 +8,7 @@
 #include <functional>
 #include "stringext.h"
 #include "fixstring.h"
+#include "CSysSync.h"
 
 #ifndef HANDLE
 typedef void* HANDLE;
@@ -45,6 +46,7 @@ public:
 	bool init(const char* product);
 	bool loadCascListFiles();
 
+	//callable from any thread, the storage is accessed under a lock, files are decompressed outside of it
 	CMemFile* openFile(const char* filename) const;
 	CMemFile* openFileById(uint32_t fileid) const;
 	bool exists(const char* filename) const;
@@ -78,10 +80,14 @@ private:
 
 	uint32_t getCascLocale(const std::string& locale) const;
 
+	//reads and closes an open file
+	CMemFile* readFile(HANDLE hFile) const;
+
 private:
 	CFileSystem*		FileSystem;
 	SConfig			Config;
 	HANDLE	hStorage;
+	mutable lock_type	CascLock;			//CascLib has no locking of its own
 	std::map<uint32_t, string_cs256>	FileId2NameMap;
 	std::map<string_cs256, uint32_t>	FileName2IdMap;
 	std::map<string_cs256, string_cs256>	DirIndexMap;
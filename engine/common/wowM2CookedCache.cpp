@@ -0,0 +1,206 @@
+#include "wowM2CookedCache.h"
+
+#include "CFileSystem.h"
+#include "CReadFile.h"
+#include "CWriteFile.h"
+#include "CMemFile.h"
+#include "wowM2File.h"
+#include "wowMeshOptimizer.h"
+#include "function.h"
+#include "stringext.h"
+#include <cstdio>
+
+template <class T>
+static SM2CookedArray addArray(std::vector<uint8_t>& blob, const T* data, uint32_t count)
+{
+	SM2CookedArray arr;
+	arr.count = count;
+	arr.ofs = (uint32_t)((blob.size() + 15) & ~(size_t)15);
+	blob.resize(arr.ofs + sizeof(T) * count, 0);
+	if (count)
+		memcpy(&blob[arr.ofs], data, sizeof(T) * count);
+	return arr;
+}
+
+template <class T>
+static bool isArrayValid(const SM2CookedArray& arr, uint32_t size)
+{
+	return (arr.ofs & 15) == 0 && arr.ofs <= size && arr.count <= (size - arr.ofs) / sizeof(T);
+}
+
+wowM2CookedCache::wowM2CookedCache(const CFileSystem* fs, const char* cacheDir)
+	: FileSystem(fs), CacheDir(cacheDir)
+{
+	normalizeDirName(CacheDir);
+}
+
+CMemFile* wowM2CookedCache::openFile(const char* filename, const SSkeletonCompression* compression) const
+{
+	char path[QMAX_PATH];
+	getCookedFileName(filename, path, QMAX_PATH);
+	if (!FileSystem->isFileExists(path))
+		return nullptr;
+
+	CReadFile file(path, true);
+	const uint32_t size = file.getSize();
+	if (!file.isOpen() || size < sizeof(SM2CookedHeader))
+		return nullptr;
+
+	uint8_t* buffer = new uint8_t[size];
+	if (file.read(buffer, size) != size || !isValid(buffer, size, compression))
+	{
+		delete[] buffer;
+		return nullptr;
+	}
+
+	return new CMemFile(buffer, size);
+}
+
+bool wowM2CookedCache::writeFile(const char* filename, const wowM2File* m2File, const uint8_t* modelData, uint32_t modelSize, const SSkeletonCompression* compression) const
+{
+	std::vector<uint8_t> blob;
+	cook(m2File, modelData, modelSize, compression, blob);
+
+	char path[QMAX_PATH];
+	getCookedFileName(filename, path, QMAX_PATH);
+	FileSystem->makeDirectory(path);
+
+	//written aside and renamed, a reader never sees a partial blob
+	char tmpPath[QMAX_PATH];
+	Q_strcpy(tmpPath, QMAX_PATH, path);
+	Q_strcat(tmpPath, QMAX_PATH, ".tmp");
+	{
+		CWriteFile file(tmpPath, true);
+		if (!file.isOpen())
+			return false;
+
+		if (file.writeBuffer(blob.data(), (uint32_t)blob.size()) != (uint32_t)blob.size())
+		{
+			file.flush();
+			FileSystem->deleteFile(tmpPath);
+			return false;
+		}
+	}
+
+	//rename of the crt fails if the target exists, a blob rewritten as stale has to replace it
+#ifdef A_PLATFORM_WIN_DESKTOP
+	if (!MoveFileExA(tmpPath, path, MOVEFILE_REPLACE_EXISTING))
+#else
+	if (rename(tmpPath, path) != 0)
+#endif
+	{
+		FileSystem->deleteFile(tmpPath);
+		return false;
+	}
+	return true;
+}
+
+void wowM2CookedCache::cook(const wowM2File* m2File, const uint8_t* modelData, uint32_t modelSize, const SSkeletonCompression* compression, std::vector<uint8_t>& blob)
+{
+	const wowSkinFile& skinFile = m2File->SkinFile;
+
+	std::vector<uint8_t> skeleton;
+	if (m2File->Skeleton.getNumBones() > 0)
+		m2File->Skeleton.cook(skeleton);
+
+	std::vector<SM2CookedGeoset> geosets(skinFile.Geosets.size());
+	std::vector<SGeoset::STexUnit> texUnits;
+	for (uint32_t i = 0; i < (uint32_t)skinFile.Geosets.size(); ++i)
+	{
+		const SGeoset& geo = skinFile.Geosets[i];
+		SM2CookedGeoset& cooked = geosets[i];
+		cooked.GeoID = geo.GeoID;
+		cooked.IStart = geo.IStart;
+		cooked.VStart = geo.VStart;
+		cooked.VCount = geo.VCount;
+		cooked.ICount = geo.ICount;
+		cooked.NumTexUnits = (uint16_t)geo.TextureUnits.size();
+		cooked.TexUnitStart = (uint32_t)texUnits.size();
+		texUnits.insert(texUnits.end(), geo.TextureUnits.begin(), geo.TextureUnits.end());
+	}
+
+	SM2CookedHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = M2COOKED_MAGIC;
+	header.version = M2COOKED_VERSION;
+	header.flags = wowMeshOptimizer::isEnabled() ? M2COOKED_FLAG_OPTIMIZED : 0;
+	if (compression)
+	{
+		header.flags |= M2COOKED_FLAG_COMPRESSED;
+		header.compression[0] = compression->translationTolerance;
+		header.compression[1] = compression->rotationTolerance;
+		header.compression[2] = compression->scaleTolerance;
+	}
+	header.boundingBox[0] = m2File->BoundingBox.MinEdge.x;
+	header.boundingBox[1] = m2File->BoundingBox.MinEdge.y;
+	header.boundingBox[2] = m2File->BoundingBox.MinEdge.z;
+	header.boundingBox[3] = m2File->BoundingBox.MaxEdge.x;
+	header.boundingBox[4] = m2File->BoundingBox.MaxEdge.y;
+	header.boundingBox[5] = m2File->BoundingBox.MaxEdge.z;
+
+	blob.assign(sizeof(SM2CookedHeader), 0);
+	header.modelData = addArray(blob, modelData, modelSize);
+	header.skinFileIDs = addArray(blob, m2File->SkinFileIDs.data(), (uint32_t)m2File->SkinFileIDs.size());
+	header.animFileIDs = addArray(blob, m2File->AnimFileIDs.data(), (uint32_t)m2File->AnimFileIDs.size());
+	header.vertices = addArray(blob, m2File->Vertices.data(), (uint32_t)m2File->Vertices.size());
+	header.indices = addArray(blob, skinFile.Indices.data(), (uint32_t)skinFile.Indices.size());
+	header.geosets = addArray(blob, geosets.data(), (uint32_t)geosets.size());
+	header.texUnits = addArray(blob, texUnits.data(), (uint32_t)texUnits.size());
+	header.skeleton = addArray(blob, skeleton.data(), (uint32_t)skeleton.size());
+	header.size = (uint32_t)blob.size();
+
+	memcpy(blob.data(), &header, sizeof(header));
+}
+
+bool wowM2CookedCache::isValid(const uint8_t* blob, uint32_t size, const SSkeletonCompression* compression)
+{
+	if (size < sizeof(SM2CookedHeader))
+		return false;
+
+	const SM2CookedHeader* header = reinterpret_cast<const SM2CookedHeader*>(blob);
+	if (header->magic != M2COOKED_MAGIC || header->version != M2COOKED_VERSION || header->size != size)
+		return false;
+
+	//indices of a blob cooked with the other optimizer setting would differ from a fresh load
+	if ((header->flags & M2COOKED_FLAG_OPTIMIZED) != (wowMeshOptimizer::isEnabled() ? M2COOKED_FLAG_OPTIMIZED : 0u))
+		return false;
+
+	//the tracks are compressed when they are cooked
+	if ((header->flags & M2COOKED_FLAG_COMPRESSED) != (compression ? M2COOKED_FLAG_COMPRESSED : 0u))
+		return false;
+	if (compression && (header->compression[0] != compression->translationTolerance ||
+		header->compression[1] != compression->rotationTolerance || header->compression[2] != compression->scaleTolerance))
+		return false;
+
+	if (header->modelData.count < sizeof(M2::Header) ||
+		!isArrayValid<uint8_t>(header->modelData, size) ||
+		!isArrayValid<uint32_t>(header->skinFileIDs, size) ||
+		!isArrayValid<uint32_t>(header->animFileIDs, size) ||
+		!isArrayValid<SVertex_PNT2WA>(header->vertices, size) ||
+		!isArrayValid<uint16_t>(header->indices, size) ||
+		!isArrayValid<SM2CookedGeoset>(header->geosets, size) ||
+		!isArrayValid<SGeoset::STexUnit>(header->texUnits, size) ||
+		!isArrayValid<uint8_t>(header->skeleton, size))
+		return false;
+
+	const SM2CookedGeoset* geosets = getArray<SM2CookedGeoset>(blob, header->geosets);
+	for (uint32_t i = 0; i < header->geosets.count; ++i)
+	{
+		if ((uint64_t)geosets[i].IStart + geosets[i].ICount > header->indices.count ||
+			(uint64_t)geosets[i].TexUnitStart + geosets[i].NumTexUnits > header->texUnits.count)
+			return false;
+	}
+
+	return true;
+}
+
+void wowM2CookedCache::getCookedFileName(const char* filename, char* outfilename, uint32_t size) const
+{
+	char realfilename[QMAX_PATH];
+	normalizeFileName(filename, realfilename, QMAX_PATH);
+	Q_strlwr(realfilename);
+
+	Q_strcpy(outfilename, size, CacheDir.c_str());
+	Q_strcat(outfilename, size, realfilename);
+	Q_strcat(outfilename, size, "c");
+}
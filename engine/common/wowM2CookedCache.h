@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class CFileSystem;
+class CMemFile;
+class wowM2File;
+struct SSkeletonCompression;
+
+#define M2COOKED_MAGIC		0x4b43324d				//"M2CK"
+#define M2COOKED_VERSION	2
+
+#define M2COOKED_FLAG_OPTIMIZED		1				//skin indices reordered by wowMeshOptimizer
+#define M2COOKED_FLAG_COMPRESSED	2				//skeleton tracks compressed with the tolerances of the header
+
+//arrays are 16 byte aligned, offsets are from the start of the blob
+struct SM2CookedArray
+{
+	uint32_t	count;
+	uint32_t	ofs;
+};
+
+struct SM2CookedGeoset
+{
+	uint32_t	GeoID;
+	uint32_t	IStart;
+	uint16_t	VStart;
+	uint16_t	VCount;
+	uint16_t	ICount;
+	uint16_t	NumTexUnits;
+	uint32_t	TexUnitStart;
+};
+
+struct SM2CookedHeader
+{
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	flags;
+	uint32_t	size;
+
+	float	boundingBox[6];
+	float	compression[3];				//translation, rotation and scale tolerances
+
+	SM2CookedArray	modelData;			//MD21 data, the tables other than the skeleton are built from it
+	SM2CookedArray	skinFileIDs;
+	SM2CookedArray	animFileIDs;
+	SM2CookedArray	vertices;			//SVertex_PNT2WA, coordinates fixed
+	SM2CookedArray	indices;			//skin 0, resolved through its index lookup
+	SM2CookedArray	geosets;			//SM2CookedGeoset
+	SM2CookedArray	texUnits;			//SGeoset::STexUnit
+	SM2CookedArray	skeleton;			//bytes of wowM2Skeleton::cook, empty without bones
+};
+
+//m2 files cooked on first load: the model data with the converted vertices, the skin 0 and the built skeleton of the m2
+//blobs are in cacheDir by game build and m2 path, a blob is written once and read in one call afterwards
+//the blob is not mapped or used in place: vertices, indices and skeleton are copied out, the other tables are parsed from the model data
+class wowM2CookedCache
+{
+public:
+	wowM2CookedCache(const CFileSystem* fs, const char* cacheDir);
+
+public:
+	//null if there is no blob, it is stale or its skeleton has another compression
+	CMemFile* openFile(const char* filename, const SSkeletonCompression* compression) const;
+	bool writeFile(const char* filename, const wowM2File* m2File, const uint8_t* modelData, uint32_t modelSize, const SSkeletonCompression* compression) const;
+
+	static void cook(const wowM2File* m2File, const uint8_t* modelData, uint32_t modelSize, const SSkeletonCompression* compression, std::vector<uint8_t>& blob);
+	static bool isValid(const uint8_t* blob, uint32_t size, const SSkeletonCompression* compression);
+
+	template <class T>
+	static const T* getArray(const uint8_t* blob, const SM2CookedArray& arr) { return reinterpret_cast<const T*>(blob + arr.ofs); }
+
+private:
+	void getCookedFileName(const char* filename, char* outfilename, uint32_t size) const;
+
+private:
+	const CFileSystem*	FileSystem;
+	std::string		CacheDir;
+};
@@ -4,18 +4,40 @@
 
 #include "wowEnvironment.h"
 #include "wowGameFile.h"
+#include "wowAnimFileCache.h"
+#include "wowSkinLodLoader.h"
+#include "wowMeshOptimizer.h"
+#include "wowM2CookedCache.h"
 
 wowM2File::wowM2File(const wowEnvironment* wowEnv)
-	: WowEnvironment(wowEnv), SkinFile(this)
+	: WowEnvironment(wowEnv), SkinFile(this), AnimFileCache(nullptr), SkinLodLoader(nullptr)
 {
 }
 
 wowM2File::~wowM2File()
 {
+	if (AnimFileCache)
+		AnimFileCache->removeM2File(this);
+	if (SkinLodLoader)
+		SkinLodLoader->removeM2File(this);
+
+	for (wowSkinFile* skinFile : SkinLods)
+		delete skinFile;
 }
 
-bool wowM2File::loadFile(const char* filename)
+bool wowM2File::loadFile(const char* filename, const SSkeletonCompression* compression, const wowM2CookedCache* cookedCache)
 {
+	if (cookedCache)
+	{
+		CMemFile* cookedFile = cookedCache->openFile(filename, compression);
+		if (cookedFile)
+		{
+			bool ret = loadCookedFile(filename, cookedFile->getBuffer(), compression);
+			delete cookedFile;
+			return ret;
+		}
+	}
+
 	CMemFile* memFile = WowEnvironment->openFile(filename);
 	if (!memFile)
 		return false;
@@ -36,23 +58,7 @@ bool wowM2File::loadFile(const char* filename)
 		}
 	}
 
-	memcpy(&Header, gameFile.getFileData(), sizeof(Header));
-
-	char meshName[DEFAULT_SIZE];
-	Q_strncpy(meshName, DEFAULT_SIZE, (const char*)&gameFile.getFileData()[Header._modelNameOffset], Header._modelNameLength);
-	meshName[Header._modelNameLength] = '\0';
-
-	const char* sharp = strstr(meshName, "#");
-	if (sharp)
-		Name = std::string(meshName, sharp - meshName);
-	else
-		Name = meshName;
-
-	FileName = getFileNameNoExtensionA(filename);
-	Dir = getFileDirA(filename);
-	normalizeDirName(Dir);
-
-	Type = getM2Type(Dir.c_str());				//ɫnpc
+	loadHeader(filename, gameFile.getFileData());
 
 	if (gameFile.isChunked() && gameFile.setChunk("SKID"))
 	{
@@ -83,37 +89,127 @@ bool wowM2File::loadFile(const char* filename)
 	}
 
 	const uint8_t* filebuffer = memFile->getPointer();
+	const uint32_t modelSize = gameFile.isChunked() ? gameFile.getFileSize() : memFile->getSize();
 
 	//
 	loadVertices(filebuffer);
 
-	loadBounds(filebuffer);
+	loadModel(filebuffer, compression);
 
-	loadTextures(filebuffer);
+	AnimFileIDs.assign(Animations.size(), 0);
+	AnimFileLoaded.assign(Animations.size(), false);
+	if (gameFile.isChunked() && gameFile.setChunk("AFID"))
+		loadAnimFileIDs(gameFile.getFileData(), gameFile.getFileSize());
 
-	loadSequences(filebuffer);
+	SkinLods.assign(SkinFileIDs.size(), nullptr);
+	SkinLodFailed.assign(SkinFileIDs.size(), false);
 
-	loadColor(filebuffer);
+	if (!loadSkin(0, &SkinFile))
+	{
+		delete memFile;
+		return false;
+	}
+
+	if (cookedCache)
+		cookedCache->writeFile(filename, this, filebuffer, modelSize, compression);
 
-	loadTransparency(filebuffer);
+	delete memFile;
 
-	loadTextureAnimation(filebuffer);
+	return true;
+}
 
-	loadBones(filebuffer);
+void wowM2File::loadHeader(const char* filename, const uint8_t* fileStart)
+{
+	memcpy(&Header, fileStart, sizeof(Header));
 
-	loadRenderFlags(filebuffer);
+	char meshName[DEFAULT_SIZE];
+	Q_strncpy(meshName, DEFAULT_SIZE, (const char*)&fileStart[Header._modelNameOffset], Header._modelNameLength);
+	meshName[Header._modelNameLength] = '\0';
+
+	const char* sharp = strstr(meshName, "#");
+	if (sharp)
+		Name = std::string(meshName, sharp - meshName);
+	else
+		Name = meshName;
 
-	loadAttachments(filebuffer);
+	FileName = getFileNameNoExtensionA(filename);
+	Dir = getFileDirA(filename);
+	normalizeDirName(Dir);
 
-	loadParticleSystems(filebuffer);
+	Type = getM2Type(Dir.c_str());				//ɫnpc
+}
 
-	loadRibbonEmitters(filebuffer);
+void wowM2File::loadModel(const uint8_t* fileStart, const SSkeletonCompression* compression, const uint8_t* cookedSkeleton, uint32_t cookedSkeletonSize)
+{
+	loadBounds(fileStart);
 
-	delete memFile;
+	loadTextures(fileStart);
 
-	if (!loadSkin(0))
-	{
+	loadSequences(fileStart);
+
+	loadColor(fileStart);
+
+	loadTransparency(fileStart);
+
+	loadTextureAnimation(fileStart);
+
+	loadBones(fileStart, compression, cookedSkeleton, cookedSkeletonSize);
+
+	loadRenderFlags(fileStart);
+
+	loadAttachments(fileStart);
+
+	loadParticleSystems(fileStart);
+
+	loadRibbonEmitters(fileStart);
+}
+
+bool wowM2File::loadCookedFile(const char* filename, const uint8_t* blob, const SSkeletonCompression* compression)
+{
+	const SM2CookedHeader* cooked = reinterpret_cast<const SM2CookedHeader*>(blob);
+	const uint8_t* fileStart = wowM2CookedCache::getArray<uint8_t>(blob, cooked->modelData);
+
+	loadHeader(filename, fileStart);
+
+	const uint32_t* skinFileIDs = wowM2CookedCache::getArray<uint32_t>(blob, cooked->skinFileIDs);
+	SkinFileIDs.assign(skinFileIDs, skinFileIDs + cooked->skinFileIDs.count);
+
+	//vertices are already converted, the cooked bounding box is the one loadVertices builds
+	const SVertex_PNT2WA* vertices = wowM2CookedCache::getArray<SVertex_PNT2WA>(blob, cooked->vertices);
+	Vertices.assign(vertices, vertices + cooked->vertices.count);
+	BoundingBox = aabbox3df(vector3df(cooked->boundingBox[0], cooked->boundingBox[1], cooked->boundingBox[2]),
+		vector3df(cooked->boundingBox[3], cooked->boundingBox[4], cooked->boundingBox[5]));
+
+	//the tracks are not read and compressed again
+	const uint8_t* skeleton = cooked->skeleton.count ? wowM2CookedCache::getArray<uint8_t>(blob, cooked->skeleton) : nullptr;
+	loadModel(fileStart, compression, skeleton, cooked->skeleton.count);
+
+	const uint32_t* animFileIDs = wowM2CookedCache::getArray<uint32_t>(blob, cooked->animFileIDs);
+	AnimFileIDs.assign(animFileIDs, animFileIDs + cooked->animFileIDs.count);
+	AnimFileIDs.resize(Animations.size(), 0);
+	AnimFileLoaded.assign(Animations.size(), false);
+
+	SkinLods.assign(SkinFileIDs.size(), nullptr);
+	SkinLodFailed.assign(SkinFileIDs.size(), false);
+
+	if (SkinFileIDs.empty())
 		return false;
+
+	const uint16_t* indices = wowM2CookedCache::getArray<uint16_t>(blob, cooked->indices);
+	SkinFile.Indices.assign(indices, indices + cooked->indices.count);
+
+	const SM2CookedGeoset* geosets = wowM2CookedCache::getArray<SM2CookedGeoset>(blob, cooked->geosets);
+	const SGeoset::STexUnit* texUnits = wowM2CookedCache::getArray<SGeoset::STexUnit>(blob, cooked->texUnits);
+	SkinFile.Geosets.resize(cooked->geosets.count);
+	for (uint32_t i = 0; i < cooked->geosets.count; ++i)
+	{
+		SGeoset& geo = SkinFile.Geosets[i];
+		geo.GeoID = geosets[i].GeoID;
+		geo.VStart = geosets[i].VStart;
+		geo.VCount = geosets[i].VCount;
+		geo.IStart = geosets[i].IStart;
+		geo.ICount = geosets[i].ICount;
+		geo.TextureUnits.assign(texUnits + geosets[i].TexUnitStart, texUnits + geosets[i].TexUnitStart + geosets[i].NumTexUnits);
 	}
 
 	return true;
@@ -145,12 +241,15 @@ void wowM2File::loadVertices(const uint8_t* fileStart)
 
 void wowM2File::loadBounds(const uint8_t* fileStart)
 {
-	if (Header._nBoundingVertices > 0)
+	if (Header._nBoundingVertices > 0 && Header._nBoundingTriangles > 0)
 	{
-	}
+		const vector3df* v = (const vector3df*)(&fileStart[Header._ofsBoundingVertices]);
+		std::vector<vector3df> vertices(Header._nBoundingVertices);
+		for (uint32_t i = 0; i < Header._nBoundingVertices; ++i)
+			vertices[i] = M2::fixCoordinate(v[i]);
 
-	if (Header._nBoundingTriangles > 0)
-	{
+		const uint16_t* indices = (const uint16_t*)(&fileStart[Header._ofsBoundingTriangles]);
+		CollisionBVH.build(vertices.data(), Header._nBoundingVertices, indices, Header._nBoundingTriangles);
 	}
 
 	BoundingAABBox = aabbox3df(M2::fixCoordinate(Header._boundingbox.MinEdge), M2::fixCoordinate(Header._boundingbox.MaxEdge));
@@ -195,6 +294,28 @@ void wowM2File::loadSequences(const uint8_t* fileStart)
 		GlobalSequences.resize(Header._nGlobalSequences);
 		memcpy(GlobalSequences.data(), p, sizeof(int32_t) * Header._nGlobalSequences);
 	}
+
+	if (Header._nAnimations > 0)
+	{
+		const M2::animseq* a = (M2::animseq*)(&fileStart[Header._ofsAnimations]);
+		Animations.resize(Header._nAnimations);
+		for (uint32_t i = 0; i < Header._nAnimations; ++i)
+		{
+			Animations[i].animID = a[i]._AnimationID;
+			Animations[i].animSubID = a[i]._SubAnimationID;
+			Animations[i].timeLength = a[i]._Length;
+			Animations[i].flags = a[i]._Flags;
+			Animations[i].NextAnimation = a[i]._NextAnimation;
+			Animations[i].Index = a[i]._Index;
+		}
+	}
+
+	if (Header._nAnimationLookup > 0)
+	{
+		const int16_t* p = (int16_t*)(&fileStart[Header._ofsAnimationLookup]);
+		AnimationLookups.resize(Header._nAnimationLookup);
+		memcpy(AnimationLookups.data(), p, sizeof(int16_t) * Header._nAnimationLookup);
+	}
 }
 
 void wowM2File::loadColor(const uint8_t* fileStart)
@@ -250,12 +371,41 @@ void wowM2File::loadTextureAnimation(const uint8_t* fileStart)
 	}
 }
 
-void wowM2File::loadBones(const uint8_t* fileStart)
+void wowM2File::loadBones(const uint8_t* fileStart, const SSkeletonCompression* compression, const uint8_t* cookedSkeleton, uint32_t cookedSkeletonSize)
 {
-	if (Header._nAnimations == 0)
-		return;
+	//a cooked skeleton that doesn't load is built again from the bones
+	if (Header._nBones > 0 && cookedSkeleton)
+	{
+		if (!Skeleton.loadCooked(cookedSkeleton, cookedSkeletonSize, GlobalSequences.data(), (uint32_t)GlobalSequences.size(), compression) ||
+			Skeleton.getNumBones() != Header._nBones)
+			cookedSkeleton = nullptr;
+	}
+
+	if (Header._nBones > 0 && !cookedSkeleton)
+	{
+		const M2::bone* b = (M2::bone*)(&fileStart[Header._ofsBones]);
+
+		//keys of sequences without the embedded flag are in .anim files
+		uint32_t numAnimFiles = Header._nAnimations;
+		for (uint32_t i = 0; i < Header._nBones; ++i)
+		{
+			numAnimFiles = std::max(numAnimFiles, b[i]._Translation._Ntimings);
+			numAnimFiles = std::max(numAnimFiles, b[i]._Rotation._Ntimings);
+			numAnimFiles = std::max(numAnimFiles, b[i]._Scaling._Ntimings);
+		}
 
+		std::vector<SAnimFile> animFiles;
+		initAnimFiles(animFiles, numAnimFiles);
 
+		Skeleton.init(fileStart, b, Header._nBones, animFiles.data(), GlobalSequences.data(), (uint32_t)GlobalSequences.size(), compression);
+	}
+
+	if (Header._nKeyBoneLookup > 0)
+	{
+		const int16_t* p = (int16_t*)(&fileStart[Header._ofsKeyBoneLookup]);
+		KeyBoneLookups.resize(Header._nKeyBoneLookup);
+		memcpy(KeyBoneLookups.data(), p, sizeof(int16_t) * Header._nKeyBoneLookup);
+	}
 }
 
 void wowM2File::loadRenderFlags(const uint8_t* fileStart)
@@ -291,17 +441,231 @@ void wowM2File::loadAttachments(const uint8_t* fileStart)
 	}
 }
 
+void wowM2File::initAnimFiles(std::vector<SAnimFile>& animFiles, uint32_t numAnimFiles) const
+{
+	animFiles.resize(numAnimFiles);
+	for (uint32_t i = 0; i < numAnimFiles; ++i)
+	{
+		animFiles[i].data = nullptr;
+		animFiles[i].size = (i < (uint32_t)Animations.size() && (Animations[i].flags & ANIMATION_EMBEDDED) == 0) ? 1 : 0;
+	}
+}
+
+//keys of sequences in .anim files are skipped, as for the bones
+template <class T>
+static void initTrack(T& track, const M2::animblock& block, const uint8_t* fileStart, std::vector<SAnimFile>& animFiles, std::vector<int32_t>& globalSequences)
+{
+	if (animFiles.size() < block._Ntimings)
+	{
+		SAnimFile embedded = { nullptr, 0 };
+		animFiles.resize(block._Ntimings, embedded);
+	}
+	track.init(&block, fileStart, animFiles.data(), globalSequences.data(), (uint32_t)globalSequences.size());
+}
+
 void wowM2File::loadParticleSystems(const uint8_t* fileStart)
 {
+	if (Header._nParticleEmitters == 0)
+		return;
+
+	//later versions append the multi texture parameters
+	uint32_t version;
+	memcpy(&version, Header._version, sizeof(version));
+	const uint32_t stride = version > 264 ? sizeof(M2::ModelParticleEmitterDefV10) : sizeof(M2::ModelParticleEmitterDef);
 
+	std::vector<SAnimFile> animFiles;
+	initAnimFiles(animFiles, Header._nAnimations);
+
+	ParticleEmitters.resize(Header._nParticleEmitters);
+	for (uint32_t i = 0; i < Header._nParticleEmitters; ++i)
+	{
+		const M2::ModelParticleEmitterDef& def = *(const M2::ModelParticleEmitterDef*)(&fileStart[Header._ofsParticleEmitters + i * stride]);
+		SModelParticleEmitter& emitter = ParticleEmitters[i];
+
+		emitter.id = def.id;
+		emitter.flags = (uint32_t)def.flags;
+		emitter.position = M2::fixCoordinate(def.pos);
+		emitter.boneIndex = (def.bone >= 0 && def.bone < (int32_t)Header._nBones) ? def.bone : -1;
+		emitter.textureIndex = def.texture;
+		emitter.blend = (uint8_t)def.blend;
+		emitter.emitterType = (uint8_t)def.EmitterType;
+		emitter.particleType = (uint8_t)def.ParticleType;
+		emitter.headTail = (uint8_t)def.HeaderTail;
+		emitter.rows = (uint16_t)std::max(def.rows, (int16_t)1);
+		emitter.cols = (uint16_t)std::max(def.cols, (int16_t)1);
+		emitter.drag = def.p.slowdown;
+
+		initTrack(emitter.speed, def.EmissionSpeed, fileStart, animFiles, GlobalSequences);
+		initTrack(emitter.speedVariation, def.SpeedVariation, fileStart, animFiles, GlobalSequences);
+		initTrack(emitter.verticalRange, def.VerticalRange, fileStart, animFiles, GlobalSequences);
+		initTrack(emitter.horizontalRange, def.HorizontalRange, fileStart, animFiles, GlobalSequences);
+		initTrack(emitter.gravity, def.Gravity, fileStart, animFiles, GlobalSequences);
+		initTrack(emitter.lifespan, def.Lifespan, fileStart, animFiles, GlobalSequences);
+		initTrack(emitter.emissionRate, def.EmissionRate, fileStart, animFiles, GlobalSequences);
+		initTrack(emitter.areaLength, def.EmissionAreaLength, fileStart, animFiles, GlobalSequences);
+		initTrack(emitter.areaWidth, def.EmissionAreaWidth, fileStart, animFiles, GlobalSequences);
+		initTrack(emitter.zSource, def.Gravity2, fileStart, animFiles, GlobalSequences);
+		initTrack(emitter.enabled, def.en, fileStart, animFiles, GlobalSequences);
+
+		//life keys, times are fixed point fractions of the lifespan
+		const M2::FakeAnimationBlock& colors = def.p.colors;
+		const M2::FakeAnimationBlock& opacity = def.p.opacity;
+		const M2::FakeAnimationBlock& sizes = def.p.sizes;
+		const uint32_t numColors = std::min(colors.nTimes, colors.nKeys);
+		const uint32_t numOpacities = std::min(opacity.nTimes, opacity.nKeys);
+		const uint32_t numSizes = std::min(sizes.nTimes, sizes.nKeys);
+
+		emitter.colorTimes.resize(numColors);
+		emitter.colors.resize(numColors);
+		for (uint32_t k = 0; k < numColors; ++k)
+		{
+			emitter.colorTimes[k] = ((const uint16_t*)&fileStart[colors.ofsTimes])[k] / 32767.0f;
+			emitter.colors[k] = ((const vector3df*)&fileStart[colors.ofsKeys])[k];
+		}
+
+		emitter.opacityTimes.resize(numOpacities);
+		emitter.opacities.resize(numOpacities);
+		for (uint32_t k = 0; k < numOpacities; ++k)
+		{
+			emitter.opacityTimes[k] = ((const uint16_t*)&fileStart[opacity.ofsTimes])[k] / 32767.0f;
+			emitter.opacities[k] = ((const uint16_t*)&fileStart[opacity.ofsKeys])[k] / 32767.0f;
+		}
+
+		emitter.sizeTimes.resize(numSizes);
+		emitter.sizes.resize(numSizes);
+		for (uint32_t k = 0; k < numSizes; ++k)
+		{
+			emitter.sizeTimes[k] = ((const uint16_t*)&fileStart[sizes.ofsTimes])[k] / 32767.0f;
+			emitter.sizes[k] = ((const vector2df*)&fileStart[sizes.ofsKeys])[k];
+		}
+	}
 }
 
 void wowM2File::loadRibbonEmitters(const uint8_t* fileStart)
 {
+	if (Header._nRibbonEmitters == 0)
+		return;
+
+	std::vector<SAnimFile> animFiles;
+	initAnimFiles(animFiles, Header._nAnimations);
+
+	const M2::ModelRibbonEmitterDef* defs = (const M2::ModelRibbonEmitterDef*)(&fileStart[Header._ofsRibbonEmitters]);
+	RibbonEmitters.resize(Header._nRibbonEmitters);
+	for (uint32_t i = 0; i < Header._nRibbonEmitters; ++i)
+	{
+		const M2::ModelRibbonEmitterDef& def = defs[i];
+		SModelRibbonEmitter& ribbon = RibbonEmitters[i];
+
+		ribbon.id = def.id;
+		ribbon.boneIndex = (def.bone >= 0 && def.bone < (int32_t)Header._nBones) ? def.bone : -1;
+		ribbon.position = M2::fixCoordinate(def.pos);
+		ribbon.resolution = def.res;
+		ribbon.length = def.length;
+		ribbon.emissionAngle = def.Emissionangle;
+
+		if (def.nTextures > 0)
+		{
+			const uint16_t* t = (const uint16_t*)(&fileStart[def.ofsTextures]);
+			ribbon.textureIndices.assign(t, t + def.nTextures);
+		}
+
+		initTrack(ribbon.color, def.color, fileStart, animFiles, GlobalSequences);
+		initTrack(ribbon.opacity, def.opacity, fileStart, animFiles, GlobalSequences);
+		initTrack(ribbon.above, def.above, fileStart, animFiles, GlobalSequences);
+		initTrack(ribbon.below, def.below, fileStart, animFiles, GlobalSequences);
+	}
+}
+
+void wowM2File::loadAnimFileIDs(const uint8_t* chunkData, uint32_t chunkSize)
+{
+	const M2::animFileID* ids = (const M2::animFileID*)chunkData;
+	const uint32_t numIds = chunkSize / sizeof(M2::animFileID);
+	for (uint32_t k = 0; k < numIds; ++k)
+	{
+		if (ids[k]._FileID == 0)
+			continue;
+
+		for (uint32_t i = 0; i < (uint32_t)Animations.size(); ++i)
+		{
+			if (Animations[i].animID == ids[k]._AnimationID && Animations[i].animSubID == ids[k]._SubAnimationID)
+			{
+				AnimFileIDs[i] = ids[k]._FileID;
+				break;
+			}
+		}
+	}
+}
+
+bool wowM2File::isAnimationExternal(uint32_t anim) const
+{
+	return anim < (uint32_t)Animations.size() && (Animations[anim].flags & ANIMATION_EMBEDDED) == 0 && AnimFileIDs[anim] != 0;
+}
+
+bool wowM2File::isAnimationLoaded(uint32_t anim) const
+{
+	if (anim >= (uint32_t)Animations.size())
+		return false;
+
+	if (Animations[anim].flags & ANIMATION_EMBEDDED)
+		return true;
+
+	return AnimFileLoaded[anim];
+}
+
+bool wowM2File::loadAnimFile(uint32_t anim, const CMemFile* memFile)
+{
+	if (!isAnimationExternal(anim))
+		return false;
+
+	if (AnimFileLoaded[anim])
+		return true;
+
+	//legacy .anim files are raw key data, newer ones put it in the AFM2 chunk
+	const uint8_t* data = memFile->getBuffer();
+	uint32_t size = memFile->getSize();
+	GameFile gameFile(memFile);
+	if (gameFile.isChunked())
+	{
+		if (!gameFile.setChunk("AFM2"))
+			return false;
+		data = gameFile.getFileData();
+		size = gameFile.getFileSize();
+	}
+
+	if (!Skeleton.loadAnimFile(anim, data, size))
+		return false;
+
+	AnimFileLoaded[anim] = true;
+	return true;
+}
+
+void wowM2File::unloadAnimFile(uint32_t anim)
+{
+	if (!isAnimationExternal(anim) || !AnimFileLoaded[anim])
+		return;
+
+	Skeleton.unloadAnimFile(anim);
+	AnimFileLoaded[anim] = false;
+}
+
+bool wowM2File::loadSkinLod(uint32_t lod, CMemFile* memFile)
+{
+	if (lod == 0 || lod >= (uint32_t)SkinLods.size() || SkinLods[lod])
+		return false;
 
+	wowSkinFile* skinFile = new wowSkinFile(this);
+	if (!memFile || !skinFile->loadFile(memFile) || skinFile->Indices.empty())
+	{
+		delete skinFile;
+		SkinLodFailed[lod] = true;
+		return false;
+	}
+
+	SkinLods[lod] = skinFile;
+	return true;
 }
 
-bool wowM2File::loadSkin(int index)
+bool wowM2File::loadSkin(int index, wowSkinFile* skinFile)
 {
 	if (index >= (int)SkinFileIDs.size())
 		return false;
@@ -310,7 +674,7 @@ bool wowM2File::loadSkin(int index)
 	if (!file)
 		return false;
 
-	if (!SkinFile.loadFile(file))
+	if (!skinFile->loadFile(file))
 	{
 		delete file;
 		return false;
@@ -349,7 +713,7 @@ bool wowSkinFile::loadFile(CMemFile* file)
 	const uint16_t* triangles = (const uint16_t*)(&skinBuffer[skinHeader->_ofsTriangles]);
 
 	Indices.resize(numIndices);
-	for (uint16_t i = 0; i < numIndices; ++i)
+	for (int i = 0; i < numIndices; ++i)
 	{
 		Indices[i] = indexLookup[triangles[i]];
 	}
@@ -357,6 +721,26 @@ bool wowSkinFile::loadFile(CMemFile* file)
 	//geosets
 	Geosets.resize(numGeosets);
 
+	const M2::submesh* submeshes = (const M2::submesh*)(&skinBuffer[skinHeader->_ofsSubmeshes]);
+	for (int i = 0; i < numGeosets; ++i)
+	{
+		SGeoset& geo = Geosets[i];
+		geo.GeoID = submeshes[i]._ID & 0xffff;
+		geo.VStart = submeshes[i]._startVertex;
+		geo.VCount = submeshes[i]._nVertices;
+		geo.IStart = submeshes[i]._startTriangle + ((submeshes[i]._ID >> 16) << 16);			//high word is the level of the start
+		geo.ICount = submeshes[i]._nTriangles;
+
+		if (geo.IStart + geo.ICount > (uint32_t)numIndices)
+		{
+			ASSERT(false);
+			geo.ICount = 0;
+		}
+
+		if (wowMeshOptimizer::isEnabled())
+			wowMeshOptimizer::optimizeVertexCache(&Indices[geo.IStart], geo.ICount);
+	}
+
 	//texture unit
 	const uint32_t numTexAnimLookup = (uint32_t)M2File->TextureAnimationLookups.size();
 	const uint32_t numTexLookup = (uint32_t)M2File->TextureAnimationLookups.size();
@@ -9,13 +9,20 @@
 #include "wowM2Struct.h"
 #include "S3DVertex.h"
 #include "wowAnimation.h"
+#include "wowM2Skeleton.h"
+#include "wowCollisionBVH.h"
 
 class wowEnvironment;
 class GameFile;
 class CMemFile;
+class wowAnimFileCache;
+class wowSkinLodLoader;
+class wowM2CookedCache;
 
 #define	ANIMATION_HANDSCLOSED	15
 
+#define	ANIMATION_EMBEDDED		0x20			//keys are in the m2 file, not in a .anim file
+
 #define	RENDERFLAGS_UNLIT		1
 #define	RENDERFLAGS_TWOSIDED	4
 #define	RENDERFLAGS_BILLBOARD	8
@@ -61,6 +68,12 @@ public:
 		uint16_t	Shading;		//shader?
 		uint32_t  TexFlags;
 
+		bool operator==(const STexUnit& c) const
+		{
+			return TexID == c.TexID && rfIndex == c.rfIndex && ColorIndex == c.ColorIndex && TransIndex == c.TransIndex &&
+				TexAnimIndex == c.TexAnimIndex && Mode == c.Mode && Shading == c.Shading && TexFlags == c.TexFlags;
+		}
+
 		bool WrapX() const { return TexAnimIndex == -1 && (TexFlags & TEXTURE_WRAPX) == 0; }
 		bool WrapY() const { return TexAnimIndex == -1 && (TexFlags & TEXTURE_WRAPY) == 0; }
 	};
@@ -69,7 +82,7 @@ public:
 	uint32_t		GeoID = 0;
 	uint16_t		VStart = 0;
 	uint16_t		VCount = 0;
-	uint16_t		IStart = 0;
+	uint32_t		IStart = 0;
 	uint16_t		ICount = 0;
 	uint16_t		MaxWeights = 0;
 	
@@ -85,6 +98,8 @@ public:
 
 	bool loadFile(CMemFile* file);
 
+	uint32_t getNumTriangles() const { return (uint32_t)Indices.size() / 3; }
+
 public:
 	std::vector<uint16_t>	Indices;
 	std::vector<SGeoset>	Geosets;
@@ -100,7 +115,25 @@ public:
 	~wowM2File();
 
 public:
-	bool loadFile(const char* filename);
+	//with a cooked cache the m2 and its skin 0 are read from the cooked blob, which is written on the first load
+	bool loadFile(const char* filename, const SSkeletonCompression* compression = nullptr, const wowM2CookedCache* cookedCache = nullptr);
+
+	//bone keys of sequences without ANIMATION_EMBEDDED are in .anim files, see wowAnimFileCache
+	bool isAnimationExternal(uint32_t anim) const;
+	bool isAnimationLoaded(uint32_t anim) const;
+	bool loadAnimFile(uint32_t anim, const CMemFile* memFile);
+	void unloadAnimFile(uint32_t anim);
+	uint32_t getAnimFileMemorySize(uint32_t anim) const { return Skeleton.getAnimMemorySize(anim); }		//decoded keys
+	void setAnimFileCache(wowAnimFileCache* cache) { AnimFileCache = cache; }
+
+	//skin LODs are the views in SFID order, LOD 0 is SkinFile and the others are loaded on request, see wowSkinLodLoader
+	uint32_t getNumSkinLods() const { return SkinFileIDs.empty() ? 1 : (uint32_t)SkinFileIDs.size(); }
+	bool isSkinLodLoaded(uint32_t lod) const { return lod == 0 || (lod < (uint32_t)SkinLods.size() && SkinLods[lod]); }
+	bool isSkinLodFailed(uint32_t lod) const { return lod != 0 && (lod >= (uint32_t)SkinLodFailed.size() || SkinLodFailed[lod]); }
+	uint32_t getSkinLodFileID(uint32_t lod) const { return lod < (uint32_t)SkinFileIDs.size() ? SkinFileIDs[lod] : 0; }
+	const wowSkinFile* getSkinLod(uint32_t lod) const { return lod == 0 ? &SkinFile : (isSkinLodLoaded(lod) ? SkinLods[lod] : nullptr); }
+	bool loadSkinLod(uint32_t lod, CMemFile* memFile);
+	void setSkinLodLoader(wowSkinLodLoader* loader) { SkinLodLoader = loader; }
 
 public:
 	struct STexDef 
@@ -152,11 +185,57 @@ public:
 		vector3df position;
 	};
 
+	//tracks are sampled at the sequence time, the particle keys at the particle age
+	struct SModelParticleEmitter
+	{
+		int32_t		id;
+		uint32_t	flags;
+		vector3df	position;				//relative to the bone
+		int32_t		boneIndex;
+		int16_t		textureIndex;
+		uint8_t		blend;
+		uint8_t		emitterType;			//MODELPARTICLE_EMITTER_*
+		uint8_t		particleType;
+		uint8_t		headTail;
+		uint16_t	rows;
+		uint16_t	cols;
+		float		drag;
+
+		SWowAnimation<float>	speed, speedVariation, verticalRange, horizontalRange;
+		SWowAnimation<float>	gravity, lifespan, emissionRate;
+		SWowAnimation<float>	areaLength, areaWidth, zSource;
+		SWowAnimation<uint8_t>	enabled;
+
+		//keys over the particle life, times in [0, 1]
+		std::vector<float>		colorTimes;
+		std::vector<vector3df>	colors;				//0 - 255
+		std::vector<float>		opacityTimes;
+		std::vector<float>		opacities;
+		std::vector<float>		sizeTimes;
+		std::vector<vector2df>	sizes;
+	};
+
+	struct SModelRibbonEmitter
+	{
+		int32_t		id;
+		int32_t		boneIndex;
+		vector3df	position;
+		float		resolution;				//segments per second
+		float		length;
+		float		emissionAngle;
+		std::vector<uint16_t>	textureIndices;
+
+		SWowAnimation<vector3df>	color;
+		SWowAnimationShort		opacity;
+		SWowAnimation<float>	above, below;
+	};
+
 	struct SModelAnimation
 	{
 		uint32_t	animID;
 		uint32_t	animSubID;
 		uint32_t	timeLength;
+		uint32_t	flags;
 
 		int16_t		NextAnimation;
 		int16_t		Index;
@@ -188,6 +267,7 @@ public:
 	aabbox3df	BoundingAABBox;			//İΧ
 	float		BoundingRadius;
 	aabbox3df		BoundingBox;
+	wowCollisionBVH		CollisionBVH;			//bounding triangles, empty if the m2 has none
 
 	std::vector<SVertex_PNT2WA>		Vertices;
 	std::vector<uint32_t>	SkinFileIDs;
@@ -207,13 +287,27 @@ public:
 
 	std::vector<SModelAnimation>	Animations;
 	std::vector<int16_t>	AnimationLookups;
+	std::vector<uint32_t>	AnimFileIDs;			//per sequence, 0 if no .anim file
+
+	wowM2Skeleton	Skeleton;
+	std::vector<int16_t>	KeyBoneLookups;
 
 	std::vector<SModelAttachment>	Attachments;
 	std::vector<int16_t>	AttachLookups;
 
+	std::vector<SModelParticleEmitter>	ParticleEmitters;
+	std::vector<SModelRibbonEmitter>	RibbonEmitters;
+
 	wowSkinFile	SkinFile;
 
 private:
+	void loadHeader(const char* filename, const uint8_t* fileStart);
+
+	//the skeleton is built from the bones, or restored from cookedSkeleton if it is set
+	void loadModel(const uint8_t* fileStart, const SSkeletonCompression* compression, const uint8_t* cookedSkeleton = nullptr, uint32_t cookedSkeletonSize = 0);
+
+	bool loadCookedFile(const char* filename, const uint8_t* blob, const SSkeletonCompression* compression);
+
 	void loadVertices(const uint8_t* fileStart);
 
 	void loadBounds(const uint8_t* fileStart);
@@ -228,7 +322,7 @@ private:
 
 	void loadTextureAnimation(const uint8_t* fileStart);
 
-	void loadBones(const uint8_t* fileStart);
+	void loadBones(const uint8_t* fileStart, const SSkeletonCompression* compression, const uint8_t* cookedSkeleton, uint32_t cookedSkeletonSize);
 
 	void loadRenderFlags(const uint8_t* fileStart);
 
@@ -238,8 +332,18 @@ private:
 
 	void loadRibbonEmitters(const uint8_t* fileStart);
 
-	bool loadSkin(int index);
+	void initAnimFiles(std::vector<SAnimFile>& animFiles, uint32_t numAnimFiles) const;
+
+	void loadAnimFileIDs(const uint8_t* chunkData, uint32_t chunkSize);
+
+	bool loadSkin(int index, wowSkinFile* skinFile);
 
 private:
 	const wowEnvironment* WowEnvironment;
+	wowAnimFileCache*	AnimFileCache;
+	wowSkinLodLoader*	SkinLodLoader;
+	std::vector<bool>	AnimFileLoaded;
+
+	std::vector<wowSkinFile*>	SkinLods;			//null until loaded
+	std::vector<bool>	SkinLodFailed;
 };
\ No newline at end of file
@@ -0,0 +1,160 @@
+#include "wowM2Geosets.h"
+
+#include "wowM2File.h"
+#include "wowDatabase.h"
+#include <algorithm>
+
+//CharacterFacialHairStyles.Geoset[i] is the variant - 1 of these groups
+static const uint32_t g_FacialHairGroups[5] = { 1, 3, 2, 16, 17 };
+
+SGeosetSelection::SGeosetSelection()
+{
+	for (uint32_t i = 0; i < M2_GEOSET_GROUPS; ++i)
+		Variants[i] = M2_GEOSET_ANY;
+}
+
+void SGeosetSelection::setCharacterDefaults()
+{
+	for (uint32_t i = 0; i < M2_GEOSET_GROUPS; ++i)
+		Variants[i] = 1;
+}
+
+bool SGeosetSelection::setHair(const wowDatabase* database, uint32_t race, uint32_t sex, uint32_t variation)
+{
+	const auto& table = database->m_CharHairGeoSetsTable;
+	for (const auto& e : table.findAll("RaceID", race))
+	{
+		const auto& r = table.RecordList[e.row];
+		if (r.SexID == sex && r.VariationID == variation)
+		{
+			Variants[0] = r.GeoSetID ? r.GeoSetID : 1;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool SGeosetSelection::setFacialHair(const wowDatabase* database, uint32_t race, uint32_t sex, uint32_t variation)
+{
+	const auto& table = database->m_CharacterFacialHairStylesTable;
+	for (const auto& e : table.findAll("RaceID", race))
+	{
+		const auto& r = table.RecordList[e.row];
+		if (r.SexID == sex && r.VariationID == variation)
+		{
+			for (uint32_t i = 0; i < 5; ++i)
+				Variants[g_FacialHairGroups[i]] = (uint16_t)(r.Geoset[i] + 1);
+			return true;
+		}
+	}
+	return false;
+}
+
+void SGeosetSelection::hideForHelmet(const wowDatabase* database, uint32_t race, uint32_t geosetVisDataId)
+{
+	const auto& table = database->m_HelmetGeosetDataTable;
+	for (const auto& e : table.findAll("GeosetVisDataID", geosetVisDataId))
+	{
+		const auto& r = table.RecordList[e.row];
+		if (r.RaceID > 0 && (uint32_t)r.RaceID != race)
+			continue;
+
+		if (r.GeosetGroup < M2_GEOSET_GROUPS)
+			Variants[r.GeosetGroup] = r.GeosetGroup == 0 ? 1 : 0;
+	}
+}
+
+bool SGeosetSelection::isVisible(uint32_t geoId) const
+{
+	const uint32_t group = geoId / 100;
+	if (geoId == 0 || group >= M2_GEOSET_GROUPS)
+		return true;
+
+	return Variants[group] == M2_GEOSET_ANY || Variants[group] == geoId % 100;
+}
+
+void wowM2Geosets::getVisibilityMask(const wowSkinFile* skinFile, const SGeosetSelection& selection, std::vector<uint32_t>& mask)
+{
+	const uint32_t numGeosets = (uint32_t)skinFile->Geosets.size();
+	mask.assign((numGeosets + 31) / 32, 0);
+	for (uint32_t i = 0; i < numGeosets; ++i)
+	{
+		if (selection.isVisible(skinFile->Geosets[i].GeoID))
+			mask[i >> 5] |= 1u << (i & 31);
+	}
+}
+
+void wowM2Geosets::buildDrawRanges(const wowSkinFile* skinFile, const std::vector<uint32_t>& mask,
+	std::vector<uint16_t>& indices, std::vector<SGeosetDrawRange>& ranges)
+{
+	const std::vector<SGeoset>& geosets = skinFile->Geosets;
+
+	//geosets of each range, in skin order
+	//only consecutive visible geosets are merged so that the draws keep the skin order for blending
+	//VStart and VCount are 16 bit, a range is not extended over more than 0xffff vertices
+	std::vector<std::vector<uint32_t>> members;
+	ranges.clear();
+	uint32_t rangeVStart = 0;
+	uint32_t rangeVEnd = 0;
+	for (uint32_t i = 0; i < (uint32_t)geosets.size(); ++i)
+	{
+		if (!isVisible(mask, i) || geosets[i].ICount == 0)
+			continue;
+
+		const SGeoset& geo = geosets[i];
+		const uint32_t geoStart = geo.VStart;
+		const uint32_t geoEnd = geoStart + geo.VCount;
+		if (!ranges.empty() && geosets[ranges.back().Geoset].TextureUnits == geo.TextureUnits &&
+			std::max(rangeVEnd, geoEnd) - std::min(rangeVStart, geoStart) <= 0xffff)
+		{
+			rangeVStart = std::min(rangeVStart, geoStart);
+			rangeVEnd = std::max(rangeVEnd, geoEnd);
+			members.back().push_back(i);
+			continue;
+		}
+
+		SGeosetDrawRange range;
+		range.Geoset = i;
+		range.NumGeosets = 0;
+		range.IStart = 0;
+		range.ICount = 0;
+		range.VStart = 0;
+		range.VCount = 0;
+		ranges.push_back(range);
+		members.emplace_back(1, i);
+		rangeVStart = geoStart;
+		rangeVEnd = geoEnd;
+	}
+
+	indices.clear();
+	for (uint32_t k = 0; k < (uint32_t)ranges.size(); ++k)
+	{
+		SGeosetDrawRange& range = ranges[k];
+		range.IStart = (uint32_t)indices.size();
+		range.NumGeosets = (uint32_t)members[k].size();
+
+		uint32_t vStart = 0xffff;
+		uint32_t vEnd = 0;
+		uint32_t runStart = 0;
+		uint32_t runEnd = 0;
+		for (uint32_t i : members[k])
+		{
+			const SGeoset& geo = geosets[i];
+			vStart = std::min(vStart, (uint32_t)geo.VStart);
+			vEnd = std::max(vEnd, (uint32_t)geo.VStart + geo.VCount);
+
+			if (geo.IStart != runEnd)
+			{
+				indices.insert(indices.end(), skinFile->Indices.begin() + runStart, skinFile->Indices.begin() + runEnd);
+				runStart = geo.IStart;
+			}
+			runEnd = geo.IStart + geo.ICount;
+		}
+		indices.insert(indices.end(), skinFile->Indices.begin() + runStart, skinFile->Indices.begin() + runEnd);
+
+		ASSERT(vEnd - vStart <= 0xffff);
+		range.ICount = (uint32_t)indices.size() - range.IStart;
+		range.VStart = (uint16_t)vStart;
+		range.VCount = (uint16_t)(vEnd - vStart);
+	}
+}
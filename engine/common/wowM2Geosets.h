@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+class wowSkinFile;
+class wowDatabase;
+
+#define M2_GEOSET_GROUPS	40
+#define M2_GEOSET_ANY		0xffff
+
+//selected variant of each geoset group, geoset ids are group * 100 + variant
+//groups show all their geosets by default, a variant of 0 hides the group, geoset 0 (the body) is always shown
+struct SGeosetSelection
+{
+	SGeosetSelection();
+
+	//variant 1 in every group, the bald scalp and no facial hair
+	void setCharacterDefaults();
+
+	//from CharHairGeoSets and CharacterFacialHairStyles
+	bool setHair(const wowDatabase* database, uint32_t race, uint32_t sex, uint32_t variation);
+	bool setFacialHair(const wowDatabase* database, uint32_t race, uint32_t sex, uint32_t variation);
+
+	//groups of HelmetGeosetData hidden by the helmet, a hidden hair group leaves the scalp
+	void hideForHelmet(const wowDatabase* database, uint32_t race, uint32_t geosetVisDataId);
+
+	bool isVisible(uint32_t geoId) const;
+
+	uint16_t	Variants[M2_GEOSET_GROUPS];
+};
+
+//visible geosets drawn with one call, Geoset is the first one and its texture units are the ones of all
+//IStart is in the index list built with the ranges
+struct SGeosetDrawRange
+{
+	uint32_t	Geoset;
+	uint32_t	NumGeosets;
+	uint32_t	IStart;
+	uint32_t	ICount;
+	uint16_t	VStart;
+	uint16_t	VCount;
+};
+
+class wowM2Geosets
+{
+public:
+	//bit i is set if skinFile->Geosets[i] is visible
+	static void getVisibilityMask(const wowSkinFile* skinFile, const SGeosetSelection& selection, std::vector<uint32_t>& mask);
+
+	//consecutive visible geosets with the same texture units become one range, their indices are gathered in indices
+	//ranges are in the order of their first geoset, runs of geosets contiguous in the skin are copied at once
+	static void buildDrawRanges(const wowSkinFile* skinFile, const std::vector<uint32_t>& mask,
+		std::vector<uint16_t>& indices, std::vector<SGeosetDrawRange>& ranges);
+
+	static bool isVisible(const std::vector<uint32_t>& mask, uint32_t geoset)
+	{
+		return (geoset >> 5) < mask.size() && (mask[geoset >> 5] & (1u << (geoset & 31))) != 0;
+	}
+};
@@ -0,0 +1,318 @@
+#include "wowM2Particles.h"
+
+#include "wowM2File.h"
+#include <algorithm>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define M2PARTICLES_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+void SParticlePool::init(uint32_t capacity)
+{
+	Capacity = capacity;
+	NumAlive = 0;
+
+	const uint32_t padded = (capacity + 3) & ~3u;
+	PosX.assign(padded, 0); PosY.assign(padded, 0); PosZ.assign(padded, 0);
+	VelX.assign(padded, 0); VelY.assign(padded, 0); VelZ.assign(padded, 0);
+	Life.assign(padded, 0);
+	LifeRate.assign(padded, 0);
+	Tile.assign(padded, 0);
+}
+
+void SParticlePool::kill(uint32_t i)
+{
+	ASSERT(i < NumAlive);
+	const uint32_t last = --NumAlive;
+	PosX[i] = PosX[last]; PosY[i] = PosY[last]; PosZ[i] = PosZ[last];
+	VelX[i] = VelX[last]; VelY[i] = VelY[last]; VelZ[i] = VelZ[last];
+	Life[i] = Life[last];
+	LifeRate[i] = LifeRate[last];
+	Tile[i] = Tile[last];
+}
+
+//xorshift, [0, 1)
+static inline float randomFloat(uint32_t& state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return (state >> 8) * (1.0f / 16777216.0f);
+}
+
+//tracks of global sequences have a single entry
+template <class T>
+static T getTrackValue(const SWowAnimation<T>& track, uint32_t anim, uint32_t time, T def)
+{
+	T v = def;
+	if (anim >= track.getNumAnimations())
+		anim = 0;
+	track.getValue(anim, time, v);
+	return v;
+}
+
+template <class T>
+static T getLifeValue(const std::vector<float>& times, const std::vector<T>& keys, float t, const T& def)
+{
+	if (keys.empty())
+		return def;
+	if (keys.size() == 1 || t <= times[0])
+		return keys[0];
+
+	for (size_t k = 1; k < keys.size(); ++k)
+	{
+		if (t <= times[k])
+		{
+			const float span = times[k] - times[k - 1];
+			const float r = span > 0 ? (t - times[k - 1]) / span : 1.0f;
+			return keys[k - 1] * (1.0f - r) + keys[k] * r;
+		}
+	}
+	return keys.back();
+}
+
+wowM2ParticleSystem::wowM2ParticleSystem(const wowM2File* m2File, uint32_t maxParticlesPerEmitter)
+	: M2File(m2File)
+{
+	Emitters.resize(M2File->ParticleEmitters.size());
+	for (uint32_t i = 0; i < (uint32_t)Emitters.size(); ++i)
+	{
+		const wowM2File::SModelParticleEmitter& def = M2File->ParticleEmitters[i];
+		SEmitterState& state = Emitters[i];
+
+		state.Pool.init(maxParticlesPerEmitter);
+		state.EmitAccumulator = 0;
+		state.Random = 0x9e3779b9u * (i + 1);
+
+		//color, opacity and size only depend on the age, they are looked up instead of interpolated per particle
+		for (uint32_t k = 0; k < PARTICLE_LUT_SIZE; ++k)
+		{
+			const float t = k / (float)(PARTICLE_LUT_SIZE - 1);
+			const vector3df color = getLifeValue(def.colorTimes, def.colors, t, vector3df(255.0f, 255.0f, 255.0f));
+			const float opacity = getLifeValue(def.opacityTimes, def.opacities, t, 1.0f);
+			state.ColorLut[k].set(
+				(uint32_t)clamp_(opacity * 255.0f, 0.0f, 255.0f),
+				(uint32_t)clamp_(color.x, 0.0f, 255.0f),
+				(uint32_t)clamp_(color.y, 0.0f, 255.0f),
+				(uint32_t)clamp_(color.z, 0.0f, 255.0f));
+			state.SizeLut[k] = getLifeValue(def.sizeTimes, def.sizes, t, vector2df(1.0f, 1.0f));
+		}
+	}
+}
+
+void wowM2ParticleSystem::tick(uint32_t anim, uint32_t time, uint32_t tickTime, const matrix4* bones, uint32_t numBones)
+{
+	const float dt = tickTime * 0.001f;
+	if (dt <= 0)
+		return;
+
+	for (uint32_t i = 0; i < (uint32_t)Emitters.size(); ++i)
+	{
+		const wowM2File::SModelParticleEmitter& def = M2File->ParticleEmitters[i];
+		const matrix4* bone = (bones && def.boneIndex >= 0 && def.boneIndex < (int32_t)numBones) ? &bones[def.boneIndex] : nullptr;
+
+		emit(i, anim, time, dt, bone);
+
+		const float gravity = getTrackValue(def.gravity, anim, time, 0.0f);
+		integrate(Emitters[i].Pool, dt, gravity, def.drag);
+	}
+}
+
+void wowM2ParticleSystem::emit(uint32_t index, uint32_t anim, uint32_t time, float dt, const matrix4* bone)
+{
+	const wowM2File::SModelParticleEmitter& def = M2File->ParticleEmitters[index];
+	SEmitterState& state = Emitters[index];
+	SParticlePool& pool = state.Pool;
+
+	if (getTrackValue(def.enabled, anim, time, (uint8_t)1) == 0)
+	{
+		state.EmitAccumulator = 0;
+		return;
+	}
+
+	const float rate = getTrackValue(def.emissionRate, anim, time, 0.0f);
+	const float lifespan = getTrackValue(def.lifespan, anim, time, 1.0f);
+	if (rate <= 0 || lifespan <= 0)
+		return;
+
+	state.EmitAccumulator += rate * dt;
+	uint32_t count = (uint32_t)state.EmitAccumulator;
+	state.EmitAccumulator -= count;
+	count = std::min(count, pool.Capacity - pool.NumAlive);
+	if (count == 0)
+		return;
+
+	const float speed = getTrackValue(def.speed, anim, time, 0.0f);
+	const float variation = getTrackValue(def.speedVariation, anim, time, 0.0f);
+	const float verticalRange = getTrackValue(def.verticalRange, anim, time, 0.0f);
+	const float horizontalRange = getTrackValue(def.horizontalRange, anim, time, 0.0f);
+	const float areaLength = getTrackValue(def.areaLength, anim, time, 0.0f);
+	const float areaWidth = getTrackValue(def.areaWidth, anim, time, 0.0f);
+	const float zSource = getTrackValue(def.zSource, anim, time, 0.0f);
+	const float lifeRate = 1.0f / lifespan;
+	const uint32_t numTiles = (uint32_t)def.rows * def.cols;
+
+	uint32_t& random = state.Random;
+	for (uint32_t k = 0; k < count; ++k)
+	{
+		//direction spread around the emitter up axis
+		const float polar = (randomFloat(random) * 2.0f - 1.0f) * verticalRange;
+		const float azimuth = (randomFloat(random) * 2.0f - 1.0f) * horizontalRange;
+		vector3df dir(sinf(polar) * cosf(azimuth), cosf(polar), sinf(polar) * sinf(azimuth));
+
+		vector3df pos;
+		if (def.emitterType == MODELPARTICLE_EMITTER_SPHERE)
+		{
+			const float radius = areaLength + (areaWidth - areaLength) * randomFloat(random);
+			pos = def.position + dir * radius;
+		}
+		else
+		{
+			pos = def.position + vector3df(
+				(randomFloat(random) * 2.0f - 1.0f) * areaLength * 0.5f,
+				0,
+				(randomFloat(random) * 2.0f - 1.0f) * areaWidth * 0.5f);
+		}
+
+		//away from a point below the emitter
+		if (zSource > 0)
+		{
+			dir = pos - (def.position - vector3df(0, zSource, 0));
+			dir.normalize();
+		}
+
+		if (bone)
+		{
+			pos = bone->multiplyPoint(pos);
+			dir = bone->multiplyVector(dir);
+		}
+
+		const float v = speed * (1.0f + (randomFloat(random) * 2.0f - 1.0f) * variation);
+		const uint32_t i = pool.NumAlive++;
+		pool.PosX[i] = pos.x; pool.PosY[i] = pos.y; pool.PosZ[i] = pos.z;
+		pool.VelX[i] = dir.x * v; pool.VelY[i] = dir.y * v; pool.VelZ[i] = dir.z * v;
+		pool.Life[i] = 0;
+		pool.LifeRate[i] = lifeRate;
+		pool.Tile[i] = numTiles > 1 ? (uint16_t)std::min((uint32_t)(randomFloat(random) * numTiles), numTiles - 1) : 0;
+	}
+}
+
+void wowM2ParticleSystem::integrate(SParticlePool& pool, float dt, float gravity, float drag)
+{
+	const float damping = std::max(0.0f, 1.0f - drag * dt);
+	const float dv = gravity * dt;
+
+#ifdef M2PARTICLES_USE_SSE
+	//the pool is padded, the last block may integrate unused slots
+	const __m128 vdt = _mm_set1_ps(dt);
+	const __m128 vdamping = _mm_set1_ps(damping);
+	const __m128 vdv = _mm_set1_ps(dv);
+	for (uint32_t i = 0; i < pool.NumAlive; i += 4)
+	{
+		const __m128 vx = _mm_mul_ps(_mm_loadu_ps(&pool.VelX[i]), vdamping);
+		const __m128 vy = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&pool.VelY[i]), vdv), vdamping);
+		const __m128 vz = _mm_mul_ps(_mm_loadu_ps(&pool.VelZ[i]), vdamping);
+		_mm_storeu_ps(&pool.VelX[i], vx);
+		_mm_storeu_ps(&pool.VelY[i], vy);
+		_mm_storeu_ps(&pool.VelZ[i], vz);
+
+		_mm_storeu_ps(&pool.PosX[i], _mm_add_ps(_mm_loadu_ps(&pool.PosX[i]), _mm_mul_ps(vx, vdt)));
+		_mm_storeu_ps(&pool.PosY[i], _mm_add_ps(_mm_loadu_ps(&pool.PosY[i]), _mm_mul_ps(vy, vdt)));
+		_mm_storeu_ps(&pool.PosZ[i], _mm_add_ps(_mm_loadu_ps(&pool.PosZ[i]), _mm_mul_ps(vz, vdt)));
+
+		_mm_storeu_ps(&pool.Life[i], _mm_add_ps(_mm_loadu_ps(&pool.Life[i]), _mm_mul_ps(_mm_loadu_ps(&pool.LifeRate[i]), vdt)));
+	}
+#else
+	for (uint32_t i = 0; i < pool.NumAlive; ++i)
+	{
+		pool.VelX[i] *= damping;
+		pool.VelY[i] = (pool.VelY[i] - dv) * damping;
+		pool.VelZ[i] *= damping;
+
+		pool.PosX[i] += pool.VelX[i] * dt;
+		pool.PosY[i] += pool.VelY[i] * dt;
+		pool.PosZ[i] += pool.VelZ[i] * dt;
+
+		pool.Life[i] += pool.LifeRate[i] * dt;
+	}
+#endif
+
+	for (uint32_t i = 0; i < pool.NumAlive;)
+	{
+		if (pool.Life[i] >= 1.0f)
+			pool.kill(i);
+		else
+			++i;
+	}
+}
+
+uint32_t wowM2ParticleSystem::fillVertices(const vector3df& right, const vector3df& up, SVertex_PCT* vertices, uint32_t maxParticles,
+	std::vector<SParticleDrawRange>& ranges) const
+{
+	ranges.clear();
+
+	uint32_t written = 0;
+	for (uint32_t e = 0; e < (uint32_t)Emitters.size(); ++e)
+	{
+		const wowM2File::SModelParticleEmitter& def = M2File->ParticleEmitters[e];
+		const SEmitterState& state = Emitters[e];
+		const SParticlePool& pool = state.Pool;
+
+		const uint32_t num = std::min(pool.NumAlive, maxParticles - written);
+		if (num == 0)
+			continue;
+
+		SParticleDrawRange range;
+		range.emitter = e;
+		range.vertexStart = written * 4;
+		range.numParticles = num;
+		ranges.push_back(range);
+
+		const float invCols = 1.0f / def.cols;
+		const float invRows = 1.0f / def.rows;
+		SVertex_PCT* v = vertices + written * 4;
+		for (uint32_t i = 0; i < num; ++i)
+		{
+			const uint32_t lut = std::min((uint32_t)(pool.Life[i] * (PARTICLE_LUT_SIZE - 1) + 0.5f), (uint32_t)PARTICLE_LUT_SIZE - 1);
+			const SColor color = state.ColorLut[lut];
+			const vector2df& size = state.SizeLut[lut];
+
+			const vector3df pos(pool.PosX[i], pool.PosY[i], pool.PosZ[i]);
+			const vector3df r = right * size.x;
+			const vector3df u = up * size.y;
+
+			const uint32_t tile = pool.Tile[i];
+			const float u0 = (tile % def.cols) * invCols;
+			const float v0 = (tile / def.cols) * invRows;
+
+			v[0].set(pos - r + u, color, vector2df(u0, v0));
+			v[1].set(pos + r + u, color, vector2df(u0 + invCols, v0));
+			v[2].set(pos - r - u, color, vector2df(u0, v0 + invRows));
+			v[3].set(pos + r - u, color, vector2df(u0 + invCols, v0 + invRows));
+			v += 4;
+		}
+
+		written += num;
+		if (written == maxParticles)
+			break;
+	}
+	return written;
+}
+
+void wowM2ParticleSystem::clear()
+{
+	for (SEmitterState& state : Emitters)
+	{
+		state.Pool.NumAlive = 0;
+		state.EmitAccumulator = 0;
+	}
+}
+
+uint32_t wowM2ParticleSystem::getNumParticles() const
+{
+	uint32_t num = 0;
+	for (const SEmitterState& state : Emitters)
+		num += state.Pool.NumAlive;
+	return num;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "S3DVertex.h"
+#include "matrix4.h"
+
+class wowM2File;
+
+#define PARTICLE_LUT_SIZE		64
+
+//particles of one emitter in structure of arrays, [0, NumAlive) are alive and dead ones are swap-removed
+//arrays are padded to a multiple of 4 for the simd loops
+struct SParticlePool
+{
+	void init(uint32_t capacity);
+	void kill(uint32_t i);
+
+	uint32_t	Capacity = 0;
+	uint32_t	NumAlive = 0;
+
+	std::vector<float>	PosX, PosY, PosZ;
+	std::vector<float>	VelX, VelY, VelZ;
+	std::vector<float>	Life;				//age / lifespan, dead at 1
+	std::vector<float>	LifeRate;			//1 / lifespan
+	std::vector<uint16_t>	Tile;			//texture cell
+};
+
+//particles of one emitter in the vertex array, 4 vertices per particle
+struct SParticleDrawRange
+{
+	uint32_t	emitter;
+	uint32_t	vertexStart;
+	uint32_t	numParticles;
+};
+
+//simulates the particle emitters of one m2 instance in model space
+class wowM2ParticleSystem
+{
+public:
+	explicit wowM2ParticleSystem(const wowM2File* m2File, uint32_t maxParticlesPerEmitter = 4096);
+
+	wowM2ParticleSystem(const wowM2ParticleSystem&) = delete;
+	wowM2ParticleSystem& operator=(const wowM2ParticleSystem&) = delete;
+
+public:
+	//emits at the bones, then integrates and removes dead particles, bones can be null for unanimated models
+	void tick(uint32_t anim, uint32_t time, uint32_t tickTime, const matrix4* bones, uint32_t numBones);
+
+	//camera facing quads, right and up are the camera axes in model space, returns the number of particles written
+	uint32_t fillVertices(const vector3df& right, const vector3df& up, SVertex_PCT* vertices, uint32_t maxParticles,
+		std::vector<SParticleDrawRange>& ranges) const;
+
+	void clear();
+
+	uint32_t getNumEmitters() const { return (uint32_t)Emitters.size(); }
+	uint32_t getNumParticles() const;
+
+	static void integrate(SParticlePool& pool, float dt, float gravity, float drag);
+
+private:
+	struct SEmitterState
+	{
+		SParticlePool	Pool;
+		float		EmitAccumulator;
+		uint32_t	Random;
+		SColor		ColorLut[PARTICLE_LUT_SIZE];
+		vector2df	SizeLut[PARTICLE_LUT_SIZE];
+	};
+
+	void emit(uint32_t index, uint32_t anim, uint32_t time, float dt, const matrix4* bone);
+
+private:
+	const wowM2File*	M2File;
+	std::vector<SEmitterState>	Emitters;
+};
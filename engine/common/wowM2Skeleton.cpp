@@ -0,0 +1,454 @@
+#include "wowM2Skeleton.h"
+
+#include "CSysThread.h"
+#include "CSysSync.h"
+#include <algorithm>
+
+#define SKELETON_BATCH_BLOCK		64
+
+//v' = (v - pivot) * S * R + pivot + t
+static inline void buildLocalMatrix(const vector3df& t, const quaternion& q, const vector3df& s, const vector3df& pivot, matrix4& local)
+{
+	local = q.toMatrix();
+	local._00 *= s.x; local._01 *= s.x; local._02 *= s.x;
+	local._10 *= s.y; local._11 *= s.y; local._12 *= s.y;
+	local._20 *= s.z; local._21 *= s.z; local._22 *= s.z;
+	local.setTranslation(pivot + t - local.multiplyVector(pivot));
+}
+
+//bone matrices are affine, the last column is not computed
+static inline void multiplyAffine(const matrix4& a, const matrix4& b, matrix4& out)
+{
+	out._00 = a._00 * b._00 + a._01 * b._10 + a._02 * b._20;
+	out._01 = a._00 * b._01 + a._01 * b._11 + a._02 * b._21;
+	out._02 = a._00 * b._02 + a._01 * b._12 + a._02 * b._22;
+	out._03 = 0;
+
+	out._10 = a._10 * b._00 + a._11 * b._10 + a._12 * b._20;
+	out._11 = a._10 * b._01 + a._11 * b._11 + a._12 * b._21;
+	out._12 = a._10 * b._02 + a._11 * b._12 + a._12 * b._22;
+	out._13 = 0;
+
+	out._20 = a._20 * b._00 + a._21 * b._10 + a._22 * b._20;
+	out._21 = a._20 * b._01 + a._21 * b._11 + a._22 * b._21;
+	out._22 = a._20 * b._02 + a._21 * b._12 + a._22 * b._22;
+	out._23 = 0;
+
+	out._30 = a._30 * b._00 + a._31 * b._10 + a._32 * b._20 + b._30;
+	out._31 = a._30 * b._01 + a._31 * b._11 + a._32 * b._21 + b._31;
+	out._32 = a._30 * b._02 + a._31 * b._12 + a._32 * b._22 + b._32;
+	out._33 = 1.0f;
+}
+
+//blocks are taken from a shared counter, the calling thread works too
+template <class F>
+static void runBlocks(uint32_t numBlocks, uint32_t numThreads, const F& func)
+{
+	if (numThreads == 0)
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+	numThreads = std::min(numThreads, numBlocks);
+
+	atomic_type<uint32_t> nextBlock(0);
+	auto worker = [&func, &nextBlock, numBlocks](void*)
+	{
+		uint32_t block;
+		while ((block = nextBlock++) < numBlocks)
+			func(block);
+		return 0;
+	};
+
+	if (numThreads <= 1)
+	{
+		worker(nullptr);
+		return;
+	}
+
+	std::vector<thread_type> threads(numThreads - 1);
+	for (uint32_t t = 0; t < numThreads - 1; ++t)
+		INIT_THREAD(&threads[t], worker, nullptr);
+
+	worker(nullptr);
+
+	for (uint32_t t = 0; t < numThreads - 1; ++t)
+	{
+		WAIT_THREAD(&threads[t]);
+		DESTROY_THREAD(&threads[t]);
+	}
+}
+
+void wowM2Skeleton::init(const uint8_t* fileStart, const M2::bone* bones, uint32_t numBones, SAnimFile* animFiles, int32_t* globalSeq, uint32_t numGlobalSeq,
+	const SSkeletonCompression* compression)
+{
+	clear();
+
+	if (numBones == 0)
+		return;
+
+	ParentIndices.resize(numBones);
+	Flags.resize(numBones);
+	Pivots.resize(numBones);
+	Translations.resize(numBones);
+	Rotations.resize(numBones);
+	Scalings.resize(numBones);
+
+	for (uint32_t i = 0; i < numBones; ++i)
+	{
+		const M2::bone& b = bones[i];
+
+		int16_t parent = b._ParentBone;
+		if (parent < 0 || parent >= (int32_t)numBones || parent == (int32_t)i)
+			parent = -1;
+
+		ParentIndices[i] = parent;
+		Flags[i] = b._Flags;
+		Pivots[i] = M2::fixCoordinate(b._PivotPoint);
+
+		if (compression)
+		{
+			Translations[i].setCompression(compression->translationTolerance);
+			Rotations[i].setCompression(compression->rotationTolerance);
+			Scalings[i].setCompression(compression->scaleTolerance);
+		}
+
+		Translations[i].init(&b._Translation, fileStart, animFiles, globalSeq, numGlobalSeq);
+		Rotations[i].init(&b._Rotation, fileStart, animFiles, globalSeq, numGlobalSeq);
+		Scalings[i].init(&b._Scaling, fileStart, animFiles, globalSeq, numGlobalSeq);
+	}
+
+	//sort by depth, bones in a loop are treated as roots
+	std::vector<uint32_t> depths(numBones, 0);
+	for (uint32_t i = 0; i < numBones; ++i)
+	{
+		uint32_t depth = 0;
+		int16_t p = ParentIndices[i];
+		while (p >= 0 && depth <= numBones)
+		{
+			++depth;
+			p = ParentIndices[p];
+		}
+
+		if (depth > numBones)
+		{
+			ParentIndices[i] = -1;
+			depth = 0;
+		}
+		depths[i] = depth;
+	}
+
+	Order.resize(numBones);
+	for (uint32_t i = 0; i < numBones; ++i)
+		Order[i] = (uint16_t)i;
+	std::stable_sort(Order.begin(), Order.end(), [&depths](uint16_t a, uint16_t b) { return depths[a] < depths[b]; });
+}
+
+void wowM2Skeleton::clear()
+{
+	ParentIndices.clear();
+	Order.clear();
+	Flags.clear();
+	Pivots.clear();
+	Translations.clear();
+	Rotations.clear();
+	Scalings.clear();
+}
+
+void wowM2Skeleton::cook(std::vector<uint8_t>& data) const
+{
+	const uint32_t numBones = getNumBones();
+	appendCookedData(data, &numBones, sizeof(uint32_t));
+	appendCookedData(data, ParentIndices.data(), sizeof(int16_t) * numBones);
+	appendCookedData(data, Order.data(), sizeof(uint16_t) * numBones);
+	appendCookedData(data, Flags.data(), sizeof(uint32_t) * numBones);
+	appendCookedData(data, Pivots.data(), sizeof(vector3df) * numBones);
+
+	for (uint32_t i = 0; i < numBones; ++i)
+	{
+		Translations[i].cook(data);
+		Rotations[i].cook(data);
+		Scalings[i].cook(data);
+	}
+}
+
+bool wowM2Skeleton::loadCooked(const uint8_t* data, uint32_t size, int32_t* globalSeq, uint32_t numGlobalSeq, const SSkeletonCompression* compression)
+{
+	clear();
+
+	const uint8_t* end = data + size;
+	uint32_t numBones;
+	if (size < sizeof(uint32_t))
+		return false;
+	memcpy(&numBones, data, sizeof(uint32_t));
+	data += sizeof(uint32_t);
+
+	const uint32_t boneSize = sizeof(int16_t) + sizeof(uint16_t) + sizeof(uint32_t) + sizeof(vector3df);
+	if (numBones == 0 || numBones > 0xffff || (uint32_t)(end - data) / boneSize < numBones)
+		return false;
+
+	ParentIndices.resize(numBones);
+	Order.resize(numBones);
+	Flags.resize(numBones);
+	Pivots.resize(numBones);
+	memcpy(ParentIndices.data(), data, sizeof(int16_t) * numBones);
+	data += sizeof(int16_t) * numBones;
+	memcpy(Order.data(), data, sizeof(uint16_t) * numBones);
+	data += sizeof(uint16_t) * numBones;
+	memcpy(Flags.data(), data, sizeof(uint32_t) * numBones);
+	data += sizeof(uint32_t) * numBones;
+	memcpy(Pivots.data(), data, sizeof(vector3df) * numBones);
+	data += sizeof(vector3df) * numBones;
+
+	for (uint32_t i = 0; i < numBones; ++i)
+	{
+		if (ParentIndices[i] >= (int32_t)numBones || Order[i] >= numBones)
+		{
+			clear();
+			return false;
+		}
+	}
+
+	Translations.resize(numBones);
+	Rotations.resize(numBones);
+	Scalings.resize(numBones);
+	for (uint32_t i = 0; i < numBones && data; ++i)
+	{
+		if (compression)
+		{
+			Translations[i].setCompression(compression->translationTolerance);
+			Rotations[i].setCompression(compression->rotationTolerance);
+			Scalings[i].setCompression(compression->scaleTolerance);
+		}
+
+		data = Translations[i].loadCooked(data, end, globalSeq, numGlobalSeq);
+		if (data)
+			data = Rotations[i].loadCooked(data, end, globalSeq, numGlobalSeq);
+		if (data)
+			data = Scalings[i].loadCooked(data, end, globalSeq, numGlobalSeq);
+	}
+
+	if (data != end)
+	{
+		clear();
+		return false;
+	}
+	return true;
+}
+
+uint32_t wowM2Skeleton::getMemorySize() const
+{
+	uint32_t size = sizeof(*this);
+	size += (uint32_t)(ParentIndices.capacity() * sizeof(int16_t) + Order.capacity() * sizeof(uint16_t));
+	size += (uint32_t)(Flags.capacity() * sizeof(uint32_t) + Pivots.capacity() * sizeof(vector3df));
+
+	const uint32_t numBones = getNumBones();
+	for (uint32_t i = 0; i < numBones; ++i)
+		size += Translations[i].getMemorySize() + Rotations[i].getMemorySize() + Scalings[i].getMemorySize();
+	return size;
+}
+
+uint32_t wowM2Skeleton::getAnimMemorySize(uint32_t anim) const
+{
+	uint32_t size = 0;
+	const uint32_t numBones = getNumBones();
+	for (uint32_t i = 0; i < numBones; ++i)
+		size += Translations[i].getAnimMemorySize(anim) + Rotations[i].getAnimMemorySize(anim) + Scalings[i].getAnimMemorySize(anim);
+	return size;
+}
+
+bool wowM2Skeleton::isAnimated() const
+{
+	const uint32_t numBones = getNumBones();
+	for (uint32_t i = 0; i < numBones; ++i)
+	{
+		if (Translations[i].hasKeys() || Rotations[i].hasKeys() || Scalings[i].hasKeys())
+			return true;
+	}
+	return false;
+}
+
+bool wowM2Skeleton::loadAnimFile(uint32_t anim, const uint8_t* data, uint32_t size)
+{
+	const uint32_t numBones = getNumBones();
+	for (uint32_t i = 0; i < numBones; ++i)
+	{
+		if (!Translations[i].loadAnimFile(anim, data, size) ||
+			!Rotations[i].loadAnimFile(anim, data, size) ||
+			!Scalings[i].loadAnimFile(anim, data, size))
+		{
+			unloadAnimFile(anim);
+			return false;
+		}
+	}
+	return true;
+}
+
+void wowM2Skeleton::unloadAnimFile(uint32_t anim)
+{
+	const uint32_t numBones = getNumBones();
+	for (uint32_t i = 0; i < numBones; ++i)
+	{
+		Translations[i].unloadAnimFile(anim);
+		Rotations[i].unloadAnimFile(anim);
+		Scalings[i].unloadAnimFile(anim);
+	}
+}
+
+void wowM2Skeleton::evaluate(uint32_t anim, uint32_t time, matrix4* matrices, int32_t* cursors) const
+{
+	int32_t dummy[3] = { 0, 0, 0 };
+
+	const uint32_t numBones = (uint32_t)Order.size();
+	const uint16_t* order = Order.data();
+	const int16_t* parents = ParentIndices.data();
+	const vector3df* pivots = Pivots.data();
+
+	for (uint32_t k = 0; k < numBones; ++k)
+	{
+		const uint16_t b = order[k];
+
+		vector3df t(0, 0, 0);
+		quaternion q(0, 0, 0, 1.0f);
+		vector3df s(1.0f, 1.0f, 1.0f);
+		int32_t* c = cursors ? cursors + b * 3 : dummy;
+		c[0] = Translations[b].getValue(anim, time, t, c[0]);
+		c[1] = Rotations[b].getValue(anim, time, q, c[1]);
+		c[2] = Scalings[b].getValue(anim, time, s, c[2]);
+
+		matrix4 local;
+		buildLocalMatrix(t, q, s, pivots[b], local);
+
+		const int16_t parent = parents[b];
+		if (parent >= 0)
+			multiplyAffine(local, matrices[parent], matrices[b]);
+		else
+			matrices[b] = local;
+	}
+}
+
+void wowM2Skeleton::sampleBatch(const SAnimationInstance* instances, uint32_t numInstances, SSkeletonBatchSamples& samples, uint32_t timeGrid, uint32_t numThreads) const
+{
+	const uint32_t numBones = getNumBones();
+	samples.NumInstances = numInstances;
+	samples.Translations.resize(numBones * numInstances);
+	samples.Rotations.resize(numBones * numInstances);
+	samples.Scalings.resize(numBones * numInstances);
+	samples.Sources.resize(numInstances);
+
+	if (numInstances == 0 || numBones == 0)
+		return;
+
+	std::vector<SAnimationInstance> snapped(instances, instances + numInstances);
+	if (timeGrid > 1)
+	{
+		for (auto& inst : snapped)
+			inst.time -= inst.time % timeGrid;
+	}
+
+	std::vector<uint32_t> sorted(numInstances);
+	for (uint32_t i = 0; i < numInstances; ++i)
+		sorted[i] = i;
+	std::sort(sorted.begin(), sorted.end(), [&snapped](uint32_t a, uint32_t b)
+	{
+		if (snapped[a].anim != snapped[b].anim)
+			return snapped[a].anim < snapped[b].anim;
+		return snapped[a].time < snapped[b].time;
+	});
+
+	//equal (anim, time) are sampled once
+	samples.Sources[sorted[0]] = sorted[0];
+	for (uint32_t k = 1; k < numInstances; ++k)
+	{
+		const SAnimationInstance& prev = snapped[sorted[k - 1]];
+		const SAnimationInstance& inst = snapped[sorted[k]];
+		if (prev.anim == inst.anim && prev.time == inst.time)
+			samples.Sources[sorted[k]] = samples.Sources[sorted[k - 1]];
+		else
+			samples.Sources[sorted[k]] = sorted[k];
+	}
+
+	const uint32_t numBlocks = (numInstances + SKELETON_BATCH_BLOCK - 1) / SKELETON_BATCH_BLOCK;
+	runBlocks(numBlocks, numThreads, [&](uint32_t block)
+	{
+		const uint32_t first = block * SKELETON_BATCH_BLOCK;
+		const uint32_t last = std::min(first + SKELETON_BATCH_BLOCK, numInstances);
+
+		for (uint32_t b = 0; b < numBones; ++b)
+		{
+			const SWowAnimationVec3& transAnim = Translations[b];
+			const SWowAnimationQuat& rotAnim = Rotations[b];
+			const SWowAnimationVec3& scaleAnim = Scalings[b];
+			vector3df* trans = &samples.Translations[b * numInstances];
+			quaternion* rot = &samples.Rotations[b * numInstances];
+			vector3df* scale = &samples.Scalings[b * numInstances];
+
+			//sorted times only move forward inside an anim, the previous key is the cursor
+			int32_t cursors[3] = { 0, 0, 0 };
+			for (uint32_t k = first; k < last; ++k)
+			{
+				const uint32_t i = sorted[k];
+				if (samples.Sources[i] != i)
+					continue;
+
+				const SAnimationInstance& inst = snapped[i];
+
+				trans[i].set(0, 0, 0);
+				rot[i] = quaternion(0, 0, 0, 1.0f);
+				scale[i].set(1.0f, 1.0f, 1.0f);
+				cursors[0] = transAnim.getValue(inst.anim, inst.time, trans[i], cursors[0]);
+				cursors[1] = rotAnim.getValue(inst.anim, inst.time, rot[i], cursors[1]);
+				cursors[2] = scaleAnim.getValue(inst.anim, inst.time, scale[i], cursors[2]);
+			}
+		}
+	});
+}
+
+void wowM2Skeleton::evaluateBatch(const SSkeletonBatchSamples& samples, matrix4* matrices, uint32_t numThreads) const
+{
+	const uint32_t numBones = getNumBones();
+	const uint32_t numInstances = samples.NumInstances;
+	if (numInstances == 0 || numBones == 0)
+		return;
+
+	const uint32_t numBlocks = (numInstances + SKELETON_BATCH_BLOCK - 1) / SKELETON_BATCH_BLOCK;
+	runBlocks(numBlocks, numThreads, [&](uint32_t block)
+	{
+		const uint32_t first = block * SKELETON_BATCH_BLOCK;
+		const uint32_t last = std::min(first + SKELETON_BATCH_BLOCK, numInstances);
+
+		for (uint32_t k = 0; k < numBones; ++k)
+		{
+			const uint16_t b = Order[k];
+			const int16_t parent = ParentIndices[b];
+			const uint32_t row = b * numInstances;
+
+			for (uint32_t i = first; i < last; ++i)
+			{
+				if (samples.Sources[i] != i)
+					continue;
+
+				matrix4* m = matrices + i * numBones;
+
+				matrix4 local;
+				buildLocalMatrix(samples.Translations[row + i], samples.Rotations[row + i], samples.Scalings[row + i], Pivots[b], local);
+
+				if (parent >= 0)
+					multiplyAffine(local, m[parent], m[b]);
+				else
+					m[b] = local;
+			}
+		}
+	});
+
+	//instances sharing samples copy the matrices
+	runBlocks(numBlocks, numThreads, [&](uint32_t block)
+	{
+		const uint32_t first = block * SKELETON_BATCH_BLOCK;
+		const uint32_t last = std::min(first + SKELETON_BATCH_BLOCK, numInstances);
+
+		for (uint32_t i = first; i < last; ++i)
+		{
+			const uint32_t source = samples.Sources[i];
+			if (source != i)
+				memcpy(matrices + i * numBones, matrices + source * numBones, sizeof(matrix4) * numBones);
+		}
+	});
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vector>
+#include "S3DVertex.h"
+#include "matrix4.h"
+#include "wowAnimation.h"
+
+#define	BONE_BILLBOARD		8
+#define	BONE_TRANSFORMED	512
+
+struct SAnimationInstance
+{
+	uint32_t	anim;
+	uint32_t	time;
+};
+
+//max error of the compressed bone tracks at the original keys
+struct SSkeletonCompression
+{
+	float	translationTolerance;
+	float	rotationTolerance;			//radians
+	float	scaleTolerance;
+};
+
+//track samples of many instances, indexed by [bone * NumInstances + instance]
+struct SSkeletonBatchSamples
+{
+	uint32_t	NumInstances = 0;
+	std::vector<uint32_t>	Sources;			//instance with the same samples, itself if unique
+	std::vector<vector3df>	Translations;
+	std::vector<quaternion>	Rotations;
+	std::vector<vector3df>	Scalings;
+};
+
+//bones in structure of arrays, Order lists parents before their children
+class wowM2Skeleton
+{
+public:
+	wowM2Skeleton() = default;
+	wowM2Skeleton(const wowM2Skeleton&) = delete;
+	wowM2Skeleton& operator=(const wowM2Skeleton&) = delete;
+
+	//tracks are compressed if compression is set, also the ones loaded later from .anim files
+	void init(const uint8_t* fileStart, const M2::bone* bones, uint32_t numBones, SAnimFile* animFiles, int32_t* globalSeq, uint32_t numGlobalSeq,
+		const SSkeletonCompression* compression = nullptr);
+	void clear();
+
+	//bone tables and tracks as built by init, loadCooked restores them without reading the bones or compressing again
+	//compression must be the one of the cooked skeleton, it is kept for the .anim files
+	void cook(std::vector<uint8_t>& data) const;
+	bool loadCooked(const uint8_t* data, uint32_t size, int32_t* globalSeq, uint32_t numGlobalSeq, const SSkeletonCompression* compression = nullptr);
+
+	//keys of an external sequence, from its .anim file (the AFM2 chunk data if chunked)
+	bool loadAnimFile(uint32_t anim, const uint8_t* data, uint32_t size);
+	void unloadAnimFile(uint32_t anim);
+
+	//matrices are written in bone index order, the array must hold getNumBones() matrices
+	//cursors keep the last key of each track per instance (getNumCursors(), zero initialized), can be null
+	void evaluate(uint32_t anim, uint32_t time, matrix4* matrices, int32_t* cursors = nullptr) const;
+
+	//samples every track for all instances in one pass over the key data, instances are sorted by (anim, time)
+	//so the same keys are reused, times are snapped to timeGrid (ms, 0 for exact) and equal ones are sampled once
+	void sampleBatch(const SAnimationInstance* instances, uint32_t numInstances, SSkeletonBatchSamples& samples, uint32_t timeGrid = 0, uint32_t numThreads = 0) const;
+
+	//matrices of instance i start at matrices[i * getNumBones()]
+	void evaluateBatch(const SSkeletonBatchSamples& samples, matrix4* matrices, uint32_t numThreads = 0) const;
+
+	//false if no bone track has keys, every pose is the bind pose
+	bool isAnimated() const;
+
+	uint32_t getNumBones() const { return (uint32_t)ParentIndices.size(); }
+	uint32_t getNumCursors() const { return getNumBones() * 3; }
+	uint32_t getMemorySize() const;
+	uint32_t getAnimMemorySize(uint32_t anim) const;
+
+public:
+	std::vector<int16_t>	ParentIndices;			//-1 for root
+	std::vector<uint16_t>	Order;
+	std::vector<uint32_t>	Flags;
+	std::vector<vector3df>	Pivots;
+
+	std::vector<SWowAnimationVec3>	Translations;
+	std::vector<SWowAnimationQuat>	Rotations;
+	std::vector<SWowAnimationVec3>	Scalings;
+};
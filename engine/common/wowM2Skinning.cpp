@@ -0,0 +1,343 @@
+#include "wowM2Skinning.h"
+
+#include "CSysThread.h"
+#include "CSysSync.h"
+#include <algorithm>
+#include <vector>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define M2SKINNING_USE_SSE
+#include <emmintrin.h>
+#endif
+
+#define SKINNING_BLOCK_VERTICES		2048
+
+void wowM2Skinning::skinScalar(const SVertex_PNT2WA* src, SVertex_PNT2WA* dst, uint32_t numVertices, const matrix4* bones, uint32_t numBones)
+{
+	for (uint32_t i = 0; i < numVertices; ++i)
+	{
+		const SVertex_PNT2WA& v = src[i];
+
+		vector3df pos(0, 0, 0);
+		vector3df normal(0, 0, 0);
+		bool skinned = false;
+		for (uint32_t k = 0; k < 4; ++k)
+		{
+			if (v.Weights[k] == 0 || v.BoneIndices[k] >= numBones)
+				continue;
+
+			const float w = v.Weights[k] * (1.0f / 255.0f);
+			const matrix4& m = bones[v.BoneIndices[k]];
+			pos += m.multiplyPoint(v.Pos) * w;
+			normal += m.multiplyVector(v.Normal) * w;
+			skinned = true;
+		}
+
+		if (skinned)
+		{
+			dst[i].Pos = pos;
+			dst[i].Normal = normal;
+		}
+		else
+		{
+			dst[i].Pos = v.Pos;
+			dst[i].Normal = v.Normal;
+		}
+	}
+}
+
+#ifdef M2SKINNING_USE_SSE
+
+static inline void addBoneSSE(__m128& r0, __m128& r1, __m128& r2, __m128& r3, __m128 w, const float* m)
+{
+	r0 = _mm_add_ps(r0, _mm_mul_ps(w, _mm_loadu_ps(m)));
+	r1 = _mm_add_ps(r1, _mm_mul_ps(w, _mm_loadu_ps(m + 4)));
+	r2 = _mm_add_ps(r2, _mm_mul_ps(w, _mm_loadu_ps(m + 8)));
+	r3 = _mm_add_ps(r3, _mm_mul_ps(w, _mm_loadu_ps(m + 12)));
+}
+
+//blend the bone matrices first, then transform once
+//weights has the 4 influences in its lanes, bit k of unused is set if influence k is skipped
+static inline void skinVertexSSE(const SVertex_PNT2WA& v, SVertex_PNT2WA& o, __m128 weights, const uint8_t* boneIndices, uint32_t unused, const matrix4* bones)
+{
+	if (unused == 0xf)
+	{
+		o.Pos = v.Pos;
+		o.Normal = v.Normal;
+		return;
+	}
+
+	__m128 r0 = _mm_setzero_ps();
+	__m128 r1 = _mm_setzero_ps();
+	__m128 r2 = _mm_setzero_ps();
+	__m128 r3 = _mm_setzero_ps();
+	if (!(unused & 1))
+		addBoneSSE(r0, r1, r2, r3, _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(0, 0, 0, 0)), bones[boneIndices[0]].M);
+	if (!(unused & 2))
+		addBoneSSE(r0, r1, r2, r3, _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(1, 1, 1, 1)), bones[boneIndices[1]].M);
+	if (!(unused & 4))
+		addBoneSSE(r0, r1, r2, r3, _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(2, 2, 2, 2)), bones[boneIndices[2]].M);
+	if (!(unused & 8))
+		addBoneSSE(r0, r1, r2, r3, _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(3, 3, 3, 3)), bones[boneIndices[3]].M);
+
+	__m128 p = _mm_add_ps(
+		_mm_add_ps(_mm_mul_ps(_mm_set1_ps(v.Pos.x), r0), _mm_mul_ps(_mm_set1_ps(v.Pos.y), r1)),
+		_mm_add_ps(_mm_mul_ps(_mm_set1_ps(v.Pos.z), r2), r3));
+	__m128 n = _mm_add_ps(
+		_mm_add_ps(_mm_mul_ps(_mm_set1_ps(v.Normal.x), r0), _mm_mul_ps(_mm_set1_ps(v.Normal.y), r1)),
+		_mm_mul_ps(_mm_set1_ps(v.Normal.z), r2));
+
+	//Pos is followed by Normal, the 4th lane of p is overwritten by the normal
+	_mm_storeu_ps(&o.Pos.x, p);
+	_mm_storel_pi((__m64*)&o.Normal.x, n);
+	_mm_store_ss(&o.Normal.z, _mm_shuffle_ps(n, n, _MM_SHUFFLE(2, 2, 2, 2)));
+}
+
+void wowM2Skinning::skinSSE(const SVertex_PNT2WA* src, SVertex_PNT2WA* dst, uint32_t numVertices, const matrix4* bones, uint32_t numBones)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i maxIndex = _mm_set1_epi8((char)(numBones > 0 ? std::min(numBones - 1, 255u) : 0));
+	const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+
+	//4 vertices at a time, a byte lane per influence for the weights and bone indices
+	uint32_t i = 0;
+	for (; i + 4 <= numVertices; i += 4)
+	{
+		_mm_prefetch((const char*)(src + i + 8), _MM_HINT_T0);
+		_mm_prefetch((const char*)(src + i + 10), _MM_HINT_T0);
+
+		const SVertex_PNT2WA* v = src + i;
+
+		//Weights is followed by BoneIndices, 8 bytes per vertex
+		const __m128i lo = _mm_unpacklo_epi32(_mm_loadl_epi64((const __m128i*)v[0].Weights), _mm_loadl_epi64((const __m128i*)v[1].Weights));
+		const __m128i hi = _mm_unpacklo_epi32(_mm_loadl_epi64((const __m128i*)v[2].Weights), _mm_loadl_epi64((const __m128i*)v[3].Weights));
+		__m128i weights = _mm_unpacklo_epi64(lo, hi);
+		__m128i indices = _mm_unpackhi_epi64(lo, hi);
+
+		//influences of invalid bones get no weight
+		if (numBones == 0)
+		{
+			weights = zero;
+		}
+		else if (numBones < 256)
+		{
+			const __m128i valid = _mm_cmpeq_epi8(_mm_min_epu8(indices, maxIndex), indices);
+			weights = _mm_and_si128(weights, valid);
+			indices = _mm_and_si128(indices, valid);
+		}
+
+		const uint32_t unused = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(weights, zero));
+		if (unused == 0xffff)
+		{
+			for (uint32_t k = 0; k < 4; ++k)
+			{
+				dst[i + k].Pos = v[k].Pos;
+				dst[i + k].Normal = v[k].Normal;
+			}
+			continue;
+		}
+
+		const __m128i weightsLo = _mm_unpacklo_epi8(weights, zero);
+		const __m128i weightsHi = _mm_unpackhi_epi8(weights, zero);
+		const __m128 w0 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(weightsLo, zero)), scale);
+		const __m128 w1 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(weightsLo, zero)), scale);
+		const __m128 w2 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(weightsHi, zero)), scale);
+		const __m128 w3 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(weightsHi, zero)), scale);
+
+		uint8_t boneIndices[16];
+		_mm_storeu_si128((__m128i*)boneIndices, indices);
+
+		//no gather in SSE2, the matrices are blended per vertex
+		skinVertexSSE(v[0], dst[i], w0, boneIndices, unused & 0xf, bones);
+		skinVertexSSE(v[1], dst[i + 1], w1, boneIndices + 4, (unused >> 4) & 0xf, bones);
+		skinVertexSSE(v[2], dst[i + 2], w2, boneIndices + 8, (unused >> 8) & 0xf, bones);
+		skinVertexSSE(v[3], dst[i + 3], w3, boneIndices + 12, (unused >> 12) & 0xf, bones);
+	}
+
+	for (; i < numVertices; ++i)
+	{
+		const SVertex_PNT2WA& v = src[i];
+		uint32_t unused = 0;
+		for (uint32_t k = 0; k < 4; ++k)
+		{
+			if (v.Weights[k] == 0 || v.BoneIndices[k] >= numBones)
+				unused |= 1 << k;
+		}
+		const __m128 w = _mm_mul_ps(_mm_setr_ps(v.Weights[0], v.Weights[1], v.Weights[2], v.Weights[3]), scale);
+		skinVertexSSE(v, dst[i], w, v.BoneIndices, unused, bones);
+	}
+}
+
+#else
+
+void wowM2Skinning::skinSSE(const SVertex_PNT2WA* src, SVertex_PNT2WA* dst, uint32_t numVertices, const matrix4* bones, uint32_t numBones)
+{
+	skinScalar(src, dst, numVertices, bones, numBones);
+}
+
+#endif
+
+void wowM2Skinning::skin(const SVertex_PNT2WA* src, SVertex_PNT2WA* dst, uint32_t numVertices, const matrix4* bones, uint32_t numBones)
+{
+#ifdef M2SKINNING_USE_SSE
+	skinSSE(src, dst, numVertices, bones, numBones);
+#else
+	skinScalar(src, dst, numVertices, bones, numBones);
+#endif
+}
+
+void wowM2Skinning::packPositionNormal(const SVertex_PNT2WA* src, SVertex_PNT2WA_Packed* dst, uint32_t numVertices)
+{
+	for (uint32_t i = 0; i < numVertices; ++i)
+	{
+		dst[i].Pos = src[i].Pos;
+		encodeOctahedralNormal(src[i].Normal, dst[i].Normal);
+	}
+}
+
+uint32_t wowM2Skinning::buildBlocks(const SSkinningJob* jobs, uint32_t numJobs, uint32_t numThreads, std::vector<SBlock>& blocks)
+{
+	blocks.clear();
+	uint32_t totalVertices = 0;
+	for (uint32_t j = 0; j < numJobs; ++j)
+	{
+		for (uint32_t start = 0; start < jobs[j].numVertices; start += SKINNING_BLOCK_VERTICES)
+		{
+			SBlock block;
+			block.job = &jobs[j];
+			block.start = start;
+			block.count = std::min((uint32_t)SKINNING_BLOCK_VERTICES, jobs[j].numVertices - start);
+			blocks.push_back(block);
+		}
+		totalVertices += jobs[j].numVertices;
+	}
+
+	if (numThreads == 0)
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+	numThreads = std::min(numThreads, std::max(1u, totalVertices / (SKINNING_BLOCK_VERTICES * 2)));
+	return std::min(numThreads, std::max(1u, (uint32_t)blocks.size()));
+}
+
+void wowM2Skinning::skinBlock(const SBlock& block)
+{
+	const SSkinningJob* job = block.job;
+	skin(job->src + block.start, job->dst + block.start, block.count, job->bones, job->numBones);
+	if (job->packedDst)
+		packPositionNormal(job->dst + block.start, job->packedDst + block.start, block.count);
+}
+
+void wowM2Skinning::skinJobs(const SSkinningJob* jobs, uint32_t numJobs, uint32_t numThreads)
+{
+	std::vector<SBlock> blocks;
+	numThreads = buildBlocks(jobs, numJobs, numThreads, blocks);
+
+	atomic_type<uint32_t> nextBlock(0);
+	auto worker = [&blocks, &nextBlock](void*)
+	{
+		while (true)
+		{
+			uint32_t index = nextBlock++;
+			if (index >= (uint32_t)blocks.size())
+				break;
+
+			skinBlock(blocks[index]);
+		}
+		return 0;
+	};
+
+	if (numThreads <= 1)
+	{
+		worker(nullptr);
+		return;
+	}
+
+	//the calling thread takes blocks too
+	std::vector<thread_type> threads(numThreads - 1);
+	for (uint32_t t = 0; t < numThreads - 1; ++t)
+		INIT_THREAD(&threads[t], worker, nullptr);
+
+	worker(nullptr);
+
+	for (uint32_t t = 0; t < numThreads - 1; ++t)
+	{
+		WAIT_THREAD(&threads[t]);
+		DESTROY_THREAD(&threads[t]);
+	}
+}
+
+wowSkinningPool::wowSkinningPool(uint32_t numThreads)
+	: NumRunning(0), NextBlock(0), Quit(false)
+{
+	if (numThreads == 0)
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	INIT_EVENT(&DoneEvent);
+	for (uint32_t t = 0; t + 1 < numThreads; ++t)
+	{
+		SWorker* worker = new SWorker;
+		INIT_EVENT(&worker->startEvent);
+		INIT_THREAD(&worker->thread, [this, worker](void*) { return workerThread(worker); }, nullptr);
+		Workers.push_back(worker);
+	}
+}
+
+wowSkinningPool::~wowSkinningPool()
+{
+	Quit = true;
+	for (SWorker* worker : Workers)
+		SET_EVENT(&worker->startEvent);
+
+	for (SWorker* worker : Workers)
+	{
+		WAIT_THREAD(&worker->thread);
+		DESTROY_THREAD(&worker->thread);
+		DESTROY_EVENT(&worker->startEvent);
+		delete worker;
+	}
+	Workers.clear();
+	DESTROY_EVENT(&DoneEvent);
+}
+
+void wowSkinningPool::run(const SSkinningJob* jobs, uint32_t numJobs)
+{
+	const uint32_t numThreads = wowM2Skinning::buildBlocks(jobs, numJobs, getNumThreads(), Blocks);
+	NextBlock = 0;
+
+	//small batches wake fewer workers, the events publish Blocks to them
+	const uint32_t numWorkers = numThreads - 1;
+	NumRunning = numWorkers;
+	for (uint32_t t = 0; t < numWorkers; ++t)
+		SET_EVENT(&Workers[t]->startEvent);
+
+	runBlocks();
+
+	if (numWorkers > 0)
+		WAIT_EVENT(&DoneEvent);
+}
+
+void wowSkinningPool::runBlocks()
+{
+	while (true)
+	{
+		uint32_t index = NextBlock++;
+		if (index >= (uint32_t)Blocks.size())
+			break;
+
+		wowM2Skinning::skinBlock(Blocks[index]);
+	}
+}
+
+int wowSkinningPool::workerThread(SWorker* worker)
+{
+	while (true)
+	{
+		WAIT_EVENT(&worker->startEvent);
+		if (Quit)
+			return 0;
+
+		runBlocks();
+
+		if (--NumRunning == 0)
+			SET_EVENT(&DoneEvent);
+	}
+}
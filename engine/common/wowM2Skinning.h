@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "S3DVertex.h"
+#include "matrix4.h"
+#include "CSysThread.h"
+#include "CSysSync.h"
+
+//one geoset of one instance, vertices are read from src and Pos, Normal are written to dst
+//and also to packedDst if set
+struct SSkinningJob
+{
+	const SVertex_PNT2WA*	src;
+	SVertex_PNT2WA*		dst;
+	SVertex_PNT2WA_Packed*	packedDst = nullptr;
+	uint32_t	numVertices;
+	const matrix4*	bones;
+	uint32_t	numBones;
+};
+
+//cpu skinning for SVertex_PNT2WA, 4 weighted bones per vertex
+//influences with zero weight or an invalid bone index are ignored
+class wowM2Skinning
+{
+public:
+	static void skinScalar(const SVertex_PNT2WA* src, SVertex_PNT2WA* dst, uint32_t numVertices, const matrix4* bones, uint32_t numBones);
+	static void skinSSE(const SVertex_PNT2WA* src, SVertex_PNT2WA* dst, uint32_t numVertices, const matrix4* bones, uint32_t numBones);
+
+	//SSE if available
+	static void skin(const SVertex_PNT2WA* src, SVertex_PNT2WA* dst, uint32_t numVertices, const matrix4* bones, uint32_t numBones);
+
+	//copies Pos and encodes Normal, the other attributes of dst don't change when skinning
+	static void packPositionNormal(const SVertex_PNT2WA* src, SVertex_PNT2WA_Packed* dst, uint32_t numVertices);
+
+	//jobs are split into blocks and run on numThreads threads, 0 for hardware concurrency
+	//the threads are created for the call, batches run every frame go to a wowSkinningPool
+	static void skinJobs(const SSkinningJob* jobs, uint32_t numJobs, uint32_t numThreads = 0);
+
+	struct SBlock
+	{
+		const SSkinningJob* job;
+		uint32_t start;
+		uint32_t count;
+	};
+
+	//large geosets are split so that threads get even work, returns the number of threads worth using
+	static uint32_t buildBlocks(const SSkinningJob* jobs, uint32_t numJobs, uint32_t numThreads, std::vector<SBlock>& blocks);
+	static void skinBlock(const SBlock& block);
+};
+
+//skinJobs on worker threads that are created once and wait for the next batch
+class wowSkinningPool
+{
+public:
+	//0 for hardware concurrency, the thread calling run works too
+	explicit wowSkinningPool(uint32_t numThreads = 0);
+	~wowSkinningPool();
+
+	wowSkinningPool(const wowSkinningPool&) = delete;
+	wowSkinningPool& operator=(const wowSkinningPool&) = delete;
+
+public:
+	//returns when all jobs are done
+	void run(const SSkinningJob* jobs, uint32_t numJobs);
+
+	uint32_t getNumThreads() const { return (uint32_t)Workers.size() + 1; }
+
+private:
+	struct SWorker
+	{
+		thread_type		thread;
+		event_type		startEvent;
+	};
+
+	void runBlocks();
+	int workerThread(SWorker* worker);
+
+private:
+	std::vector<SWorker*>	Workers;
+	event_type		DoneEvent;
+	atomic_type<uint32_t>	NumRunning;
+
+	std::vector<wowM2Skinning::SBlock>	Blocks;
+	atomic_type<uint32_t>	NextBlock;
+	bool	Quit;
+};
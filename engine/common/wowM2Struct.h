@@ -154,6 +154,13 @@ namespace M2
 		/*0x04*/    uint32_t  _SequencesOfs;
 	};
 
+	//------------------------------------------------------------------------------
+	struct animFileID {					// AFID chunk entry
+		/*0x00*/    uint16_t  _AnimationID;
+		/*0x02*/    uint16_t  _SubAnimationID;
+		/*0x04*/    uint32_t  _FileID;
+	};
+
 	//------------------------------------------------------------------------------
 	struct animblock {
 		/*0x00*/    int16_t   _Interpolation;         	     // interpolation type
@@ -0,0 +1,241 @@
+#include "wowMeshOptimizer.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#define VERTEXCACHE_MAX_SIZE		64
+#define VERTEXCACHE_MAX_VALENCE		32
+
+bool wowMeshOptimizer::Enabled = false;
+
+struct SCacheScoreTable
+{
+	float	position[VERTEXCACHE_MAX_SIZE];
+	float	valence[VERTEXCACHE_MAX_VALENCE];
+
+	explicit SCacheScoreTable(uint32_t cacheSize)
+	{
+		//the last triangle's vertices get a fixed score so that strips are not favoured over fans
+		for (uint32_t i = 0; i < VERTEXCACHE_MAX_SIZE; ++i)
+		{
+			if (i >= cacheSize)
+				position[i] = 0;
+			else if (i < 3)
+				position[i] = 0.75f;
+			else
+				position[i] = powf(1.0f - (i - 3) / (float)(cacheSize - 3), 1.5f);
+		}
+
+		//vertices with few triangles left are finished first
+		valence[0] = 0;
+		for (uint32_t i = 1; i < VERTEXCACHE_MAX_VALENCE; ++i)
+			valence[i] = 2.0f * powf((float)i, -0.5f);
+	}
+
+	float score(int32_t cachePos, uint32_t remaining) const
+	{
+		if (remaining == 0)
+			return -1.0f;
+
+		float s = cachePos >= 0 ? position[cachePos] : 0;
+		return s + valence[std::min(remaining, (uint32_t)VERTEXCACHE_MAX_VALENCE - 1)];
+	}
+};
+
+void wowMeshOptimizer::optimizeVertexCache(uint16_t* indices, uint32_t numIndices, uint32_t cacheSize)
+{
+	const uint32_t numTriangles = numIndices / 3;
+	if (numTriangles < 2)
+		return;
+
+	cacheSize = std::max(4u, std::min(cacheSize, (uint32_t)VERTEXCACHE_MAX_SIZE - 3));
+
+	uint16_t minIndex = 0xffff;
+	uint16_t maxIndex = 0;
+	for (uint32_t i = 0; i < numTriangles * 3; ++i)
+	{
+		minIndex = std::min(minIndex, indices[i]);
+		maxIndex = std::max(maxIndex, indices[i]);
+	}
+	const uint32_t numVertices = maxIndex - minIndex + 1;
+
+	//triangles of each vertex
+	std::vector<uint32_t> remaining(numVertices, 0);
+	for (uint32_t i = 0; i < numTriangles * 3; ++i)
+		++remaining[indices[i] - minIndex];
+
+	std::vector<uint32_t> offsets(numVertices + 1, 0);
+	for (uint32_t v = 0; v < numVertices; ++v)
+		offsets[v + 1] = offsets[v] + remaining[v];
+
+	std::vector<uint32_t> adjacency(numTriangles * 3);
+	{
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (uint32_t t = 0; t < numTriangles; ++t)
+		{
+			for (uint32_t k = 0; k < 3; ++k)
+				adjacency[fill[indices[t * 3 + k] - minIndex]++] = t;
+		}
+	}
+
+	const SCacheScoreTable table(cacheSize);
+	std::vector<int32_t> cachePos(numVertices, -1);
+	std::vector<float> vertexScore(numVertices);
+	for (uint32_t v = 0; v < numVertices; ++v)
+		vertexScore[v] = table.score(-1, remaining[v]);
+
+	std::vector<float> triangleScore(numTriangles);
+	std::vector<bool> emitted(numTriangles, false);
+	for (uint32_t t = 0; t < numTriangles; ++t)
+	{
+		triangleScore[t] = vertexScore[indices[t * 3] - minIndex] +
+			vertexScore[indices[t * 3 + 1] - minIndex] +
+			vertexScore[indices[t * 3 + 2] - minIndex];
+	}
+
+	std::vector<uint16_t> result(numTriangles * 3);
+	uint32_t cache[VERTEXCACHE_MAX_SIZE + 3];
+	uint32_t cacheCount = 0;
+	uint32_t scanCursor = 0;
+
+	for (uint32_t n = 0; n < numTriangles; ++n)
+	{
+		//best triangle touching the cache, otherwise the next one left in input order
+		int32_t best = -1;
+		float bestScore = -1.0f;
+		for (uint32_t c = 0; c < cacheCount; ++c)
+		{
+			const uint32_t v = cache[c];
+			for (uint32_t a = offsets[v]; a < offsets[v] + remaining[v]; ++a)
+			{
+				const uint32_t t = adjacency[a];
+				if (triangleScore[t] > bestScore)
+				{
+					bestScore = triangleScore[t];
+					best = (int32_t)t;
+				}
+			}
+		}
+
+		//the cursor only moves forward, all the fallbacks together scan the triangles once
+		if (best < 0)
+		{
+			while (emitted[scanCursor])
+				++scanCursor;
+			best = (int32_t)scanCursor;
+		}
+
+		const uint32_t t = (uint32_t)best;
+		emitted[t] = true;
+
+		//the triangle's vertices go to the front of the cache, the others are pushed back
+		uint32_t newCache[VERTEXCACHE_MAX_SIZE + 3];
+		uint32_t newCount = 0;
+		for (uint32_t k = 0; k < 3; ++k)
+		{
+			const uint32_t v = indices[t * 3 + k] - minIndex;
+			result[n * 3 + k] = indices[t * 3 + k];
+			newCache[newCount++] = v;
+
+			//drop the triangle from the vertex
+			for (uint32_t a = offsets[v]; a < offsets[v] + remaining[v]; ++a)
+			{
+				if (adjacency[a] == t)
+				{
+					std::swap(adjacency[a], adjacency[offsets[v] + remaining[v] - 1]);
+					break;
+				}
+			}
+			--remaining[v];
+		}
+		for (uint32_t c = 0; c < cacheCount; ++c)
+		{
+			const uint32_t v = cache[c];
+			if (v != newCache[0] && v != newCache[1] && v != newCache[2])
+				newCache[newCount++] = v;
+		}
+
+		for (uint32_t c = 0; c < newCount; ++c)
+			cachePos[newCache[c]] = c < cacheSize ? (int32_t)c : -1;
+
+		//rescore the vertices whose position changed and their triangles
+		for (uint32_t c = 0; c < newCount; ++c)
+		{
+			const uint32_t v = newCache[c];
+			vertexScore[v] = table.score(cachePos[v], remaining[v]);
+		}
+		for (uint32_t c = 0; c < newCount; ++c)
+		{
+			const uint32_t v = newCache[c];
+			for (uint32_t a = offsets[v]; a < offsets[v] + remaining[v]; ++a)
+			{
+				const uint32_t tri = adjacency[a];
+				triangleScore[tri] = vertexScore[indices[tri * 3] - minIndex] +
+					vertexScore[indices[tri * 3 + 1] - minIndex] +
+					vertexScore[indices[tri * 3 + 2] - minIndex];
+			}
+		}
+
+		cacheCount = std::min(newCount, cacheSize);
+		memcpy(cache, newCache, sizeof(uint32_t) * cacheCount);
+	}
+
+	memcpy(indices, result.data(), sizeof(uint16_t) * numTriangles * 3);
+}
+
+void wowMeshOptimizer::optimizeVertexFetch(uint16_t* indices, uint32_t numIndices, uint16_t vertexStart, uint16_t vertexEnd, std::vector<uint16_t>& remap)
+{
+	const uint32_t numVertices = vertexEnd - vertexStart + 1;
+	remap.assign(numVertices, 0);
+	std::vector<bool> used(numVertices, false);
+
+	uint32_t next = vertexStart;
+	for (uint32_t i = 0; i < numIndices; ++i)
+	{
+		const uint16_t v = indices[i];
+		if (v < vertexStart || v > vertexEnd)
+			continue;
+
+		if (!used[v - vertexStart])
+		{
+			used[v - vertexStart] = true;
+			remap[v - vertexStart] = (uint16_t)next++;
+		}
+		indices[i] = remap[v - vertexStart];
+	}
+
+	for (uint32_t v = 0; v < numVertices; ++v)
+	{
+		if (!used[v])
+			remap[v] = (uint16_t)next++;
+	}
+}
+
+SVertexCacheStats wowMeshOptimizer::getCacheStats(const uint16_t* indices, uint32_t numIndices, uint32_t cacheSize)
+{
+	SVertexCacheStats stats;
+	stats.numTriangles = numIndices / 3;
+	stats.numVertices = 0;
+	stats.numTransforms = 0;
+
+	//FIFO: a vertex is in the cache if it was transformed within the last cacheSize transforms
+	std::vector<uint32_t> transformed(65536, 0);
+	std::vector<bool> referenced(65536, false);
+	for (uint32_t i = 0; i < stats.numTriangles * 3; ++i)
+	{
+		const uint16_t v = indices[i];
+		if (!referenced[v])
+		{
+			referenced[v] = true;
+			++stats.numVertices;
+		}
+
+		if (transformed[v] == 0 || stats.numTransforms - transformed[v] >= cacheSize)
+		{
+			++stats.numTransforms;
+			transformed[v] = stats.numTransforms;
+		}
+	}
+	return stats;
+}
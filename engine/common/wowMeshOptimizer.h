@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+//post-transform cache simulation of an index list
+struct SVertexCacheStats
+{
+	uint32_t	numTriangles;
+	uint32_t	numVertices;			//referenced vertices
+	uint32_t	numTransforms;			//cache misses, vertex shader invocations
+
+	float getACMR() const { return numTriangles ? (float)numTransforms / numTriangles : 0; }
+	float getATVR() const { return numVertices ? (float)numTransforms / numVertices : 0; }
+};
+
+//index buffer reordering done at load, skin geosets and wmo batches are optimized one by one
+class wowMeshOptimizer
+{
+public:
+	//triangle order for a post-transform vertex cache (Forsyth), the triangle set is unchanged
+	static void optimizeVertexCache(uint16_t* indices, uint32_t numIndices, uint32_t cacheSize = 32);
+
+	//renumbers the vertices in [vertexStart, vertexEnd] by first use in indices
+	//remap[v - vertexStart] is the new index of vertex v, unused vertices are moved to the end of the range
+	static void optimizeVertexFetch(uint16_t* indices, uint32_t numIndices, uint16_t vertexStart, uint16_t vertexEnd, std::vector<uint16_t>& remap);
+
+	//FIFO cache of cacheSize vertices
+	static SVertexCacheStats getCacheStats(const uint16_t* indices, uint32_t numIndices, uint32_t cacheSize = 16);
+
+	//applied by the m2 and wmo loaders, off by default, it changes the index order of the cooked m2 blobs
+	static void setEnabled(bool enable) { Enabled = enable; }
+	static bool isEnabled() { return Enabled; }
+
+private:
+	static bool		Enabled;
+};
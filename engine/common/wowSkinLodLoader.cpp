@@ -0,0 +1,173 @@
+#include "wowSkinLodLoader.h"
+#include "CMemFile.h"
+#include "wowEnvironment.h"
+#include "wowM2File.h"
+
+wowSkinLodLoader::wowSkinLodLoader(const wowEnvironment* wowEnv, bool async)
+	: WowEnvironment(wowEnv), NextSerial(0), Async(async), Quit(false)
+{
+	if (Async)
+	{
+		INIT_EVENT(&LoaderEvent);
+		INIT_THREAD(&LoaderThread, [this](void*) { return loaderThread(); }, nullptr);
+	}
+}
+
+wowSkinLodLoader::~wowSkinLodLoader()
+{
+	if (Async)
+	{
+		BEGIN_LOCK(&QueueLock);
+		Quit = true;
+		END_LOCK(&QueueLock);
+		SET_EVENT(&LoaderEvent);
+
+		WAIT_THREAD(&LoaderThread);
+		DESTROY_THREAD(&LoaderThread);
+		DESTROY_EVENT(&LoaderEvent);
+	}
+
+	for (const SLoadResult& result : Results)
+		delete result.memFile;
+	Results.clear();
+
+	for (wowM2File* m2File : M2Files)
+		m2File->setSkinLodLoader(nullptr);
+}
+
+const wowSkinFile* wowSkinLodLoader::requestSkinLod(wowM2File* m2File, uint32_t lod)
+{
+	if (lod == 0 || lod >= m2File->getNumSkinLods() || m2File->isSkinLodLoaded(lod) || m2File->isSkinLodFailed(lod))
+		return m2File->getSkinLod(lod);
+
+	if (Async)
+	{
+		applyResults();
+		if (m2File->isSkinLodLoaded(lod) || m2File->isSkinLodFailed(lod))
+			return m2File->getSkinLod(lod);
+	}
+
+	const T_Key key(m2File, lod);
+	if (Pending.find(key) != Pending.end())
+		return nullptr;
+
+	if (M2Files.insert(m2File).second)
+		m2File->setSkinLodLoader(this);
+
+	const uint32_t fileId = m2File->getSkinLodFileID(lod);
+	if (!Async)
+	{
+		CMemFile* memFile = WowEnvironment->openFileById(fileId);
+		m2File->loadSkinLod(lod, memFile);
+		delete memFile;
+		return m2File->getSkinLod(lod);
+	}
+
+	SLoadRequest request;
+	request.m2File = m2File;
+	request.lod = lod;
+	request.serial = NextSerial++;
+	request.fileId = fileId;
+	Pending[key] = request.serial;
+
+	BEGIN_LOCK(&QueueLock);
+	Requests.push_back(request);
+	END_LOCK(&QueueLock);
+	SET_EVENT(&LoaderEvent);
+
+	return nullptr;
+}
+
+void wowSkinLodLoader::removeM2File(wowM2File* m2File)
+{
+	if (M2Files.erase(m2File) == 0)
+		return;
+
+	for (auto itr = Pending.begin(); itr != Pending.end();)
+	{
+		if (itr->first.first == m2File)
+			itr = Pending.erase(itr);
+		else
+			++itr;
+	}
+
+	//a file being read now is dropped by applyResults, it is no longer pending
+	BEGIN_LOCK(&QueueLock);
+	for (auto itr = Requests.begin(); itr != Requests.end();)
+	{
+		if (itr->m2File == m2File)
+			itr = Requests.erase(itr);
+		else
+			++itr;
+	}
+	for (auto itr = Results.begin(); itr != Results.end();)
+	{
+		if (itr->m2File == m2File)
+		{
+			delete itr->memFile;
+			itr = Results.erase(itr);
+		}
+		else
+		{
+			++itr;
+		}
+	}
+	END_LOCK(&QueueLock);
+}
+
+void wowSkinLodLoader::applyResults()
+{
+	std::vector<SLoadResult> results;
+	BEGIN_LOCK(&QueueLock);
+	results.swap(Results);
+	END_LOCK(&QueueLock);
+
+	for (const SLoadResult& result : results)
+	{
+		//a new m2 file at the address of a removed one has other serials
+		auto itr = Pending.find(T_Key(result.m2File, result.lod));
+		if (itr != Pending.end() && itr->second == result.serial)
+		{
+			Pending.erase(itr);
+			result.m2File->loadSkinLod(result.lod, result.memFile);
+		}
+		delete result.memFile;
+	}
+}
+
+int wowSkinLodLoader::loaderThread()
+{
+	while (true)
+	{
+		WAIT_EVENT(&LoaderEvent);
+
+		while (true)
+		{
+			SLoadRequest request;
+			BEGIN_LOCK(&QueueLock);
+			if (Quit)
+			{
+				END_LOCK(&QueueLock);
+				return 0;
+			}
+			if (Requests.empty())
+			{
+				END_LOCK(&QueueLock);
+				break;
+			}
+			request = Requests.front();
+			Requests.pop_front();
+			END_LOCK(&QueueLock);
+
+			SLoadResult result;
+			result.m2File = request.m2File;
+			result.lod = request.lod;
+			result.serial = request.serial;
+			result.memFile = WowEnvironment->openFileById(request.fileId);
+
+			BEGIN_LOCK(&QueueLock);
+			Results.push_back(result);
+			END_LOCK(&QueueLock);
+		}
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <deque>
+#include <vector>
+#include "CSysThread.h"
+#include "CSysSync.h"
+
+class wowEnvironment;
+class wowM2File;
+class wowSkinFile;
+class CMemFile;
+
+//skin files of the LODs after LOD 0, read on first request and kept by their m2 file
+//with async the files are read on a loader thread, the skins are built by requestSkinLod on the calling thread
+class wowSkinLodLoader
+{
+public:
+	explicit wowSkinLodLoader(const wowEnvironment* wowEnv, bool async = true);
+	~wowSkinLodLoader();
+
+	wowSkinLodLoader(const wowSkinLodLoader&) = delete;
+	wowSkinLodLoader& operator=(const wowSkinLodLoader&) = delete;
+
+public:
+	//the skin of the LOD if it is loaded, otherwise its file is queued and null is returned until it is read
+	//null also if the skin file fails to load
+	const wowSkinFile* requestSkinLod(wowM2File* m2File, uint32_t lod);
+
+	//called by the m2 file when it is destroyed
+	void removeM2File(wowM2File* m2File);
+
+	uint32_t getNumPending() const { return (uint32_t)Pending.size(); }
+
+private:
+	struct SLoadRequest
+	{
+		wowM2File*	m2File;
+		uint32_t	lod;
+		uint32_t	serial;
+		uint32_t	fileId;
+	};
+
+	struct SLoadResult
+	{
+		wowM2File*	m2File;
+		uint32_t	lod;
+		uint32_t	serial;
+		CMemFile*	memFile;
+	};
+
+	using T_Key = std::pair<wowM2File*, uint32_t>;
+
+	void applyResults();
+	int loaderThread();
+
+private:
+	const wowEnvironment*	WowEnvironment;
+	uint32_t	NextSerial;
+	bool	Async;
+
+	std::map<T_Key, uint32_t>	Pending;			//queued skins and their serial
+	std::set<wowM2File*>	M2Files;
+
+	//loader thread
+	thread_type		LoaderThread;
+	event_type		LoaderEvent;
+	lock_type		QueueLock;
+	std::deque<SLoadRequest>	Requests;
+	std::vector<SLoadResult>	Results;
+	bool	Quit;
+};
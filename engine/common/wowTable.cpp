@@ -2,8 +2,30 @@
 
 #include "wowDatabase.h"
 #include "wowDbFile.h"
+#include "CFileSystem.h"
 
-bool g_IterateTableRecords(const wowDatabase* database, const char* tableName, const std::function<void(const std::vector<VAR_T>&val)>& callback)
+//integer keys only, float and text columns have no index
+static bool getIndexKey(const VAR_T& v, uint32_t& key)
+{
+	if (v.Is<uint32_t>())
+		key = v.Get<uint32_t>();
+	else if (v.Is<int>())
+		key = (uint32_t)v.Get<int>();
+	else if (v.Is<uint16_t>())
+		key = v.Get<uint16_t>();
+	else if (v.Is<uint64_t>())
+		key = (uint32_t)v.Get<uint64_t>();
+	else
+		return false;
+	return true;
+}
+
+static bool isIndexKeyType(const std::string& type)
+{
+	return type == "uint" || type == "int" || type == "uint16" || type == "byte" || type == "uint64";
+}
+
+bool g_IterateTableRecords(const wowDatabase* database, const char* tableName, const std::function<void(const std::vector<VAR_T>&val)>& callback, TableIndexMap* indexMap)
 {
 	const CTableStruct* table = database->getDBStruct(tableName);
 	if (!table)
@@ -24,15 +46,49 @@ bool g_IterateTableRecords(const wowDatabase* database, const char* tableName, c
 // 		int x = 0;
 // 	}
 
+	//fields with createIndex, value offset in record
+	std::vector<std::pair<CTableIndex*, uint32_t>> indexFields;
+	if (indexMap)
+	{
+		uint32_t offset = 0;
+		for (const auto& field : table->fields)
+		{
+			//an index on a float, text or array column is an error in database.xml, the table is still read
+			if (field.needIndex && (field.arraySize != 1 || !isIndexKeyType(field.type)))
+			{
+				if (g_FileSystem)
+					g_FileSystem->writeLog(ELOG_RES, "%s: createIndex on field %s of type %s is skipped", table->name.c_str(), field.name.c_str(), field.type.c_str());
+			}
+			else if (field.needIndex)
+			{
+				CTableIndex& index = (*indexMap)[field.name];
+				index.Entries.clear();
+				index.Entries.reserve(file->getRecordCount());
+				indexFields.emplace_back(&index, offset);
+			}
+			offset += (field.isKey || field.isRelationshipData) ? 1 : field.arraySize;
+		}
+	}
+
 	//read records
 	for (uint32_t i = 0; i < file->getRecordCount(); ++i)
 	{
 		const std::vector<VAR_T>& val = file->getRecordValue(i, table);
 
+		for (const auto& kv : indexFields)
+		{
+			uint32_t key;
+			if (kv.second < (uint32_t)val.size() && getIndexKey(val[kv.second], key))
+				kv.first->add(key, i);
+		}
+
 		if (callback)
 			callback(val);
 	}
 
+	for (const auto& kv : indexFields)
+		kv.first->build();
+
 	delete file;
 	return true;
 }
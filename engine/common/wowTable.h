@@ -5,11 +5,64 @@
 #include <unordered_map>
 #include <functional>
 
+#include <string>
+#include <algorithm>
+
 #include "wowDbFile.h"
 #include <cassert>
 
 class wowDatabase;
 
+//secondary index, sorted (key, row) array built from fields marked createIndex in database.xml
+class CTableIndex
+{
+public:
+	struct SEntry
+	{
+		uint32_t key;
+		uint32_t row;
+
+		bool operator<(const SEntry& other) const
+		{
+			if (key != other.key)
+				return key < other.key;
+			return row < other.row;
+		}
+	};
+
+	struct SRange
+	{
+		const SEntry* first;
+		const SEntry* last;
+
+		const SEntry* begin() const { return first; }
+		const SEntry* end() const { return last; }
+		bool empty() const { return first == last; }
+		uint32_t size() const { return (uint32_t)(last - first); }
+	};
+
+public:
+	void add(uint32_t key, uint32_t row) { Entries.push_back({ key, row }); }
+	void build() { std::sort(Entries.begin(), Entries.end()); }
+
+	SRange findAll(uint32_t key) const
+	{
+		auto lower = std::lower_bound(Entries.begin(), Entries.end(), key,
+			[](const SEntry& e, uint32_t k) { return e.key < k; });
+		auto upper = std::upper_bound(lower, Entries.end(), key,
+			[](uint32_t k, const SEntry& e) { return k < e.key; });
+		SRange range;
+		range.first = Entries.data() + (lower - Entries.begin());
+		range.last = Entries.data() + (upper - Entries.begin());
+		return range;
+	}
+
+public:
+	std::vector<SEntry> Entries;
+};
+
+using TableIndexMap = std::unordered_map<std::string, CTableIndex>;
+
 #define BUILD_INDEX_MAP(id2indexMap, field)		\
 id2indexMap.reserve(RecordList.size());			\
 for (uint32_t i = 0; i < (uint32_t)RecordList.size(); ++i)	\
@@ -18,6 +71,7 @@ for (uint32_t i = 0; i < (uint32_t)RecordList.size(); ++i)	\
 #define IMPLEMENT_RECORD_COMMON()	\
 std::vector<SRecord>  RecordList;				\
 std::unordered_map<uint32_t, uint32_t> Id2IndexMap;			\
+TableIndexMap IndexMap;						\
 std::function<void(const std::vector<VAR_T>& val)>   OnLoadItem;	\
 bool hasKey() const { return !Id2IndexMap.empty(); }		\
 const SRecord* getByID(uint32_t id) const		\
@@ -26,18 +80,25 @@ const SRecord* getByID(uint32_t id) const		\
 	if (itr == Id2IndexMap.end())			\
 		return nullptr;					\
 	return &RecordList[itr->second];			\
+}							\
+CTableIndex::SRange findAll(const char* field, uint32_t key) const	\
+{							\
+	auto itr = IndexMap.find(field);			\
+	if (itr == IndexMap.end())				\
+	{ assert(false); return CTableIndex::SRange{ nullptr, nullptr }; }	\
+	return itr->second.findAll(key);			\
 }
 
 #define IMPLEMENT_RECORD_LOAD(name)			\
 bool loadData(const wowDatabase* database)		\
 {									\
-	if (!g_IterateTableRecords(database, name, OnLoadItem))		\
+	if (!g_IterateTableRecords(database, name, OnLoadItem, &IndexMap))		\
 		return false;				\
 	BUILD_INDEX_MAP(Id2IndexMap, ID);			\
 	return true;					\
 }
 
-bool g_IterateTableRecords(const wowDatabase* database, const char* tableName, const std::function<void(const std::vector<VAR_T>& val)>& callback);
+bool g_IterateTableRecords(const wowDatabase* database, const char* tableName, const std::function<void(const std::vector<VAR_T>& val)>& callback, TableIndexMap* indexMap = nullptr);
 
 /*
 CharBaseSection
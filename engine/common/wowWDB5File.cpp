@@ -2,6 +2,7 @@
 
 #include "CMemFile.h"
 #include "wowDatabase.h"
+#include "wowWDCFieldDecoder.h"
 #include <cassert>
 
 WDB5File::WDB5File(CMemFile* memFile)
@@ -22,10 +23,17 @@ bool WDB5File::open()
 	WDB5File::header header;
 	m_pMemFile->read(&header, sizeof(header));
 
+	WDB5File::header_wdb6_ext headerExt;
+	memset(&headerExt, 0, sizeof(headerExt));
+	if (strncmp(header.magic, "WDB6", 4) == 0)
+		m_pMemFile->read(&headerExt, sizeof(headerExt));
+
 	recordSize = header.record_size;
 	recordCount = header.record_count;
 	fieldCount = header.field_count;
 	stringSize = header.string_table_size;
+	tableHash = header.table_hash;
+	layoutHash = header.layout_hash;
 
 	//field
 	std::vector<WDB5File::field_structure> fields;
@@ -130,6 +138,18 @@ bool WDB5File::open()
 		recordCount += nbEntries;
 	}
 
+	// common data table, at the end of file
+	if (headerExt.common_data_table_size > 0)
+	{
+		uint32_t size = headerExt.common_data_table_size;
+		if (size > m_pMemFile->getSize() ||
+			!readCommonData(buffer + m_pMemFile->getSize() - size, size))
+		{
+			ASSERT(false);
+			return false;
+		}
+	}
+
 	return true;
 }
 
@@ -139,51 +159,155 @@ std::vector<VAR_T> WDB5File::getRecordValue(uint32_t index, const CTableStruct*
 
 	const uint8_t* recordOffset = m_recordOffsets[index];
 
-	std::vector<uint8_t> vals;
 	for (const auto& field : table->fields )
 	{
-		if (field.isCommonData)
+		VAR_T v;
+
+		if (field.isKey)
+		{
+			v = (uint32_t)m_IDs[index];
+			result.push_back(v);
 			continue;
+		}
+
+		uint32_t fieldSize = 4;
+		if (!field.isCommonData)
+		{
+			auto itr = m_fieldSizes.find(field.pos);
+			if (itr == m_fieldSizes.end())
+			{
+				ASSERT(false);
+				result.insert(result.end(), field.arraySize, VAR_T());
+				continue;
+			}
+			fieldSize = (32 - itr->second) / 8;
+		}
 
 		for (uint32_t i = 0; i < field.arraySize; ++i)
 		{
-			int fieldSize = (32 - m_fieldSizes.at(field.pos)) / 8;
-			vals.resize(fieldSize);
-			memcpy(vals.data(), recordOffset + field.pos + i * fieldSize, fieldSize);
-		
-			VAR_T v;
+			uint32_t val = 0;
+			if (field.isCommonData)		//pos is the column index in common data table
+			{
+				auto mapIt = m_commonData.find(field.pos);
+				if (mapIt != m_commonData.end())
+				{
+					auto valIt = mapIt->second.find(m_IDs[index]);
+					if (valIt != mapIt->second.end())
+						val = valIt->second;
+				}
+			}
+			else
+			{
+				memcpy(&val, recordOffset + field.pos + i * fieldSize, fieldSize > 4 ? 4 : fieldSize);
+			}
+
 			if (field.type == "text")
 			{
 				const char* stringPtr;
 				if (m_isSparseTable)
 					stringPtr = reinterpret_cast<const char *>(recordOffset + field.pos);
 				else
-					stringPtr = reinterpret_cast<const char *>(stringTable + *reinterpret_cast<int *>(vals.data()));
+					stringPtr = reinterpret_cast<const char *>(stringTable + val);
 
 				v = std::string(stringPtr);
 			}
 			else if (field.type == "float")
 			{
-				v = *reinterpret_cast<float*>(vals.data());
+				v = *reinterpret_cast<float*>(&val);
 			}
 			else if (field.type == "int")
 			{
-				v = *reinterpret_cast<int*>(vals.data());
+				//columns narrower than 4 bytes keep the sign of the value
+				if (!field.isCommonData && fieldSize < 4)
+					val = (uint32_t)WDCFieldDecoder::readBits(recordOffset, (field.pos + i * fieldSize) * 8, fieldSize * 8, true);
+				v = *reinterpret_cast<int*>(&val);
+			}
+			else if (field.type == "uint16")
+			{
+				v = (uint16_t)(val & 0x0000FFFF);
+			}
+			else if (field.type == "byte")
+			{
+				v = (uint16_t)(val & 0x000000FF);
+			}
+			else if (field.type == "uint64")
+			{
+				uint64_t val64 = val;
+				if (!field.isCommonData && fieldSize == 8)
+					memcpy(&val64, recordOffset + field.pos + i * fieldSize, 8);
+				v = val64;
 			}
 			else
 			{
-				unsigned int mask = 0xFFFFFFFF;
-				if (fieldSize == 1)
-					mask = 0x000000FF;
-				else if (fieldSize == 2)
-					mask = 0x0000FFFF;
-				else if (fieldSize == 3)
-					mask = 0x00FFFFFF;
-				
-				v = (*reinterpret_cast<uint32_t*>(vals.data()) & mask);	
+				v = val;
 			}
 			result.push_back(v);
 		}
 	}
 	return result;
 }
+
+bool WDB5File::readCommonData(const uint8_t* ptr, uint32_t size)
+{
+	static const uint32_t typeSizes[] = { 4, 2, 1, 4, 4 };		//string, short, byte, float, int
+
+	// early WDB6 builds store values by type size, later ones pad every value to 4 bytes
+	for (int padded = 0; padded < 2; ++padded)
+	{
+		m_commonData.clear();
+
+		const uint8_t* p = ptr;
+		const uint8_t* end = ptr + size;
+		uint32_t numColumns;
+		memcpy(&numColumns, p, 4);
+		p += 4;
+
+		bool ok = true;
+		for (uint32_t c = 0; c < numColumns && ok; ++c)
+		{
+			if (p + 5 > end)
+			{
+				ok = false;
+				break;
+			}
+
+			uint32_t count;
+			memcpy(&count, p, 4);
+			uint8_t type = p[4];
+			p += 5;
+
+			if (type >= sizeof(typeSizes) / sizeof(typeSizes[0]))
+			{
+				ok = false;
+				break;
+			}
+
+			uint32_t valSize = padded ? 4 : typeSizes[type];
+			if (p + count * (4 + valSize) > end)
+			{
+				ok = false;
+				break;
+			}
+
+			if (count == 0)
+				continue;
+
+			auto& vals = m_commonData[c];
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				uint32_t id;
+				uint32_t val = 0;
+				memcpy(&id, p, 4);
+				memcpy(&val, p + 4, valSize);
+				p += 4 + valSize;
+				vals[id] = val;
+			}
+		}
+
+		if (ok && p == end)
+			return true;
+	}
+
+	m_commonData.clear();
+	return false;
+}
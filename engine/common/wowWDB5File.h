@@ -25,12 +25,19 @@ public:
 		uint16_t id_index;                                            // new in WDB5 (and only after build 21737), this is the index of the field containing ID values; this is ignored if flags & 0x04 != 0
 	};
 
+	struct header_wdb6_ext
+	{
+		uint32_t total_field_count;                                   // new in WDB6, includes columns in common_data_table
+		uint32_t common_data_table_size;
+	};
+
 	explicit WDB5File(CMemFile* memFile);
 	~WDB5File() = default;
 
 	bool open();
 
 	virtual std::vector<VAR_T> getRecordValue(uint32_t index, const CTableStruct* table) const override;
+	uint32_t getRecordID(uint32_t index) const override { return m_IDs[index]; }
 
 protected:
 	struct field_structure
@@ -45,9 +52,12 @@ protected:
 		uint32_t copiedRowId;
 	};
 
+	bool readCommonData(const uint8_t* ptr, uint32_t size);
+
 	std::vector<uint32_t> m_IDs;
 	std::map<int, int> m_fieldSizes;
 	std::vector<const uint8_t*> m_recordOffsets;
+	std::map<uint32_t, std::map<uint32_t, uint32_t> > m_commonData;		//WDB6, column -> (id -> value)
 
 	bool m_isSparseTable;
 
@@ -0,0 +1,155 @@
+#include "wowWDBCFile.h"
+
+#include "CMemFile.h"
+#include "wowDatabase.h"
+#include <algorithm>
+#include <cassert>
+
+WDBCFile::WDBCFile(CMemFile* memFile)
+	: DBFile(memFile), m_offsetsTable(nullptr)
+{
+}
+
+bool WDBCFile::open()
+{
+	if (!m_pMemFile)
+	{
+		ASSERT(false);
+		return false;
+	}
+
+	const char* magic = (const char*)m_pMemFile->getBuffer();
+	if (strncmp(magic, "WDB2", 4) == 0)
+	{
+		WDBCFile::header_wdb2 header;
+		m_pMemFile->read(&header, sizeof(header));
+
+		recordSize = header.record_size;
+		recordCount = header.record_count;
+		fieldCount = header.field_count;
+		stringSize = header.string_table_size;
+		tableHash = header.table_hash;
+
+		//skip index table and string length table
+		if (header.max_id != 0)
+		{
+			uint32_t numIds = header.max_id - header.min_id + 1;
+			m_pMemFile->seek(numIds * 4 + numIds * 2, true);
+		}
+	}
+	else
+	{
+		WDBCFile::header header;
+		m_pMemFile->read(&header, sizeof(header));
+
+		recordSize = header.record_size;
+		recordCount = header.record_count;
+		fieldCount = header.field_count;
+		stringSize = header.string_table_size;
+	}
+
+	data = m_pMemFile->getPointer();
+	stringTable = data + recordSize * recordCount;
+
+	if (stringTable + stringSize > m_pMemFile->getBuffer() + m_pMemFile->getSize())
+	{
+		ASSERT(false);
+		return false;
+	}
+
+	return true;
+}
+
+std::vector<VAR_T> WDBCFile::getRecordValue(uint32_t index, const CTableStruct* table) const
+{
+	std::vector<VAR_T> result;
+
+	const std::vector<uint32_t>& offsets = getCachedColumnOffsets(table);
+
+	const uint8_t* recordOffset = data + index * recordSize;
+
+	for (const auto& field : table->fields)
+	{
+		VAR_T v;
+
+		if (field.isKey)
+		{
+			v = readColumn(index, 0);
+			result.push_back(v);
+			continue;
+		}
+
+		for (uint32_t i = 0; i < field.arraySize; ++i)
+		{
+			uint32_t column = field.pos + i;
+			if (column >= fieldCount)
+			{
+				ASSERT(false);
+				result.push_back(VAR_T());
+				continue;
+			}
+
+			uint64_t val = 0;
+			memcpy(&val, recordOffset + offsets[column], std::min(offsets[column + 1] - offsets[column], 8u));
+
+			if (field.type == "text")
+			{
+				v = std::string(reinterpret_cast<const char*>(stringTable + (uint32_t)val));
+				result.push_back(v);
+			}
+			else
+			{
+				result.push_back(makeValue(field.type, val));
+			}
+		}
+	}
+
+	return result;
+}
+
+const std::vector<uint32_t>& WDBCFile::getCachedColumnOffsets(const CTableStruct* table) const
+{
+	if (m_offsetsTable != table)
+	{
+		getColumnOffsets(table, m_columnOffsets);
+		m_offsetsTable = table;
+	}
+	return m_columnOffsets;
+}
+
+void WDBCFile::getColumnOffsets(const CTableStruct* table, std::vector<uint32_t>& offsets) const
+{
+	offsets.assign(fieldCount + 1, 4);
+	for (const auto& field : table->fields)
+	{
+		if (field.isKey)
+			continue;
+
+		uint32_t size = 4;
+		if (field.type == "byte")
+			size = 1;
+		else if (field.type == "uint16")
+			size = 2;
+		else if (field.type == "uint64")
+			size = 8;
+
+		for (uint32_t i = 0; i < field.arraySize && field.pos + i < fieldCount; ++i)
+			offsets[field.pos + i] = size;
+	}
+
+	//sizes to offsets
+	uint32_t offset = 0;
+	for (uint32_t i = 0; i <= fieldCount; ++i)
+	{
+		uint32_t size = offsets[i];
+		offsets[i] = offset;
+		offset += size;
+	}
+
+	//columns not in the table make the sizes unknown, all columns are 4 bytes then
+	if (offsets[fieldCount] != recordSize)
+	{
+		for (uint32_t i = 0; i <= fieldCount; ++i)
+			offsets[i] = i * 4;
+	}
+}
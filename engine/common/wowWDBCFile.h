@@ -0,0 +1,60 @@
+#pragma once
+
+#include "wowDbFile.h"
+#include <vector>
+
+//WDBC (.dbc) and WDB2 (.db2), ID is column 0
+//WDBC columns are 4 bytes, WDB2 packs byte, uint16 and uint64 columns to their size
+class WDBCFile : public DBFile
+{
+public:
+	struct header
+	{
+		char magic[4];                 // 'WDBC'
+		uint32_t record_count;
+		uint32_t field_count;
+		uint32_t record_size;
+		uint32_t string_table_size;
+	};
+
+	struct header_wdb2
+	{
+		char magic[4];                 // 'WDB2'
+		uint32_t record_count;
+		uint32_t field_count;
+		uint32_t record_size;
+		uint32_t string_table_size;
+		uint32_t table_hash;
+		uint32_t build;
+		uint32_t timestamp_last_written;
+		uint32_t min_id;
+		uint32_t max_id;               // if max_id != 0, an index table and a string length table follow the header
+		uint32_t locale;
+		uint32_t copy_table_size;
+	};
+
+	explicit WDBCFile(CMemFile* memFile);
+	~WDBCFile() = default;
+
+	bool open();
+
+	std::vector<VAR_T> getRecordValue(uint32_t index, const CTableStruct* table) const override;
+	uint32_t getRecordID(uint32_t index) const override { return readColumn(index, 0); }
+
+private:
+	//offsets of the columns and the record end, from the field types of the table
+	void getColumnOffsets(const CTableStruct* table, std::vector<uint32_t>& offsets) const;
+	//getColumnOffsets of the last table read, computed once for all its records
+	const std::vector<uint32_t>& getCachedColumnOffsets(const CTableStruct* table) const;
+
+	uint32_t readColumn(uint32_t index, uint32_t column) const
+	{
+		uint32_t val;
+		memcpy(&val, data + index * recordSize + column * 4, 4);
+		return val;
+	}
+
+private:
+	mutable const CTableStruct*	m_offsetsTable;
+	mutable std::vector<uint32_t>	m_columnOffsets;
+};
@@ -0,0 +1,245 @@
+#include "wowWDC1File.h"
+#include "CMemFile.h"
+#include "wowDatabase.h"
+#include "stringext.h"
+#include <cassert>
+
+WDC1File::WDC1File(CMemFile * memFile)
+	: DBFile(memFile), m_isSparseTable(false)
+{
+	memset(&m_header, 0, sizeof(m_header));
+}
+
+bool WDC1File::open()
+{
+	if (!m_pMemFile)
+	{
+		ASSERT(false);
+		return false;
+	}
+
+	const uint8_t* buffer = m_pMemFile->getBuffer();
+
+	m_pMemFile->read(&m_header, sizeof(m_header));
+
+	recordSize = m_header.record_size;
+	recordCount = m_header.record_count;
+	fieldCount = m_header.field_count;
+	stringSize = m_header.string_table_size;
+	tableHash = m_header.table_hash;
+	layoutHash = m_header.layout_hash;
+
+	m_isSparseTable = (m_header.flags & 0x01) != 0;
+
+	//field
+	m_pMemFile->seek(fieldCount * sizeof(WDC1File::field_structure), true);
+
+	// file =
+	// 1. records, string block (or variable record data with offset map)
+	// 2. offset map
+	// 3. id list
+	// 4. copy table
+	// 5. field storage info
+	// 6. pallet data
+	// 7. common data
+	// 8. relationship map
+
+	//1. records
+	data = m_pMemFile->getPointer();
+	const uint8_t* curPtr;
+	if (!m_isSparseTable)
+	{
+		stringTable = data + recordSize * recordCount;
+		curPtr = stringTable + stringSize;
+
+		m_recordOffsets.reserve(recordCount);
+		for (uint32_t i = 0; i < recordCount; ++i)
+			m_recordOffsets.push_back(data + i * recordSize);
+	}
+	else
+	{
+		// embedded strings in fields instead of stringTable
+		stringSize = 0;
+		curPtr = buffer + m_header.offset_map_offset;
+
+		//2. offset map
+		recordCount = 0;
+		for (uint32_t i = 0; i < (m_header.max_id - m_header.min_id + 1); ++i)
+		{
+			offset_map_entry entry;
+			memcpy(&entry, curPtr, sizeof(offset_map_entry));
+			curPtr += sizeof(offset_map_entry);
+
+			if (entry.offset == 0 || entry.size == 0)
+				continue;
+
+			m_IDs.push_back(m_header.min_id + i);
+			m_recordOffsets.push_back(buffer + entry.offset);
+			++recordCount;
+		}
+	}
+
+	//3. id list
+	const uint8_t* idList = curPtr;
+	curPtr += m_header.id_list_size;
+
+	//4. copy table
+	const copy_table_entry* copyTable = reinterpret_cast<const copy_table_entry*>(curPtr);
+	uint32_t nbCopyEntries = m_header.copy_table_size / sizeof(copy_table_entry);
+	curPtr += m_header.copy_table_size;
+
+	//5. storage info, 6. pallet data, 7. common data
+	curPtr = m_fieldDecoder.load(curPtr, m_header.field_storage_info_size, m_header.pallet_data_size, m_header.common_data_size);
+
+	//8. relationship map
+	if (m_header.relationship_data_size > 0)
+	{
+		uint32_t nbEntries;
+		memcpy(&nbEntries, curPtr, 4);
+		curPtr += (4 + 8);
+
+		for (uint32_t i = 0; i < nbEntries; ++i)
+		{
+			uint32_t foreignKey;
+			uint32_t recordIndex;
+			memcpy(&foreignKey, curPtr, 4);
+			curPtr += 4;
+			memcpy(&recordIndex, curPtr, 4);
+			curPtr += 4;
+			m_relationShipData[recordIndex] = foreignKey;
+		}
+	}
+
+	//read IDs
+	if (!m_isSparseTable)
+	{
+		if (m_header.id_list_size > 0)
+		{
+			m_IDs.resize(m_header.id_list_size / 4);
+			memcpy(m_IDs.data(), idList, m_header.id_list_size);
+		}
+		else
+		{
+			//read ids from data
+			m_IDs.resize(recordCount);
+			for (uint32_t i = 0; i < recordCount; ++i)
+			{
+				if (!m_fieldDecoder.readID(m_recordOffsets[i], m_header.id_index, m_IDs[i]))
+				{
+					ASSERT(false);
+					return false;
+				}
+			}
+		}
+	}
+
+	if (m_IDs.size() != recordCount)
+	{
+		ASSERT(false);
+		return false;
+	}
+
+	//apply copy table
+	if (nbCopyEntries > 0)
+	{
+		m_IDs.reserve(recordCount + nbCopyEntries);
+		m_recordOffsets.reserve(recordCount + nbCopyEntries);
+
+		// create a id->offset map
+		std::map<uint32_t, const uint8_t*> IDToOffsetMap;
+
+		for (uint32_t i = 0; i < recordCount; ++i)
+		{
+			IDToOffsetMap[m_IDs[i]] = m_recordOffsets[i];
+		}
+
+		for (uint32_t i = 0; i < nbCopyEntries; ++i)
+		{
+			copy_table_entry entry;
+			memcpy(&entry, copyTable + i, sizeof(copy_table_entry));
+			m_IDs.push_back(entry.newRowId);
+			m_recordOffsets.push_back(IDToOffsetMap[entry.copiedRowId]);
+		}
+		recordCount += nbCopyEntries;
+	}
+
+	return true;
+}
+
+std::vector<VAR_T> WDC1File::getRecordValue(uint32_t index, const CTableStruct* table) const
+{
+	std::vector<VAR_T> result;
+
+	const uint8_t* recordOffset = m_recordOffsets[index];
+
+	for (const auto& field : table->fields)
+	{
+		VAR_T v;
+
+		if (field.isKey)
+		{
+			v = (uint32_t)m_IDs[index];
+			result.push_back(v);
+			continue;
+		}
+
+		if (field.isRelationshipData)
+		{
+			uint32_t key;
+			auto itr = m_relationShipData.find(index);
+			if (itr != m_relationShipData.end())
+				key = itr->second;
+			else
+				key = 0;
+			v = key;
+			result.push_back(v);
+			continue;
+		}
+
+		for (uint32_t i = 0; i < field.arraySize; ++i)
+		{
+			uint64_t val = 0;
+			if (!m_fieldDecoder.readFieldValue(recordOffset, m_IDs[index], field.pos, i, field.arraySize, val))
+			{
+				result.push_back(VAR_T());
+				continue;
+			}
+
+			if (field.type == "text")
+			{
+				const char* strPtr;
+				if (m_isSparseTable)
+				{
+					const uint8_t* ptr = recordOffset;
+					for (int f = 0; f <= field.pos; ++f)
+					{
+						if (table->fields[f].isKey)
+							continue;
+						if (table->fields[f].type == "uint64")
+						{
+							ptr += 8;
+						}
+						else
+						{
+							ptr += (strlen((const char*)ptr) + 1);
+						}
+					}
+					strPtr = reinterpret_cast<const char*>(ptr);
+				}
+				else
+				{
+					//WDC1 string offsets are into the string block, not relative to the field
+					strPtr = reinterpret_cast<const char*>(stringTable + (uint32_t)val);
+				}
+				v = std::string(strPtr);
+				result.push_back(v);
+			}
+			else
+			{
+				result.push_back(makeValue(field.type, val));
+			}
+		}
+	}
+
+	return result;
+}
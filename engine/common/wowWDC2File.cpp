@@ -26,6 +26,8 @@ bool WDC2File::open()
 	recordCount = m_header.record_count;
 	fieldCount = m_header.field_count;
 	stringSize = m_header.string_table_size;
+	tableHash = m_header.table_hash;
+	layoutHash = m_header.layout_hash;
 
 	//section header
 	m_sectionHeaders.resize(m_header.section_count);
@@ -42,67 +44,10 @@ bool WDC2File::open()
 		m_fieldSizes[field.position] = field.size;
 	}
 
-	//storage info
-	if (m_header.field_storage_info_size > 0)
-	{
-		uint32_t nFieldStorageInfo = m_header.field_storage_info_size / sizeof(field_storage_info);
-		m_fieldStorageInfo.resize(nFieldStorageInfo);
-		m_pMemFile->read(m_fieldStorageInfo.data(), sizeof(field_storage_info) * nFieldStorageInfo);
-	}
-
-	//pallte data
-	if (m_header.pallet_data_size > 0)
-	{
-		m_pMemFile->seek(m_header.pallet_data_size, true);
-
-		uint32_t fieldId = 0;
-		uint32_t offset = 0;
-		for (const auto& info : m_fieldStorageInfo)
-		{
-			if ((info.storage_type == FIELD_COMPRESSION::BITPACKED_INDEXED || info.storage_type == FIELD_COMPRESSION::BITPACKED_INDEXED_ARRAY) &&
-				info.additional_data_size != 0)
-			{
-				m_palletBlockOffsets[fieldId] = offset;
-				offset += info.additional_data_size;
-			}
-			++fieldId;
-		}
-	}
-
-	//common data
-	if (m_header.common_data_size > 0)
-	{
-		const uint8_t* commonData = m_pMemFile->getPointer();
-
-		uint32_t fieldId = 0;
-		uint32_t offset = 0;
-		for (const auto& info : m_fieldStorageInfo)
-		{
-			if ((info.storage_type == FIELD_COMPRESSION::COMMON_DATA) &&
-				info.additional_data_size != 0)
-			{
-				const uint8_t* ptr = commonData + offset;
-				std::map<uint32_t, uint32_t> commonVals;
-				for (uint32_t i = 0; i < info.additional_data_size / 8; ++i)
-				{
-					uint32_t id;
-					uint32_t val;
-					memcpy(&id, ptr, 4);
-					ptr += 4;
-					memcpy(&val, ptr, 4);
-					ptr += 4;
-
-					commonVals[id] = val;
-				}
-				m_commonData[fieldId] = commonVals;
-				offset += info.additional_data_size;
-			}
-
-			++fieldId;
-		}
-
-		m_pMemFile->seek(m_header.common_data_size, true);
-	}
+	//storage info, pallet data, common data
+	const uint8_t* fieldData = m_pMemFile->getPointer();
+	const uint8_t* fieldDataEnd = m_fieldDecoder.load(fieldData, m_header.field_storage_info_size, m_header.pallet_data_size, m_header.common_data_size);
+	m_pMemFile->seek((int32_t)(fieldDataEnd - fieldData), true);
 
 	// a section = 
 	// 1. records
@@ -165,49 +110,12 @@ bool WDC2File::open()
 		}
 		else
 		{
-			m_IDs.reserve(recordCount);
-			const auto& info = m_fieldStorageInfo[m_header.id_index];
-
 			//read ids from data
+			m_IDs.resize(recordCount);
 			for (uint32_t i = 0; i < recordCount; ++i)
 			{
-				const uint8_t* recordOffset = sectionData + i * recordSize;
-				switch (info.storage_type)
-				{
-				case FIELD_COMPRESSION::NONE:
-				{
-					uint8_t* val = new uint8_t[info.field_size_bits / 8];
-					memcpy(val, recordOffset + info.field_offset_bits / 8, info.field_size_bits / 8);
-					m_IDs.push_back((*reinterpret_cast<unsigned int*>(val)));
-					delete[] val;
-				}
-				break;
-				case FIELD_COMPRESSION::BITPACKED:
-				{
-					unsigned int size = (info.field_size_bits + (info.field_offset_bits & 7) + 7) / 8;
-					unsigned int offset = info.field_offset_bits / 8;
-					uint8_t* val = new unsigned char[size];
-					memcpy(val, recordOffset + offset, size);
-					unsigned int id = (*reinterpret_cast<unsigned int*>(val));
-					delete[] val;
-					id = id & ((1ull << info.field_size_bits) - 1);
-					m_IDs.push_back(id);
-				}
-				break;
-				case FIELD_COMPRESSION::COMMON_DATA:
-					ASSERT(false);
-					return false;
-				case FIELD_COMPRESSION::BITPACKED_INDEXED:
-				case FIELD_COMPRESSION::BITPACKED_SIGNED:
+				if (!m_fieldDecoder.readID(sectionData + i * recordSize, m_header.id_index, m_IDs[i]))
 				{
-					uint32_t id = readBitpackedValue(info, recordOffset);
-					m_IDs.push_back(id);
-					break;
-				}
-				case FIELD_COMPRESSION::BITPACKED_INDEXED_ARRAY:
-					ASSERT(false);
-					return false;
-				default:
 					ASSERT(false);
 					return false;
 				}
@@ -309,9 +217,12 @@ std::vector<VAR_T> WDC2File::getRecordValue(uint32_t index, const CTableStruct*
 
 		for (uint32_t i = 0; i < field.arraySize; ++i)
 		{
-			uint32_t val = 0;
-			if (!readFieldValue(index, field.pos, i, field.arraySize, val))
+			uint64_t val = 0;
+			if (!m_fieldDecoder.readFieldValue(recordOffset, m_IDs[index], field.pos, i, field.arraySize, val))
+			{
+				result.push_back(VAR_T());
 				continue;
+			}
 
 			if (field.type == "text")
 			{
@@ -336,144 +247,18 @@ std::vector<VAR_T> WDC2File::getRecordValue(uint32_t index, const CTableStruct*
 				}
 				else
 				{
-					strPtr = reinterpret_cast<const char*>(recordOffset + m_fieldStorageInfo[field.pos].field_offset_bits / 8 + val
+					strPtr = reinterpret_cast<const char*>(recordOffset + m_fieldDecoder.getStorageInfo(field.pos).field_offset_bits / 8 + (uint32_t)val
 						- ((m_header.record_count - m_sectionHeaders[0].record_count) * m_header.record_size));
 				}
 				v = std::string(strPtr);
 				result.push_back(v);
 			}
-			else if (field.type == "float")
-			{
-				v = *reinterpret_cast<float*>(&val);
-				result.push_back(v);
-			}
-			else if (field.type == "int")
-			{
-				v = *reinterpret_cast<int*>(&val);
-				result.push_back(v);
-			}
-			else if (field.type == "uint16")
-			{
-				v = *reinterpret_cast<uint16_t*>(&val);
-				result.push_back(v);
-			}
-			else if (field.type == "byte")
-			{
-				v = (uint16_t)(*reinterpret_cast<uint16_t*>(&val) & 0x000000FF);
-				result.push_back(v);
-			}
-			else if (field.type == "uint64")
-			{
-				v = *reinterpret_cast<uint64_t*>(&val);
-				result.push_back(v);
-			}
 			else
 			{
-				v = *reinterpret_cast<uint32_t*>(&val);
-				result.push_back(v);
-			}
-		}
-
-	}
-
-	return result;
-}
-
-bool WDC2File::readFieldValue(uint32_t recordIndex, uint32_t fieldIndex, uint32_t arrayIndex, uint32_t arraySize, uint32_t& result) const
-{
-	const uint8_t* recordOffset = m_recordOffsets[recordIndex];
-	const auto& info = m_fieldStorageInfo[fieldIndex];
-
-	switch (info.storage_type)
-	{
-	case FIELD_COMPRESSION::NONE:
-	{
-		uint16_t fieldSize = info.field_size_bits / 8;
-		const uint8_t* fieldOffset = recordOffset + info.field_offset_bits / 8;
-
-		if (arraySize != 1)
-		{
-			fieldSize /= arraySize;
-			fieldOffset += ((info.field_size_bits / 8 / arraySize) * arrayIndex);
-		}
-
-		uint8_t* val = new uint8_t[fieldSize];
-		memcpy(val, fieldOffset, fieldSize);
-		// handle special case => when value is supposed to be 0, values read are all 0xFF
-		// Don't understand why, so I use this ugly stuff...
-		if (arraySize != 1)
-		{
-			uint8_t nbFF = 0;
-			for (uint8_t i = 0; i < fieldSize; i++)
-			{
-				if (val[i] == 0xFF)
-					nbFF++;
-			}
-
-			if (nbFF == fieldSize)
-			{
-				for (uint8_t i = 0; i < fieldSize; i++)
-					val[i] = 0;
+				result.push_back(makeValue(field.type, val));
 			}
 		}
-		result = (*reinterpret_cast<uint32_t*>(val));
-		result = result & ((1ull << (info.field_size_bits / arraySize)) - 1);
-		delete[] val;
-	}
-	break;
-	case FIELD_COMPRESSION::BITPACKED:
-	case FIELD_COMPRESSION::BITPACKED_SIGNED:
-	{
-		result = readBitpackedValue(info, recordOffset);
-	}
-	break;
-	case FIELD_COMPRESSION::COMMON_DATA:
-	{
-		result = info.val1;
-		auto mapIt = m_commonData.find(fieldIndex);
-		if (mapIt != m_commonData.end())
-		{
-			auto valIt = mapIt->second.find(m_IDs[recordIndex]);
-			if (valIt != mapIt->second.end())
-				result = valIt->second;
-		}
-	}
-	break;
-	case FIELD_COMPRESSION::BITPACKED_INDEXED:
-	{
-		uint32_t index = readBitpackedValue(info, recordOffset);
-		auto it = m_palletBlockOffsets.find(fieldIndex);
-		uint32_t offset = it->second + index * 4;
-		memcpy(&result, m_pMemFile->getBuffer() + offset, 4);
 	}
-	break;
-	case FIELD_COMPRESSION::BITPACKED_INDEXED_ARRAY:
-	{
-		uint32_t index = readBitpackedValue(info, recordOffset);
-		auto it = m_palletBlockOffsets.find(fieldIndex);
-		uint32_t offset = it->second + index * arraySize * 4 + arrayIndex * 4;
-		memcpy(&result, m_pMemFile->getBuffer() + offset, 4);
-	}
-	break;
-	default:
-		ASSERT(false);
-		return false;
-	}
-	return true;
-}
-
-uint32_t WDC2File::readBitpackedValue(const field_storage_info& info, const uint8_t* recordOffset) const
-{
-	uint16_t size = (info.field_size_bits + (info.field_offset_bits & 7) + 7) / 8;
-	uint16_t offset = info.field_offset_bits / 8;
-
-	uint8_t* vals = new uint8_t[size];
-	memcpy(vals, recordOffset + offset, size);
-
-	uint32_t result = (*reinterpret_cast<uint32_t*>(vals));
-	delete[] vals;
 
-	result = result >> (info.field_offset_bits & 7);
-	result = result & ((1ull << info.field_size_bits) - 1);
 	return result;
 }
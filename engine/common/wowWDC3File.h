@@ -1,6 +1,7 @@
 #pragma once
 
 #include "wowDbFile.h"
+#include "wowWDCFieldDecoder.h"
 #include <vector>
 #include <map>
 
@@ -49,34 +50,12 @@ public:
 	bool open();
 
 	std::vector<VAR_T> getRecordValue(uint32_t index, const CTableStruct* table) const override;
+	uint32_t getRecordID(uint32_t index) const override { return m_IDs[index]; }
 
-private:
-	enum class FIELD_COMPRESSION : uint32_t
-	{
-		NONE = 0,
-		BITPACKED,
-		COMMON_DATA,
-		BITPACKED_INDEXED,
-		BITPACKED_INDEXED_ARRAY,
-		BITPACKED_SIGNED,
-	};
-
-	struct field_storage_info
-	{
-		uint16_t field_offset_bits;
-		uint16_t field_size_bits; // very important for reading bitpacked fields; size is the sum of all array pieces in bits - for example, uint32[3] will appear here as '96'
-								  // additional_data_size is the size in bytes of the corresponding section in
-								  // common_data or pallet_data.  These sections are in the same order as the
-								  // field_info, so to find the offset, add up the additional_data_size of any
-								  // previous fields which are stored in the same block (common_data or
-								  // pallet_data).
-		uint32_t additional_data_size;
-		FIELD_COMPRESSION storage_type;
-		uint32_t val1;
-		uint32_t val2;
-		uint32_t val3;
-	};
+protected:
+	void getDecodedRanges(std::vector<SDataRange>& ranges) const override;
 
+private:
 #pragma pack(2)
 	struct offset_map_entry
 	{
@@ -103,9 +82,6 @@ private:
 		uint32_t copiedRowId;
 	};
 
-	bool readFieldValue(uint32_t recordIndex, uint32_t fieldIndex, uint32_t arrayIndex, uint32_t arraySize, uint32_t& result) const;
-	uint32_t readBitpackedValue(const field_storage_info& info, const uint8_t* recordOffset) const;
-
 private:
 	std::vector<uint32_t> m_IDs;
 	std::map<int, int> m_fieldSizes;
@@ -115,11 +91,11 @@ private:
 
 	WDC3File::header m_header;
 	std::vector<section_header> m_sectionHeaders;
-	std::vector<field_storage_info> m_fieldStorageInfo;
+	WDCFieldDecoder m_fieldDecoder;
 
-	std::map<uint32_t, uint32_t> m_palletBlockOffsets;
-	std::map<uint32_t, std::map<uint32_t, uint32_t> > m_commonData;
-	std::map<uint32_t, uint32_t> m_relationShipData;
+	//field info through common data, and section 0 which is the only one decoded
+	SDataRange m_fieldRange;
+	SDataRange m_sectionRange;
 
-	std::vector<uint8_t> m_palletData;
+	std::map<uint32_t, uint32_t> m_relationShipData;
 };
@@ -0,0 +1,204 @@
+#include "wowWDCFieldDecoder.h"
+
+#include <algorithm>
+#include <cassert>
+
+const uint8_t* WDCFieldDecoder::load(const uint8_t* ptr, uint32_t storageInfoSize, uint32_t palletDataSize, uint32_t commonDataSize)
+{
+	m_fieldStorageInfo.clear();
+	m_palletData = nullptr;
+	m_palletBlockOffsets.clear();
+	m_commonData.clear();
+
+	//storage info
+	if (storageInfoSize > 0)
+	{
+		uint32_t nFieldStorageInfo = storageInfoSize / sizeof(field_storage_info);
+		m_fieldStorageInfo.resize(nFieldStorageInfo);
+		memcpy(m_fieldStorageInfo.data(), ptr, sizeof(field_storage_info) * nFieldStorageInfo);
+		ptr += storageInfoSize;
+	}
+
+	//pallet data
+	if (palletDataSize > 0)
+	{
+		m_palletData = ptr;
+
+		uint32_t fieldId = 0;
+		uint32_t offset = 0;
+		for (const auto& info : m_fieldStorageInfo)
+		{
+			if ((info.storage_type == FIELD_COMPRESSION::BITPACKED_INDEXED || info.storage_type == FIELD_COMPRESSION::BITPACKED_INDEXED_ARRAY) &&
+				info.additional_data_size != 0)
+			{
+				m_palletBlockOffsets[fieldId] = offset;
+				offset += info.additional_data_size;
+			}
+			++fieldId;
+		}
+
+		ptr += palletDataSize;
+	}
+
+	//common data
+	if (commonDataSize > 0)
+	{
+		uint32_t fieldId = 0;
+		uint32_t offset = 0;
+		for (const auto& info : m_fieldStorageInfo)
+		{
+			if ((info.storage_type == FIELD_COMPRESSION::COMMON_DATA) &&
+				info.additional_data_size != 0)
+			{
+				const uint8_t* p = ptr + offset;
+				std::map<uint32_t, uint32_t>& commonVals = m_commonData[fieldId];
+				for (uint32_t i = 0; i < info.additional_data_size / 8; ++i)
+				{
+					uint32_t id;
+					uint32_t val;
+					memcpy(&id, p, 4);
+					p += 4;
+					memcpy(&val, p, 4);
+					p += 4;
+
+					commonVals[id] = val;
+				}
+				offset += info.additional_data_size;
+			}
+
+			++fieldId;
+		}
+
+		ptr += commonDataSize;
+	}
+
+	return ptr;
+}
+
+bool WDCFieldDecoder::readFieldValue(const uint8_t* recordOffset, uint32_t id, uint32_t fieldIndex, uint32_t arrayIndex, uint32_t arraySize, uint64_t& result) const
+{
+	if (fieldIndex >= (uint32_t)m_fieldStorageInfo.size())
+	{
+		ASSERT(false);
+		return false;
+	}
+
+	const auto& info = m_fieldStorageInfo[fieldIndex];
+
+	switch (info.storage_type)
+	{
+	case FIELD_COMPRESSION::NONE:
+	{
+		uint32_t fieldSize = info.field_size_bits / 8;
+		const uint8_t* fieldOffset = recordOffset + info.field_offset_bits / 8;
+
+		if (arraySize != 1)
+		{
+			fieldSize /= arraySize;
+			fieldOffset += (fieldSize * arrayIndex);
+		}
+		fieldSize = std::min(fieldSize, 8u);
+
+		uint64_t val = 0;
+		memcpy(&val, fieldOffset, fieldSize);
+		// handle special case => when value is supposed to be 0, values read are all 0xFF
+		// Don't understand why, so I use this ugly stuff...
+		if (arraySize != 1 && fieldSize > 0 && val == (~0ull >> (64 - fieldSize * 8)))
+			val = 0;
+		result = val;
+	}
+	break;
+	case FIELD_COMPRESSION::BITPACKED:
+	case FIELD_COMPRESSION::BITPACKED_SIGNED:
+	{
+		result = readBitpackedValue(info, recordOffset);
+	}
+	break;
+	case FIELD_COMPRESSION::COMMON_DATA:
+	{
+		result = info.val1;
+		auto mapIt = m_commonData.find(fieldIndex);
+		if (mapIt != m_commonData.end())
+		{
+			auto valIt = mapIt->second.find(id);
+			if (valIt != mapIt->second.end())
+				result = valIt->second;
+		}
+	}
+	break;
+	case FIELD_COMPRESSION::BITPACKED_INDEXED:
+	case FIELD_COMPRESSION::BITPACKED_INDEXED_ARRAY:
+	{
+		auto it = m_palletBlockOffsets.find(fieldIndex);
+		if (it == m_palletBlockOffsets.end())
+		{
+			ASSERT(false);
+			return false;
+		}
+
+		uint32_t index = (uint32_t)readBitpackedValue(info, recordOffset);
+		if (info.storage_type == FIELD_COMPRESSION::BITPACKED_INDEXED_ARRAY)
+			index = index * arraySize + arrayIndex;
+		uint32_t offset = it->second + index * 4;
+
+		uint32_t val;
+		memcpy(&val, m_palletData + offset, 4);
+		result = val;
+	}
+	break;
+	default:
+		ASSERT(false);
+		return false;
+	}
+	return true;
+}
+
+bool WDCFieldDecoder::readID(const uint8_t* recordOffset, uint32_t fieldIndex, uint32_t& id) const
+{
+	if (fieldIndex >= (uint32_t)m_fieldStorageInfo.size())
+		return false;
+
+	switch (m_fieldStorageInfo[fieldIndex].storage_type)
+	{
+	case FIELD_COMPRESSION::NONE:
+	case FIELD_COMPRESSION::BITPACKED:
+	case FIELD_COMPRESSION::BITPACKED_INDEXED:
+	case FIELD_COMPRESSION::BITPACKED_SIGNED:
+	{
+		uint64_t val;
+		if (!readFieldValue(recordOffset, 0, fieldIndex, 0, 1, val))
+			return false;
+		id = (uint32_t)val;
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+uint64_t WDCFieldDecoder::readBitpackedValue(const field_storage_info& info, const uint8_t* recordOffset) const
+{
+	return readBits(recordOffset, info.field_offset_bits, info.field_size_bits, info.storage_type == FIELD_COMPRESSION::BITPACKED_SIGNED);
+}
+
+uint64_t WDCFieldDecoder::readBits(const uint8_t* recordOffset, uint32_t offsetBits, uint32_t sizeBits, bool isSigned)
+{
+	const uint32_t bits = std::min<uint32_t>(sizeBits, 64);
+	const uint32_t shift = offsetBits & 7;
+	const uint32_t size = (bits + shift + 7) / 8;
+	const uint8_t* ptr = recordOffset + offsetBits / 8;
+
+	uint64_t vals = 0;
+	memcpy(&vals, ptr, std::min(size, 8u));
+	vals >>= shift;
+	if (size > 8)			//a 64 bit field not starting on a byte
+		vals |= (uint64_t)ptr[8] << (64 - shift);
+
+	if (bits < 64)
+	{
+		vals &= (1ull << bits) - 1;
+		if (isSigned && bits > 0 && (vals >> (bits - 1)) != 0)
+			vals |= ~0ull << bits;
+	}
+	return vals;
+}
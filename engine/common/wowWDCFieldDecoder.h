@@ -0,0 +1,65 @@
+#pragma once
+
+#include "wowDbFile.h"
+#include <vector>
+#include <map>
+
+//field storage of WDC1, WDC2 and WDC3: storage info, pallet data and common data, and the decoding of record fields
+//pallet data points into the file buffer, it is not copied
+class WDCFieldDecoder
+{
+public:
+	enum class FIELD_COMPRESSION : uint32_t
+	{
+		NONE = 0,
+		BITPACKED,
+		COMMON_DATA,
+		BITPACKED_INDEXED,
+		BITPACKED_INDEXED_ARRAY,
+		BITPACKED_SIGNED,
+	};
+
+	struct field_storage_info
+	{
+		uint16_t field_offset_bits;
+		uint16_t field_size_bits; // very important for reading bitpacked fields; size is the sum of all array pieces in bits - for example, uint32[3] will appear here as '96'
+								  // additional_data_size is the size in bytes of the corresponding section in
+								  // common_data or pallet_data.  These sections are in the same order as the
+								  // field_info, so to find the offset, add up the additional_data_size of any
+								  // previous fields which are stored in the same block (common_data or
+								  // pallet_data).
+		uint32_t additional_data_size;
+		FIELD_COMPRESSION storage_type;
+		uint32_t val1;
+		uint32_t val2;
+		uint32_t val3;
+	};
+
+public:
+	WDCFieldDecoder() : m_palletData(nullptr) {}
+
+	//storage info, pallet data and common data follow each other, returns the end of common data
+	const uint8_t* load(const uint8_t* ptr, uint32_t storageInfoSize, uint32_t palletDataSize, uint32_t commonDataSize);
+
+	uint32_t getFieldCount() const { return (uint32_t)m_fieldStorageInfo.size(); }
+	const field_storage_info& getStorageInfo(uint32_t fieldIndex) const { return m_fieldStorageInfo[fieldIndex]; }
+
+	//one element of a field, id is the record id for common data, BITPACKED_SIGNED values are sign extended to 64 bits
+	bool readFieldValue(const uint8_t* recordOffset, uint32_t id, uint32_t fieldIndex, uint32_t arrayIndex, uint32_t arraySize, uint64_t& result) const;
+
+	//id field of a table without id list
+	bool readID(const uint8_t* recordOffset, uint32_t fieldIndex, uint32_t& id) const;
+
+	//sizeBits (up to 64) bits at offsetBits of the record, signed values are sign extended to 64 bits
+	static uint64_t readBits(const uint8_t* recordOffset, uint32_t offsetBits, uint32_t sizeBits, bool isSigned);
+
+private:
+	uint64_t readBitpackedValue(const field_storage_info& info, const uint8_t* recordOffset) const;
+
+private:
+	std::vector<field_storage_info> m_fieldStorageInfo;
+
+	const uint8_t* m_palletData;
+	std::map<uint32_t, uint32_t> m_palletBlockOffsets;
+	std::map<uint32_t, std::map<uint32_t, uint32_t> > m_commonData;
+};
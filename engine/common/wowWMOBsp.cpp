@@ -0,0 +1,365 @@
+#include "wowWMOBsp.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#define WMOBSP_LEAF		0xffff
+#define WMOBSP_NONE		0xffff
+#define WMOBSP_STACK_SIZE		64
+
+static float getAxis(const vector3df& v, uint32_t axis)
+{
+	return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+//earliest t in [0, best] at which the sphere start + dir * t touches the triangle: face, then edges and corners
+static bool sweepSphereTriangle(const vector3df& start, const vector3df& dir, float radius, const vector3df* v, float& best)
+{
+	const float radiusSQ = radius * radius;
+	if (wowCollisionBVH::getClosestPointOnTriangle(start, v).getDistanceFromSQ(start) <= radiusSQ)
+	{
+		best = 0.0f;
+		return true;
+	}
+
+	vector3df normal = (v[1] - v[0]).crossProduct(v[2] - v[0]);
+	const float lengthSQ = normal.squareMagnitude();
+	if (lengthSQ > 1e-12f)
+	{
+		normal /= sqrtf(lengthSQ);
+		float dist = normal.dotProduct(start - v[0]);
+		const float side = dist < 0.0f ? -1.0f : 1.0f;
+		dist *= side;
+
+		//the plane is reached first, if the contact point is inside nothing is earlier
+		//a sphere already cutting the plane beside the triangle (t < 0) is left to the edges and corners
+		const float denom = normal.dotProduct(dir) * side;
+		const float t = denom < 0.0f ? (dist - radius) / -denom : -1.0f;
+		if (t >= 0.0f)
+		{
+			const vector3df p = start + dir * t - normal * (radius * side);
+			if ((v[1] - v[0]).crossProduct(p - v[0]).dotProduct(normal) >= 0.0f &&
+				(v[2] - v[1]).crossProduct(p - v[1]).dotProduct(normal) >= 0.0f &&
+				(v[0] - v[2]).crossProduct(p - v[2]).dotProduct(normal) >= 0.0f)
+			{
+				if (t > best)
+					return false;
+				best = t;
+				return true;
+			}
+		}
+	}
+
+	bool found = false;
+	const float dd = dir.dotProduct(dir);
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		//edge cylinder
+		const vector3df e = v[(i + 1) % 3] - v[i];
+		const vector3df m = start - v[i];
+		const float ee = e.dotProduct(e);
+		const float ed = e.dotProduct(dir);
+		const float em = e.dotProduct(m);
+		const float a = ee * dd - ed * ed;
+		if (ee > 1e-12f && a > 1e-12f)
+		{
+			const float b = ee * m.dotProduct(dir) - em * ed;
+			const float c = ee * (m.dotProduct(m) - radiusSQ) - em * em;
+			const float disc = b * b - a * c;
+			if (disc >= 0.0f)
+			{
+				const float t = (-b - sqrtf(disc)) / a;
+				const float s = (em + t * ed) / ee;
+				if (t >= 0.0f && t <= best && s >= 0.0f && s <= 1.0f)
+				{
+					best = t;
+					found = true;
+				}
+			}
+		}
+
+		//corner sphere
+		const float b = m.dotProduct(dir);
+		const float c = m.dotProduct(m) - radiusSQ;
+		const float disc = b * b - dd * c;
+		if (dd > 1e-12f && disc >= 0.0f)
+		{
+			const float t = (-b - sqrtf(disc)) / dd;
+			if (t >= 0.0f && t <= best)
+			{
+				best = t;
+				found = true;
+			}
+		}
+	}
+	return found;
+}
+
+bool wowWMOBsp::load(const WMO::wmoBspNode* nodes, uint32_t numNodes, const uint16_t* faces, uint32_t numFaces,
+	const uint16_t* indices, uint32_t numIndices, uint32_t numVertices)
+{
+	clear();
+	if (numNodes == 0 || numNodes >= WMOBSP_NONE || numVertices == 0)
+		return false;
+	numFaces = std::min<uint32_t>(numFaces, 65536);
+
+	//file axes are x, y, z up, wmo space swaps y and z as WMO::fixCoordinate
+	Nodes.resize(numNodes);
+	for (uint32_t i = 0; i < numNodes; ++i)
+	{
+		const WMO::wmoBspNode& node = nodes[i];
+		SNode& n = Nodes[i];
+		n.Distance = node.distance;
+		if (node.planetype & 4)
+		{
+			const uint32_t first = std::min<uint32_t>(node.firstface, numFaces);
+			n.Axis = WMOBSP_LEAF;
+			n.Data[0] = (uint16_t)first;
+			n.Data[1] = (uint16_t)std::min<uint32_t>(node.numfaces, numFaces - first);
+		}
+		else
+		{
+			//children are after their parent, which also rules out cycles
+			static const uint16_t axes[3] = { 0, 2, 1 };
+			n.Axis = axes[std::min<uint16_t>(node.planetype, 2)];
+			for (uint32_t k = 0; k < 2; ++k)
+				n.Data[k] = ((int32_t)node.children[k] > (int32_t)i && (uint32_t)node.children[k] < numNodes) ? (uint16_t)node.children[k] : WMOBSP_NONE;
+		}
+	}
+
+	//triangles out of range are left degenerate, no ray or sphere hits them
+	Faces.assign(faces, faces + numFaces);
+	Indices.resize(numFaces * 3);
+	for (uint32_t i = 0; i < numFaces; ++i)
+	{
+		const uint32_t k = faces[i] * 3;
+		const bool valid = k + 2 < numIndices && indices[k] < numVertices && indices[k + 1] < numVertices && indices[k + 2] < numVertices;
+		for (uint32_t j = 0; j < 3; ++j)
+			Indices[i * 3 + j] = valid ? indices[k + j] : 0;
+	}
+
+	return true;
+}
+
+void wowWMOBsp::clear()
+{
+	Nodes.clear();
+	Faces.clear();
+	Indices.clear();
+}
+
+void wowWMOBsp::remapVertices(uint16_t vertexStart, uint16_t vertexEnd, const std::vector<uint16_t>& remap)
+{
+	for (uint16_t& v : Indices)
+	{
+		if (v >= vertexStart && v <= vertexEnd)
+			v = remap[v - vertexStart];
+	}
+}
+
+int32_t wowWMOBsp::findLeaf(const vector3df& pos) const
+{
+	if (Nodes.empty())
+		return -1;
+
+	uint32_t nodeIndex = 0;
+	for (uint32_t depth = 0; depth < (uint32_t)Nodes.size(); ++depth)
+	{
+		const SNode& node = Nodes[nodeIndex];
+		if (node.Axis == WMOBSP_LEAF)
+			return (int32_t)nodeIndex;
+
+		const uint16_t child = node.Data[getAxis(pos, node.Axis) < node.Distance ? 0 : 1];
+		if (child == WMOBSP_NONE)
+			return -1;
+		nodeIndex = child;
+	}
+	return -1;
+}
+
+bool wowWMOBsp::rayCast(const SVertex_PNCT2* vertices, const vector3df& start, const vector3df& dir, float maxDistance, SCollisionHit& hit) const
+{
+	if (Nodes.empty())
+		return false;
+
+	struct SEntry
+	{
+		uint32_t	node;
+		float	tmin;
+		float	tmax;
+	};
+
+	float best = maxDistance;
+	bool found = false;
+
+	//front to back, the ray interval is split at each plane
+	SEntry stack[WMOBSP_STACK_SIZE];
+	uint32_t top = 0;
+	SEntry entry = { 0, 0.0f, maxDistance };
+	for (;;)
+	{
+		const SNode& node = Nodes[entry.node];
+		if (node.Axis == WMOBSP_LEAF)
+		{
+			for (uint32_t i = node.Data[0]; i < (uint32_t)node.Data[0] + node.Data[1]; ++i)
+			{
+				vector3df v[3];
+				getTriangle(vertices, i, v);
+
+				float t;
+				if (wowCollisionBVH::intersectRayTriangle(start, dir, v, t) && t >= 0.0f && t <= best)
+				{
+					best = t;
+					hit.Distance = t;
+					hit.Triangle = Faces[i];
+					found = true;
+				}
+			}
+		}
+		else
+		{
+			const float s = getAxis(start, node.Axis);
+			const float d = getAxis(dir, node.Axis);
+			const uint32_t nearSide = (s < node.Distance || (s == node.Distance && d < 0.0f)) ? 0 : 1;
+			const uint16_t nearChild = node.Data[nearSide];
+			const uint16_t farChild = node.Data[1 - nearSide];
+			const float t = d != 0.0f ? (node.Distance - s) / d : -1.0f;
+
+			uint16_t next = WMOBSP_NONE;
+			if (t < 0.0f || t > entry.tmax)
+			{
+				next = nearChild;
+			}
+			else if (t < entry.tmin)
+			{
+				next = farChild;
+			}
+			else
+			{
+				ASSERT(top < WMOBSP_STACK_SIZE);
+				if (farChild != WMOBSP_NONE && top < WMOBSP_STACK_SIZE)
+				{
+					SEntry farEntry = { farChild, t, entry.tmax };
+					stack[top++] = farEntry;
+				}
+				next = nearChild;
+				entry.tmax = t;
+			}
+
+			if (next != WMOBSP_NONE)
+			{
+				entry.node = next;
+				continue;
+			}
+		}
+
+		//the far sides start beyond the nearest hit
+		do
+		{
+			if (top == 0)
+				return found;
+			entry = stack[--top];
+		} while (entry.tmin > best);
+	}
+}
+
+bool wowWMOBsp::rayCastBruteForce(const SVertex_PNCT2* vertices, const vector3df& start, const vector3df& dir, float maxDistance, SCollisionHit& hit) const
+{
+	float best = maxDistance;
+	bool found = false;
+	for (uint32_t i = 0; i < (uint32_t)Faces.size(); ++i)
+	{
+		vector3df v[3];
+		getTriangle(vertices, i, v);
+
+		float t;
+		if (wowCollisionBVH::intersectRayTriangle(start, dir, v, t) && t >= 0.0f && t <= best)
+		{
+			best = t;
+			hit.Distance = t;
+			hit.Triangle = Faces[i];
+			found = true;
+		}
+	}
+	return found;
+}
+
+bool wowWMOBsp::sweepSphere(const SVertex_PNCT2* vertices, const vector3df& start, const vector3df& dir, float maxDistance, float radius, SCollisionHit& hit) const
+{
+	if (Nodes.empty())
+		return false;
+
+	//nodes are visited on the sides the swept box reaches
+	aabbox3df box;
+	box.setByMinMax(start, start);
+	box.addInternalPoint(start + dir * maxDistance);
+	box.MinEdge -= vector3df(radius, radius, radius);
+	box.MaxEdge += vector3df(radius, radius, radius);
+
+	float best = maxDistance;
+	bool found = false;
+
+	uint16_t stack[WMOBSP_STACK_SIZE];
+	uint32_t top = 0;
+	uint16_t nodeIndex = 0;
+	for (;;)
+	{
+		const SNode& node = Nodes[nodeIndex];
+		if (node.Axis == WMOBSP_LEAF)
+		{
+			for (uint32_t i = node.Data[0]; i < (uint32_t)node.Data[0] + node.Data[1]; ++i)
+			{
+				vector3df v[3];
+				getTriangle(vertices, i, v);
+
+				if (sweepSphereTriangle(start, dir, radius, v, best))
+				{
+					hit.Distance = best;
+					hit.Triangle = Faces[i];
+					found = true;
+				}
+			}
+		}
+		else
+		{
+			const uint16_t below = getAxis(box.MinEdge, node.Axis) < node.Distance ? node.Data[0] : WMOBSP_NONE;
+			const uint16_t above = getAxis(box.MaxEdge, node.Axis) >= node.Distance ? node.Data[1] : WMOBSP_NONE;
+			ASSERT(top < WMOBSP_STACK_SIZE);
+			if (below != WMOBSP_NONE && above != WMOBSP_NONE && top < WMOBSP_STACK_SIZE)
+				stack[top++] = above;
+
+			const uint16_t next = below != WMOBSP_NONE ? below : above;
+			if (next != WMOBSP_NONE)
+			{
+				nodeIndex = next;
+				continue;
+			}
+		}
+
+		if (top == 0)
+			break;
+		nodeIndex = stack[--top];
+	}
+
+	return found;
+}
+
+bool wowWMOBsp::sweepSphereBruteForce(const SVertex_PNCT2* vertices, const vector3df& start, const vector3df& dir, float maxDistance, float radius, SCollisionHit& hit) const
+{
+	float best = maxDistance;
+	bool found = false;
+	for (uint32_t i = 0; i < (uint32_t)Faces.size(); ++i)
+	{
+		vector3df v[3];
+		getTriangle(vertices, i, v);
+
+		if (sweepSphereTriangle(start, dir, radius, v, best))
+		{
+			hit.Distance = best;
+			hit.Triangle = Faces[i];
+			found = true;
+		}
+	}
+	return found;
+}
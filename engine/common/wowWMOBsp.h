@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "vector3d.h"
+#include "aabbox3d.h"
+#include "S3DVertex.h"
+#include "wowWMOStruct.h"
+#include "wowCollisionBVH.h"
+
+//collision bsp of a wmo group from MOBN and MOBR, axis aligned planes with triangles at the leaves
+//triangles are vertex index triples of the group, queries take the group vertices and are in wmo space
+class wowWMOBsp
+{
+public:
+	wowWMOBsp() {}
+
+public:
+	//faces index the triangles of indices, nodes and faces out of range are dropped
+	bool load(const WMO::wmoBspNode* nodes, uint32_t numNodes, const uint16_t* faces, uint32_t numFaces,
+		const uint16_t* indices, uint32_t numIndices, uint32_t numVertices);
+	void clear();
+
+	//follows the vertex renumbering of wowMeshOptimizer::optimizeVertexFetch
+	void remapVertices(uint16_t vertexStart, uint16_t vertexEnd, const std::vector<uint16_t>& remap);
+
+	bool empty() const { return Nodes.empty(); }
+	uint32_t getNumNodes() const { return (uint32_t)Nodes.size(); }
+	uint32_t getNumFaces() const { return (uint32_t)Faces.size(); }
+
+	//leaf node around the point, -1 when the point falls into an empty side
+	int32_t findLeaf(const vector3df& pos) const;
+
+	//nearest triangle hit by start + dir * t, 0 <= t <= maxDistance, hit.Triangle is the triangle number in the file
+	bool rayCast(const SVertex_PNCT2* vertices, const vector3df& start, const vector3df& dir, float maxDistance, SCollisionHit& hit) const;
+	bool rayCastBruteForce(const SVertex_PNCT2* vertices, const vector3df& start, const vector3df& dir, float maxDistance, SCollisionHit& hit) const;
+
+	//first contact of a sphere moved from start along dir, same units as rayCast, 0 if it touches at start
+	bool sweepSphere(const SVertex_PNCT2* vertices, const vector3df& start, const vector3df& dir, float maxDistance, float radius, SCollisionHit& hit) const;
+	bool sweepSphereBruteForce(const SVertex_PNCT2* vertices, const vector3df& start, const vector3df& dir, float maxDistance, float radius, SCollisionHit& hit) const;
+
+private:
+	//inner nodes have the children below and above Distance in Data, leaves the first face and the face count
+	struct SNode
+	{
+		float		Distance;
+		uint16_t	Axis;
+		uint16_t	Data[2];
+	};
+
+	void getTriangle(const SVertex_PNCT2* vertices, uint32_t ref, vector3df* v) const
+	{
+		v[0] = vertices[Indices[ref * 3]].Pos;
+		v[1] = vertices[Indices[ref * 3 + 1]].Pos;
+		v[2] = vertices[Indices[ref * 3 + 2]].Pos;
+	}
+
+private:
+	std::vector<SNode>		Nodes;
+	std::vector<uint16_t>		Faces;			//leaf face lists, MOBR
+	std::vector<uint16_t>		Indices;			//vertices of each entry of Faces, 3 per entry
+};
@@ -4,6 +4,15 @@
 #include "function.h"
 
 #include "wowEnvironment.h"
+#include "wowMeshOptimizer.h"
+#include "CSysThread.h"
+#include "CSysSync.h"
+#include <algorithm>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define WMOFILE_USE_SSE
+#include <xmmintrin.h>
+#endif
 
 wowWMOFile::wowWMOFile(const wowEnvironment* wowEnv)
 	: WowEnvironment(wowEnv)
@@ -14,7 +23,7 @@ wowWMOFile::~wowWMOFile()
 {
 }
 
-bool wowWMOFile::loadFile(const char* filename)
+bool wowWMOFile::loadFile(const char* filename, uint32_t numThreads)
 {
 	CMemFile* memFile = WowEnvironment->openFile(filename);
 	if (!memFile)
@@ -97,6 +106,8 @@ bool wowWMOFile::loadFile(const char* filename)
 				GroupList[i].index = i;
 				GroupList[i].flags = g.flags;
 				GroupList[i].box.setByMinMax(WMO::fixCoordinate(g.min), WMO::fixCoordinate(g.max));
+				GroupList[i].portalStart = 0;
+				GroupList[i].portalCount = 0;
 				if (g.nameIndex >= 0 && g.nameIndex < (int32_t)GroupNameBlock.size())
 					GroupList[i].name = (const char*)&GroupNameBlock[g.nameIndex];
 			}
@@ -107,15 +118,42 @@ bool wowWMOFile::loadFile(const char* filename)
 		}
 		else if (strcmp(fourcc, "MOPV") == 0)
 		{
-
+			uint32_t nVertices = size / sizeof(vector3df);
+			PortalVertices.resize(nVertices);
+			for (uint32_t i = 0; i < nVertices; ++i)
+			{
+				vector3df v;
+				memFile->read(&v, sizeof(vector3df));
+				PortalVertices[i] = WMO::fixCoordinate(v);
+			}
 		}
 		else if (strcmp(fourcc, "MOPT") == 0)
 		{
+			uint32_t nPortals = size / sizeof(WMO::wmoPortalInfo);
+			PortalList.resize(nPortals);
+			for (uint32_t i = 0; i < nPortals; ++i)
+			{
+				WMO::wmoPortalInfo p;
+				memFile->read(&p, sizeof(WMO::wmoPortalInfo));
 
+				PortalList[i].vStart = p.baseIndex;
+				PortalList[i].vCount = p.numVerts;
+				PortalList[i].plane.setPlane(WMO::fixCoordinate(p.normal), p.d);
+			}
 		}
 		else if (strcmp(fourcc, "MOPR") == 0)
 		{
+			uint32_t nRelations = size / sizeof(WMO::wmoPortalRelation);
+			PortalRelationList.resize(nRelations);
+			for (uint32_t i = 0; i < nRelations; ++i)
+			{
+				WMO::wmoPortalRelation r;
+				memFile->read(&r, sizeof(WMO::wmoPortalRelation));
 
+				PortalRelationList[i].portalIndex = r.portal;
+				PortalRelationList[i].groupIndex = (int16_t)r.group;
+				PortalRelationList[i].face = r.dir > 0;
+			}
 		}
 		else if (strcmp(fourcc, "MOLT") == 0)
 		{
@@ -173,7 +211,10 @@ bool wowWMOFile::loadFile(const char* filename)
 		}
 		else if (strcmp(fourcc, "GFID") == 0)
 		{
-
+			//one id per group for each lod, lod 0 first
+			uint32_t nIds = std::min(size / (uint32_t)sizeof(uint32_t), Header.nGroups);
+			GroupFileIDs.resize(nIds);
+			memFile->read(GroupFileIDs.data(), nIds * sizeof(uint32_t));
 		}
 		else if (strcmp(fourcc, "MODI") == 0)
 		{
@@ -187,42 +228,335 @@ bool wowWMOFile::loadFile(const char* filename)
 		memFile->seek((int32_t)nextpos);
 	}
 
-	//load groups and bounding box
+	delete memFile;
+
+	//load groups, one task per group
+	const uint32_t numGroups = (uint32_t)GroupList.size();
+	std::vector<uint8_t> loaded(numGroups, 0);
+	atomic_type<uint32_t> nextGroup(0);
+	auto worker = [this, numGroups, &loaded, &nextGroup](void*)
+	{
+		while (true)
+		{
+			uint32_t index = nextGroup++;
+			if (index >= numGroups)
+				break;
+
+			loaded[index] = loadGroupFile(GroupList[index]) ? 1 : 0;
+		}
+		return 0;
+	};
+
+	if (numThreads == 0)
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+	numThreads = std::min(numThreads, numGroups);
+
+	if (numThreads <= 1)
+	{
+		worker(nullptr);
+	}
+	else
+	{
+		//the calling thread takes groups too
+		std::vector<thread_type> threads(numThreads - 1);
+		for (uint32_t t = 0; t < numThreads - 1; ++t)
+			INIT_THREAD(&threads[t], worker, nullptr);
+
+		worker(nullptr);
+
+		for (uint32_t t = 0; t < numThreads - 1; ++t)
+		{
+			WAIT_THREAD(&threads[t]);
+			DESTROY_THREAD(&threads[t]);
+		}
+	}
+
+	//bounding box
 	Box.clear();
-	for (SWMOGroup& group : GroupList)
+	for (uint32_t i = 0; i < numGroups; ++i)
 	{
-		if (!loadGroupFile(memFile, group))
+		if (!loaded[i])
 		{
 			ASSERT(false);
 			return false;
 		}
-		Box.addInternalBox(group.box);
+		Box.addInternalBox(GroupList[i].box);
+	}
+
+	loadPortals();
 
-		//group box
-		for (auto& batch : group.batchList)
+	return true;
+}
+
+void wowWMOFile::loadPortals()
+{
+	//portal box, drop portals with vertices out of range
+	for (SWMOPortal& portal : PortalList)
+	{
+		portal.box.clear();
+		if (portal.vStart + portal.vCount > (uint32_t)PortalVertices.size())
 		{
-			batch.box.clear();
-			for (uint32_t k = batch.vertexStart; k <= batch.vertexEnd; ++k)
-			{
-				batch.box.addInternalPoint(group.vertices[k].Pos);
-			}
+			portal.vCount = 0;
+			continue;
 		}
+
+		for (uint32_t k = portal.vStart; k < portal.vStart + portal.vCount; ++k)
+			portal.box.addInternalPoint(PortalVertices[k]);
 	}
 
-	delete memFile;
+	//the relations of each group give the sides of its portals
+	for (const SWMOGroup& group : GroupList)
+	{
+		for (uint32_t i = group.portalStart; i < group.portalStart + group.portalCount && i < (uint32_t)PortalRelationList.size(); ++i)
+		{
+			const SWMOPortalRelation& relation = PortalRelationList[i];
+			if (relation.portalIndex >= (uint16_t)PortalList.size())
+				continue;
+
+			SWMOPortal& portal = PortalList[relation.portalIndex];
+			if (relation.face)
+				portal.frontGroupIndex = (int16_t)group.index;
+			else
+				portal.backGroupIndex = (int16_t)group.index;
+		}
+	}
+}
+
+//slab test of start + dir * t, 0 <= t <= maxDistance
+static bool intersectRayBox(const vector3df& start, const vector3df& dir, float maxDistance, const aabbox3df& box)
+{
+	float tmin = 0.0f;
+	float tmax = maxDistance;
+	for (uint32_t axis = 0; axis < 3; ++axis)
+	{
+		const float s = axis == 0 ? start.x : (axis == 1 ? start.y : start.z);
+		const float d = axis == 0 ? dir.x : (axis == 1 ? dir.y : dir.z);
+		const float bmin = axis == 0 ? box.MinEdge.x : (axis == 1 ? box.MinEdge.y : box.MinEdge.z);
+		const float bmax = axis == 0 ? box.MaxEdge.x : (axis == 1 ? box.MaxEdge.y : box.MaxEdge.z);
+		if (d == 0.0f)
+		{
+			if (s < bmin || s > bmax)
+				return false;
+			continue;
+		}
 
+		float t0 = (bmin - s) / d;
+		float t1 = (bmax - s) / d;
+		if (t0 > t1)
+			std::swap(t0, t1);
+		tmin = std::max(tmin, t0);
+		tmax = std::min(tmax, t1);
+		if (tmin > tmax)
+			return false;
+	}
 	return true;
 }
 
-bool wowWMOFile::loadGroupFile(CMemFile* pMemFile, SWMOGroup& group)
+int32_t wowWMOFile::findGroup(const vector3df& pos) const
+{
+	int32_t group = -1;
+	float floorDistance = FLT_MAX;
+	int32_t boxGroup = -1;
+	float boxVolume = 0;
+	for (uint32_t i = 0; i < (uint32_t)GroupList.size(); ++i)
+	{
+		const SWMOGroup& g = GroupList[i];
+		if (!(g.flags & WMOGROUP_INDOOR) || !g.box.isPointInside(pos))
+			continue;
+
+		//smallest box when no bsp has a floor below
+		const float volume = g.box.getVolume();
+		if (boxGroup == -1 || volume < boxVolume)
+		{
+			boxGroup = (int32_t)i;
+			boxVolume = volume;
+		}
+
+		SCollisionHit hit;
+		if (!g.vertices.empty() &&
+			g.bsp.rayCast(g.vertices.data(), pos, vector3df(0, -1, 0), pos.y - g.box.MinEdge.y, hit) &&
+			hit.Distance < floorDistance)
+		{
+			group = (int32_t)i;
+			floorDistance = hit.Distance;
+		}
+	}
+	return group != -1 ? group : boxGroup;
+}
+
+bool wowWMOFile::rayCast(const vector3df& start, const vector3df& dir, float maxDistance, SCollisionHit& hit, int32_t& group) const
 {
-	char path[QMAX_PATH];
-	getFullFileNameNoExtensionA(this->Name.c_str(), path, QMAX_PATH);
+	bool found = false;
+	for (uint32_t i = 0; i < (uint32_t)GroupList.size(); ++i)
+	{
+		const SWMOGroup& g = GroupList[i];
+		if (g.vertices.empty() || !intersectRayBox(start, dir, maxDistance, g.box))
+			continue;
 
-	char filename[QMAX_PATH];
-	Q_sprintf(filename, QMAX_PATH, "%s_%03d.wmo", path, (int32_t)group.index);
+		if (g.bsp.rayCast(g.vertices.data(), start, dir, maxDistance, hit))
+		{
+			maxDistance = hit.Distance;
+			group = (int32_t)i;
+			found = true;
+		}
+	}
+	return found;
+}
 
-	CMemFile* file = WowEnvironment->openFile(filename);
+bool wowWMOFile::sweepSphere(const vector3df& start, const vector3df& dir, float maxDistance, float radius, SCollisionHit& hit, int32_t& group) const
+{
+	aabbox3df box;
+	box.setByMinMax(start, start);
+	box.addInternalPoint(start + dir * maxDistance);
+	box.MinEdge -= vector3df(radius, radius, radius);
+	box.MaxEdge += vector3df(radius, radius, radius);
+
+	bool found = false;
+	for (uint32_t i = 0; i < (uint32_t)GroupList.size(); ++i)
+	{
+		const SWMOGroup& g = GroupList[i];
+		if (g.vertices.empty() || !g.box.intersectsWithBox(box))
+			continue;
+
+		if (g.bsp.sweepSphere(g.vertices.data(), start, dir, maxDistance, radius, hit))
+		{
+			maxDistance = hit.Distance;
+			group = (int32_t)i;
+			found = true;
+		}
+	}
+	return found;
+}
+
+//triangles of each batch in vertex cache order, vertices of each batch in first use order
+static void optimizeGroupIndices(SWMOGroup& group)
+{
+	const uint32_t numIndices = (uint32_t)group.indices.size();
+	const uint32_t numVertices = (uint32_t)group.vertices.size();
+
+	std::vector<const SWMOBatch*> batches;
+	for (const SWMOBatch& batch : group.batchList)
+	{
+		if (batch.indexStart + batch.indexCount > numIndices || batch.vertexEnd >= numVertices || batch.vertexStart > batch.vertexEnd)
+			return;
+
+		wowMeshOptimizer::optimizeVertexCache(&group.indices[batch.indexStart], batch.indexCount);
+		batches.push_back(&batch);
+	}
+
+	//vertices are only moved when no two batches share them
+	std::sort(batches.begin(), batches.end(), [](const SWMOBatch* a, const SWMOBatch* b) { return a->vertexStart < b->vertexStart; });
+	for (size_t i = 1; i < batches.size(); ++i)
+	{
+		if (batches[i]->vertexStart <= batches[i - 1]->vertexEnd)
+			return;
+	}
+
+	std::vector<uint16_t> remap;
+	std::vector<SVertex_PNCT2> vertices;
+	for (const SWMOBatch* batch : batches)
+	{
+		const uint32_t indexEnd = batch->indexStart + batch->indexCount;
+		wowMeshOptimizer::optimizeVertexFetch(&group.indices[batch->indexStart], batch->indexCount, batch->vertexStart, batch->vertexEnd, remap);
+
+		//triangles outside the batch, such as collision ones, can use the same vertices
+		for (uint32_t i = 0; i < numIndices; ++i)
+		{
+			const uint16_t v = group.indices[i];
+			if ((i < batch->indexStart || i >= indexEnd) && v >= batch->vertexStart && v <= batch->vertexEnd)
+				group.indices[i] = remap[v - batch->vertexStart];
+		}
+		group.bsp.remapVertices(batch->vertexStart, batch->vertexEnd, remap);
+
+		vertices.assign(group.vertices.begin() + batch->vertexStart, group.vertices.begin() + batch->vertexEnd + 1);
+		for (uint32_t k = 0; k < (uint32_t)vertices.size(); ++k)
+			group.vertices[remap[k]] = vertices[k];
+	}
+}
+
+//file vectors to the vertex member at dst, y and z swapped as WMO::fixCoordinate, stride is sizeof(SVertex_PNCT2)
+//src is the chunk payload and may be unaligned
+static void convertVectors(const uint8_t* src, vector3df* dst, uint32_t count, bool normalize)
+{
+	const uint32_t stride = sizeof(SVertex_PNCT2);
+	uint8_t* out = reinterpret_cast<uint8_t*>(dst);
+	uint32_t i = 0;
+
+#ifdef WMOFILE_USE_SSE
+	//4 vectors are 3 loads, transposed to x, y, z lanes
+	const __m128 minLengthSQ = _mm_set1_ps(ROUNDING_ERROR_f32);
+	const __m128 one = _mm_set1_ps(1.0f);
+	for (; i + 4 <= count; i += 4)
+	{
+		const float* f = reinterpret_cast<const float*>(src + i * sizeof(vector3df));
+		const __m128 a = _mm_loadu_ps(f);				//x0 y0 z0 x1
+		const __m128 b = _mm_loadu_ps(f + 4);			//y1 z1 x2 y2
+		const __m128 c = _mm_loadu_ps(f + 8);			//z2 x3 y3 z3
+
+		__m128 x = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+		__m128 y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+
+		if (normalize)
+		{
+			//zero vectors are kept
+			const __m128 lengthSQ = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+			const __m128 valid = _mm_cmpgt_ps(lengthSQ, minLengthSQ);
+			const __m128 scale = _mm_or_ps(_mm_and_ps(valid, _mm_div_ps(one, _mm_sqrt_ps(lengthSQ))), _mm_andnot_ps(valid, one));
+			x = _mm_mul_ps(x, scale);
+			y = _mm_mul_ps(y, scale);
+			z = _mm_mul_ps(z, scale);
+		}
+
+		float xs[4], ys[4], zs[4];
+		_mm_storeu_ps(xs, x);
+		_mm_storeu_ps(ys, y);
+		_mm_storeu_ps(zs, z);
+		for (uint32_t k = 0; k < 4; ++k)
+		{
+			vector3df* v = reinterpret_cast<vector3df*>(out + (i + k) * stride);
+			v->set(xs[k], zs[k], ys[k]);
+		}
+	}
+#endif
+
+	for (; i < count; ++i)
+	{
+		vector3df tmp;
+		memcpy(&tmp, src + i * sizeof(vector3df), sizeof(vector3df));
+		vector3df* v = reinterpret_cast<vector3df*>(out + i * stride);
+		*v = WMO::fixCoordinate(tmp);
+		if (normalize)
+			v->normalize();
+	}
+}
+
+//chunk payload to the vertex member at dst, stride is sizeof(SVertex_PNCT2)
+template <class T>
+static void copyToVertices(const uint8_t* src, T* dst, uint32_t count)
+{
+	uint8_t* out = reinterpret_cast<uint8_t*>(dst);
+	for (uint32_t i = 0; i < count; ++i)
+		memcpy(out + i * sizeof(SVertex_PNCT2), src + i * sizeof(T), sizeof(T));
+}
+
+bool wowWMOFile::loadGroupFile(SWMOGroup& group) const
+{
+	//by file id when the root has GFID, by name otherwise
+	CMemFile* file = nullptr;
+	if (group.index < (uint32_t)GroupFileIDs.size() && GroupFileIDs[group.index] != 0)
+		file = WowEnvironment->openFileById(GroupFileIDs[group.index]);
+
+	if (!file)
+	{
+		char path[QMAX_PATH];
+		getFullFileNameNoExtensionA(this->Name.c_str(), path, QMAX_PATH);
+
+		char filename[QMAX_PATH];
+		Q_sprintf(filename, QMAX_PATH, "%s_%03d.wmo", path, (int32_t)group.index);
+
+		file = WowEnvironment->openFile(filename);
+	}
 	if (!file)
 		return false;
 
@@ -232,6 +566,8 @@ bool wowWMOFile::loadGroupFile(CMemFile* pMemFile, SWMOGroup& group)
 	uint32_t size;
 
 	uint32_t nTcoords = 0;
+	std::vector<WMO::wmoBspNode> bspNodes;
+	std::vector<uint16_t> bspFaces;
 
 	while (!file->isEof())
 	{
@@ -246,6 +582,11 @@ bool wowWMOFile::loadGroupFile(CMemFile* pMemFile, SWMOGroup& group)
 
 		uint32_t nextpos = file->getPos() + size;
 
+		//payload of the vertex chunks, read in place
+		const uint8_t* data = file->getPointer();
+		if (nextpos > file->getSize())
+			size = file->getSize() - file->getPos();
+
 		if (strcmp(fourcc, "MVER") == 0)				//version
 		{
 			uint32_t version;
@@ -257,6 +598,9 @@ bool wowWMOFile::loadGroupFile(CMemFile* pMemFile, SWMOGroup& group)
 			size = sizeof(WMO::wmoGroupHeader);
 			nextpos = file->getPos() + size;
 			file->read(&header, sizeof(WMO::wmoGroupHeader));
+
+			group.portalStart = header.portalStart;
+			group.portalCount = header.portalCount;
 		}
 		else if (strcmp(fourcc, "MOPY") == 0)
 		{
@@ -272,47 +616,24 @@ bool wowWMOFile::loadGroupFile(CMemFile* pMemFile, SWMOGroup& group)
 		{
 			uint32_t vcount = size / sizeof(vector3df);
 			group.vertices.resize(vcount);
-			for (uint32_t i = 0; i < vcount; ++i)
-			{
-				vector3df tmp;
-				file->read(&tmp, sizeof(vector3df));
-				group.vertices[i].Pos = WMO::fixCoordinate(tmp);
-			}
+			if (vcount)
+				convertVectors(data, &group.vertices[0].Pos, vcount, false);
 		}
 		else if (strcmp(fourcc, "MONR") == 0)
 		{
 			uint32_t vcount = (uint32_t)group.vertices.size();
 			ASSERT(size == vcount * sizeof(vector3df));
-			for (uint32_t i = 0; i < vcount; ++i)
-			{
-				vector3df tmp;
-				file->read(&tmp, sizeof(vector3df));
-				group.vertices[i].Normal = WMO::fixCoordinate(tmp);
-				group.vertices[i].Normal.normalize();
-			}
+			vcount = std::min(vcount, size / (uint32_t)sizeof(vector3df));
+			if (vcount)
+				convertVectors(data, &group.vertices[0].Normal, vcount, true);
 		}
 		else if (strcmp(fourcc, "MOTV") == 0)
 		{
 			uint32_t vcount = (uint32_t)group.vertices.size();
 			ASSERT(size == vcount * sizeof(vector2df));
-			if (nTcoords == 0)
-			{
-				for (uint32_t i = 0; i < vcount; ++i)
-				{
-					vector2df tmp;
-					file->read(&tmp, sizeof(vector2df));
-					group.vertices[i].TCoords0 = tmp;
-				}
-			}
-			else
-			{
-				for (uint32_t i = 0; i < vcount; ++i)
-				{
-					vector2df tmp;
-					file->read(&tmp, sizeof(vector2df));
-					group.vertices[i].TCoords1 = tmp;
-				}
-			}
+			vcount = std::min(vcount, size / (uint32_t)sizeof(vector2df));
+			if (vcount)
+				copyToVertices(data, nTcoords == 0 ? &group.vertices[0].TCoords0 : &group.vertices[0].TCoords1, vcount);
 			++nTcoords;
 			ASSERT(nTcoords <= 2);
 		}
@@ -321,12 +642,9 @@ bool wowWMOFile::loadGroupFile(CMemFile* pMemFile, SWMOGroup& group)
 			group.hasVertexColor = true;
 			uint32_t vcount = (uint32_t)group.vertices.size();
 			ASSERT(size == vcount * sizeof(SColor));
-			for (uint32_t i = 0; i < vcount; ++i)
-			{
-				SColor color;
-				file->read(&color, sizeof(SColor));
-				group.vertices[i].Color = color;
-			}
+			vcount = std::min(vcount, size / (uint32_t)sizeof(SColor));
+			if (vcount)
+				copyToVertices(data, &group.vertices[0].Color, vcount);
 		}
 		else if (strcmp(fourcc, "MOBA") == 0)
 		{
@@ -360,11 +678,15 @@ bool wowWMOFile::loadGroupFile(CMemFile* pMemFile, SWMOGroup& group)
 		}
 		else if (strcmp(fourcc, "MOBN") == 0)			//bsp node
 		{
-
+			uint32_t nNodes = (uint32_t)(size / sizeof(WMO::wmoBspNode));
+			bspNodes.resize(nNodes);
+			file->read(bspNodes.data(), nNodes * sizeof(WMO::wmoBspNode));
 		}
 		else if (strcmp(fourcc, "MOBR") == 0)				//bsp triangle
 		{
-
+			uint32_t nFaces = (uint32_t)(size / sizeof(uint16_t));
+			bspFaces.resize(nFaces);
+			file->read(bspFaces.data(), nFaces * sizeof(uint16_t));
 		}
 		else if (strcmp(fourcc, "MLIQ") == 0)
 		{
@@ -392,5 +714,26 @@ bool wowWMOFile::loadGroupFile(CMemFile* pMemFile, SWMOGroup& group)
 
 	delete file;
 
+	//the bsp keeps its own triangles, they follow the vertex renumbering of the optimizer
+	group.bsp.clear();
+	if (!bspNodes.empty())
+	{
+		group.bsp.load(bspNodes.data(), (uint32_t)bspNodes.size(), bspFaces.data(), (uint32_t)bspFaces.size(),
+			group.indices.data(), (uint32_t)group.indices.size(), (uint32_t)group.vertices.size());
+	}
+
+	if (wowMeshOptimizer::isEnabled())
+		optimizeGroupIndices(group);
+
+	//batch box
+	for (auto& batch : group.batchList)
+	{
+		batch.box.clear();
+		for (uint32_t k = batch.vertexStart; k <= batch.vertexEnd && k < (uint32_t)group.vertices.size(); ++k)
+		{
+			batch.box.addInternalPoint(group.vertices[k].Pos);
+		}
+	}
+
 	return true;
 }
@@ -8,10 +8,14 @@
 #include "S3DVertex.h"
 #include "aabbox3d.h"
 #include "wowWMOStruct.h"
+#include "wowWMOBsp.h"
 
 class CMemFile;
 class wowEnvironment;
 
+#define WMOGROUP_OUTDOOR		0x8
+#define WMOGROUP_INDOOR		0x2000
+
 enum class E_WMO_SHADER : int
 {
 	Diffuse = 0,
@@ -68,8 +72,8 @@ struct SWMOPortal
 struct SWMOPortalRelation
 {
 	uint16_t portalIndex;
-	int16_t groupIndex;
-	bool face;
+	int16_t groupIndex;			//group on the other side of the portal
+	bool face;			//the owning group is in front of the portal plane
 };
 
 struct SWMOLight
@@ -117,24 +121,13 @@ struct SWMOBatch
 	uint16_t getVertexCount() const { return vertexEnd - vertexStart + 1; }
 };
 
-struct SWMOBspNode
-{
-	uint16_t planetype;		//4: leaf, 0 for YZ-plane, 1 for XZ-plane, 2 for XY-plane?
-	int16_t left;
-	int16_t right;
-	uint16_t numfaces;
-	uint16_t firstface;
-	float distance;
-	uint16_t startIndex;
-	uint16_t minVertex;
-	uint16_t maxVertex;
-};
-
 struct SWMOGroup
 {
 	uint32_t		index;
 	uint32_t		flags;
 	aabbox3df		box;
+	uint16_t		portalStart;			//relations of the group in PortalRelationList
+	uint16_t		portalCount;
 	bool	hasVertexColor;
 	std::string			name;
 	std::vector<SWMOBatch>	batchList;
@@ -142,6 +135,7 @@ struct SWMOGroup
 	std::vector<SVertex_PNCT2>	vertices;
 	std::vector<uint16_t>	lightList;
 	std::vector<uint16_t>	doodadList;
+	wowWMOBsp	bsp;
 };
 
 class wowWMOFile
@@ -151,8 +145,17 @@ public:
 	~wowWMOFile();
 
 public:
-	bool loadFile(const char* filename);
-	bool loadGroupFile(CMemFile* pMemFile, SWMOGroup& group);
+	//groups are loaded on numThreads threads, 0 for hardware concurrency
+	bool loadFile(const char* filename, uint32_t numThreads = 0);
+	//reads group.index and fills the rest of group, safe to call for different groups at once
+	bool loadGroupFile(SWMOGroup& group) const;
+
+	//indoor group around the point, between overlapping boxes the one with the nearest bsp floor below, -1 for none
+	int32_t findGroup(const vector3df& pos) const;
+
+	//nearest hit over the group bsps, hit.Triangle is the triangle number in that group
+	bool rayCast(const vector3df& start, const vector3df& dir, float maxDistance, SCollisionHit& hit, int32_t& group) const;
+	bool sweepSphere(const vector3df& start, const vector3df& dir, float maxDistance, float radius, SCollisionHit& hit, int32_t& group) const;
 
 public:
 	WMO::wmoHeader		Header;
@@ -162,13 +165,21 @@ public:
 
 	std::vector<SWMOMaterial>	MaterialList;
 	std::vector<SWMOGroup>		GroupList;
+	std::vector<uint32_t>		GroupFileIDs;			//per group, 0 if the group is opened by name
 	std::vector<SWMOLight>		LightList;
 	std::vector<SWMODoodadSet>	DoodadSets;
 	std::vector<SWMOFog>	FogList;
 
+	std::vector<vector3df>		PortalVertices;
+	std::vector<SWMOPortal>		PortalList;
+	std::vector<SWMOPortalRelation>	PortalRelationList;
+
 	std::vector<char>		TextureFileNameBlock;
 	std::vector<char>		GroupNameBlock;
 
+private:
+	void loadPortals();
+
 private:
 	const wowEnvironment* WowEnvironment;
 };
\ No newline at end of file
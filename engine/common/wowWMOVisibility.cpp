@@ -0,0 +1,224 @@
+#include "wowWMOVisibility.h"
+
+#include "wowWMOFile.h"
+#include <cmath>
+
+#define WMO_PORTAL_MAX_DEPTH		32
+#define WMO_PORTAL_EPSILON		0.01f
+
+wowWMOVisibility::wowWMOVisibility(const wowWMOFile* wmoFile)
+	: WmoFile(wmoFile), CameraGroup(-1)
+{
+}
+
+void wowWMOVisibility::update(const vector3df& camPos, const frustum& viewFrustum)
+{
+	const std::vector<SWMOGroup>& groupList = WmoFile->GroupList;
+	const uint32_t numGroups = (uint32_t)groupList.size();
+
+	CamPos = camPos;
+	FarPlane = viewFrustum.getPlane(frustum::VF_FAR);
+
+	VisibleGroups.clear();
+	GroupVisible.assign(numGroups, 0);
+	GroupInPath.assign(numGroups, 0);
+	BatchOffsets.resize(numGroups);
+	uint32_t numBatches = 0;
+	for (uint32_t i = 0; i < numGroups; ++i)
+	{
+		BatchOffsets[i] = numBatches;
+		numBatches += (uint32_t)groupList[i].batchList.size();
+	}
+	BatchVisible.assign(numBatches, 0);
+
+	//the near plane is left out, a portal closer than it still leads on
+	T_Planes planes;
+	for (int i = 0; i < frustum::VF_PLANE_COUNT; ++i)
+	{
+		if (i != frustum::VF_NEAR)
+			planes.push_back(viewFrustum.getPlane(i));
+	}
+
+	CameraGroup = WmoFile->findGroup(camPos);
+
+	if (WmoFile->PortalList.empty())
+	{
+		for (uint32_t i = 0; i < numGroups; ++i)
+			addGroup(i, planes);
+		return;
+	}
+
+	if (CameraGroup >= 0)
+	{
+		traverse((uint32_t)CameraGroup, planes, 0);
+		return;
+	}
+
+	//from outside, the outdoor groups are seen directly and the rest through their portals
+	bool hasOutdoor = false;
+	for (uint32_t i = 0; i < numGroups; ++i)
+	{
+		if (groupList[i].flags & WMOGROUP_OUTDOOR)
+		{
+			hasOutdoor = true;
+			traverse(i, planes, 0);
+		}
+	}
+
+	if (!hasOutdoor)
+	{
+		for (uint32_t i = 0; i < numGroups; ++i)
+			addGroup(i, planes);
+	}
+}
+
+uint32_t wowWMOVisibility::getNumVisibleBatches() const
+{
+	uint32_t count = 0;
+	for (uint8_t v : BatchVisible)
+		count += v;
+	return count;
+}
+
+void wowWMOVisibility::addGroup(uint32_t group, const T_Planes& planes)
+{
+	const SWMOGroup& g = WmoFile->GroupList[group];
+	if (!isInPlanes(g.box, planes))
+		return;
+
+	if (!GroupVisible[group])
+	{
+		GroupVisible[group] = 1;
+		VisibleGroups.push_back(group);
+	}
+
+	//a group seen through several portals has the batches of each view
+	uint8_t* batchVisible = &BatchVisible[BatchOffsets[group]];
+	for (uint32_t i = 0; i < (uint32_t)g.batchList.size(); ++i)
+	{
+		if (!batchVisible[i] && isInPlanes(g.batchList[i].box, planes))
+			batchVisible[i] = 1;
+	}
+}
+
+void wowWMOVisibility::traverse(uint32_t group, const T_Planes& planes, uint32_t depth)
+{
+	addGroup(group, planes);
+	if (depth >= WMO_PORTAL_MAX_DEPTH)
+		return;
+
+	const std::vector<SWMOPortal>& portalList = WmoFile->PortalList;
+	const std::vector<SWMOPortalRelation>& relationList = WmoFile->PortalRelationList;
+	const SWMOGroup& g = WmoFile->GroupList[group];
+	const uint32_t numGroups = (uint32_t)WmoFile->GroupList.size();
+
+	GroupInPath[group] = 1;
+
+	std::vector<vector3df> polygon;
+	T_Planes portalPlanes;
+	for (uint32_t i = g.portalStart; i < g.portalStart + g.portalCount && i < (uint32_t)relationList.size(); ++i)
+	{
+		const SWMOPortalRelation& relation = relationList[i];
+		if (relation.portalIndex >= (uint16_t)portalList.size() ||
+			relation.groupIndex < 0 || relation.groupIndex >= (int16_t)numGroups ||
+			GroupInPath[relation.groupIndex])
+			continue;
+
+		const SWMOPortal& portal = portalList[relation.portalIndex];
+		if (portal.vCount < 3)
+			continue;
+
+		//the camera looks through the portal from the side of this group
+		const float dist = portal.plane.Normal.dotProduct(CamPos) + portal.plane.D;
+		if (relation.face ? dist < -WMO_PORTAL_EPSILON : dist > WMO_PORTAL_EPSILON)
+			continue;
+
+		//standing in the portal, the view is not narrowed
+		if (fabs(dist) <= WMO_PORTAL_EPSILON)
+		{
+			if (isInPlanes(portal.box, planes))
+				traverse((uint32_t)relation.groupIndex, planes, depth + 1);
+			continue;
+		}
+
+		if (!clipPortal(relation.portalIndex, planes, polygon))
+			continue;
+
+		vector3df center(0, 0, 0);
+		for (const vector3df& v : polygon)
+			center += v;
+		center /= (float)polygon.size();
+
+		//one plane through the camera and each edge, facing the inside of the portal
+		portalPlanes.clear();
+		for (uint32_t k = 0; k < (uint32_t)polygon.size(); ++k)
+		{
+			const vector3df& a = polygon[k];
+			const vector3df& b = polygon[(k + 1) % polygon.size()];
+			vector3df normal = (a - CamPos).crossProduct(b - CamPos);
+			if (normal.squareMagnitude() < 1e-8f)
+				continue;
+			normal.normalize();
+
+			plane3df plane(normal, -normal.dotProduct(CamPos));
+			if (plane.Normal.dotProduct(center) + plane.D < 0)
+				plane.setPlane(-plane.Normal, -plane.D);
+			portalPlanes.push_back(plane);
+		}
+
+		//nothing in front of the portal is seen through it
+		plane3df nearPlane = portal.plane;
+		if (dist > 0)
+			nearPlane.setPlane(-nearPlane.Normal, -nearPlane.D);
+		portalPlanes.push_back(nearPlane);
+		portalPlanes.push_back(FarPlane);
+
+		traverse((uint32_t)relation.groupIndex, portalPlanes, depth + 1);
+	}
+
+	GroupInPath[group] = 0;
+}
+
+bool wowWMOVisibility::clipPortal(uint32_t portal, const T_Planes& planes, std::vector<vector3df>& polygon) const
+{
+	const SWMOPortal& p = WmoFile->PortalList[portal];
+	if (!isInPlanes(p.box, planes))
+		return false;
+
+	polygon.assign(WmoFile->PortalVertices.begin() + p.vStart, WmoFile->PortalVertices.begin() + p.vStart + p.vCount);
+
+	std::vector<vector3df> clipped;
+	for (const plane3df& plane : planes)
+	{
+		clipped.clear();
+		const uint32_t count = (uint32_t)polygon.size();
+		for (uint32_t k = 0; k < count; ++k)
+		{
+			const vector3df& a = polygon[k];
+			const vector3df& b = polygon[(k + 1) % count];
+			const float da = plane.Normal.dotProduct(a) + plane.D;
+			const float db = plane.Normal.dotProduct(b) + plane.D;
+
+			if (da >= 0)
+				clipped.push_back(a);
+			if ((da >= 0) != (db >= 0))
+				clipped.push_back(a + (b - a) * (da / (da - db)));
+		}
+
+		polygon.swap(clipped);
+		if (polygon.size() < 3)
+			return false;
+	}
+
+	return true;
+}
+
+bool wowWMOVisibility::isInPlanes(const aabbox3df& box, const T_Planes& planes)
+{
+	for (const plane3df& plane : planes)
+	{
+		if (ISREL3D_BACK == box.classifyPlaneRelation(plane))
+			return false;
+	}
+	return true;
+}
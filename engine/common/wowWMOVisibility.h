@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "vector3d.h"
+#include "plane3d.h"
+#include "frustum.h"
+
+class wowWMOFile;
+
+//groups and batches of a wmo seen from a camera, walking the portal graph from the group of the camera
+//the view volume is narrowed by each portal it passes, groups behind closed walls are not reached
+class wowWMOVisibility
+{
+public:
+	explicit wowWMOVisibility(const wowWMOFile* wmoFile);
+
+public:
+	//camera position and frustum in wmo space
+	void update(const vector3df& camPos, const frustum& viewFrustum);
+
+	//-1 when the camera is outside of the indoor groups
+	int32_t getCameraGroup() const { return CameraGroup; }
+	const std::vector<uint32_t>& getVisibleGroups() const { return VisibleGroups; }
+	bool isGroupVisible(uint32_t group) const { return GroupVisible[group] != 0; }
+	bool isBatchVisible(uint32_t group, uint32_t batch) const { return BatchVisible[BatchOffsets[group] + batch] != 0; }
+	uint32_t getNumVisibleBatches() const;
+
+private:
+	typedef std::vector<plane3df>	T_Planes;
+
+	void addGroup(uint32_t group, const T_Planes& planes);
+	void traverse(uint32_t group, const T_Planes& planes, uint32_t depth);
+	bool clipPortal(uint32_t portal, const T_Planes& planes, std::vector<vector3df>& polygon) const;
+
+	static bool isInPlanes(const aabbox3df& box, const T_Planes& planes);
+
+private:
+	const wowWMOFile*	WmoFile;
+
+	vector3df	CamPos;
+	plane3df	FarPlane;
+	int32_t		CameraGroup;
+
+	std::vector<uint32_t>	VisibleGroups;
+	std::vector<uint8_t>	GroupVisible;
+	std::vector<uint8_t>	GroupInPath;			//groups on the current portal path, no cycles
+	std::vector<uint32_t>	BatchOffsets;
+	std::vector<uint8_t>	BatchVisible;
+};
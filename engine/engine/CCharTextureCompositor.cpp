@@ -0,0 +1,370 @@
+#include "CCharTextureCompositor.h"
+#include "CTextureManager.h"
+#include "Engine.h"
+#include "IVideoDriver.h"
+#include "ITexture.h"
+#include "CCImage.h"
+#include "CBLPImage.h"
+#include "ddslib.h"
+#include "wowDatabase.h"
+#include <algorithm>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define CHARTEXTURE_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#define BILINEAR_WEIGHT_BITS	7			//(b - a) * w stays in 16 bits
+
+CCharTextureCompositor::CCharTextureCompositor(CTextureManager* textureManager)
+	: TextureManager(textureManager)
+{
+}
+
+CCharTextureCompositor::~CCharTextureCompositor()
+{
+	flushCache();
+}
+
+void CCharTextureCompositor::flushCache()
+{
+	AtlasCache.flushCache();
+}
+
+std::shared_ptr<ITexture> CCharTextureCompositor::getCharTexture(uint32_t layoutId, const CM2SceneNode::SCharTexture& charTexture)
+{
+	std::vector<CM2SceneNode::SCharTexturePart> parts = charTexture.textureParts;
+	for (auto& part : parts)
+	{
+		char realfilename[QMAX_PATH];
+		normalizeFileName(part.name.c_str(), realfilename, QMAX_PATH);
+		Q_strlwr(realfilename);
+		part.name = realfilename;
+	}
+	sortParts(parts);
+
+	std::string key = makeCacheKey(layoutId, parts);
+	std::shared_ptr<ITexture> tex = AtlasCache.tryLoadFromCache(key.c_str());
+	if (tex)
+		return tex;
+
+	std::shared_ptr<CCImage> image = compositeImage(layoutId, parts);
+	if (!image)
+		return nullptr;
+
+	tex = g_Engine->getDriver()->createTexture(true, image);
+	if (tex)
+		AtlasCache.addToCache(key.c_str(), tex);
+
+	return tex;
+}
+
+std::shared_ptr<CCImage> CCharTextureCompositor::compositeImage(uint32_t layoutId, const std::vector<CM2SceneNode::SCharTexturePart>& parts)
+{
+	const SLayout* layout = getLayout(layoutId);
+	if (!layout)
+		return nullptr;
+
+	const uint32_t width = layout->size.width;
+	const uint32_t height = layout->size.height;
+
+	uint8_t* data = new uint8_t[width * height * 4];
+	memset(data, 0, width * height * 4);
+	uint32_t* atlas = reinterpret_cast<uint32_t*>(data);
+
+	std::vector<CM2SceneNode::SCharTexturePart> sorted = parts;
+	std::stable_sort(sorted.begin(), sorted.end());
+
+	for (const auto& part : sorted)
+	{
+		recti rc;
+		if (!getSectionRect(*layout, part.region, rc))
+			continue;
+
+		const uint32_t rw = (uint32_t)rc.getWidth();
+		const uint32_t rh = (uint32_t)rc.getHeight();
+
+		dimension2d size;
+		if (!decodePart(part.name.c_str(), rw, rh, size))
+			continue;
+
+		const uint32_t* src = DecodeBuffer.data();
+		if (size.width != rw || size.height != rh)
+		{
+			ResampleBuffer.resize(rw * rh);
+			resampleBilinear(DecodeBuffer.data(), size.width, size.height, ResampleBuffer.data(), rw, rh);
+			src = ResampleBuffer.data();
+		}
+
+		for (uint32_t y = 0; y < rh; ++y)
+			blendOver(src + y * rw, atlas + (rc.top + y) * width + rc.left, rw);
+	}
+
+	return std::make_shared<CCImage>(ECF_A8R8G8B8, layout->size, data, true);
+}
+
+const CCharTextureCompositor::SLayout* CCharTextureCompositor::getLayout(uint32_t layoutId)
+{
+	auto itr = Layouts.find(layoutId);
+	if (itr != Layouts.end())
+		return &itr->second;
+
+	const auto* r = g_WowDatabase->m_CharComponentTextureLayoutsTable.getByID(layoutId);
+	if (!r || !r->Width || !r->Height)
+		return nullptr;
+
+	SLayout& layout = Layouts[layoutId];
+	layout.size.set(r->Width, r->Height);
+
+	recti bounds(0, 0, r->Width, r->Height);
+	const auto& sections = g_WowDatabase->m_CharComponentTextureSectionsTable;
+	for (const auto& e : sections.findAll("LayoutID", layoutId))
+	{
+		const auto& s = sections.RecordList[e.row];
+		recti rc(s.X, s.Y, s.X + s.Width, s.Y + s.Height);
+		if (rc.isEmpty() || !bounds.contains(rc))
+		{
+			ASSERT(false);
+			continue;
+		}
+		layout.sections[s.Section] = rc;
+	}
+
+	return &layout;
+}
+
+bool CCharTextureCompositor::getSectionRect(const SLayout& layout, int region, recti& rc) const
+{
+	if (region < 0)
+	{
+		rc.set(0, 0, layout.size.width, layout.size.height);
+		return true;
+	}
+
+	auto itr = layout.sections.find((uint32_t)region);
+	if (itr == layout.sections.end())
+		return false;
+
+	rc = itr->second;
+	return true;
+}
+
+bool CCharTextureCompositor::decodePart(const char* filename, uint32_t width, uint32_t height, dimension2d& size)
+{
+	std::shared_ptr<IImage> image = TextureManager->loadBLP(filename);
+	if (!image || image->getImageType() != EIT_BLP)
+		return false;
+
+	const CBLPImage* blp = static_cast<const CBLPImage*>(image.get());
+	const ECOLOR_FORMAT format = blp->getColorFormat();
+	const bool compressed = format != ECF_A8R8G8B8;
+
+	//smallest mip that still covers the section, dxt needs whole blocks
+	uint32_t level = 0;
+	while (level + 1 < blp->getNumMipLevels())
+	{
+		dimension2d next = blp->getDimension().getMipLevelSize(level + 1);
+		if (next.width < width || next.height < height)
+			break;
+		if (compressed && (next.width < 4 || next.height < 4))
+			break;
+		++level;
+	}
+
+	size = blp->getDimension().getMipLevelSize(level);
+	DecodeBuffer.resize(size.width * size.height);
+	uint8_t* dest = reinterpret_cast<uint8_t*>(DecodeBuffer.data());
+
+	if (!compressed)
+		return blp->copyMipmapData(0, level, dest, size.width * 4, size.width, size.height);
+
+	if (size.width % 4 != 0 || size.height % 4 != 0)
+		return false;
+
+	uint8_t* src = (uint8_t*)blp->getMipmapData(level);
+	if (!src)
+		return false;
+
+	switch (format)
+	{
+	case ECF_DXT1:
+		DDSDecompressDXT1(src, size.width, size.height, dest, false);
+		break;
+	case ECF_DXT3:
+		DDSDecompressDXT3(src, size.width, size.height, dest);
+		break;
+	case ECF_DXT5:
+		DDSDecompressDXT5(src, size.width, size.height, dest);
+		break;
+	default:
+		ASSERT(false);
+		return false;
+	}
+
+	//ddslib writes b, g, r, a bytes, the layout of the palettized parts and the atlas
+	return true;
+}
+
+void CCharTextureCompositor::resampleBilinear(const uint32_t* src, uint32_t srcWidth, uint32_t srcHeight, uint32_t* dest, uint32_t destWidth, uint32_t destHeight)
+{
+	//pixel centers are aligned, coordinates are 16.16 fixed point
+	std::vector<uint32_t> x0(destWidth), x1(destWidth), wx(destWidth);
+	for (uint32_t x = 0; x < destWidth; ++x)
+	{
+		int64_t fx = ((int64_t)(2 * x + 1) * srcWidth << 15) / destWidth - 32768;
+		fx = std::max(fx, (int64_t)0);
+		x0[x] = std::min((uint32_t)(fx >> 16), srcWidth - 1);
+		x1[x] = std::min(x0[x] + 1, srcWidth - 1);
+		wx[x] = ((uint32_t)fx & 0xffff) >> (16 - BILINEAR_WEIGHT_BITS);
+	}
+
+	for (uint32_t y = 0; y < destHeight; ++y)
+	{
+		int64_t fy = ((int64_t)(2 * y + 1) * srcHeight << 15) / destHeight - 32768;
+		fy = std::max(fy, (int64_t)0);
+		const uint32_t y0 = std::min((uint32_t)(fy >> 16), srcHeight - 1);
+		const uint32_t y1 = std::min(y0 + 1, srcHeight - 1);
+		const uint32_t wy = ((uint32_t)fy & 0xffff) >> (16 - BILINEAR_WEIGHT_BITS);
+
+		const uint32_t* row0 = src + y0 * srcWidth;
+		const uint32_t* row1 = src + y1 * srcWidth;
+		uint32_t* target = dest + y * destWidth;
+
+#ifdef CHARTEXTURE_USE_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i vwy = _mm_set1_epi16((short)wy);
+		for (uint32_t x = 0; x < destWidth; ++x)
+		{
+			//left pixel in the low 4 lanes, right pixel in the high 4 lanes
+			__m128i top = _mm_unpacklo_epi32(_mm_cvtsi32_si128(row0[x0[x]]), _mm_cvtsi32_si128(row0[x1[x]]));
+			__m128i bottom = _mm_unpacklo_epi32(_mm_cvtsi32_si128(row1[x0[x]]), _mm_cvtsi32_si128(row1[x1[x]]));
+			top = _mm_unpacklo_epi8(top, zero);
+			bottom = _mm_unpacklo_epi8(bottom, zero);
+
+			__m128i v = _mm_add_epi16(top, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(bottom, top), vwy), BILINEAR_WEIGHT_BITS));
+			__m128i right = _mm_srli_si128(v, 8);
+			__m128i h = _mm_add_epi16(v, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(right, v), _mm_set1_epi16((short)wx[x])), BILINEAR_WEIGHT_BITS));
+
+			target[x] = (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(h, zero));
+		}
+#else
+		for (uint32_t x = 0; x < destWidth; ++x)
+		{
+			uint32_t c = 0;
+			for (uint32_t shift = 0; shift < 32; shift += 8)
+			{
+				int a = (row0[x0[x]] >> shift) & 0xff;
+				int b = (row0[x1[x]] >> shift) & 0xff;
+				int d = (row1[x0[x]] >> shift) & 0xff;
+				int e = (row1[x1[x]] >> shift) & 0xff;
+
+				int left = a + (((d - a) * (int)wy) >> BILINEAR_WEIGHT_BITS);
+				int right = b + (((e - b) * (int)wy) >> BILINEAR_WEIGHT_BITS);
+				int v = left + (((right - left) * (int)wx[x]) >> BILINEAR_WEIGHT_BITS);
+				c |= (uint32_t)v << shift;
+			}
+			target[x] = c;
+		}
+#endif
+	}
+}
+
+//dest = src * a + dest * (1 - a), alpha accumulates as a + dest.a * (1 - a)
+void CCharTextureCompositor::blendOver(const uint32_t* src, uint32_t* dest, uint32_t count)
+{
+	uint32_t i = 0;
+
+#ifdef CHARTEXTURE_USE_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alphaMask = _mm_set1_epi32((int)0xff000000);
+	const __m128i v255 = _mm_set1_epi16(255);
+	const __m128i v128 = _mm_set1_epi16(128);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+
+		//whole blocks of opaque or transparent texels are common in the skin layers
+		int opaque = _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(s, alphaMask), alphaMask));
+		if (opaque == 0xffff)
+		{
+			_mm_storeu_si128((__m128i*)(dest + i), s);
+			continue;
+		}
+		int transparent = _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(s, alphaMask), zero));
+		if (transparent == 0xffff)
+			continue;
+
+		__m128i d = _mm_loadu_si128((const __m128i*)(dest + i));
+		__m128i color = _mm_or_si128(s, alphaMask);
+
+		__m128i sLo = _mm_unpacklo_epi8(s, zero);
+		__m128i sHi = _mm_unpackhi_epi8(s, zero);
+		__m128i aLo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sLo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+		__m128i aHi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sHi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+
+		__m128i cLo = _mm_unpacklo_epi8(color, zero);
+		__m128i cHi = _mm_unpackhi_epi8(color, zero);
+		__m128i dLo = _mm_unpacklo_epi8(d, zero);
+		__m128i dHi = _mm_unpackhi_epi8(d, zero);
+
+		//x = c * a + d * (255 - a) + 128, x / 255 = (x + (x >> 8)) >> 8
+		__m128i xLo = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(cLo, aLo), _mm_mullo_epi16(dLo, _mm_sub_epi16(v255, aLo))), v128);
+		__m128i xHi = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(cHi, aHi), _mm_mullo_epi16(dHi, _mm_sub_epi16(v255, aHi))), v128);
+		xLo = _mm_srli_epi16(_mm_add_epi16(xLo, _mm_srli_epi16(xLo, 8)), 8);
+		xHi = _mm_srli_epi16(_mm_add_epi16(xHi, _mm_srli_epi16(xHi, 8)), 8);
+
+		_mm_storeu_si128((__m128i*)(dest + i), _mm_packus_epi16(xLo, xHi));
+	}
+#endif
+
+	for (; i < count; ++i)
+	{
+		const uint32_t s = src[i];
+		const uint32_t a = s >> 24;
+		if (a == 255)
+		{
+			dest[i] = s;
+			continue;
+		}
+		if (a == 0)
+			continue;
+
+		const uint32_t color = s | 0xff000000;
+		const uint32_t d = dest[i];
+		uint32_t c = 0;
+		for (uint32_t shift = 0; shift < 32; shift += 8)
+		{
+			uint32_t x = ((color >> shift) & 0xff) * a + ((d >> shift) & 0xff) * (255 - a) + 128;
+			c |= ((x + (x >> 8)) >> 8) << shift;
+		}
+		dest[i] = c;
+	}
+}
+
+std::string CCharTextureCompositor::makeCacheKey(uint32_t layoutId, const std::vector<CM2SceneNode::SCharTexturePart>& parts)
+{
+	std::string key = "charlayout" + std::to_string(layoutId);
+	for (const auto& part : parts)
+	{
+		key += '|';
+		key += std::to_string(part.layer);
+		key += ',';
+		key += std::to_string(part.region);
+		key += ',';
+		key += part.name;
+	}
+	return key;
+}
+
+void CCharTextureCompositor::sortParts(std::vector<CM2SceneNode::SCharTexturePart>& parts)
+{
+	std::sort(parts.begin(), parts.end(), [](const CM2SceneNode::SCharTexturePart& a, const CM2SceneNode::SCharTexturePart& b)
+	{
+		if (a.layer != b.layer)
+			return a.layer < b.layer;
+		if (a.region != b.region)
+			return a.region < b.region;
+		return a.name < b.name;
+	});
+}
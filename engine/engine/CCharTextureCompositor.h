@@ -0,0 +1,61 @@
+#pragma once
+
+#include "base.h"
+#include <memory>
+#include <map>
+#include <vector>
+#include "rect.h"
+#include "CResourceCache.h"
+#include "CM2SceneNode.h"
+
+class ITexture;
+class CCImage;
+class CTextureManager;
+
+//composites character texture parts into the sections of a CharComponentTextureLayouts atlas
+//finished atlases are cached by layout and sorted part list, so the same outfit is composited once
+class CCharTextureCompositor
+{
+private:
+	DISALLOW_COPY_AND_ASSIGN(CCharTextureCompositor);
+
+public:
+	explicit CCharTextureCompositor(CTextureManager* textureManager);
+	~CCharTextureCompositor();
+
+public:
+	//parts are blended by layer, a negative region covers the whole atlas
+	std::shared_ptr<ITexture> getCharTexture(uint32_t layoutId, const CM2SceneNode::SCharTexture& charTexture);
+
+	//A8R8G8B8 atlas without the cache, null if the layout is unknown
+	std::shared_ptr<CCImage> compositeImage(uint32_t layoutId, const std::vector<CM2SceneNode::SCharTexturePart>& parts);
+
+	void flushCache();
+
+	//pixels are A8R8G8B8, the blend only needs alpha in the high byte
+	static void resampleBilinear(const uint32_t* src, uint32_t srcWidth, uint32_t srcHeight, uint32_t* dest, uint32_t destWidth, uint32_t destHeight);
+	static void blendOver(const uint32_t* src, uint32_t* dest, uint32_t count);
+
+private:
+	struct SLayout
+	{
+		dimension2d		size;
+		std::map<uint32_t, recti>	sections;
+	};
+
+	const SLayout* getLayout(uint32_t layoutId);
+	bool getSectionRect(const SLayout& layout, int region, recti& rc) const;
+	bool decodePart(const char* filename, uint32_t width, uint32_t height, dimension2d& size);
+
+	static std::string makeCacheKey(uint32_t layoutId, const std::vector<CM2SceneNode::SCharTexturePart>& parts);
+	static void sortParts(std::vector<CM2SceneNode::SCharTexturePart>& parts);
+
+private:
+	CTextureManager*	TextureManager;
+
+	std::map<uint32_t, SLayout>		Layouts;
+	CResourceCache<ITexture>	AtlasCache;
+
+	std::vector<uint32_t>	DecodeBuffer;
+	std::vector<uint32_t>	ResampleBuffer;
+};
@@ -0,0 +1,227 @@
+#include "CM2RenderData.h"
+#include "wowM2File.h"
+#include "Engine.h"
+#include "CMaterial.h"
+#include "CTextureManager.h"
+
+CM2RenderData::CM2RenderData(const wowM2File* file, bool packedVertices)
+	: M2File(file)
+{
+	VertexBuffer = nullptr;
+	const uint32_t numVertices = (uint32_t)M2File->Vertices.size();
+	if (numVertices > 0 && numVertices < 65536)
+	{
+		VertexBuffer = g_Engine->getDriver()->createVertexBuffer(EMM_STATIC);
+		if (packedVertices)
+		{
+			SVertex_PNT2WA_Packed* vertices = VertexBuffer->alloc<SVertex_PNT2WA_Packed>(numVertices);
+			for (uint32_t i = 0; i < numVertices; ++i)
+				vertices[i].set(M2File->Vertices[i]);
+		}
+		else
+		{
+			SVertex_PNT2WA* vertices = VertexBuffer->alloc<SVertex_PNT2WA>(numVertices);
+			memcpy(vertices, M2File->Vertices.data(), sizeof(SVertex_PNT2WA) * numVertices);
+		}
+	}
+
+	//replaceable textures are drawn white, the body texture of a node with a character texture has its own materials
+	Textures.resize(M2File->TexDefs.size());
+	for (uint32_t i = 0; i < (uint32_t)M2File->TexDefs.size(); ++i)
+	{
+		const wowM2File::STexDef& texDef = M2File->TexDefs[i];
+		if (texDef.type == TEXTURE_FILENAME && !texDef.filename.empty())
+			Textures[i] = g_Engine->getTextureManager()->loadTexture(texDef.filename.c_str(), true);
+	}
+
+	MaxParticleVertices = 0;
+	ParticleIndexBuffer = nullptr;
+	const uint32_t numEmitters = (uint32_t)M2File->ParticleEmitters.size();
+	if (numEmitters > 0)
+	{
+		MaxParticleVertices = std::min(numEmitters * M2_PARTICLES_PER_EMITTER * 4, (uint32_t)M2_MAX_PARTICLE_VERTICES);
+
+		//same winding as the quad list of the driver, vertices of a particle are top left, top right, bottom left, bottom right
+		const uint32_t numQuads = MaxParticleVertices / 4;
+		ParticleIndexBuffer = g_Engine->getDriver()->createIndexBuffer(EMM_STATIC);
+		uint16_t* indices = ParticleIndexBuffer->alloc<uint16_t>(numQuads * 6);
+		for (uint32_t i = 0; i < numQuads; ++i)
+		{
+			const uint16_t firstVert = (uint16_t)(i * 4);
+			indices[0] = firstVert + 0;
+			indices[1] = firstVert + 1;
+			indices[2] = firstVert + 2;
+			indices[3] = firstVert + 3;
+			indices[4] = firstVert + 2;
+			indices[5] = firstVert + 1;
+			indices += 6;
+		}
+
+		for (uint32_t i = 0; i < numEmitters; ++i)
+			ParticleMaterials.push_back(createParticleMaterial(i));
+	}
+}
+
+CM2RenderData::~CM2RenderData()
+{
+	for (const auto& kv : SkinDataMap)
+	{
+		SSkinData* skinData = kv.second;
+		for (CMaterial* material : skinData->Materials)
+			delete material;
+		delete skinData->IndexBuffer;
+		delete skinData;
+	}
+	SkinDataMap.clear();
+
+	for (CMaterial* material : ParticleMaterials)
+		delete material;
+	delete ParticleIndexBuffer;
+
+	delete VertexBuffer;
+}
+
+const CM2RenderData::SSkinData* CM2RenderData::getSkinData(const wowSkinFile* skinFile)
+{
+	auto itr = SkinDataMap.find(skinFile);
+	if (itr != SkinDataMap.end())
+		return itr->second;
+
+	SSkinData* skinData = new SSkinData;
+
+	std::vector<uint32_t> mask;
+	std::vector<uint16_t> indices;
+	wowM2Geosets::getVisibilityMask(skinFile, SGeosetSelection(), mask);
+	wowM2Geosets::buildDrawRanges(skinFile, mask, indices, skinData->DrawRanges);
+
+	skinData->IndexBuffer = nullptr;
+	if (!indices.empty())
+	{
+		skinData->IndexBuffer = g_Engine->getDriver()->createIndexBuffer(EMM_STATIC);
+		uint16_t* dest = skinData->IndexBuffer->alloc<uint16_t>((uint32_t)indices.size());
+		memcpy(dest, indices.data(), sizeof(uint16_t) * indices.size());
+	}
+
+	for (const SGeoset& geoset : skinFile->Geosets)
+		skinData->Materials.push_back(createMaterial(geoset, nullptr));
+
+	SkinDataMap[skinFile] = skinData;
+	return skinData;
+}
+
+CMaterial* CM2RenderData::createCharMaterial(const SGeoset& geoset, const ITexture* charTexture) const
+{
+	if (!charTexture || geoset.TextureUnits.empty())
+		return nullptr;
+
+	const int16_t texId = geoset.TextureUnits[0].TexID;
+	if (texId < 0 || texId >= (int16_t)M2File->TexDefs.size() || M2File->TexDefs[texId].type != TEXTURE_BODY)
+		return nullptr;
+
+	return createMaterial(geoset, charTexture);
+}
+
+CMaterial* CM2RenderData::createMaterial(const SGeoset& geoset, const ITexture* charTexture) const
+{
+	CMaterial* material = new CMaterial;
+	CPass* pass = material->addPass(ELM_ALWAYS);
+
+	const ITexture* texture = nullptr;
+	E_TEXTURE_CLAMP wrapU = ETC_CLAMP;
+	E_TEXTURE_CLAMP wrapV = ETC_CLAMP;
+	uint16_t blend = M2::BM_OPAQUE;
+	if (!geoset.TextureUnits.empty())
+	{
+		const SGeoset::STexUnit& texUnit = geoset.TextureUnits[0];
+		if (texUnit.TexID >= 0 && texUnit.TexID < (int16_t)Textures.size())
+		{
+			texture = Textures[texUnit.TexID].get();
+			if (!texture && M2File->TexDefs[texUnit.TexID].type == TEXTURE_BODY)
+				texture = charTexture;
+		}
+		if (texUnit.TexFlags & TEXTURE_WRAPX)
+			wrapU = ETC_REPEAT;
+		if (texUnit.TexFlags & TEXTURE_WRAPY)
+			wrapV = ETC_REPEAT;
+
+		if (texUnit.rfIndex >= 0)
+		{
+			const wowM2File::SRenderFlag& renderFlag = M2File->RenderFlags[texUnit.rfIndex];
+			blend = renderFlag.blend;
+			pass->Cull = renderFlag.frontCulling() ? ECM_BACK : ECM_NONE;
+			pass->ZWrite = renderFlag.zwrite();
+		}
+	}
+
+	if (!texture)
+		texture = g_Engine->getTextureManager()->getTextureWhite().get();
+	material->setMainTexture(texture, wrapU, wrapV);
+
+	setBlend(material, pass, blend);
+
+	return material;
+}
+
+CMaterial* CM2RenderData::createParticleMaterial(uint32_t emitter)
+{
+	const wowM2File::SModelParticleEmitter& def = M2File->ParticleEmitters[emitter];
+
+	CMaterial* material = new CMaterial;
+	CPass* pass = material->addPass(ELM_ALWAYS);
+	pass->Cull = ECM_NONE;
+
+	const ITexture* texture = nullptr;
+	if (def.textureIndex >= 0 && def.textureIndex < (int16_t)Textures.size())
+		texture = Textures[def.textureIndex].get();
+	if (!texture)
+		texture = g_Engine->getTextureManager()->getTextureWhite().get();
+	material->setMainTexture(texture);
+
+	//the blend of an emitter has the values of the render flags
+	setBlend(material, pass, def.blend);
+
+	return material;
+}
+
+void CM2RenderData::setBlend(CMaterial* material, CPass* pass, uint16_t blend)
+{
+	switch (blend)
+	{
+	case M2::BM_OPAQUE:
+		material->RenderQueue = ERQ_GEOMETRY;
+		break;
+	case M2::BM_ALPHA_TEST:
+		material->RenderQueue = ERQ_ALPHATEST;
+		break;
+	default:
+	{
+		material->RenderQueue = ERQ_TRANSPARENT;
+		pass->ZWrite = false;
+		pass->AlphaBlendEnabled = true;
+		switch (blend)
+		{
+		case M2::BM_ALPHA_BLEND:
+			pass->SrcBlend = EBF_SRC_ALPHA;
+			pass->DestBlend = EBF_ONE_MINUS_SRC_ALPHA;
+			break;
+		case M2::BM_ADDITIVE_COLOR:
+			pass->SrcBlend = EBF_ONE;
+			pass->DestBlend = EBF_ONE;
+			break;
+		case M2::BM_ADDITIVE_ALPHA:
+			pass->SrcBlend = EBF_SRC_ALPHA;
+			pass->DestBlend = EBF_ONE;
+			break;
+		case M2::BM_MODULATE:
+			pass->SrcBlend = EBF_DST_COLOR;
+			pass->DestBlend = EBF_ZERO;
+			break;
+		default:			//modulate 2x and 4x
+			pass->SrcBlend = EBF_DST_COLOR;
+			pass->DestBlend = EBF_SRC_COLOR;
+			break;
+		}
+	}
+	break;
+	}
+}
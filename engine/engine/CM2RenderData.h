@@ -0,0 +1,71 @@
+#pragma once
+
+#include "base.h"
+#include <map>
+#include <memory>
+#include <vector>
+#include "wowM2Geosets.h"
+
+class wowM2File;
+class wowSkinFile;
+class SGeoset;
+class IVertexBuffer;
+class IIndexBuffer;
+class ITexture;
+class CMaterial;
+class CPass;
+
+#define M2_PARTICLES_PER_EMITTER	1024
+#define M2_MAX_PARTICLE_VERTICES	65532			//16 bit indices
+
+//bind pose vertices, skin indices and geoset materials of a m2 file, shared by its scene nodes
+//units of nodes drawing these buffers with the same range and material can be drawn instanced
+//the particle quads of the nodes are drawn with the quad indices and the emitter materials
+class CM2RenderData
+{
+private:
+	DISALLOW_COPY_AND_ASSIGN(CM2RenderData);
+
+public:
+	CM2RenderData(const wowM2File* file, bool packedVertices);
+	~CM2RenderData();
+
+public:
+	struct SSkinData
+	{
+		IIndexBuffer*	IndexBuffer;			//indices of DrawRanges, null if the skin has no triangles
+		std::vector<SGeosetDrawRange>	DrawRanges;			//all geosets visible
+		std::vector<CMaterial*>		Materials;			//per geoset
+	};
+
+	//null if the vertices don't fit 16 bit indices
+	IVertexBuffer* getVertexBuffer() const { return VertexBuffer; }
+
+	const SSkinData* getSkinData(const wowSkinFile* skinFile);
+
+	//vertices of the particle buffer of a node, 0 without emitters
+	uint32_t getMaxParticleVertices() const { return MaxParticleVertices; }
+	//2 triangles per 4 vertices, null without emitters
+	IIndexBuffer* getParticleIndexBuffer() const { return ParticleIndexBuffer; }
+	const CMaterial* getParticleMaterial(uint32_t emitter) const { return ParticleMaterials[emitter]; }
+
+	//material of a geoset drawing the body texture with a composited character texture, null if the geoset has another texture
+	//owned by the caller
+	CMaterial* createCharMaterial(const SGeoset& geoset, const ITexture* charTexture) const;
+
+private:
+	CMaterial* createMaterial(const SGeoset& geoset, const ITexture* charTexture) const;
+	CMaterial* createParticleMaterial(uint32_t emitter);
+	static void setBlend(CMaterial* material, CPass* pass, uint16_t blend);
+
+private:
+	const wowM2File*	M2File;
+	IVertexBuffer*		VertexBuffer;
+
+	std::map<const wowSkinFile*, SSkinData*>	SkinDataMap;
+	std::vector<std::shared_ptr<ITexture>>		Textures;			//per TexDefs, null for replaceable textures
+
+	uint32_t	MaxParticleVertices;
+	IIndexBuffer*		ParticleIndexBuffer;
+	std::vector<CMaterial*>		ParticleMaterials;			//per emitter
+};
@@ -1,35 +1,367 @@
 #include "CM2SceneNode.h"
 #include "wowM2File.h"
+#include "wowM2Skinning.h"
+#include "wowAnimFileCache.h"
+#include "wowSkinLodLoader.h"
+#include "Engine.h"
+#include "CMeshManager.h"
+#include "CCamera.h"
+#include "CTextureManager.h"
+#include "CCharTextureCompositor.h"
+#include "CM2RenderData.h"
+#include "CMaterial.h"
 
 CM2Renderer::CM2Renderer(CM2SceneNode* node)
-	: IRenderer(node)
+	: IRenderer(node), WowSkinFile(nullptr)
 {
 	M2File = node->M2File.get();
-	WowSkinFile = node->WowSkinFile;
 }
 
 aabbox3df CM2Renderer::getBoundingBox() const
 {
-	return M2File->BoundingBox;
+	return getLocalToWorldMatrix().transformBox(M2File->BoundingBox);
 }
 
 CM2SceneNode::CM2SceneNode(std::shared_ptr<wowM2File> file)
 	: M2File(file), M2Renderer(this)
 {
 	WowSkinFile = &M2File->SkinFile;
+	M2Renderer.setSkinFile(WowSkinFile);
 
 	m_Renderer = &M2Renderer;
+
+	CurrentLod = 0;
+	LodScreenError = 2.0f;
+
+	CurrentAnimation = 0;
+	AnimationTime = 0;
+	BoneMatrices.resize(M2File->Skeleton.getNumBones());
+	AnimationCursors.resize(M2File->Skeleton.getNumCursors(), 0);
+
+	RenderData = g_Engine->getMeshManager()->getM2RenderData(M2File.get());
+	GeosetIndexBuffer = nullptr;
+	AllGeosetsVisible = true;
+	updateGeosets();
+
+	//without bone keys the vertices stay in the bind pose, RenderData is drawn and instanced
+	SkinnedVertexBuffer = nullptr;
+	const uint32_t numVertices = (uint32_t)M2File->Vertices.size();
+	if (!BoneMatrices.empty() && numVertices > 0 && numVertices < 65536 && M2File->Skeleton.isAnimated())
+	{
+		SkinnedVertices = M2File->Vertices;
+		SkinnedVertexBuffer = g_Engine->getDriver()->createVertexBuffer(EMM_DYNAMIC);
+		if (g_Engine->getMeshManager()->isPackedVertices())
+		{
+			PackedVertices.resize(numVertices);
+			for (uint32_t i = 0; i < numVertices; ++i)
+				PackedVertices[i].set(SkinnedVertices[i]);
+
+			SVertex_PNT2WA_Packed* vertices = SkinnedVertexBuffer->alloc<SVertex_PNT2WA_Packed>(numVertices);
+			memcpy(vertices, PackedVertices.data(), sizeof(SVertex_PNT2WA_Packed) * numVertices);
+		}
+		else
+		{
+			SVertex_PNT2WA* vertices = SkinnedVertexBuffer->alloc<SVertex_PNT2WA>(numVertices);
+			memcpy(vertices, SkinnedVertices.data(), sizeof(SVertex_PNT2WA) * numVertices);
+		}
+	}
+
+	ParticleSystem = nullptr;
+	ParticleVertexBuffer = nullptr;
+	if (!M2File->ParticleEmitters.empty())
+	{
+		ParticleSystem = new wowM2ParticleSystem(M2File.get(), M2_PARTICLES_PER_EMITTER);
+
+		const uint32_t maxVertices = RenderData->getMaxParticleVertices();
+		ParticleVertices.resize(maxVertices);
+		ParticleVertexBuffer = g_Engine->getDriver()->createVertexBuffer(EMM_DYNAMIC);
+		ParticleVertexBuffer->alloc<SVertex_PCT>(maxVertices);
+	}
 }
 
 CM2SceneNode::~CM2SceneNode()
 {
-	
+	delete ParticleVertexBuffer;
+	delete ParticleSystem;
+	delete SkinnedVertexBuffer;
+	delete GeosetIndexBuffer;
+
+	for (CMaterial* material : CharMaterials)
+		delete material;
+}
+
+void CM2SceneNode::tick(uint32_t tickTime, const CCamera* cam)
+{
+	if (cam)
+		updateLod(cam);
+
+	if (BoneMatrices.empty())
+	{
+		updateParticles(0, tickTime, cam);
+		return;
+	}
+
+	AnimationTime += tickTime;
+	if (CurrentAnimation < (uint32_t)M2File->Animations.size() && M2File->Animations[CurrentAnimation].timeLength > 0)
+		AnimationTime %= M2File->Animations[CurrentAnimation].timeLength;
+
+	//stand pose until the .anim file of the sequence is loaded
+	uint32_t anim = CurrentAnimation;
+	if (!g_Engine->getMeshManager()->getAnimFileCache()->requestAnimation(M2File.get(), anim))
+		anim = 0;
+
+	M2File->Skeleton.evaluate(anim, AnimationTime, BoneMatrices.data(), AnimationCursors.data());
+
+	updateParticles(anim, tickTime, cam);
+
+	if (SkinnedVertexBuffer)
+	{
+		SSkinningJob job;
+		job.src = M2File->Vertices.data();
+		job.dst = SkinnedVertices.data();
+		job.packedDst = PackedVertices.empty() ? nullptr : PackedVertices.data();
+		job.numVertices = (uint32_t)SkinnedVertices.size();
+		job.bones = BoneMatrices.data();
+		job.numBones = (uint32_t)BoneMatrices.size();
+
+		//skinned and streamed with the other nodes after the tick of the scene
+		g_Engine->getMeshManager()->queueSkinning(job, SkinnedVertexBuffer);
+	}
+}
+
+void CM2SceneNode::updateParticles(uint32_t anim, uint32_t tickTime, const CCamera* cam)
+{
+	if (!ParticleSystem)
+		return;
+
+	ParticleSystem->tick(anim, AnimationTime, tickTime, BoneMatrices.data(), (uint32_t)BoneMatrices.size());
+
+	//quads face the camera, particles are in model space
+	vector3df right(1, 0, 0);
+	vector3df up(0, 1, 0);
+	if (cam)
+	{
+		const matrix4 worldToModel = getTransform()->getAbsoluteTransformation().getInverse();
+		right = worldToModel.multiplyVector(cam->getRight());
+		up = worldToModel.multiplyVector(cam->getUp());
+		right.normalize();
+		up.normalize();
+	}
+
+	const uint32_t numParticles = ParticleSystem->fillVertices(right, up, ParticleVertices.data(), (uint32_t)ParticleVertices.size() / 4, ParticleDrawRanges);
+	if (numParticles > 0)
+		ParticleVertexBuffer->updateBuffer(ParticleVertices.data(), numParticles * 4);
+}
+
+void CM2SceneNode::setCharTexture(uint32_t layoutId, const SCharTexture& charTexture)
+{
+	CharTexture = charTexture;
+	CharTextureAtlas = g_Engine->getTextureManager()->getCharTextureCompositor()->getCharTexture(layoutId, CharTexture);
+	updateCharMaterials();
+}
+
+void CM2SceneNode::updateCharMaterials()
+{
+	for (CMaterial* material : CharMaterials)
+		delete material;
+	CharMaterials.clear();
+
+	if (!CharTextureAtlas)
+		return;
+
+	bool hasBody = false;
+	for (const SGeoset& geoset : WowSkinFile->Geosets)
+	{
+		CMaterial* material = RenderData->createCharMaterial(geoset, CharTextureAtlas.get());
+		CharMaterials.push_back(material);
+		hasBody |= material != nullptr;
+	}
+
+	if (!hasBody)
+		CharMaterials.clear();
+}
+
+uint32_t CM2SceneNode::getNumTriangles() const
+{
+	return WowSkinFile ? WowSkinFile->getNumTriangles() : 0;
+}
+
+bool CM2SceneNode::rayCast(const vector3df& start, const vector3df& dir, float maxDistance, float& distance) const
+{
+	if (M2File->CollisionBVH.empty())
+		return false;
+
+	//the ray parameter is kept by an affine transform
+	const matrix4 worldToLocal = getTransform()->getAbsoluteTransformation().getInverse();
+	SCollisionHit hit;
+	if (!M2File->CollisionBVH.rayCast(worldToLocal.multiplyPoint(start), worldToLocal.multiplyVector(dir), maxDistance, hit))
+		return false;
+
+	distance = hit.Distance;
+	return true;
+}
+
+bool CM2SceneNode::intersectsSphere(const vector3df& center, float radius) const
+{
+	if (M2File->CollisionBVH.empty())
+		return false;
+
+	//the local radius covers the sphere under the largest scale of worldToLocal, conservative if the scale is not uniform
+	const matrix4 worldToLocal = getTransform()->getAbsoluteTransformation().getInverse();
+	const float scale = std::max(worldToLocal.multiplyVector(vector3df(1, 0, 0)).magnitude(),
+		std::max(worldToLocal.multiplyVector(vector3df(0, 1, 0)).magnitude(), worldToLocal.multiplyVector(vector3df(0, 0, 1)).magnitude()));
+	return M2File->CollisionBVH.intersectsSphere(worldToLocal.multiplyPoint(center), radius * scale);
+}
+
+//mean edge length of the triangles spread on the bounding sphere, against the one of LOD 0
+static float getLodError(float radius, uint32_t numTriangles, uint32_t baseTriangles)
+{
+	if (numTriangles == 0 || numTriangles >= baseTriangles)
+		return 0;
+
+	const float area = 4.0f * PI * radius * radius;
+	return sqrtf(area / numTriangles) - sqrtf(area / baseTriangles);
+}
+
+void CM2SceneNode::updateLod(const CCamera* cam)
+{
+	const uint32_t numLods = M2File->getNumSkinLods();
+	const uint32_t baseTriangles = M2File->SkinFile.getNumTriangles();
+	if (numLods <= 1 || baseTriangles == 0 || cam->IsOrthogonal())
+		return;
+
+	const matrix4& mat = getTransform()->getAbsoluteTransformation();
+	const vector3df scale = mat.getScale();
+	const float radius = M2File->BoundingRadius * std::max(scale.x, std::max(scale.y, scale.z));
+	const vector3df center = mat.multiplyPoint(M2File->BoundingBox.getCenter());
+	const float distance = std::max(center.getDistanceFrom(cam->getPos()) - radius, cam->getZFront());
+
+	const float viewHeight = (float)g_Engine->getDriver()->getViewPort().getHeight();
+	const float pixelsPerUnit = viewHeight / (2.0f * distance * tanf(cam->getFOV() * 0.5f));
+
+	//coarsest LOD within the error, a LOD is requested once its estimate (half the triangles of the previous one) fits
+	//and used when the loader has read it, switching to a coarser LOD needs a smaller error so that instances near the limit don't flicker
+	uint32_t lod = 0;
+	const wowSkinFile* skinFile = &M2File->SkinFile;
+	for (uint32_t k = 1; k < numLods; ++k)
+	{
+		const float maxError = LodScreenError * (k > CurrentLod ? 0.8f : 1.0f);
+		if (!M2File->isSkinLodLoaded(k) && getLodError(radius, baseTriangles >> k, baseTriangles) * pixelsPerUnit > maxError)
+			break;
+
+		const wowSkinFile* skin = g_Engine->getMeshManager()->getSkinLodLoader()->requestSkinLod(M2File.get(), k);
+		if (!skin || getLodError(radius, skin->getNumTriangles(), baseTriangles) * pixelsPerUnit > maxError)
+			break;
+
+		lod = k;
+		skinFile = skin;
+	}
+
+	if (lod != CurrentLod)
+		setLod(lod, skinFile);
+}
+
+void CM2SceneNode::setLod(uint32_t lod, const wowSkinFile* skinFile)
+{
+	CurrentLod = lod;
+	WowSkinFile = skinFile;
+	M2Renderer.setSkinFile(skinFile);
+
+	updateGeosets();
+	updateCharMaterials();
+}
+
+void CM2SceneNode::setGeosetSelection(const SGeosetSelection& selection)
+{
+	GeosetSelection = selection;
+	updateGeosets();
+}
+
+void CM2SceneNode::updateGeosets()
+{
+	wowM2Geosets::getVisibilityMask(WowSkinFile, GeosetSelection, GeosetMask);
+	wowM2Geosets::buildDrawRanges(WowSkinFile, GeosetMask, GeosetIndices, DynGeosets);
+
+	AllGeosetsVisible = true;
+	for (uint32_t i = 0; i < (uint32_t)WowSkinFile->Geosets.size(); ++i)
+	{
+		if (!wowM2Geosets::isVisible(GeosetMask, i))
+		{
+			AllGeosetsVisible = false;
+			break;
+		}
+	}
+
+	delete GeosetIndexBuffer;
+	GeosetIndexBuffer = nullptr;
+	if (!AllGeosetsVisible && !GeosetIndices.empty())
+	{
+		GeosetIndexBuffer = g_Engine->getDriver()->createIndexBuffer(EMM_STATIC);
+		uint16_t* indices = GeosetIndexBuffer->alloc<uint16_t>((uint32_t)GeosetIndices.size());
+		memcpy(indices, GeosetIndices.data(), sizeof(uint16_t) * GeosetIndices.size());
+	}
 }
 
 std::list<SRenderUnit*> CM2SceneNode::render(const IRenderer* renderer, const CCamera* cam)
 {
 	std::list<SRenderUnit*> unitList;
 
+	renderGeosets(renderer, unitList);
+	renderParticles(renderer, unitList);
+
 	return unitList;
 }
 
+void CM2SceneNode::renderGeosets(const IRenderer* renderer, std::list<SRenderUnit*>& unitList) const
+{
+	IVertexBuffer* vbuffer = SkinnedVertexBuffer ? SkinnedVertexBuffer : RenderData->getVertexBuffer();
+	if (!vbuffer)
+		return;
+
+	const CM2RenderData::SSkinData* skinData = RenderData->getSkinData(WowSkinFile);
+	IIndexBuffer* ibuffer = AllGeosetsVisible ? skinData->IndexBuffer : GeosetIndexBuffer;
+	const std::vector<SGeosetDrawRange>& ranges = AllGeosetsVisible ? skinData->DrawRanges : DynGeosets;
+	if (!ibuffer)
+		return;
+
+	//nodes without bone animation, with all geosets and with the shared materials draw the shared buffers and ranges, the render loop instances them
+	const bool instanced = !SkinnedVertexBuffer && AllGeosetsVisible && CharMaterials.empty();
+	for (const SGeosetDrawRange& range : ranges)
+	{
+		SRenderUnit* unit = new SRenderUnit(renderer);
+		unit->vbuffer = vbuffer;
+		unit->ibuffer = ibuffer;
+		unit->primType = EPT_TRIANGLES;
+		unit->primCount = range.ICount / 3;
+		unit->drawParam.startIndex = range.IStart;
+		unit->drawParam.numVertices = vbuffer->getNumVertices();
+		unit->material = skinData->Materials[range.Geoset];
+		if (!CharMaterials.empty() && CharMaterials[range.Geoset])
+			unit->material = CharMaterials[range.Geoset];
+		unit->instanceKey = instanced ? &range : nullptr;
+
+		unitList.push_back(unit);
+	}
+}
+
+void CM2SceneNode::renderParticles(const IRenderer* renderer, std::list<SRenderUnit*>& unitList) const
+{
+	if (!ParticleVertexBuffer)
+		return;
+
+	//one unit per emitter with particles, the vertices were streamed by the last tick
+	for (const SParticleDrawRange& range : ParticleDrawRanges)
+	{
+		SRenderUnit* unit = new SRenderUnit(renderer);
+		unit->vbuffer = ParticleVertexBuffer;
+		unit->ibuffer = RenderData->getParticleIndexBuffer();
+		unit->primType = EPT_TRIANGLES;
+		unit->primCount = range.numParticles * 2;
+		unit->drawParam.startIndex = range.vertexStart / 4 * 6;
+		unit->drawParam.numVertices = range.vertexStart + range.numParticles * 4;
+		unit->material = RenderData->getParticleMaterial(range.emitter);
+
+		unitList.push_back(unit);
+	}
+}
+
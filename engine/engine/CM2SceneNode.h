@@ -3,10 +3,18 @@
 #include "ISceneNode.h"
 #include "aabbox3d.h"
 #include "IRenderer.h"
+#include "S3DVertex.h"
+#include "wowM2Particles.h"
+#include "wowM2Geosets.h"
 
 class CM2SceneNode;
 class wowM2File;
 class wowSkinFile;
+class IVertexBuffer;
+class IIndexBuffer;
+class ITexture;
+class CM2RenderData;
+class CMaterial;
 
 class CM2Renderer : public IRenderer
 {
@@ -16,6 +24,8 @@ public:
 public:
 	aabbox3df getBoundingBox() const override;
 
+	void setSkinFile(const wowSkinFile* skinFile) { WowSkinFile = skinFile; }
+
 private:
 	aabbox3df Box;
 
@@ -47,23 +57,60 @@ public:
 		std::vector<SCharTexturePart>	textureParts;
 	};
 
-	struct SDynGeoset
-	{
+public:
+	SGeosetSelection	GeosetSelection;
+	std::vector<uint32_t>	GeosetMask;			//bit per geoset of WowSkinFile
+	std::vector<uint16_t>	GeosetIndices;			//indices of the visible geosets, gathered by DynGeosets
+	std::vector<SGeosetDrawRange>	DynGeosets;			//one draw per texture unit set
+	IIndexBuffer*		GeosetIndexBuffer;			//GeosetIndices, null if all geosets are visible
+	bool		AllGeosetsVisible;			//drawn with the shared index buffer of RenderData
+	CM2RenderData*		RenderData;
+	std::vector<matrix4>	BoneMatrices;
+	std::vector<int32_t>	AnimationCursors;			//last key of each bone track
+	const wowSkinFile*		WowSkinFile;			//skin of CurrentLod
+
+	uint32_t	CurrentLod;
+	float		LodScreenError;				//max pixels a coarser LOD may deviate from LOD 0
+
+	uint32_t	CurrentAnimation;
+	uint32_t	AnimationTime;
+
+	std::vector<SVertex_PNT2WA>		SkinnedVertices;
+	std::vector<SVertex_PNT2WA_Packed>		PackedVertices;			//empty if the buffer holds SkinnedVertices
+	IVertexBuffer*		SkinnedVertexBuffer;			//streamed every tick
+
+	wowM2ParticleSystem*	ParticleSystem;			//null without emitters
+	std::vector<SVertex_PCT>	ParticleVertices;
+	std::vector<SParticleDrawRange>		ParticleDrawRanges;
+	IVertexBuffer*		ParticleVertexBuffer;			//all emitters, 4 vertices per particle, streamed every tick and drawn by ParticleDrawRanges
+
+	SCharTexture	CharTexture;
+	std::shared_ptr<ITexture>	CharTextureAtlas;			//composited CharTexture, shared by the nodes with the same parts
+	std::vector<CMaterial*>		CharMaterials;			//per geoset of WowSkinFile, null for the geosets without the body texture
 
-	};
+public:
+	void tick(uint32_t tickTime, const CCamera* cam) override;
+	std::list<SRenderUnit*> render(const IRenderer* renderer, const CCamera* cam) override;
 
-	struct SDynBone
-	{
+	//against the bounding triangles of the m2, in the bind pose
+	bool rayCast(const vector3df& start, const vector3df& dir, float maxDistance, float& distance) const override;
+	bool intersectsSphere(const vector3df& center, float radius) const override;
 
-	};
+	uint32_t getNumTriangles() const;
 
-public:
-	std::vector<SDynGeoset>		DynGeosets;
-	std::vector<SDynBone>	DynBones;
-	const wowSkinFile*		WowSkinFile;
+	//layoutId is a CharComponentTextureLayouts id
+	void setCharTexture(uint32_t layoutId, const SCharTexture& charTexture);
 
-public:
-	std::list<SRenderUnit*> render(const IRenderer* renderer, const CCamera* cam) override;
+	void setGeosetSelection(const SGeosetSelection& selection);
+
+private:
+	void updateLod(const CCamera* cam);
+	void updateParticles(uint32_t anim, uint32_t tickTime, const CCamera* cam);
+	void setLod(uint32_t lod, const wowSkinFile* skinFile);
+	void updateGeosets();
+	void updateCharMaterials();
+	void renderGeosets(const IRenderer* renderer, std::list<SRenderUnit*>& unitList) const;
+	void renderParticles(const IRenderer* renderer, std::list<SRenderUnit*>& unitList) const;
 
 private:
 	std::shared_ptr<wowM2File> M2File;
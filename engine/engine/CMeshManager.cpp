@@ -2,11 +2,30 @@
 #include "CMesh.h"
 #include "Engine.h"
 #include "wowEnvironment.h"
+#include "CFileSystem.h"
 #include "wowM2File.h"
+#include "wowAnimFileCache.h"
+#include "wowSkinLodLoader.h"
+#include "wowM2CookedCache.h"
+#include "CM2RenderData.h"
+
+#define ANIMFILE_CACHE_BYTES		(32 * 1024 * 1024)
+
+//about 1mm and 0.06 degree at the keys
+static const SSkeletonCompression g_SkeletonCompression = { 0.001f, 0.001f, 0.001f };
 
 CMeshManager::CMeshManager(wowEnvironment* wowEnv)
-	: WowEnv(wowEnv)
+	: WowEnv(wowEnv), SkeletonCompression(false), PackedVertices(false), CookedCache(true)
 {
+	AnimFileCache = new wowAnimFileCache(wowEnv, ANIMFILE_CACHE_BYTES);
+	SkinLodLoader = new wowSkinLodLoader(wowEnv);
+	SkinningPool = new wowSkinningPool;
+
+	std::string cacheDir = wowEnv->getFileSystem()->getWorkingDirectory();
+	normalizeDirName(cacheDir);
+	cacheDir += "Cache/m2/";
+	cacheDir += wowEnv->getVersionString();
+	M2CookedCache = new wowM2CookedCache(wowEnv->getFileSystem(), cacheDir.c_str());
 }
 
 CMeshManager::~CMeshManager()
@@ -17,6 +36,43 @@ CMeshManager::~CMeshManager()
 	}
 
 	MeshMap.clear();
+
+	for (const auto& kv : M2RenderDataMap)
+	{
+		delete kv.second;
+	}
+	M2RenderDataMap.clear();
+
+	delete SkinningPool;
+	delete M2CookedCache;
+	delete SkinLodLoader;
+	delete AnimFileCache;
+}
+
+void CMeshManager::queueSkinning(const SSkinningJob& job, IVertexBuffer* vbuffer)
+{
+	SkinningJobs.push_back(job);
+	SkinningBuffers.push_back(vbuffer);
+}
+
+void CMeshManager::flushSkinning()
+{
+	if (SkinningJobs.empty())
+		return;
+
+	SkinningPool->run(SkinningJobs.data(), (uint32_t)SkinningJobs.size());
+
+	for (uint32_t i = 0; i < (uint32_t)SkinningJobs.size(); ++i)
+	{
+		const SSkinningJob& job = SkinningJobs[i];
+		if (job.packedDst)
+			SkinningBuffers[i]->updateBuffer(job.packedDst, job.numVertices);
+		else
+			SkinningBuffers[i]->updateBuffer(job.dst, job.numVertices);
+	}
+
+	SkinningJobs.clear();
+	SkinningBuffers.clear();
 }
 
 std::shared_ptr<wowM2File> CMeshManager::loadM2(const char* filename)
@@ -33,7 +89,7 @@ std::shared_ptr<wowM2File> CMeshManager::loadM2(const char* filename)
 		return m2file;
 
 	std::shared_ptr<wowM2File> file(new wowM2File(WowEnv));
-	if (!file->loadFile(realfilename))
+	if (!file->loadFile(realfilename, SkeletonCompression ? &g_SkeletonCompression : nullptr, CookedCache ? M2CookedCache : nullptr))
 	{
 		file.reset();
 		return nullptr;
@@ -45,6 +101,17 @@ std::shared_ptr<wowM2File> CMeshManager::loadM2(const char* filename)
 	return file;
 }
 
+CM2RenderData* CMeshManager::getM2RenderData(const wowM2File* file)
+{
+	auto itr = M2RenderDataMap.find(file);
+	if (itr != M2RenderDataMap.end())
+		return itr->second;
+
+	CM2RenderData* renderData = new CM2RenderData(file, PackedVertices);
+	M2RenderDataMap[file] = renderData;
+	return renderData;
+}
+
 bool CMeshManager::addMesh(const char* name, IVertexBuffer* vbuffer, IIndexBuffer* ibuffer, E_PRIMITIVE_TYPE primType, uint32_t primCount, const aabbox3df& box)
 {
 	if (MeshMap.find(name) != MeshMap.end())
@@ -6,10 +6,15 @@
 #include "S3DVertex.h"
 #include "IVertexIndexBuffer.h"
 #include "CResourceCache.h"
+#include "wowM2Skinning.h"
 
 class CMesh;
 class wowEnvironment;
 class wowM2File;
+class wowAnimFileCache;
+class wowSkinLodLoader;
+class wowM2CookedCache;
+class CM2RenderData;
 
 class CMeshManager
 {
@@ -22,6 +27,28 @@ public:
 
 public:
 	std::shared_ptr<wowM2File>	loadM2(const char* filename);
+	wowAnimFileCache* getAnimFileCache() const { return AnimFileCache; }
+	wowSkinLodLoader* getSkinLodLoader() const { return SkinLodLoader; }
+
+	//skinning of the m2 nodes ticked in a frame, run in one batch on the skinning pool by flushSkinning
+	//vbuffer gets job.packedDst if set, otherwise job.dst, the vertices must be valid until the flush
+	void queueSkinning(const SSkinningJob& job, IVertexBuffer* vbuffer);
+	void flushSkinning();
+
+	//buffers and materials shared by the scene nodes of file, created on first use
+	CM2RenderData* getM2RenderData(const wowM2File* file);
+
+	//bone tracks of m2 files loaded afterwards are compressed, off by default
+	void setSkeletonCompression(bool enable) { SkeletonCompression = enable; }
+	bool isSkeletonCompression() const { return SkeletonCompression; }
+
+	//m2 scene nodes created afterwards stream EVT_PNT2WA_PACKED vertices (32 bytes instead of 48), off by default
+	void setPackedVertices(bool enable) { PackedVertices = enable; }
+	bool isPackedVertices() const { return PackedVertices; }
+
+	//m2 files loaded afterwards are read from and cooked into Cache/m2/<build>/ under the working directory, on by default
+	void setCookedCache(bool enable) { CookedCache = enable; }
+	bool isCookedCache() const { return CookedCache; }
 
 public:
 	bool addMesh(const char* name, IVertexBuffer* vbuffer, IIndexBuffer* ibuffer, E_PRIMITIVE_TYPE primType, uint32_t primCount, const aabbox3df& box);
@@ -67,8 +94,18 @@ public:
 
 private:
 	std::map<std::string, CMesh*>	MeshMap;
+	std::map<const wowM2File*, CM2RenderData*>	M2RenderDataMap;
 
 	wowEnvironment*		WowEnv;
+	wowAnimFileCache*	AnimFileCache;
+	wowSkinLodLoader*	SkinLodLoader;
+	wowM2CookedCache*	M2CookedCache;
+	wowSkinningPool*	SkinningPool;
+	std::vector<SSkinningJob>	SkinningJobs;
+	std::vector<IVertexBuffer*>		SkinningBuffers;			//per SkinningJobs
+	bool	SkeletonCompression;
+	bool	PackedVertices;
+	bool	CookedCache;
 
 	CResourceCache<wowM2File>	m_M2FileCache;
 };
\ No newline at end of file
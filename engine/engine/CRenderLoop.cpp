@@ -6,6 +6,13 @@
 #include "CCamera.h"
 #include "EngineUtil.h"
 
+#define INSTANCE_BUFFER_SIZE		1024
+
+static const CMaterial& getUnitMaterial(const SRenderUnit* unit)
+{
+	return unit->material ? *unit->material : unit->renderer->getMaterial();
+}
+
 bool OpaqueCompare(const SRenderUnit* a, const SRenderUnit* b)
 {
 	const SGlobalLayerData& layerData1 = a->renderer->getGlobalLayerData();
@@ -14,8 +21,8 @@ bool OpaqueCompare(const SRenderUnit* a, const SRenderUnit* b)
 	if (layerData1 != layerData2)
 		return layerData1 < layerData2;
 
-	int queue1 = a->renderer->getRenderQueue();
-	int queue2 = b->renderer->getRenderQueue();
+	int queue1 = getUnitMaterial(a).RenderQueue;
+	int queue2 = getUnitMaterial(b).RenderQueue;
 	if (queue1 != queue2)
 		return queue1 < queue2;
 
@@ -33,6 +40,10 @@ bool OpaqueCompare(const SRenderUnit* a, const SRenderUnit* b)
 
 	//pass
 
+	//instances
+	if (a->instanceKey != b->instanceKey)
+		return a->instanceKey < b->instanceKey;
+
 	if (a->distance != b->distance)
 		return a->distance > b->distance;
 
@@ -47,15 +58,16 @@ bool AfterOpaqueCompare(const SRenderUnit* a, const SRenderUnit* b)
 	if (layerData1 != layerData2)
 		return layerData1 < layerData2;
 
-	int queue1 = a->renderer->getRenderQueue();
-	int queue2 = b->renderer->getRenderQueue();
+	int queue1 = getUnitMaterial(a).RenderQueue;
+	int queue2 = getUnitMaterial(b).RenderQueue;
 	if (queue1 != queue2)
 		return queue1 < queue2;
 
 	ASSERT(queue1 > ERQ_GEOMETRY_INDEX_MAX);
 
+	//back to front
 	if (a->distance != b->distance)
-		return a->distance < b->distance;
+		return a->distance > b->distance;
 
 	//render all first passes first
 
@@ -69,23 +81,25 @@ bool AfterOpaqueCompare(const SRenderUnit* a, const SRenderUnit* b)
 
 	//pass
 
-
-	return a < b;
+	//equal keys keep the order they were added in (stable_sort), the geosets of a node are drawn in skin order
+	return false;
 }
 
 CRenderLoop::CRenderLoop()
 {
 	m_Canvas = std::make_unique<CCanvas>();
+	m_InstanceBuffer = nullptr;
 }
 
 CRenderLoop::~CRenderLoop()
 {
+	delete m_InstanceBuffer;
 	m_Canvas.reset();
 }
 
 void CRenderLoop::addRenderUnit(SRenderUnit* unit)
 {
-	int renderQueue = unit->renderer->getRenderQueue();
+	int renderQueue = getUnitMaterial(unit).RenderQueue;
 
 	if (renderQueue <= ERQ_GEOMETRY_INDEX_MAX)		//solid
 	{
@@ -134,30 +148,91 @@ void CRenderLoop::renderOpaques(const CCamera* cam)
 	const auto& matProjection = cam->getProjectionTM();
 	const auto& matVP = cam->getVPTM();
 
-	for (const SRenderUnit* unit : m_RenderUnits_Opaque)
+	driver->setShaderVariable("g_MatrixVP", matVP);
+	driver->setShaderVariable("g_MatrixV", matView);
+	driver->setShaderVariable("g_MatrixP", matProjection);
+
+	drawUnits(m_RenderUnits_Opaque);
+}
+
+//adjacent units with the same instance key are drawn instanced, the order of the units is kept
+void CRenderLoop::drawUnits(const std::vector<const SRenderUnit*>& units)
+{
+	IVideoDriver* driver = g_Engine->getDriver();
+	for (uint32_t i = 0; i < (uint32_t)units.size();)
 	{
-		if (!unit->primCount)
-			continue;
-
-		const IRenderer* renderer = unit->renderer;
-		const CPass* pass;
-		if (EngineUtil::hasLight(renderer))				//ʱֻ֧޹
-			pass = nullptr;
-		else
-			pass = renderer->getMaterial().getPass(ELM_ALWAYS);
-
-		driver->setShaderVariable("g_ObjectToWorld", renderer->getLocalToWorldMatrix());
-		driver->setShaderVariable("g_MatrixVP", matVP);
-		driver->setShaderVariable("g_MatrixV", matView);
-		driver->setShaderVariable("g_MatrixP", matProjection);
-
-		driver->draw(pass, unit->vbuffer, unit->ibuffer, unit->primType, unit->primCount, unit->drawParam);
+		const SRenderUnit* unit = units[i];
+
+		uint32_t numUnits = 1;
+		if (unit->instanceKey && driver->isSupportInstancing())
+		{
+			while (i + numUnits < (uint32_t)units.size() && units[i + numUnits]->instanceKey == unit->instanceKey)
+				++numUnits;
+		}
+
+		if (numUnits > 1)
+		{
+			drawInstanced(&units[i], numUnits);
+		}
+		else if (unit->primCount)
+		{
+			driver->setShaderVariable("g_ObjectToWorld", unit->renderer->getLocalToWorldMatrix());
+
+			driver->draw(getPass(unit), unit->vbuffer, unit->ibuffer, unit->primType, unit->primCount, unit->drawParam);
+		}
+
+		i += numUnits;
+	}
+}
+
+const CPass* CRenderLoop::getPass(const SRenderUnit* unit) const
+{
+	const IRenderer* renderer = unit->renderer;
+	const CPass* pass;
+	if (EngineUtil::hasLight(renderer))				//ʱֻ֧޹
+		pass = nullptr;
+	else
+		pass = getUnitMaterial(unit).getPass(ELM_ALWAYS);
+	return pass;
+}
+
+//units share buffers, draw param and material, their transforms go to the instance buffer in chunks
+void CRenderLoop::drawInstanced(const SRenderUnit* const* units, uint32_t numUnits)
+{
+	IVideoDriver* driver = g_Engine->getDriver();
+	const SRenderUnit* first = units[0];
+	if (!first->primCount)
+		return;
+
+	if (!m_InstanceBuffer)
+	{
+		m_InstanceBuffer = driver->createVertexBuffer(EMM_DYNAMIC);
+		m_InstanceBuffer->alloc<SVertex_Instance>(INSTANCE_BUFFER_SIZE);
+		m_Instances.resize(INSTANCE_BUFFER_SIZE);
+	}
+
+	const CPass* pass = getPass(first);
+	for (uint32_t start = 0; start < numUnits; start += INSTANCE_BUFFER_SIZE)
+	{
+		const uint32_t count = std::min(numUnits - start, (uint32_t)INSTANCE_BUFFER_SIZE);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const SRenderUnit* unit = units[start + i];
+			m_Instances[i].set(unit->renderer->getLocalToWorldMatrix().M, unit->color);
+		}
+		m_InstanceBuffer->updateBuffer(m_Instances.data(), count);
+
+		driver->drawInstanced(pass, first->vbuffer, first->ibuffer, m_InstanceBuffer, count, first->primType, first->primCount, first->drawParam);
 	}
 }
 
 void CRenderLoop::renderAfterOpaues(const CCamera* cam)
 {
-	std::sort(m_RenderUnits_AfterOpaque.begin(), m_RenderUnits_AfterOpaque.end(), AfterOpaqueCompare);
+	std::stable_sort(m_RenderUnits_AfterOpaque.begin(), m_RenderUnits_AfterOpaque.end(), AfterOpaqueCompare);
+
+	//camera variables are set by renderOpaques
+	//only instances already adjacent back to front are batched, e.g. the blended geosets of repeated nodes at the same distance
+	drawUnits(m_RenderUnits_AfterOpaque);
 }
 
 void CRenderLoop::processRenderUnit(SRenderUnit* unit)
@@ -2,12 +2,15 @@
 
 #include "ISceneNode.h"
 #include "RenderStruct.h"
+#include "S3DVertex.h"
 #include "CCanvas.h"
 #include <vector>
 #include <map>
 #include <algorithm>
 
 class CCamera;
+class CPass;
+class IVertexBuffer;
 
 class CRenderLoop
 {
@@ -31,6 +34,10 @@ private:
 
 	void processRenderUnit(SRenderUnit* unit);
 
+	const CPass* getPass(const SRenderUnit* unit) const;
+	void drawUnits(const std::vector<const SRenderUnit*>& units);
+	void drawInstanced(const SRenderUnit* const* units, uint32_t numUnits);
+
 private:
 	//
 	std::vector<const SRenderUnit*>		m_RenderUnits_Opaque;
@@ -38,4 +45,7 @@ private:
 
 	//
 	std::unique_ptr<CCanvas>		m_Canvas;
+
+	IVertexBuffer*		m_InstanceBuffer;			//transforms of the instanced units, created on first use
+	std::vector<SVertex_Instance>	m_Instances;
 };
\ No newline at end of file
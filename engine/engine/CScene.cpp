@@ -108,3 +108,37 @@ CM2SceneNode* CScene::addM2SceneNode(const char* filename)
 	return node;
 }
 
+ISceneNode* CScene::rayCast(const vector3df& start, const vector3df& dir, float maxDistance, float& distance) const
+{
+	ISceneNode* nearest = nullptr;
+	float best = maxDistance;
+	for (ISceneNode* sceneNode : m_SceneNodes)
+	{
+		sceneNode->traverse([&](ISceneNode* node)
+		{
+			float t;
+			if (node->activeSelf() && !node->isToDelete() && node->rayCast(start, dir, best, t))
+			{
+				best = t;
+				nearest = node;
+			}
+		});
+	}
+
+	if (nearest)
+		distance = best;
+	return nearest;
+}
+
+void CScene::querySphere(const vector3df& center, float radius, std::vector<ISceneNode*>& nodes) const
+{
+	for (ISceneNode* sceneNode : m_SceneNodes)
+	{
+		sceneNode->traverse([&](ISceneNode* node)
+		{
+			if (node->activeSelf() && !node->isToDelete() && node->intersectsSphere(center, radius))
+				nodes.push_back(node);
+		});
+	}
+}
+
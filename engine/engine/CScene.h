@@ -5,6 +5,7 @@
 #include "rect.h"
 #include <string>
 #include <list>
+#include <vector>
 
 class CCamera;
 class ISceneNode;
@@ -41,6 +42,11 @@ public:
 	CMeshSceneNode* addMeshSceneNode(const char* name);
 	CM2SceneNode* addM2SceneNode(const char* filename);
 
+	//nearest active node hit by start + dir * t, 0 <= t <= maxDistance, through the collision meshes of the nodes
+	ISceneNode* rayCast(const vector3df& start, const vector3df& dir, float maxDistance, float& distance) const;
+	//active nodes touching the sphere are appended
+	void querySphere(const vector3df& center, float radius, std::vector<ISceneNode*>& nodes) const;
+
 private:
 	std::string m_strName;
 	std::unique_ptr<CCamera>	m_p3DCamera;
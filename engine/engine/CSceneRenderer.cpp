@@ -8,6 +8,7 @@
 #include "CRenderLoop.h"
 #include "CRenderSetting.h"
 #include "ITexture.h"
+#include "CMeshManager.h"
 #include <algorithm>
 
 bool SceneNodeCompare(const ISceneNode* a, const ISceneNode* b)
@@ -77,6 +78,7 @@ void CSceneRenderer::renderFrame(const CScene* scene, bool active)
 				{
 					node->tick(tickTime, cam);
 				}
+				g_Engine->getMeshManager()->flushSkinning();
 
 				//cull renderers
 				camRender->CullResult.VisibleRenderers.clear();
@@ -97,8 +99,12 @@ void CSceneRenderer::renderFrame(const CScene* scene, bool active)
 				{
 					ISceneNode* node = renderer->getSceneNode();
 					std::list<SRenderUnit*> renderUnitList = node->render(renderer, cam);
+
+					//transparent units are sorted back to front by it
+					const float distance = cam->getPos().getDistanceFrom(renderer->getBoundingBox().getCenter());
 					for (SRenderUnit* renderUnit : renderUnitList)
 					{
+						renderUnit->distance = distance;
 						camRender->RenderLoop.addRenderUnit(renderUnit);
 					}
 				}
@@ -318,13 +318,25 @@ void CShaderUtil::getShaderMacroSet(const char* macroString, std::set<std::strin
 	std_string_split(macroString, '#', macroSet);
 }
 
-CShaderUtil::SShaderKey CShaderUtil::getShaderKey(const char* vsFile, const char* psFile, const char* macroString, E_VERTEX_TYPE vertexType)
+CShaderUtil::SShaderKey CShaderUtil::getShaderKey(const char* vsFile, const char* psFile, const char* macroString, E_VERTEX_TYPE vertexType, bool instancing)
 {
 	SShaderKey key(vsFile, psFile, macroString);
 	if (key.VSFile.empty())
 		key.VSFile = getDefaultVSFileName(vertexType);
 	if (key.PSFile.empty())
 		key.PSFile = getDefaultPSFileName(vertexType);
+
+	//vertex shader variant that decodes the packed attributes, instanced variant that reads the transform from the instance buffer
+	if (vertexType == EVT_PNT2WA_PACKED || instancing)
+	{
+		std::set<std::string> macroSet;
+		getShaderMacroSet(macroString, macroSet);
+		if (vertexType == EVT_PNT2WA_PACKED)
+			macroSet.insert("_PACKED_VERTEX_");
+		if (instancing)
+			macroSet.insert("_INSTANCING_");
+		key.MacroString = getShaderMacroString(macroSet);
+	}
 	return key;
 }
 
@@ -356,6 +368,7 @@ const char* CShaderUtil::getDefaultVSFileName(E_VERTEX_TYPE vType)
 	case EVT_PNCT2:
 		return "Default_PNCT";
 	case EVT_PNT2WA:
+	case EVT_PNT2WA_PACKED:
 		return "Default_PNT";
 	default:
 		break;
@@ -377,6 +390,7 @@ const char* CShaderUtil::getDefaultPSFileName(E_VERTEX_TYPE vType)
 	case EVT_PNCT2:
 		return "Default_PNCT";
 	case EVT_PNT2WA:
+	case EVT_PNT2WA_PACKED:
 		return "Default_PNT";
 	default:
 		break;
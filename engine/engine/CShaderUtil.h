@@ -44,7 +44,7 @@ public:
 		}
 	};
 
-	static SShaderKey getShaderKey(const char* vsFile, const char* psFile, const char* macroString, E_VERTEX_TYPE vertexType);
+	static SShaderKey getShaderKey(const char* vsFile, const char* psFile, const char* macroString, E_VERTEX_TYPE vertexType, bool instancing = false);
 	static int getShaderProgramSortId(const char* vsFile, const char* psFile, const char* macroString, E_VERTEX_TYPE vertexType);
 
 	static const char* getDefaultVSFileName(E_VERTEX_TYPE vType);
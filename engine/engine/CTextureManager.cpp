@@ -6,15 +6,19 @@
 #include "wowEnvironment.h"
 #include "CBLPImage.h"
 #include "CMemFile.h"
+#include "CCharTextureCompositor.h"
 
 CTextureManager::CTextureManager(wowEnvironment* wowEnv)
 	: WowEnv(wowEnv)
 {
+	CharTextureCompositor = new CCharTextureCompositor(this);
 	loadDefaultTextures();
 }
 
 CTextureManager::~CTextureManager()
 {
+	delete CharTextureCompositor;
+
 	for (auto itr = TextureMap.begin(); itr != TextureMap.end(); ++itr)
 	{
 		itr->second.reset();
@@ -13,6 +13,7 @@ class ITexture;
 class IRenderTarget;
 class IImage;
 class wowEnvironment;
+class CCharTextureCompositor;
 
 class CTextureManager
 {
@@ -30,6 +31,8 @@ public:
 
 	std::shared_ptr<ITexture> loadTexture(const char* filename, bool mipmap);
 
+	CCharTextureCompositor* getCharTextureCompositor() const { return CharTextureCompositor; }
+
 public:
 	std::shared_ptr<ITexture> getTextureWhite() const
 	{
@@ -45,6 +48,7 @@ private:
 
 private:
 	wowEnvironment*		WowEnv;
+	CCharTextureCompositor*		CharTextureCompositor;
 
 	std::map<std::string, std::shared_ptr<ITexture>>	TextureMap;
 	std::list<IRenderTarget*>	RenderTargets;
@@ -28,6 +28,10 @@ public:
 	virtual void tick(uint32_t tickTime, const CCamera* cam) {}
 	virtual std::list<SRenderUnit*> render(const IRenderer* renderer, const CCamera* cam) = 0;
 
+	//world space queries against the collision mesh of the node, nodes without one are never hit
+	virtual bool rayCast(const vector3df& start, const vector3df& dir, float maxDistance, float& distance) const { return false; }
+	virtual bool intersectsSphere(const vector3df& center, float radius) const { return false; }
+
 public:
 	void setParent(ISceneNode* parent)
 	{
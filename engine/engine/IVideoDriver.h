@@ -93,6 +93,7 @@ public:
 		CurrentRenderTarget = nullptr;
 
 		IsSupportDepthTexture = false;
+		IsSupportInstancing = false;
 		IsMultiSampleEnabled = false;
 
 		PrimitivesDrawn = 0;
@@ -118,6 +119,7 @@ public:
 	bool isFXAAEnabled() const { return DriverSetting.aaMode >= E_AA_FXAA && DriverSetting.aaMode <= E_AA_FXAA; }
 	bool isMultiSampleEnabled() const { return IsMultiSampleEnabled; }
 	bool isSupportDepthTexture() const { return IsSupportDepthTexture; }
+	bool isSupportInstancing() const { return IsSupportInstancing; }
 
 	void setShaderVariable(const char* name, const float* src, uint32_t size);
 	void setShaderVariable(const char* name, const matrix4& mat) { setShaderVariable(name, mat.M, 16); }
@@ -141,6 +143,13 @@ public:
 		uint32_t primCount,
 		const SDrawParam& drawParam) = 0;
 
+	//the same primitives numInstances times, instanceBuffer holds an EVT_INSTANCE vertex per instance
+	virtual void drawInstanced(const CPass* pass, const IVertexBuffer* vbuffer, const IIndexBuffer* ibuffer,
+		const IVertexBuffer* instanceBuffer, uint32_t numInstances,
+		E_PRIMITIVE_TYPE primType,
+		uint32_t primCount,
+		const SDrawParam& drawParam) = 0;
+
 public:
 	virtual IVertexBuffer* createVertexBuffer(E_MESHBUFFER_MAPPING mapping) = 0;
 	virtual IIndexBuffer* createIndexBuffer(E_MESHBUFFER_MAPPING mapping) = 0;
@@ -182,6 +191,7 @@ protected:
 
 	bool	IsMultiSampleEnabled;
 	bool	IsSupportDepthTexture;
+	bool	IsSupportInstancing;
 };
 
 inline void IVideoDriver::setShaderVariable(const char* name, const float* src, uint32_t size)
@@ -2,10 +2,12 @@
 
 #include "base.h"
 #include "matrix4.h"
+#include "SColor.h"
 
 class IVertexBuffer;
 class IIndexBuffer;
 class IRenderer;
+class CMaterial;
 
 enum E_2DBlendMode : int8_t
 {
@@ -96,6 +98,9 @@ struct SRenderUnit
 		primType = EPT_TRIANGLES;
 		distance = 0;
 		shaderSortId = 0;
+		material = nullptr;
+		instanceKey = nullptr;
+		color = SColor::White();
 	}
 
 	const IRenderer* renderer;
@@ -107,4 +112,8 @@ struct SRenderUnit
 	float distance;
 	int shaderSortId;
 
+	const CMaterial* material;			//null for the material of the renderer
+	const void* instanceKey;			//units with the same key have the same buffers, draw param and material, null if not instanced
+	SColor color;			//per instance color of instanced draws
+
 };
\ No newline at end of file
@@ -263,6 +263,7 @@ bool COpenGLDriver::initDriver(const SWindowInfo& wndInfo, bool vsync, E_AA_MODE
 
 	IsMultiSampleEnabled = (DriverSetting.aaMode >= E_AA_MSAA_1 && DriverSetting.aaMode <= E_AA_MSAA_4) && GLExtension.MultisampleSupported;
 	IsSupportDepthTexture = GLExtension.queryOpenGLFeature(IRR_ARB_depth_texture);
+	IsSupportInstancing = GLExtension.canUseInstancing();
 
 	g_FileSystem->writeLog(ELOG_GX,
 		"IsMultiSampleEnabled : %d, IsFxAAEnabled: %d",
@@ -555,11 +556,12 @@ bool COpenGLDriver::reset()
 	return true;
 }
 
-void COpenGLDriver::setVertexDeclarationAndBuffers(const CGLProgram* program, const IVertexBuffer* vbuffer0, uint32_t offset0, const IIndexBuffer* ibuffer)
+void COpenGLDriver::setVertexDeclarationAndBuffers(const CGLProgram* program, const IVertexBuffer* vbuffer0, uint32_t offset0, const IIndexBuffer* ibuffer,
+	const IVertexBuffer* instanceBuffer)
 {
 	COpenGLVertexDeclaration* decl = getVertexDeclaration(vbuffer0->getVertexType());
 	ASSERT(decl);
-	decl->apply(program, vbuffer0, offset0);
+	decl->apply(program, vbuffer0, offset0, instanceBuffer);
 
 	if (ibuffer)
 	{
@@ -750,10 +752,65 @@ void COpenGLDriver::draw(const CPass* pass, const IVertexBuffer* vbuffer, const
 	drawIndexedPrimitive(vbuffer, ibuffer, program, primType, primCount, drawParam);
 }
 
+void COpenGLDriver::drawInstanced(const CPass* pass, const IVertexBuffer* vbuffer, const IIndexBuffer* ibuffer,
+	const IVertexBuffer* instanceBuffer, uint32_t numInstances, E_PRIMITIVE_TYPE primType, uint32_t primCount, const SDrawParam& drawParam)
+{
+	ASSERT(pass && pass->getMaterial());
+	ASSERT(IsSupportInstancing && ibuffer && instanceBuffer);
+	ASSERT(IVideoResource::hasVideoBuilt(vbuffer));
+	ASSERT(IVideoResource::hasVideoBuilt(ibuffer));
+	ASSERT(IVideoResource::hasVideoBuilt(instanceBuffer));
+
+	if (!drawParam.numVertices || drawParam.numVertices >= 65536 || !primCount || drawParam.baseVertIndex ||
+		!numInstances || numInstances > instanceBuffer->getNumVertices())
+	{
+		ASSERT(false);
+		return;
+	}
+
+	const CGLProgram* program = ShaderManageComponent->applyShaders(pass, vbuffer->getVertexType(), true);
+	MaterialRenderComponent->setRenderStates(pass, GlobalMaterial, program);
+
+	ShaderManageComponent->setShaderVariables(program, pass->getMaterial());
+
+	MaterialRenderComponent->applyRenderStates();
+
+	GLenum type = GL_UNSIGNED_SHORT;
+	uint32_t indexSize = 2;
+	if (ibuffer->getIndexType() == EIT_32BIT)
+	{
+		type = GL_UNSIGNED_INT;
+		indexSize = 4;
+	}
+
+	setVertexDeclarationAndBuffers(program,
+		vbuffer, drawParam.voffset,
+		ibuffer, instanceBuffer);
+
+	GLExtension.extGlDrawElementsInstanced(COpenGLHelper::getGLTopology(primType),
+		getIndexCount(primType, primCount),
+		type,
+		COpenGLHelper::buffer_offset(indexSize * drawParam.startIndex),
+		numInstances);
+
+	if (primType == EPT_TRIANGLES || primType == EPT_TRIANGLE_STRIP)
+	{
+		PrimitivesDrawn += primCount * numInstances;
+	}
+
+	++DrawCall;
+}
+
 void COpenGLDriver::deleteVao(const IVertexBuffer* vbuffer)
 {
 	E_VERTEX_TYPE vType = vbuffer->getVertexType();
-	if (vType != EVT_INVALID)
+	if (vType == EVT_INSTANCE)
+	{
+		//instance buffers are bound in the vaos of every vertex type
+		for (int i = 0; i < EVT_COUNT; ++i)
+			VertexDeclarations[i]->deleteVao(vbuffer);
+	}
+	else if (vType != EVT_INVALID)
 	{
 		VertexDeclarations[vType]->deleteVao(vbuffer);
 	}
@@ -42,6 +42,12 @@ public:
 		uint32_t primCount,
 		const SDrawParam& drawParam) override;
 
+	void drawInstanced(const CPass* pass, const IVertexBuffer* vbuffer, const IIndexBuffer* ibuffer,
+		const IVertexBuffer* instanceBuffer, uint32_t numInstances,
+		E_PRIMITIVE_TYPE primType,
+		uint32_t primCount,
+		const SDrawParam& drawParam) override;
+
 public:
 	IVertexBuffer* createVertexBuffer(E_MESHBUFFER_MAPPING mapping) override;
 	IIndexBuffer* createIndexBuffer(E_MESHBUFFER_MAPPING mapping) override;
@@ -67,7 +73,8 @@ private:
 
 	//
 	COpenGLVertexDeclaration* getVertexDeclaration(E_VERTEX_TYPE type) const { return VertexDeclarations[type].get(); }
-	void setVertexDeclarationAndBuffers(const CGLProgram* program, const IVertexBuffer* vbuffer0, uint32_t offset0, const IIndexBuffer* ibuffer);
+	void setVertexDeclarationAndBuffers(const CGLProgram* program, const IVertexBuffer* vbuffer0, uint32_t offset0, const IIndexBuffer* ibuffer,
+		const IVertexBuffer* instanceBuffer = nullptr);
 	void drawIndexedPrimitive(const IVertexBuffer* vbuffer, const IIndexBuffer* ibuffer, const CGLProgram* program,
 		E_PRIMITIVE_TYPE primType,
 		uint32_t primCount,
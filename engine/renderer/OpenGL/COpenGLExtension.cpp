@@ -479,6 +479,8 @@ COpenGLExtension::COpenGLExtension()
 	pGlDrawRangeElements = nullptr;
 	pGlDrawElementsBaseVertex = nullptr;
 	pGlDrawRangeElementsBaseVertex = nullptr;
+	pGlDrawElementsInstanced = nullptr;
+	pGlVertexAttribDivisor = nullptr;
 
 	pGlGetProgramBinary = nullptr;
 	pGlProgramBinary = nullptr;
@@ -744,6 +746,13 @@ bool COpenGLExtension::initExtFunctions()
 	pGlDrawElementsBaseVertex = (PFNGLDRAWELEMENTSBASEVERTEXPROC)getProcAddress("glDrawElementsBaseVertex");
 	pGlDrawRangeElementsBaseVertex = (PFNGLDRAWRANGEELEMENTSBASEVERTEXPROC)getProcAddress("glDrawRangeElementsBaseVertex");
 
+	// instancing
+	if (queryOpenGLFeature(IRR_ARB_draw_instanced) && queryOpenGLFeature(IRR_ARB_instanced_arrays))
+	{
+		pGlDrawElementsInstanced = (PFNGLDRAWELEMENTSINSTANCEDPROC)getProcAddress("glDrawElementsInstanced");
+		pGlVertexAttribDivisor = (PFNGLVERTEXATTRIBDIVISORPROC)getProcAddress("glVertexAttribDivisor");
+	}
+
 	// vao
 	pGlGenVertexArrays = (PFNGLGENVERTEXARRAYSPROC)getProcAddress("glGenVertexArrays");
 	pGlDeleteVertexArrays = (PFNGLDELETEVERTEXARRAYSPROC)getProcAddress("glDeleteVertexArrays");
@@ -1167,6 +1176,12 @@ void COpenGLExtension::extGlDrawElementsBaseVertex(GLenum mode, GLsizei count, G
 	CHECK_OPENGL_ERROR("extGlDrawElementsBaseVertex");
 }
 
+void COpenGLExtension::extGlDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const GLvoid *indices, GLsizei instancecount) const
+{
+	pGlDrawElementsInstanced(mode, count, type, indices, instancecount);
+	CHECK_OPENGL_ERROR("extGlDrawElementsInstanced");
+}
+
 void COpenGLExtension::extGlDrawRangeElementsBaseVertex(GLenum mode, GLuint start, GLuint end, GLsizei count, GLenum type, const GLvoid *indices, GLint basevertex) const
 {
 	pGlDrawRangeElementsBaseVertex(mode, start, end, count, type, indices, basevertex);
@@ -1209,6 +1224,12 @@ void COpenGLExtension::extGlVertexAttribPointerARB(GLuint index, GLint size, GLe
 	CHECK_OPENGL_ERROR("extGlVertexAttribPointerARB");
 }
 
+void COpenGLExtension::extGlVertexAttribDivisor(GLuint index, GLuint divisor) const
+{
+	pGlVertexAttribDivisor(index, divisor);
+	CHECK_OPENGL_ERROR("extGlVertexAttribDivisor");
+}
+
 GLint COpenGLExtension::extGlGetAttribLocationARB(GLhandleARB programObj, const GLcharARB *name) const
 {
 	GLint v = pGlGetAttribLocationARB(programObj, name);
@@ -1237,6 +1258,11 @@ bool COpenGLExtension::canUseVAO() const
 	return ShaderLanguageVersion >= 303 && queryOpenGLFeature(IRR_ARB_vertex_array_object);
 }
 
+bool COpenGLExtension::canUseInstancing() const
+{
+	return canUseVAO() && pGlDrawElementsInstanced && pGlVertexAttribDivisor;
+}
+
 bool COpenGLExtension::checkFBOStatus() const
 {
 	if (!queryOpenGLFeature(IRR_EXT_framebuffer_object))
@@ -377,6 +377,7 @@ public:
 	}
 
 	bool canUseVAO() const;
+	bool canUseInstancing() const;
 
 	bool checkFBOStatus() const;
 
@@ -452,6 +453,7 @@ public:
 	void extGlDrawRangeElements(GLenum mode, GLuint start, GLuint end, GLsizei count, GLenum type, const GLvoid *indices) const;
 	void extGlDrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const GLvoid *indices, GLint basevertex) const;
 	void extGlDrawRangeElementsBaseVertex(GLenum mode, GLuint start, GLuint end, GLsizei count, GLenum type, const GLvoid *indices, GLint basevertex) const;
+	void extGlDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const GLvoid *indices, GLsizei instancecount) const;
 
 	void extGlGenVertexArrays(GLsizei n, GLuint *arrays) const;
 	void extGlDeleteVertexArrays(GLsizei n, const GLuint *arrays) const;
@@ -459,6 +461,7 @@ public:
 	void extGlEnableVertexAttribArrayARB(GLuint index) const;
 	void extGlDisableVertexAttribArrayARB(GLuint index) const;
 	void extGlVertexAttribPointerARB(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid *pointer) const;
+	void extGlVertexAttribDivisor(GLuint index, GLuint divisor) const;
 	GLint extGlGetAttribLocationARB(GLhandleARB programObj, const GLcharARB *name) const;
 
 	void extGlTexImage2DMultisample(GLenum target, GLsizei samples, GLint internalformat, GLsizei width, GLsizei height, GLboolean fixedsamplelocations) const;
@@ -551,6 +554,8 @@ private:
 	PFNGLDRAWRANGEELEMENTSPROC pGlDrawRangeElements;
 	PFNGLDRAWELEMENTSBASEVERTEXPROC	pGlDrawElementsBaseVertex;
 	PFNGLDRAWRANGEELEMENTSBASEVERTEXPROC	pGlDrawRangeElementsBaseVertex;
+	PFNGLDRAWELEMENTSINSTANCEDPROC	pGlDrawElementsInstanced;
+	PFNGLVERTEXATTRIBDIVISORPROC	pGlVertexAttribDivisor;
 
 	PFNGLGENVERTEXARRAYSPROC		pGlGenVertexArrays;
 	PFNGLDELETEVERTEXARRAYSPROC	pGlDeleteVertexArrays;
@@ -46,10 +46,10 @@ bool COpenGLShaderManageComponent::init()
 	return true;
 }
 
-const CGLProgram* COpenGLShaderManageComponent::applyShaders(const CPass* pass, E_VERTEX_TYPE vertexType)
+const CGLProgram* COpenGLShaderManageComponent::applyShaders(const CPass* pass, E_VERTEX_TYPE vertexType, bool instancing)
 {
 	auto shaderKey = CShaderUtil::getShaderKey(
-		pass->VSFile.c_str(), pass->PSFile.c_str(), CShaderUtil::getShaderMacroString(pass->MacroSet).c_str(), vertexType);
+		pass->VSFile.c_str(), pass->PSFile.c_str(), CShaderUtil::getShaderMacroString(pass->MacroSet).c_str(), vertexType, instancing);
 
 	const COpenGLVertexShader* vertexShader = getVertexShader(shaderKey.VSFile.c_str(), shaderKey.MacroString.c_str());
 	const COpenGLPixelShader* pixelShader = getPixelShader(shaderKey.PSFile.c_str(), shaderKey.MacroString.c_str());
@@ -113,7 +113,7 @@ public:
 public:
 	bool init();
 
-	const CGLProgram* applyShaders(const CPass* pass, E_VERTEX_TYPE vertexType);
+	const CGLProgram* applyShaders(const CPass* pass, E_VERTEX_TYPE vertexType, bool instancing = false);
 	const COpenGLVertexShader* getVertexShader(const char* fileName, const char* macroString = "");
 	const COpenGLPixelShader* getPixelShader(const char* fileName, const char* macroString = "");
 
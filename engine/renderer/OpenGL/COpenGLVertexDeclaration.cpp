@@ -16,6 +16,11 @@
 #define NAME_BLENDINDICES		"BlendIndices"
 #define NAME_BINORMAL		"Binormal"
 #define NAME_TANGENT		"Tangent"
+#define NAME_INSTANCEROW0		"InstanceRow0"
+#define NAME_INSTANCEROW1		"InstanceRow1"
+#define NAME_INSTANCEROW2		"InstanceRow2"
+#define NAME_INSTANCEROW3		"InstanceRow3"
+#define NAME_INSTANCECOLOR		"InstanceColor"
 
 #define buffer_offset COpenGLHelper::buffer_offset
 
@@ -34,7 +39,7 @@ COpenGLVertexDeclaration::~COpenGLVertexDeclaration()
 	VaoMap.clear();
 }
 
-void COpenGLVertexDeclaration::apply(const CGLProgram* program, const IVertexBuffer* vbuffer0, uint32_t offset0)
+void COpenGLVertexDeclaration::apply(const CGLProgram* program, const IVertexBuffer* vbuffer0, uint32_t offset0, const IVertexBuffer* instanceBuffer)
 {
 	if (Driver->GLExtension.canUseVAO())
 	{
@@ -42,6 +47,7 @@ void COpenGLVertexDeclaration::apply(const CGLProgram* program, const IVertexBuf
 		param.program = program;
 		param.vbuffer0 = vbuffer0;
 		param.offset0 = offset0;
+		param.instanceBuffer = instanceBuffer;
 
 		GLuint vao = getVao(param);
 		Driver->GLExtension.extGlBindVertexArray(vao);
@@ -50,7 +56,7 @@ void COpenGLVertexDeclaration::apply(const CGLProgram* program, const IVertexBuf
 	{
 		const SVertexInfo& vertexInfo = getVertexInfo(program);
 
-		ASSERT(vbuffer0);
+		ASSERT(vbuffer0 && !instanceBuffer);
 		Driver->GLExtension.extGlBindBuffer(GL_ARRAY_BUFFER, static_cast<const COpenGLVertexBuffer*>(vbuffer0)->getHWBuffer());
 
 		applyVbo(vertexInfo, offset0);
@@ -71,11 +77,14 @@ void COpenGLVertexDeclaration::unapply()
 
 void COpenGLVertexDeclaration::deleteVao(const IVertexBuffer* vbuffer0)
 {
-	ASSERT(vbuffer0->getVertexType() == VertexType);
+	ASSERT(vbuffer0->getVertexType() == VertexType || vbuffer0->getVertexType() == EVT_INSTANCE);
 	for (auto itr = VaoMap.begin(); itr != VaoMap.end();)
 	{
-		if (itr->first.vbuffer0 == vbuffer0)
+		if (itr->first.vbuffer0 == vbuffer0 || itr->first.instanceBuffer == vbuffer0)
+		{
+			Driver->GLExtension.extGlDeleteVertexArrays(1, &itr->second);
 			VaoMap.erase(itr++);
+		}
 		else
 			++itr;
 	}
@@ -88,7 +97,7 @@ GLuint COpenGLVertexDeclaration::createVao(const SVAOParam& param)
 
 	Driver->GLExtension.extGlBindVertexArray(vao);
 
-	bindVbo(param.program, param.vbuffer0, param.offset0);
+	bindVbo(param.program, param.vbuffer0, param.offset0, param.instanceBuffer);
 
 	Driver->GLExtension.extGlBindVertexArray(0);
 
@@ -130,6 +139,9 @@ COpenGLVertexDeclaration::SVertexInfo COpenGLVertexDeclaration::createVertexInfo
 	case EVT_PNT2WA:
 		vertexInfo = createVertexInfo_PNT2WA(program);
 		break;
+	case EVT_PNT2WA_PACKED:
+		vertexInfo = createVertexInfo_PNT2WA_Packed(program);
+		break;
 	default:
 		ASSERT(false);
 		break;
@@ -151,7 +163,18 @@ const COpenGLVertexDeclaration::SVertexInfo& COpenGLVertexDeclaration::getVertex
 	return itr->second;
 }
 
-void COpenGLVertexDeclaration::bindVbo(const CGLProgram* program, const IVertexBuffer* vbuffer0, uint32_t offset0)
+const COpenGLVertexDeclaration::SVertexInfo& COpenGLVertexDeclaration::getInstanceInfo(const CGLProgram* program)
+{
+	auto itr = InstanceInfoMap.find(program);
+	if (itr == InstanceInfoMap.end())
+	{
+		InstanceInfoMap[program] = createVertexInfo_Instance(program);
+		return InstanceInfoMap[program];
+	}
+	return itr->second;
+}
+
+void COpenGLVertexDeclaration::bindVbo(const CGLProgram* program, const IVertexBuffer* vbuffer0, uint32_t offset0, const IVertexBuffer* instanceBuffer)
 {
 	ASSERT(vbuffer0);
 	Driver->GLExtension.extGlBindBuffer(GL_ARRAY_BUFFER, static_cast<const COpenGLVertexBuffer*>(vbuffer0)->getHWBuffer());
@@ -160,6 +183,14 @@ void COpenGLVertexDeclaration::bindVbo(const CGLProgram* program, const IVertexB
 
 	applyVbo(vertexInfo, offset0);
 
+	if (instanceBuffer)
+	{
+		ASSERT(instanceBuffer->getVertexType() == EVT_INSTANCE);
+		Driver->GLExtension.extGlBindBuffer(GL_ARRAY_BUFFER, static_cast<const COpenGLVertexBuffer*>(instanceBuffer)->getHWBuffer());
+
+		applyVbo(getInstanceInfo(program), 0, 1);
+	}
+
 	Driver->GLExtension.extGlBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
@@ -357,14 +388,14 @@ COpenGLVertexDeclaration::SVertexInfo COpenGLVertexDeclaration::createVertexInfo
 
 	//weight
 	{
-		SElementInfo element(40, 3, GL_FLOAT, GL_FALSE);
+		SElementInfo element(40, 4, GL_UNSIGNED_BYTE, GL_TRUE);
 		element.location = (int32_t)Driver->GLExtension.extGlGetAttribLocationARB(program->handle, NAME_WEIGHT);
 		vertexInfo.elementInfos.emplace_back(element);
 	}
 
 	//blendindices
 	{
-		SElementInfo element(52, 4, GL_UNSIGNED_BYTE, GL_FALSE);
+		SElementInfo element(44, 4, GL_UNSIGNED_BYTE, GL_FALSE);
 		element.location = (int32_t)Driver->GLExtension.extGlGetAttribLocationARB(program->handle, NAME_BLENDINDICES);
 		vertexInfo.elementInfos.emplace_back(element);
 	}
@@ -372,7 +403,81 @@ COpenGLVertexDeclaration::SVertexInfo COpenGLVertexDeclaration::createVertexInfo
 	return vertexInfo;
 }
 
-void COpenGLVertexDeclaration::applyVbo(const SVertexInfo & vertexInfo, uint32_t offset0)
+COpenGLVertexDeclaration::SVertexInfo COpenGLVertexDeclaration::createVertexInfo_PNT2WA_Packed(const CGLProgram* program)
+{
+	SVertexInfo vertexInfo;
+	vertexInfo.vertexSize = sizeof(SVertex_PNT2WA_Packed);
+
+	//position
+	{
+		SElementInfo element(0, 3, GL_FLOAT, GL_FALSE);
+		element.location = (int32_t)Driver->GLExtension.extGlGetAttribLocationARB(program->handle, NAME_POS);
+		vertexInfo.elementInfos.emplace_back(element);
+	}
+
+	//normal, octahedral
+	{
+		SElementInfo element(12, 2, GL_SHORT, GL_TRUE);
+		element.location = (int32_t)Driver->GLExtension.extGlGetAttribLocationARB(program->handle, NAME_NORMAL);
+		vertexInfo.elementInfos.emplace_back(element);
+	}
+
+	//tex0
+	{
+		SElementInfo element(16, 2, GL_HALF_FLOAT, GL_FALSE);
+		element.location = (int32_t)Driver->GLExtension.extGlGetAttribLocationARB(program->handle, NAME_TEX0);
+		vertexInfo.elementInfos.emplace_back(element);
+	}
+
+	//tex1
+	{
+		SElementInfo element(20, 2, GL_HALF_FLOAT, GL_FALSE);
+		element.location = (int32_t)Driver->GLExtension.extGlGetAttribLocationARB(program->handle, NAME_TEX1);
+		vertexInfo.elementInfos.emplace_back(element);
+	}
+
+	//weight
+	{
+		SElementInfo element(24, 4, GL_UNSIGNED_BYTE, GL_TRUE);
+		element.location = (int32_t)Driver->GLExtension.extGlGetAttribLocationARB(program->handle, NAME_WEIGHT);
+		vertexInfo.elementInfos.emplace_back(element);
+	}
+
+	//blendindices
+	{
+		SElementInfo element(28, 4, GL_UNSIGNED_BYTE, GL_FALSE);
+		element.location = (int32_t)Driver->GLExtension.extGlGetAttribLocationARB(program->handle, NAME_BLENDINDICES);
+		vertexInfo.elementInfos.emplace_back(element);
+	}
+
+	return vertexInfo;
+}
+
+COpenGLVertexDeclaration::SVertexInfo COpenGLVertexDeclaration::createVertexInfo_Instance(const CGLProgram* program)
+{
+	SVertexInfo vertexInfo;
+	vertexInfo.vertexSize = sizeof(SVertex_Instance);
+
+	//transform rows
+	const char* rowNames[4] = { NAME_INSTANCEROW0, NAME_INSTANCEROW1, NAME_INSTANCEROW2, NAME_INSTANCEROW3 };
+	for (int i = 0; i < 4; ++i)
+	{
+		SElementInfo element(16 * i, 4, GL_FLOAT, GL_FALSE);
+		element.location = (int32_t)Driver->GLExtension.extGlGetAttribLocationARB(program->handle, rowNames[i]);
+		vertexInfo.elementInfos.emplace_back(element);
+	}
+
+	//color
+	{
+		SElementInfo element(64, 4, GL_UNSIGNED_BYTE, GL_TRUE);
+		element.location = (int32_t)Driver->GLExtension.extGlGetAttribLocationARB(program->handle, NAME_INSTANCECOLOR);
+		vertexInfo.elementInfos.emplace_back(element);
+	}
+
+	return vertexInfo;
+}
+
+void COpenGLVertexDeclaration::applyVbo(const SVertexInfo & vertexInfo, uint32_t offset0, GLuint divisor)
 {
 	for (const auto& elementInfo : vertexInfo.elementInfos)
 	{
@@ -381,6 +486,8 @@ void COpenGLVertexDeclaration::applyVbo(const SVertexInfo & vertexInfo, uint32_t
 		{
 			Driver->GLExtension.extGlEnableVertexAttribArrayARB(index);
 			Driver->GLExtension.extGlVertexAttribPointerARB(index, elementInfo.size, elementInfo.type, elementInfo.normalized, vertexInfo.vertexSize, buffer_offset(elementInfo.vOffset + vertexInfo.vertexSize * offset0));
+			if (divisor)
+				Driver->GLExtension.extGlVertexAttribDivisor(index, divisor);
 		}
 	}
 }
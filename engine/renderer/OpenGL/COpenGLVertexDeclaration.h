@@ -17,9 +17,11 @@ public:
 	~COpenGLVertexDeclaration();
 
 public:
-	void apply(const CGLProgram* program, const IVertexBuffer* vbuffer0, uint32_t offset0);
+	//instanceBuffer holds SVertex_Instance with a divisor of 1, it needs vao
+	void apply(const CGLProgram* program, const IVertexBuffer* vbuffer0, uint32_t offset0, const IVertexBuffer* instanceBuffer = nullptr);
 	void unapply();
 
+	//vaos using vbuffer0 as vertex or instance buffer
 	void deleteVao(const IVertexBuffer* vbuffer0);
 
 private:
@@ -28,6 +30,7 @@ private:
 		const CGLProgram* program;
 		const IVertexBuffer* vbuffer0;
 		uint32_t offset0;
+		const IVertexBuffer* instanceBuffer;
 
 		bool operator<(const SVAOParam& other) const
 		{
@@ -35,15 +38,18 @@ private:
 				return program < other.program;
 			else if (vbuffer0 != other.vbuffer0)
 				return vbuffer0 < other.vbuffer0;
-			else
+			else if (offset0 != other.offset0)
 				return offset0 < other.offset0;
+			else
+				return instanceBuffer < other.instanceBuffer;
 		}
 
 		bool operator==(const SVAOParam& other) const
 		{
 			return program == other.program &&
 				vbuffer0 == other.vbuffer0 &&
-				offset0 == other.offset0;
+				offset0 == other.offset0 &&
+				instanceBuffer == other.instanceBuffer;
 		}
 	};
 
@@ -73,9 +79,10 @@ private:
 
 	SVertexInfo createVertexInfo(const CGLProgram* program);
 	const SVertexInfo& getVertexInfo(const CGLProgram* program);
+	const SVertexInfo& getInstanceInfo(const CGLProgram* program);
 
 private:
-	void bindVbo(const CGLProgram* program, const IVertexBuffer* vbuffer0, uint32_t offset0);
+	void bindVbo(const CGLProgram* program, const IVertexBuffer* vbuffer0, uint32_t offset0, const IVertexBuffer* instanceBuffer);
 
 private:
 	SVertexInfo createVertexInfo_PC(const CGLProgram* program);
@@ -84,8 +91,10 @@ private:
 	SVertexInfo createVertexInfo_PNCT(const CGLProgram* program);
 	SVertexInfo createVertexInfo_PNCT2(const CGLProgram* program);
 	SVertexInfo createVertexInfo_PNT2WA(const CGLProgram* program);
+	SVertexInfo createVertexInfo_PNT2WA_Packed(const CGLProgram* program);
+	SVertexInfo createVertexInfo_Instance(const CGLProgram* program);
 
-	void applyVbo(const SVertexInfo& vertexInfo, uint32_t offset0);
+	void applyVbo(const SVertexInfo& vertexInfo, uint32_t offset0, GLuint divisor = 0);
 
 private:
 	E_VERTEX_TYPE		VertexType;
@@ -93,5 +102,6 @@ private:
 
 	std::map<SVAOParam, GLuint>		VaoMap;
 	std::map<const CGLProgram*, SVertexInfo>		VInfoMap;
+	std::map<const CGLProgram*, SVertexInfo>		InstanceInfoMap;
 
 };
\ No newline at end of file
@@ -0,0 +1,20 @@
+#version 150
+
+#include "../includes/PSCommon.glsl"
+
+in mediump vec2 v_Tex0;
+in vec3 v_Normal;
+#ifdef _INSTANCING_
+in mediump vec4 v_InstanceColor;
+#endif
+
+uniform sampler2D _MainTex;
+
+void main(void)
+{
+	mediump vec4 color = texture2D(_MainTex, v_Tex0);
+#ifdef _INSTANCING_
+	color *= v_InstanceColor;
+#endif
+	SV_Target0 = color;
+}
\ No newline at end of file
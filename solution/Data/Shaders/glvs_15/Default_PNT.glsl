@@ -0,0 +1,34 @@
+#version 150
+
+#include "../includes/VSCommon.glsl"
+
+in vec3 Pos;
+#ifdef _PACKED_VERTEX_
+in vec2 Normal;
+#else
+in vec3 Normal;
+#endif
+in mediump vec2 Tex0;
+
+out vec3 v_Normal;
+out mediump vec2 v_Tex0;
+#ifdef _INSTANCING_
+out mediump vec4 v_InstanceColor;
+#endif
+
+void main(void)
+{
+	gl_Position = g_ObjectToClipPos(Pos);
+
+#ifdef _PACKED_VERTEX_
+	v_Normal = Mul(mat3(g_ObjectToWorld), DecodeOctNormal(Normal));
+#else
+	v_Normal = Mul(mat3(g_ObjectToWorld), Normal);
+#endif
+
+	v_Tex0.xy = Tex0.xy;
+
+#ifdef _INSTANCING_
+	v_InstanceColor = InstanceColor.zyxw;
+#endif
+}
\ No newline at end of file
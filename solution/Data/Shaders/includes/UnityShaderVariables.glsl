@@ -11,7 +11,9 @@
 #define CBUFFER_START(name) struct name {
 #define CBUFFER_END };
 
+#ifndef _INSTANCING_
 uniform mat4 g_ObjectToWorld;
+#endif
 uniform mat4 g_MatrixVP;
 uniform mat4 g_MatrixV;
 uniform mat4 g_MatrixInvV;
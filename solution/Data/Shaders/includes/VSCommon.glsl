@@ -4,6 +4,17 @@
 #include "UnityShaderVariables.glsl"
 #include "Lighting.glsl"
 
+#ifdef _INSTANCING_
+//rows of the object to world matrix and the color of the instance
+in vec4 InstanceRow0;
+in vec4 InstanceRow1;
+in vec4 InstanceRow2;
+in vec4 InstanceRow3;
+in mediump vec4 InstanceColor;
+
+#define g_ObjectToWorld transpose(mat4(InstanceRow0, InstanceRow1, InstanceRow2, InstanceRow3))
+#endif
+
 vec3 Mul( mat3 matrix, vec3 pos )
 {
 	vec3 vResult = pos * matrix;
@@ -22,4 +33,12 @@ vec4 g_ObjectToClipPos(vec3 pos)
     return Mul(UNITY_MATRIX_VP, Mul(g_ObjectToWorld, vec4(pos, 1.0)));
 }
 
+vec3 DecodeOctNormal(vec2 oct)
+{
+	vec3 n = vec3(oct.xy, 1.0 - abs(oct.x) - abs(oct.y));
+	if (n.z < 0.0)
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(n);
+}
+
 #endif
\ No newline at end of file
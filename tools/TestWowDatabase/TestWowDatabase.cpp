@@ -3,6 +3,8 @@
 #include <regex>
 #include <iostream>
 #include <list>
+#include <random>
+#include <thread>
 
 #include "CFileSystem.h"
 #include "wowEnvironment.h"
@@ -11,13 +13,18 @@
 #include "stringext.h"
 
 #include "wowDbFile.h"
+#include "wowDbQuery.h"
+#include "wowDatabaseDiff.h"
+#include "CSysChrono.h"
 
 #pragma comment(lib, "CascLib.lib")
 #pragma comment(lib, "pugixml.lib")
 
-void testWowDatabase83();
+void testWowDatabase83(const char* wowDir);
 void dumpWowDatabase(CFileSystem* fs, const wowDatabase* wowDB);
-void testWowDatabaseClassic();
+void testWowDatabaseClassic(const char* wowDir);
+void testDbQueryBenchmark();
+void testWowDatabaseDiff(const char* oldWowDir, const char* newWowDir);
 
 int main(int argc, char* argv[])
 {
@@ -25,17 +32,33 @@ int main(int argc, char* argv[])
 	_CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
 #endif
 
-	testWowDatabase83();
-	//testWowDatabase81();
-	//testWowDatabaseClassic();
+	//TestWowDatabase <wow dir> [old build wow dir]
+	const char* wowDir = argc > 1 ? argv[1] : nullptr;
+	const char* oldWowDir = argc > 2 ? argv[2] : nullptr;
+
+	//synthetic data, runs without a game install
+	testDbQueryBenchmark();
+
+	if (wowDir)
+	{
+		testWowDatabase83(wowDir);
+		testWowDatabaseClassic(wowDir);
+	}
+	else
+	{
+		printf("no wow dir given, game data tests skipped\n");
+	}
+
+	if (wowDir && oldWowDir)
+		testWowDatabaseDiff(oldWowDir, wowDir);
 
 	getchar();
 	return 0;
 }
 
-void testWowDatabase83()
+void testWowDatabase83(const char* wowDir)
 {
-	CFileSystem* fs = new CFileSystem(R"(E:\World Of Warcraft)");
+	CFileSystem* fs = new CFileSystem(wowDir);
 	wowEnvironment* wowEnv = new wowEnvironment(fs);
 	wowDatabase* wowDB = new wowDatabase(wowEnv);
 
@@ -306,9 +329,9 @@ void dumpWowDatabase(CFileSystem* fs, const wowDatabase* wowDB)
 	}
 }
 
-void testWowDatabaseClassic()
+void testWowDatabaseClassic(const char* wowDir)
 {
-	CFileSystem* fs = new CFileSystem(R"(E:\World Of Warcraft)");
+	CFileSystem* fs = new CFileSystem(wowDir);
 	wowEnvironment* wowEnv = new wowEnvironment(fs);
 	wowDatabase* wowDB = new wowDatabase(wowEnv);
 
@@ -337,4 +360,141 @@ void testWowDatabaseClassic()
 	delete wowDB;
 	delete wowEnv;
 	delete fs;
-}
\ No newline at end of file
+}
+
+void testDbQueryBenchmark()
+{
+	//synthetic ItemSparse sized table
+	const uint32_t numRecords = 180000;
+	const uint32_t numLoops = 20;
+
+	std::mt19937 rng(1234);
+	std::vector<ItemSparseTable::SRecord> records(numRecords);
+	for (uint32_t i = 0; i < numRecords; ++i)
+	{
+		auto& r = records[i];
+		r.ID = i + 1;
+		r.AllowableRace = (rng() % 4 == 0) ? 0xffffffffffffffffull : (((uint64_t)rng() << 32) | rng());
+		r.Name = std::string("Item_") + std::to_string(i);
+	}
+
+	const uint64_t raceMask = 1ull << (34 - 1);
+	const uint32_t minID = 20000;
+
+	std::vector<uint32_t> naive;
+	auto start = CSysChrono::getTimePointNow();
+	for (uint32_t n = 0; n < numLoops; ++n)
+	{
+		naive.clear();
+		for (uint32_t i = 0; i < numRecords; ++i)
+		{
+			const auto& r = records[i];
+			if ((r.AllowableRace & raceMask) && r.ID > minID)
+				naive.push_back(i);
+		}
+	}
+	uint32_t naiveTime = CSysChrono::getDurationMicroseconds(start);
+
+	CDbQuery query;
+	start = CSysChrono::getTimePointNow();
+	query.addColumn("ID", records, &ItemSparseTable::SRecord::ID);
+	query.addColumn("AllowableRace", records, &ItemSparseTable::SRecord::AllowableRace);
+	uint32_t projectTime = CSysChrono::getDurationMicroseconds(start);
+
+	query.where("AllowableRace", EDQ_ANYBITS, raceMask).where("ID", EDQ_GREATER, minID);
+
+	std::vector<uint32_t> single;
+	start = CSysChrono::getTimePointNow();
+	for (uint32_t n = 0; n < numLoops; ++n)
+		query.execute(single, 1);
+	uint32_t singleTime = CSysChrono::getDurationMicroseconds(start);
+
+	std::vector<uint32_t> multi;
+	start = CSysChrono::getTimePointNow();
+	for (uint32_t n = 0; n < numLoops; ++n)
+		query.execute(multi);
+	uint32_t multiTime = CSysChrono::getDurationMicroseconds(start);
+
+	printf("rows: %u, selected: %u\n", numRecords, (uint32_t)naive.size());
+	printf("naive loop: %u us\n", naiveTime / numLoops);
+	printf("column projection: %u us\n", projectTime);
+	printf("query 1 thread: %u us\n", singleTime / numLoops);
+	printf("query %u threads: %u us\n", std::thread::hardware_concurrency(), multiTime / numLoops);
+	printf("result %s\n", (naive == single && naive == multi) ? "match" : "mismatch!");
+
+	//signed 16bit column, negative values must compare below zero
+	struct SSigned { int16_t RaceID; };
+	std::vector<SSigned> signedRecords(1000);
+	std::vector<uint32_t> negative;
+	for (uint32_t i = 0; i < (uint32_t)signedRecords.size(); ++i)
+	{
+		signedRecords[i].RaceID = (int16_t)((int)(rng() % 64) - 32);
+		if (signedRecords[i].RaceID < -5)
+			negative.push_back(i);
+	}
+
+	CDbQuery signedQuery;
+	signedQuery.addColumn("RaceID", signedRecords, &SSigned::RaceID);
+	signedQuery.where("RaceID", EDQ_LESS, (uint64_t)-5);
+	std::vector<uint32_t> signedSelection, signedScalar;
+	signedQuery.execute(signedSelection);
+	signedQuery.executeScalar(signedScalar);
+	printf("signed column %s\n", (signedSelection == negative && signedScalar == negative) ? "match" : "mismatch!");
+}
+
+void testWowDatabaseDiff(const char* oldWowDir, const char* newWowDir)
+{
+	CFileSystem* oldFs = new CFileSystem(oldWowDir);
+	CFileSystem* newFs = new CFileSystem(newWowDir);
+	wowEnvironment* oldEnv = new wowEnvironment(oldFs);
+	wowEnvironment* newEnv = new wowEnvironment(newFs);
+	wowDatabase* oldDB = new wowDatabase(oldEnv);
+	wowDatabase* newDB = new wowDatabase(newEnv);
+
+	if (!oldEnv->init("wow") || !newEnv->init("wow"))
+	{
+		printf("init fail!\n");
+	}
+	else if (!oldDB->init(false) || !newDB->init(false))
+	{
+		printf("wowDB init fail!\n");
+	}
+	else
+	{
+		std::string dir = newFs->getWorkingDirectory();
+		normalizeDirName(dir);
+		CWriteFile* wf = newFs->createAndWriteFile((dir + "DatabaseDiff.txt").c_str(), false);
+
+		static const char* rowTypes[] = { "added", "removed", "changed" };
+		wowDatabaseDiff diff(oldDB, newDB);
+		std::vector<SDbDiffTableResult> results;
+
+		auto start = CSysChrono::getTimePointNow();
+		diff.diffAll([wf](const char* table, E_DBDIFF_ROW type, uint32_t id, const std::vector<VAR_T>*, const std::vector<VAR_T>*)
+		{
+			wf->writeLine("%s %s ID: %u", table, rowTypes[type], id);
+		}, results);
+		uint32_t time = CSysChrono::getDurationMilliseconds(start);
+
+		for (const auto& r : results)
+		{
+			if (r.identical)
+				printf("%s: identical\n", r.name.c_str());
+			else if (r.layoutIncompatible)
+				printf("%s: layout incompatible, added %u, removed %u\n", r.name.c_str(), r.numAdded, r.numRemoved);
+			else
+				printf("%s: added %u, removed %u, changed %u%s\n", r.name.c_str(), r.numAdded, r.numRemoved, r.numChanged,
+					r.layoutChanged ? ", layout changed" : "");
+		}
+		printf("diff finished in %u ms\n", time);
+
+		delete wf;
+	}
+
+	delete oldDB;
+	delete newDB;
+	delete oldEnv;
+	delete newEnv;
+	delete oldFs;
+	delete newFs;
+}
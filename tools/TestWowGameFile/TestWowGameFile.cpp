@@ -1,5 +1,7 @@
 #include <iostream>
 #include <list>
+#include <random>
+#include <thread>
 
 #include "CFileSystem.h"
 #include "wowEnvironment.h"
@@ -9,11 +11,33 @@
 #include "wowDbFile.h"
 #include "wowWMOFile.h"
 #include "wowM2File.h"
+#include "wowM2Skinning.h"
+#include "wowMeshOptimizer.h"
+#include "wowM2Particles.h"
+#include "wowM2Geosets.h"
+#include "wowM2CookedCache.h"
+#include "wowCollisionBVH.h"
+#include "wowWMOVisibility.h"
+#include "CSysChrono.h"
 
 #pragma comment(lib, "CascLib.lib")
 #pragma comment(lib, "pugixml.lib")
 
 void testWowGameFile();
+void testM2SkinningBenchmark();
+void testAnimationCursorBenchmark();
+void testSkeletonBatchBenchmark();
+void testAnimationCompression();
+void testVertexCacheReport();
+void testPackedVertices();
+void testParticleBenchmark();
+void testGeosetDrawRanges();
+void testM2InstancingReport();
+void testM2CookedLoad();
+void testCollisionBVH();
+void testWMOLoadBenchmark();
+void testWMOPortalCulling();
+void testWMOBsp();
 
 int main(int argc, char* argv[])
 {
@@ -22,6 +46,20 @@ int main(int argc, char* argv[])
 #endif
 
 	testWowGameFile();
+	//testM2SkinningBenchmark();
+	//testAnimationCursorBenchmark();
+	//testSkeletonBatchBenchmark();
+	//testAnimationCompression();
+	//testVertexCacheReport();
+	//testPackedVertices();
+	//testParticleBenchmark();
+	//testGeosetDrawRanges();
+	//testM2InstancingReport();
+	//testM2CookedLoad();
+	//testCollisionBVH();
+	//testWMOLoadBenchmark();
+	//testWMOPortalCulling();
+	//testWMOBsp();
 
 	getchar();
 	return 0;
@@ -69,4 +107,1515 @@ void testWowGameFile()
 
 	delete wowEnv;
 	delete fs;
-}
\ No newline at end of file
+}
+
+void testM2SkinningBenchmark()
+{
+	//synthetic character sized meshes
+	const uint32_t numVertices = 6000;
+	const uint32_t numBones = 120;
+	const uint32_t numInstances = 200;
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+	std::vector<SVertex_PNT2WA> vertices(numVertices);
+	for (auto& v : vertices)
+	{
+		v.Pos.set(dist(rng), dist(rng), dist(rng));
+		v.Normal.set(dist(rng), dist(rng), dist(rng));
+		uint32_t w0 = 128 + rng() % 128;
+		uint32_t w1 = 255 - w0;
+		v.Weights[0] = (uint8_t)w0;
+		v.Weights[1] = (uint8_t)w1;
+		v.Weights[2] = v.Weights[3] = 0;
+		for (uint32_t k = 0; k < 4; ++k)
+			v.BoneIndices[k] = (uint8_t)(rng() % numBones);
+	}
+
+	std::vector<matrix4> bones(numBones * numInstances);
+	for (auto& m : bones)
+	{
+		m = quaternion(dist(rng), dist(rng), dist(rng)).toMatrix();
+		m.setTranslation(vector3df(dist(rng), dist(rng), dist(rng)));
+	}
+
+	std::vector<SVertex_PNT2WA> scalar(vertices.size() * numInstances, vertices[0]);
+	std::vector<SVertex_PNT2WA> simd(scalar);
+	std::vector<SVertex_PNT2WA> threaded(scalar);
+
+	auto start = CSysChrono::getTimePointNow();
+	for (uint32_t i = 0; i < numInstances; ++i)
+		wowM2Skinning::skinScalar(vertices.data(), &scalar[i * numVertices], numVertices, &bones[i * numBones], numBones);
+	uint32_t scalarTime = CSysChrono::getDurationMicroseconds(start);
+
+	start = CSysChrono::getTimePointNow();
+	for (uint32_t i = 0; i < numInstances; ++i)
+		wowM2Skinning::skinSSE(vertices.data(), &simd[i * numVertices], numVertices, &bones[i * numBones], numBones);
+	uint32_t simdTime = CSysChrono::getDurationMicroseconds(start);
+
+	std::vector<SSkinningJob> jobs(numInstances);
+	for (uint32_t i = 0; i < numInstances; ++i)
+	{
+		jobs[i].src = vertices.data();
+		jobs[i].dst = &threaded[i * numVertices];
+		jobs[i].numVertices = numVertices;
+		jobs[i].bones = &bones[i * numBones];
+		jobs[i].numBones = numBones;
+	}
+	start = CSysChrono::getTimePointNow();
+	wowM2Skinning::skinJobs(jobs.data(), (uint32_t)jobs.size());
+	uint32_t threadedTime = CSysChrono::getDurationMicroseconds(start);
+
+	//frames as the scene runs them: a call per node against one batch on the persistent pool
+	const uint32_t numFrames = 20;
+	std::vector<SVertex_PNT2WA> pooled(scalar);
+	std::vector<SSkinningJob> pooledJobs(jobs);
+	for (uint32_t i = 0; i < numInstances; ++i)
+		pooledJobs[i].dst = &pooled[i * numVertices];
+
+	start = CSysChrono::getTimePointNow();
+	for (uint32_t f = 0; f < numFrames; ++f)
+	{
+		for (uint32_t i = 0; i < numInstances; ++i)
+			wowM2Skinning::skinJobs(&jobs[i], 1);
+	}
+	uint32_t perNodeTime = CSysChrono::getDurationMicroseconds(start) / numFrames;
+
+	wowSkinningPool pool;
+	start = CSysChrono::getTimePointNow();
+	for (uint32_t f = 0; f < numFrames; ++f)
+		pool.run(pooledJobs.data(), (uint32_t)pooledJobs.size());
+	uint32_t poolTime = CSysChrono::getDurationMicroseconds(start) / numFrames;
+
+	auto diff = [](const vector3df& a, const vector3df& b)
+	{
+		return std::max(std::max(fabsf(a.x - b.x), fabsf(a.y - b.y)), fabsf(a.z - b.z));
+	};
+
+	float maxDiff = 0;
+	for (size_t i = 0; i < scalar.size(); ++i)
+	{
+		maxDiff = std::max(maxDiff, diff(scalar[i].Pos, simd[i].Pos));
+		maxDiff = std::max(maxDiff, diff(scalar[i].Normal, simd[i].Normal));
+		maxDiff = std::max(maxDiff, diff(scalar[i].Pos, threaded[i].Pos));
+		maxDiff = std::max(maxDiff, diff(scalar[i].Normal, threaded[i].Normal));
+		maxDiff = std::max(maxDiff, diff(scalar[i].Pos, pooled[i].Pos));
+		maxDiff = std::max(maxDiff, diff(scalar[i].Normal, pooled[i].Normal));
+	}
+
+	printf("instances: %u, vertices: %u, bones: %u\n", numInstances, numVertices, numBones);
+	printf("scalar: %u us\n", scalarTime);
+	printf("sse: %u us\n", simdTime);
+	printf("sse %u threads: %u us\n", std::thread::hardware_concurrency(), threadedTime);
+	printf("frame, skinJobs per node: %u us, pool of %u threads: %u us\n", perNodeTime, pool.getNumThreads(), poolTime);
+	printf("max difference: %g, result %s\n", maxDiff, maxDiff < 1e-4f ? "match" : "mismatch!");
+}
+
+void testAnimationCursorBenchmark()
+{
+	//track shapes: short bone tracks, 30fps sequences, long global sequences
+	const uint32_t numTracks = 3000;
+	const uint32_t numFrames = 2000;
+	const uint32_t frameTime = 16;
+
+	std::mt19937 rng(1234);
+	std::vector<uint32_t> numKeys(numTracks);
+	uint32_t totalKeys = 0;
+	for (uint32_t i = 0; i < numTracks; ++i)
+	{
+		switch (i % 3)
+		{
+		case 0: numKeys[i] = 2 + rng() % 8; break;
+		case 1: numKeys[i] = 30 + rng() % 90; break;
+		default: numKeys[i] = 500 + rng() % 2500; break;
+		}
+		totalKeys += numKeys[i];
+	}
+
+	//m2 layout: animblock -> sequence -> times, values
+	std::vector<uint8_t> fileData(numTracks * (sizeof(M2::animblock) + sizeof(M2::sequence) * 2) + totalKeys * 8);
+	std::vector<const uint32_t*> rawTimes(numTracks);
+	std::vector<const float*> rawValues(numTracks);
+	std::vector<SWowAnimation<float>> tracks(numTracks);
+	uint32_t ofs = 0;
+	for (uint32_t i = 0; i < numTracks; ++i)
+	{
+		M2::animblock* block = (M2::animblock*)&fileData[ofs];
+		ofs += sizeof(M2::animblock);
+		block->_Interpolation = INTERPOLATION_LINEAR;
+		block->_SequenceID = -1;
+		block->_Ntimings = block->_Nvalues = 1;
+		block->_TimingsOfs = ofs;
+		block->_ValuesOfs = ofs + sizeof(M2::sequence);
+
+		M2::sequence* t = (M2::sequence*)&fileData[ofs];
+		M2::sequence* v = (M2::sequence*)&fileData[ofs + sizeof(M2::sequence)];
+		ofs += sizeof(M2::sequence) * 2;
+		t->_NValues = v->_NValues = numKeys[i];
+		t->_SequencesOfs = ofs;
+		v->_SequencesOfs = ofs + numKeys[i] * 4;
+
+		uint32_t* times = (uint32_t*)&fileData[t->_SequencesOfs];
+		float* values = (float*)&fileData[v->_SequencesOfs];
+		uint32_t time = 0;
+		for (uint32_t k = 0; k < numKeys[i]; ++k)
+		{
+			times[k] = time;
+			values[k] = (float)k;
+			time += 33;
+		}
+		ofs += numKeys[i] * 8;
+
+		rawTimes[i] = times;
+		rawValues[i] = values;
+		tracks[i].init(block, fileData.data(), nullptr, 0);
+	}
+
+	//previous getValue, scan from the first key, then the same interpolation as getValue
+	//all three loops find the key and interpolate the value, only the key search differs
+	auto scanValue = [](const uint32_t* times, const float* values, uint32_t num, uint32_t time, float& v)
+	{
+		if (num <= 1 || time <= times[0])
+		{
+			v = values[0];
+			return 0;
+		}
+		if (time >= times[num - 1])
+		{
+			v = values[num - 1];
+			return (int32_t)num - 1;
+		}
+		for (uint32_t k = 1; k < num; ++k)
+		{
+			if (time <= times[k])
+			{
+				v = interpolate<float>((time - times[k - 1]) / (float)(times[k] - times[k - 1]), values[k - 1], values[k]);
+				return (int32_t)k;
+			}
+		}
+		return -1;
+	};
+
+	float v;
+	uint64_t scanSum = 0;
+	double scanValues = 0;
+	auto start = CSysChrono::getTimePointNow();
+	for (uint32_t f = 0; f < numFrames; ++f)
+	{
+		for (uint32_t i = 0; i < numTracks; ++i)
+		{
+			uint32_t length = (numKeys[i] - 1) * 33;
+			scanSum += scanValue(rawTimes[i], rawValues[i], numKeys[i], (f * frameTime) % (length + 1), v);
+			scanValues += v;
+		}
+	}
+	uint32_t scanTime = CSysChrono::getDurationMicroseconds(start);
+
+	uint64_t searchSum = 0;
+	double searchValues = 0;
+	start = CSysChrono::getTimePointNow();
+	for (uint32_t f = 0; f < numFrames; ++f)
+	{
+		for (uint32_t i = 0; i < numTracks; ++i)
+		{
+			uint32_t length = (numKeys[i] - 1) * 33;
+			searchSum += tracks[i].getValue(0, (f * frameTime) % (length + 1), v);
+			searchValues += v;
+		}
+	}
+	uint32_t searchTime = CSysChrono::getDurationMicroseconds(start);
+
+	std::vector<int32_t> cursors(numTracks, 0);
+	uint64_t cursorSum = 0;
+	double cursorValues = 0;
+	start = CSysChrono::getTimePointNow();
+	for (uint32_t f = 0; f < numFrames; ++f)
+	{
+		for (uint32_t i = 0; i < numTracks; ++i)
+		{
+			uint32_t length = (numKeys[i] - 1) * 33;
+			cursors[i] = tracks[i].getValue(0, (f * frameTime) % (length + 1), v, cursors[i]);
+			cursorSum += cursors[i];
+			cursorValues += v;
+		}
+	}
+	uint32_t cursorTime = CSysChrono::getDurationMicroseconds(start);
+
+	printf("tracks: %u, keys: %u, frames: %u\n", numTracks, totalKeys, numFrames);
+	printf("linear scan: %u us\n", scanTime);
+	printf("binary search: %u us\n", searchTime);
+	printf("cursor: %u us\n", cursorTime);
+	printf("result %s\n", (scanSum == searchSum && scanSum == cursorSum && scanValues == searchValues && scanValues == cursorValues) ? "match" : "mismatch!");
+}
+
+void testSkeletonBatchBenchmark()
+{
+	//a crowd of one creature, bone chains with 30fps translation and rotation keys
+	const uint32_t numBones = 80;
+	const uint32_t numKeys = 120;
+	const uint32_t numInstances = 1000;
+	const uint32_t numFrames = 20;
+	const uint32_t length = (numKeys - 1) * 33;
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+	const uint32_t trackSize = sizeof(M2::sequence) * 2 + numKeys * 4 + numKeys * (uint32_t)sizeof(vector3df);
+	std::vector<uint8_t> fileData(numBones * trackSize * 2);
+	std::vector<M2::bone> bones(numBones);
+	uint32_t ofs = 0;
+	auto initBlock = [&](M2::animblock& block, uint32_t valueSize)
+	{
+		block._Interpolation = INTERPOLATION_LINEAR;
+		block._SequenceID = -1;
+		block._Ntimings = block._Nvalues = 1;
+		block._TimingsOfs = ofs;
+		block._ValuesOfs = ofs + sizeof(M2::sequence);
+
+		M2::sequence* t = (M2::sequence*)&fileData[ofs];
+		M2::sequence* v = (M2::sequence*)&fileData[ofs + sizeof(M2::sequence)];
+		ofs += sizeof(M2::sequence) * 2;
+		t->_NValues = v->_NValues = numKeys;
+		t->_SequencesOfs = ofs;
+		v->_SequencesOfs = ofs + numKeys * 4;
+
+		uint32_t* times = (uint32_t*)&fileData[t->_SequencesOfs];
+		for (uint32_t k = 0; k < numKeys; ++k)
+			times[k] = k * 33;
+		ofs += numKeys * 4;
+		return &fileData[v->_SequencesOfs];
+	};
+
+	for (uint32_t b = 0; b < numBones; ++b)
+	{
+		M2::bone& bone = bones[b];
+		memset(&bone, 0, sizeof(bone));
+		bone._ParentBone = b == 0 ? -1 : (int16_t)(rng() % b);
+		bone._PivotPoint.set(dist(rng), dist(rng), dist(rng));
+		bone._Translation._SequenceID = bone._Rotation._SequenceID = bone._Scaling._SequenceID = -1;
+
+		vector3df* trans = (vector3df*)initBlock(bone._Translation, sizeof(vector3df));
+		for (uint32_t k = 0; k < numKeys; ++k)
+			trans[k].set(dist(rng) * 0.1f, dist(rng) * 0.1f, dist(rng) * 0.1f);
+		ofs += numKeys * sizeof(vector3df);
+
+		PACK_QUATERNION* rot = (PACK_QUATERNION*)initBlock(bone._Rotation, sizeof(PACK_QUATERNION));
+		for (uint32_t k = 0; k < numKeys; ++k)
+		{
+			quaternion q(dist(rng), dist(rng), dist(rng));
+			rot[k].x = (int16_t)(q.x * 32767.0f);
+			rot[k].y = (int16_t)(q.y * 32767.0f);
+			rot[k].z = (int16_t)(q.z * 32767.0f);
+			rot[k].w = (int16_t)(q.w * 32767.0f);
+		}
+		ofs += numKeys * sizeof(PACK_QUATERNION);
+	}
+
+	SAnimFile animFile = { nullptr, 0 };
+	wowM2Skeleton skeleton;
+	skeleton.init(fileData.data(), bones.data(), numBones, &animFile, nullptr, 0);
+
+	//instances play the same sequence with small offsets
+	std::vector<SAnimationInstance> instances(numInstances);
+	std::vector<uint32_t> offsets(numInstances);
+	for (uint32_t i = 0; i < numInstances; ++i)
+		offsets[i] = rng() % 500;
+
+	std::vector<matrix4> single(numInstances * numBones);
+	std::vector<int32_t> cursors(numInstances * skeleton.getNumCursors(), 0);
+	auto start = CSysChrono::getTimePointNow();
+	for (uint32_t f = 0; f < numFrames; ++f)
+	{
+		for (uint32_t i = 0; i < numInstances; ++i)
+			skeleton.evaluate(0, (f * 16 + offsets[i]) % length, &single[i * numBones], &cursors[i * skeleton.getNumCursors()]);
+	}
+	uint32_t singleTime = CSysChrono::getDurationMicroseconds(start);
+
+	SSkeletonBatchSamples samples;
+	std::vector<matrix4> batch(numInstances * numBones);
+	start = CSysChrono::getTimePointNow();
+	for (uint32_t f = 0; f < numFrames; ++f)
+	{
+		for (uint32_t i = 0; i < numInstances; ++i)
+		{
+			instances[i].anim = 0;
+			instances[i].time = (f * 16 + offsets[i]) % length;
+		}
+		skeleton.sampleBatch(instances.data(), numInstances, samples, 0, 1);
+		skeleton.evaluateBatch(samples, batch.data(), 1);
+	}
+	uint32_t batchTime = CSysChrono::getDurationMicroseconds(start);
+
+	std::vector<matrix4> threaded(numInstances * numBones);
+	start = CSysChrono::getTimePointNow();
+	for (uint32_t f = 0; f < numFrames; ++f)
+	{
+		for (uint32_t i = 0; i < numInstances; ++i)
+		{
+			instances[i].anim = 0;
+			instances[i].time = (f * 16 + offsets[i]) % length;
+		}
+		skeleton.sampleBatch(instances.data(), numInstances, samples);
+		skeleton.evaluateBatch(samples, threaded.data());
+	}
+	uint32_t threadedTime = CSysChrono::getDurationMicroseconds(start);
+
+	std::vector<matrix4> grid(numInstances * numBones);
+	start = CSysChrono::getTimePointNow();
+	for (uint32_t f = 0; f < numFrames; ++f)
+	{
+		for (uint32_t i = 0; i < numInstances; ++i)
+		{
+			instances[i].anim = 0;
+			instances[i].time = (f * 16 + offsets[i]) % length;
+		}
+		skeleton.sampleBatch(instances.data(), numInstances, samples, 33, 1);
+		skeleton.evaluateBatch(samples, grid.data(), 1);
+	}
+	uint32_t gridTime = CSysChrono::getDurationMicroseconds(start);
+
+	bool match = true;
+	for (size_t i = 0; i < single.size(); ++i)
+	{
+		if (!single[i].equals(batch[i], 1e-4f) || !single[i].equals(threaded[i], 1e-4f))
+			match = false;
+	}
+
+	printf("instances: %u, bones: %u, frames: %u\n", numInstances, numBones, numFrames);
+	printf("evaluate per instance: %u us\n", singleTime / numFrames);
+	printf("batch 1 thread: %u us\n", batchTime / numFrames);
+	printf("batch %u threads: %u us\n", std::thread::hardware_concurrency(), threadedTime / numFrames);
+	printf("batch 33ms grid: %u us\n", gridTime / numFrames);
+	printf("result %s\n", match ? "match" : "mismatch!");
+}
+
+void testAnimationCompression()
+{
+	//character like tracks: smooth 30fps curves, many constant translations, unit scales
+	const uint32_t numBones = 80;
+	const uint32_t numKeys = 120;
+	const uint32_t length = (numKeys - 1) * 33;
+	const SSkeletonCompression compression = { 0.001f, 0.001f, 0.001f };
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+	const uint32_t trackSize = sizeof(M2::sequence) * 2 + numKeys * 4 + numKeys * (uint32_t)sizeof(vector3df);
+	std::vector<uint8_t> fileData(numBones * trackSize * 3);
+	std::vector<M2::bone> bones(numBones);
+	uint32_t ofs = 0;
+	auto initBlock = [&](M2::animblock& block)
+	{
+		block._Interpolation = INTERPOLATION_LINEAR;
+		block._SequenceID = -1;
+		block._Ntimings = block._Nvalues = 1;
+		block._TimingsOfs = ofs;
+		block._ValuesOfs = ofs + sizeof(M2::sequence);
+
+		M2::sequence* t = (M2::sequence*)&fileData[ofs];
+		M2::sequence* v = (M2::sequence*)&fileData[ofs + sizeof(M2::sequence)];
+		ofs += sizeof(M2::sequence) * 2;
+		t->_NValues = v->_NValues = numKeys;
+		t->_SequencesOfs = ofs;
+		v->_SequencesOfs = ofs + numKeys * 4;
+
+		uint32_t* times = (uint32_t*)&fileData[t->_SequencesOfs];
+		for (uint32_t k = 0; k < numKeys; ++k)
+			times[k] = k * 33;
+		ofs += numKeys * 4;
+		return &fileData[v->_SequencesOfs];
+	};
+
+	//inverse of Quat16ToMinusQuat32
+	auto packComponent = [](float f)
+	{
+		int32_t v = (int32_t)floorf(f * 32767.0f + 0.5f);
+		return (int16_t)(v > 0 ? v - 32768 : v + 32767);
+	};
+
+	for (uint32_t b = 0; b < numBones; ++b)
+	{
+		M2::bone& bone = bones[b];
+		memset(&bone, 0, sizeof(bone));
+		bone._ParentBone = b == 0 ? -1 : (int16_t)(rng() % b);
+		bone._PivotPoint.set(dist(rng), dist(rng), dist(rng));
+		bone._Translation._SequenceID = bone._Rotation._SequenceID = bone._Scaling._SequenceID = -1;
+
+		const bool moving = (b % 4) == 0;
+		const vector3df amplitude(dist(rng) * 0.2f, dist(rng) * 0.2f, dist(rng) * 0.2f);
+		const vector3df angles(dist(rng), dist(rng), dist(rng));
+		const float phase = dist(rng) * 3.14f;
+		const float speed = 0.002f + 0.002f * (rng() % 4);
+
+		vector3df* trans = (vector3df*)initBlock(bone._Translation);
+		for (uint32_t k = 0; k < numKeys; ++k)
+			trans[k] = moving ? amplitude * sinf(k * 33 * speed + phase) : vector3df(0, 0, 0);
+		ofs += numKeys * sizeof(vector3df);
+
+		PACK_QUATERNION* rot = (PACK_QUATERNION*)initBlock(bone._Rotation);
+		for (uint32_t k = 0; k < numKeys; ++k)
+		{
+			quaternion q(angles * (0.5f * sinf(k * 33 * speed + phase)));
+			rot[k].x = packComponent(q.x);
+			rot[k].y = packComponent(q.z);
+			rot[k].z = packComponent(q.y);
+			rot[k].w = packComponent(-q.w);
+		}
+		ofs += numKeys * sizeof(PACK_QUATERNION);
+
+		vector3df* scale = (vector3df*)initBlock(bone._Scaling);
+		for (uint32_t k = 0; k < numKeys; ++k)
+			scale[k].set(1.0f, 1.0f, 1.0f);
+		ofs += numKeys * sizeof(vector3df);
+	}
+
+	SAnimFile animFile = { nullptr, 0 };
+	wowM2Skeleton raw;
+	raw.init(fileData.data(), bones.data(), numBones, &animFile, nullptr, 0);
+	wowM2Skeleton compressed;
+	compressed.init(fileData.data(), bones.data(), numBones, &animFile, nullptr, 0, &compression);
+
+	//track errors every 5ms, including the time between keys
+	float maxTrans = 0, maxRot = 0, maxScale = 0;
+	for (uint32_t b = 0; b < numBones; ++b)
+	{
+		for (uint32_t time = 0; time <= length; time += 5)
+		{
+			vector3df t0, t1, s0, s1;
+			quaternion q0, q1;
+			raw.Translations[b].getValue(0, time, t0);
+			compressed.Translations[b].getValue(0, time, t1);
+			raw.Rotations[b].getValue(0, time, q0);
+			compressed.Rotations[b].getValue(0, time, q1);
+			raw.Scalings[b].getValue(0, time, s0);
+			compressed.Scalings[b].getValue(0, time, s1);
+
+			maxTrans = std::max(maxTrans, SAnimationKeyError<vector3df>::error(t0, t1));
+			maxRot = std::max(maxRot, SAnimationKeyError<quaternion>::error(q0, q1));
+			maxScale = std::max(maxScale, SAnimationKeyError<vector3df>::error(s0, s1));
+		}
+	}
+
+	//error of the bone positions after the hierarchy
+	std::vector<matrix4> m0(numBones), m1(numBones);
+	float maxPos = 0;
+	for (uint32_t time = 0; time <= length; time += 5)
+	{
+		raw.evaluate(0, time, m0.data());
+		compressed.evaluate(0, time, m1.data());
+		for (uint32_t b = 0; b < numBones; ++b)
+			maxPos = std::max(maxPos, m0[b].getTranslation().getDistanceFrom(m1[b].getTranslation()));
+	}
+
+	const uint32_t numFrames = 20000;
+	std::vector<int32_t> cursors(raw.getNumCursors(), 0);
+	auto start = CSysChrono::getTimePointNow();
+	for (uint32_t f = 0; f < numFrames; ++f)
+		raw.evaluate(0, (f * 16) % length, m0.data(), cursors.data());
+	uint32_t rawTime = CSysChrono::getDurationMicroseconds(start);
+
+	std::fill(cursors.begin(), cursors.end(), 0);
+	start = CSysChrono::getTimePointNow();
+	for (uint32_t f = 0; f < numFrames; ++f)
+		compressed.evaluate(0, (f * 16) % length, m1.data(), cursors.data());
+	uint32_t compressedTime = CSysChrono::getDurationMicroseconds(start);
+
+	//restored from the cooked bytes as by the m2 cooked cache, against compressing the tracks again
+	std::vector<uint8_t> cookedData;
+	compressed.cook(cookedData);
+
+	const uint32_t numLoads = 20;
+	start = CSysChrono::getTimePointNow();
+	for (uint32_t i = 0; i < numLoads; ++i)
+	{
+		wowM2Skeleton skeleton;
+		skeleton.init(fileData.data(), bones.data(), numBones, &animFile, nullptr, 0, &compression);
+	}
+	uint32_t initTime = CSysChrono::getDurationMicroseconds(start);
+
+	wowM2Skeleton cooked;
+	bool cookedSame = true;
+	start = CSysChrono::getTimePointNow();
+	for (uint32_t i = 0; i < numLoads; ++i)
+		cookedSame &= cooked.loadCooked(cookedData.data(), (uint32_t)cookedData.size(), nullptr, 0, &compression);
+	uint32_t cookedTime = CSysChrono::getDurationMicroseconds(start);
+
+	for (uint32_t time = 0; time <= length && cookedSame; time += 5)
+	{
+		compressed.evaluate(0, time, m0.data());
+		cooked.evaluate(0, time, m1.data());
+		cookedSame = memcmp(m0.data(), m1.data(), sizeof(matrix4) * numBones) == 0;
+	}
+
+	const float slack = 1.01f;
+	const bool bounded = maxTrans <= compression.translationTolerance * slack &&
+		maxRot <= compression.rotationTolerance * slack &&
+		maxScale <= compression.scaleTolerance * slack;
+
+	printf("bones: %u, keys per track: %u\n", numBones, numKeys);
+	printf("memory raw: %u bytes, compressed: %u bytes, ratio %.2f\n", raw.getMemorySize(), compressed.getMemorySize(),
+		raw.getMemorySize() / (float)compressed.getMemorySize());
+	printf("max error translation: %g, rotation: %g rad, scale: %g, bone position: %g\n", maxTrans, maxRot, maxScale, maxPos);
+	printf("evaluate raw: %u us, compressed: %u us (%u frames)\n", rawTime, compressedTime, numFrames);
+	printf("cooked: %u bytes, init compressed: %u us, load cooked: %u us (%u loads), %s\n", (uint32_t)cookedData.size(),
+		initTime, cookedTime, numLoads, cookedSame ? "same" : "DIFFERENT");
+	printf("result %s\n", bounded ? "within tolerance" : "out of tolerance!");
+
+	//the same on the embedded sequences of real models
+	CFileSystem* fs = new CFileSystem(R"(E:\World Of Warcraft)");
+	wowEnvironment* wowEnv = new wowEnvironment(fs);
+
+	if (!wowEnv->init("wow_classic"))
+	{
+		printf("init fail!\n");
+		delete wowEnv;
+		delete fs;
+		return;
+	}
+
+	const char* m2Files[] =
+	{
+		"Character\\HUMAN\\Male\\humanmale.m2",
+		"Character\\Orc\\Male\\orcmale.m2",
+		"Creature\\Wolf\\wolf.m2",
+		"World\\Azeroth\\Elwynn\\PassiveDoodads\\Trees\\ElwynnTreeCanopy01.m2",
+	};
+
+	uint32_t totalRaw = 0;
+	uint32_t totalCompressed = 0;
+	for (const char* path : m2Files)
+	{
+		wowM2File* rawFile = new wowM2File(wowEnv);
+		wowM2File* compressedFile = new wowM2File(wowEnv);
+		if (!rawFile->loadFile(path) || !compressedFile->loadFile(path, &compression))
+		{
+			printf("%s: load fail!\n", path);
+			delete rawFile;
+			delete compressedFile;
+			continue;
+		}
+
+		const wowM2Skeleton& rawSkeleton = rawFile->Skeleton;
+		const wowM2Skeleton& compressedSkeleton = compressedFile->Skeleton;
+		const uint32_t bones = rawSkeleton.getNumBones();
+		m0.resize(bones);
+		m1.resize(bones);
+		float maxBonePos = 0;
+		uint32_t numSequences = 0;
+		for (uint32_t a = 0; a < (uint32_t)rawFile->Animations.size(); ++a)
+		{
+			if (!rawFile->isAnimationLoaded(a))
+				continue;
+
+			++numSequences;
+			for (uint32_t time = 0; time <= rawFile->Animations[a].timeLength; time += 5)
+			{
+				rawSkeleton.evaluate(a, time, m0.data());
+				compressedSkeleton.evaluate(a, time, m1.data());
+				for (uint32_t b = 0; b < bones; ++b)
+					maxBonePos = std::max(maxBonePos, m0[b].getTranslation().getDistanceFrom(m1[b].getTranslation()));
+			}
+		}
+
+		printf("%s\n", path);
+		printf("\tbones: %u, embedded sequences: %u, memory raw: %u bytes, compressed: %u bytes, ratio %.2f, max bone position error: %g\n",
+			bones, numSequences, rawSkeleton.getMemorySize(), compressedSkeleton.getMemorySize(),
+			rawSkeleton.getMemorySize() / (float)std::max(1u, compressedSkeleton.getMemorySize()), maxBonePos);
+
+		totalRaw += rawSkeleton.getMemorySize();
+		totalCompressed += compressedSkeleton.getMemorySize();
+		delete rawFile;
+		delete compressedFile;
+	}
+	printf("real models, memory raw: %u bytes, compressed: %u bytes, ratio %.2f\n", totalRaw, totalCompressed,
+		totalRaw / (float)std::max(1u, totalCompressed));
+
+	delete wowEnv;
+	delete fs;
+}
+
+void testVertexCacheReport()
+{
+	CFileSystem* fs = new CFileSystem(R"(E:\World Of Warcraft)");
+	wowEnvironment* wowEnv = new wowEnvironment(fs);
+
+	if (!wowEnv->init("wow_classic"))
+	{
+		printf("init fail!\n");
+		delete wowEnv;
+		delete fs;
+		return;
+	}
+
+	const char* m2Files[] =
+	{
+		"Character\\HUMAN\\Male\\humanmale.m2",
+		"Character\\HUMAN\\Female\\humanfemale.m2",
+		"Character\\Orc\\Male\\orcmale.m2",
+		"Creature\\Wolf\\wolf.m2",
+	};
+
+	const char* wmoFiles[] =
+	{
+		"World\\wmo\\kalimdor\\ogrimmar\\ogrimmar.wmo",
+		"World\\wmo\\Azeroth\\Buildings\\Stormwind\\Stormwind.wmo",
+	};
+
+	const uint32_t cacheSize = 16;
+	auto addStats = [](SVertexCacheStats& total, const SVertexCacheStats& stats)
+	{
+		total.numTriangles += stats.numTriangles;
+		total.numVertices += stats.numVertices;
+		total.numTransforms += stats.numTransforms;
+	};
+
+	//geosets and batches are drawn separately, they are measured one by one
+	auto getM2Stats = [&](const char* path)
+	{
+		SVertexCacheStats total = { 0, 0, 0 };
+		wowM2File* m2File = new wowM2File(wowEnv);
+		if (m2File->loadFile(path))
+		{
+			for (const SGeoset& geo : m2File->SkinFile.Geosets)
+				addStats(total, wowMeshOptimizer::getCacheStats(&m2File->SkinFile.Indices[geo.IStart], geo.ICount, cacheSize));
+		}
+		delete m2File;
+		return total;
+	};
+
+	auto getWMOStats = [&](const char* path)
+	{
+		SVertexCacheStats total = { 0, 0, 0 };
+		wowWMOFile* wmoFile = new wowWMOFile(wowEnv);
+		if (wmoFile->loadFile(path))
+		{
+			for (const SWMOGroup& group : wmoFile->GroupList)
+			{
+				for (const SWMOBatch& batch : group.batchList)
+					addStats(total, wowMeshOptimizer::getCacheStats(&group.indices[batch.indexStart], batch.indexCount, cacheSize));
+			}
+		}
+		delete wmoFile;
+		return total;
+	};
+
+	SVertexCacheStats totalBefore = { 0, 0, 0 };
+	SVertexCacheStats totalAfter = { 0, 0, 0 };
+	auto report = [&](const char* path, const SVertexCacheStats& before, const SVertexCacheStats& after)
+	{
+		printf("%s\n", path);
+		printf("\ttriangles: %u, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", before.numTriangles,
+			before.getACMR(), after.getACMR(), before.getATVR(), after.getATVR());
+		addStats(totalBefore, before);
+		addStats(totalAfter, after);
+	};
+
+	for (const char* path : m2Files)
+	{
+		wowMeshOptimizer::setEnabled(false);
+		SVertexCacheStats before = getM2Stats(path);
+		wowMeshOptimizer::setEnabled(true);
+		report(path, before, getM2Stats(path));
+	}
+
+	for (const char* path : wmoFiles)
+	{
+		wowMeshOptimizer::setEnabled(false);
+		SVertexCacheStats before = getWMOStats(path);
+		wowMeshOptimizer::setEnabled(true);
+		report(path, before, getWMOStats(path));
+	}
+	wowMeshOptimizer::setEnabled(false);
+
+	printf("FIFO cache %u, total ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", cacheSize,
+		totalBefore.getACMR(), totalAfter.getACMR(), totalBefore.getATVR(), totalAfter.getATVR());
+	printf("vertex shader invocations: %u -> %u, saved %.1f%%\n", totalBefore.numTransforms, totalAfter.numTransforms,
+		totalBefore.numTransforms ? 100.0f * (totalBefore.numTransforms - totalAfter.numTransforms) / totalBefore.numTransforms : 0.0f);
+
+	delete wowEnv;
+	delete fs;
+}
+
+void testPackedVertices()
+{
+	CFileSystem* fs = new CFileSystem(R"(E:\World Of Warcraft)");
+	wowEnvironment* wowEnv = new wowEnvironment(fs);
+
+	if (!wowEnv->init("wow_classic"))
+	{
+		printf("init fail!\n");
+		delete wowEnv;
+		delete fs;
+		return;
+	}
+
+	const char* m2Files[] =
+	{
+		"Character\\HUMAN\\Male\\humanmale.m2",
+		"Character\\HUMAN\\Female\\humanfemale.m2",
+		"Character\\Orc\\Male\\orcmale.m2",
+		"Creature\\Wolf\\wolf.m2",
+	};
+
+	uint32_t totalVertices = 0;
+	float maxAngle = 0;
+	float maxUV = 0;
+	uint32_t packTime = 0;
+	for (const char* path : m2Files)
+	{
+		wowM2File* m2File = new wowM2File(wowEnv);
+		if (m2File->loadFile(path))
+		{
+			const std::vector<SVertex_PNT2WA>& vertices = m2File->Vertices;
+			std::vector<SVertex_PNT2WA_Packed> packed(vertices.size());
+
+			auto start = CSysChrono::getTimePointNow();
+			for (size_t i = 0; i < vertices.size(); ++i)
+				packed[i].set(vertices[i]);
+			packTime += CSysChrono::getDurationMicroseconds(start);
+
+			for (size_t i = 0; i < vertices.size(); ++i)
+			{
+				vector3df n = vertices[i].Normal;
+				n.normalize();
+				const float d = clamp_(n.dotProduct(decodeOctahedralNormal(packed[i].Normal)), -1.0f, 1.0f);
+				maxAngle = std::max(maxAngle, acosf(d));
+				maxUV = std::max(maxUV, fabsf(halfToFloat(packed[i].TCoords0[0]) - vertices[i].TCoords0.x));
+				maxUV = std::max(maxUV, fabsf(halfToFloat(packed[i].TCoords0[1]) - vertices[i].TCoords0.y));
+			}
+
+			printf("%s: %u vertices\n", path, (uint32_t)vertices.size());
+			totalVertices += (uint32_t)vertices.size();
+		}
+		delete m2File;
+	}
+
+	printf("vertex size %u -> %u bytes, total %u -> %u bytes\n", (uint32_t)sizeof(SVertex_PNT2WA), (uint32_t)sizeof(SVertex_PNT2WA_Packed),
+		totalVertices * (uint32_t)sizeof(SVertex_PNT2WA), totalVertices * (uint32_t)sizeof(SVertex_PNT2WA_Packed));
+	printf("max normal error: %g degree, max uv error: %g, pack: %u us\n", maxAngle * 180.0f / PI, maxUV, packTime);
+
+	delete wowEnv;
+	delete fs;
+}
+
+void testParticleBenchmark()
+{
+	//emitters with constant tracks, 2000 particles per second living 2.5s, about 40000 alive
+	const uint32_t numEmitters = 8;
+	const uint32_t numFrames = 600;
+	const uint32_t tickTime = 16;
+
+	std::vector<uint8_t> fileData(numEmitters * 12 * 24);
+	uint32_t ofs = 0;
+	auto initConstant = [&](SWowAnimation<float>& track, float value)
+	{
+		M2::animblock block;
+		block._Interpolation = INTERPOLATION_NONE;
+		block._SequenceID = -1;
+		block._Ntimings = block._Nvalues = 1;
+		block._TimingsOfs = ofs;
+		block._ValuesOfs = ofs + sizeof(M2::sequence);
+
+		M2::sequence* t = (M2::sequence*)&fileData[ofs];
+		M2::sequence* v = (M2::sequence*)&fileData[ofs + sizeof(M2::sequence)];
+		t->_NValues = v->_NValues = 1;
+		t->_SequencesOfs = ofs + sizeof(M2::sequence) * 2;
+		v->_SequencesOfs = t->_SequencesOfs + 4;
+		*(uint32_t*)&fileData[t->_SequencesOfs] = 0;
+		*(float*)&fileData[v->_SequencesOfs] = value;
+		ofs += 24;
+
+		track.init(&block, fileData.data(), nullptr, 0);
+	};
+
+	wowM2File* m2File = new wowM2File(nullptr);
+	m2File->ParticleEmitters.resize(numEmitters);
+	for (uint32_t i = 0; i < numEmitters; ++i)
+	{
+		wowM2File::SModelParticleEmitter& emitter = m2File->ParticleEmitters[i];
+		emitter.id = i;
+		emitter.flags = 0;
+		emitter.position.set((float)i, 0, 0);
+		emitter.boneIndex = -1;
+		emitter.textureIndex = 0;
+		emitter.blend = 0;
+		emitter.emitterType = (i % 2) ? MODELPARTICLE_EMITTER_SPHERE : MODELPARTICLE_EMITTER_PLANE;
+		emitter.particleType = 0;
+		emitter.headTail = 0;
+		emitter.rows = emitter.cols = 2;
+		emitter.drag = 0.5f;
+
+		initConstant(emitter.speed, 3.0f);
+		initConstant(emitter.speedVariation, 0.2f);
+		initConstant(emitter.verticalRange, 0.5f);
+		initConstant(emitter.horizontalRange, 3.14f);
+		initConstant(emitter.gravity, 2.0f);
+		initConstant(emitter.lifespan, 2.5f);
+		initConstant(emitter.emissionRate, 2000.0f);
+		initConstant(emitter.areaLength, 1.0f);
+		initConstant(emitter.areaWidth, 1.0f);
+
+		emitter.opacityTimes = { 0.0f, 0.5f, 1.0f };
+		emitter.opacities = { 0.0f, 1.0f, 0.0f };
+		emitter.sizeTimes = { 0.0f, 1.0f };
+		emitter.sizes = { vector2df(0.1f, 0.1f), vector2df(0.3f, 0.3f) };
+	}
+
+	const uint32_t maxParticles = 8192;
+	wowM2ParticleSystem* particles = new wowM2ParticleSystem(m2File, maxParticles);
+	std::vector<SVertex_PCT> vertices(numEmitters * maxParticles * 4);
+	std::vector<SParticleDrawRange> ranges;
+
+	uint32_t tickUs = 0, fillUs = 0, measured = 0, alive = 0;
+	for (uint32_t f = 0; f < numFrames; ++f)
+	{
+		auto start = CSysChrono::getTimePointNow();
+		particles->tick(0, f * tickTime, tickTime, nullptr, 0);
+		uint32_t t0 = CSysChrono::getDurationMicroseconds(start);
+
+		start = CSysChrono::getTimePointNow();
+		uint32_t num = particles->fillVertices(vector3df(1, 0, 0), vector3df(0, 1, 0), vertices.data(), (uint32_t)vertices.size() / 4, ranges);
+		uint32_t t1 = CSysChrono::getDurationMicroseconds(start);
+
+		//steady state after the first lifespan
+		if (f * tickTime >= 3000)
+		{
+			tickUs += t0;
+			fillUs += t1;
+			alive += num;
+			++measured;
+		}
+	}
+
+	printf("emitters: %u, live particles: %u\n", numEmitters, measured ? alive / measured : 0);
+	printf("tick: %.3f ms, fill vertices: %.3f ms per frame\n", measured ? tickUs / 1000.0f / measured : 0.0f, measured ? fillUs / 1000.0f / measured : 0.0f);
+
+	delete particles;
+	delete m2File;
+}
+
+void testGeosetDrawRanges()
+{
+	CFileSystem* fs = new CFileSystem(R"(E:\World Of Warcraft)");
+	wowEnvironment* wowEnv = new wowEnvironment(fs);
+
+	if (!wowEnv->init("wow_classic"))
+	{
+		printf("init fail!\n");
+		delete wowEnv;
+		delete fs;
+		return;
+	}
+
+	const char* m2Files[] =
+	{
+		"Character\\HUMAN\\Male\\humanmale.m2",
+		"Character\\HUMAN\\Female\\humanfemale.m2",
+		"Character\\Orc\\Male\\orcmale.m2",
+	};
+
+	//a naked character with the default hair and facial hair
+	SGeosetSelection selection;
+	selection.setCharacterDefaults();
+
+	std::vector<uint32_t> mask;
+	std::vector<uint16_t> indices;
+	std::vector<SGeosetDrawRange> ranges;
+	for (const char* path : m2Files)
+	{
+		wowM2File* m2File = new wowM2File(wowEnv);
+		if (m2File->loadFile(path))
+		{
+			const wowSkinFile* skinFile = &m2File->SkinFile;
+
+			auto start = CSysChrono::getTimePointNow();
+			wowM2Geosets::getVisibilityMask(skinFile, selection, mask);
+			wowM2Geosets::buildDrawRanges(skinFile, mask, indices, ranges);
+			uint32_t buildTime = CSysChrono::getDurationMicroseconds(start);
+
+			uint32_t numVisible = 0;
+			for (uint32_t i = 0; i < (uint32_t)skinFile->Geosets.size(); ++i)
+			{
+				if (wowM2Geosets::isVisible(mask, i) && skinFile->Geosets[i].ICount > 0)
+					++numVisible;
+			}
+
+			printf("%s\n", path);
+			printf("\tgeosets: %u, visible: %u, draws: %u, triangles: %u, build: %u us\n", (uint32_t)skinFile->Geosets.size(),
+				numVisible, (uint32_t)ranges.size(), (uint32_t)indices.size() / 3, buildTime);
+		}
+		delete m2File;
+	}
+
+	delete wowEnv;
+	delete fs;
+}
+
+void testM2InstancingReport()
+{
+	CFileSystem* fs = new CFileSystem(R"(E:\World Of Warcraft)");
+	wowEnvironment* wowEnv = new wowEnvironment(fs);
+
+	if (!wowEnv->init("wow_classic"))
+	{
+		printf("init fail!\n");
+		delete wowEnv;
+		delete fs;
+		return;
+	}
+
+	//a zone with many doodads and a few characters
+	struct SPlacement
+	{
+		const char* path;
+		uint32_t count;
+	};
+
+	const SPlacement placements[] =
+	{
+		{ "World\\Azeroth\\Elwynn\\PassiveDoodads\\Trees\\ElwynnTreeCanopy01.m2", 300 },
+		{ "World\\Azeroth\\Elwynn\\PassiveDoodads\\Trees\\ElwynnTreeCanopy02.m2", 300 },
+		{ "World\\Azeroth\\Elwynn\\PassiveDoodads\\Bush\\ElwynnBush01.m2", 500 },
+		{ "World\\Generic\\Human\\Passive Doodads\\Barrel\\Barrel01.m2", 100 },
+		{ "World\\Generic\\Human\\Passive Doodads\\Crate\\Crate01.m2", 100 },
+		{ "Creature\\Wolf\\wolf.m2", 20 },
+		{ "Character\\HUMAN\\Male\\humanmale.m2", 20 },
+	};
+
+	//the choice of CM2SceneNode: a skinned buffer for animated bones, RenderData and instanced draws otherwise
+	//instanced draws are one per range for up to 1024 instances, skinned nodes draw each range alone
+	uint32_t totalInstanced = 0;
+	uint32_t totalSkinned = 0;
+	uint32_t totalDraws = 0;
+	uint32_t totalDrawsNoInstancing = 0;
+	std::vector<uint32_t> mask;
+	std::vector<uint16_t> indices;
+	std::vector<SGeosetDrawRange> ranges;
+	for (const SPlacement& placement : placements)
+	{
+		wowM2File* m2File = new wowM2File(wowEnv);
+		if (!m2File->loadFile(placement.path))
+		{
+			printf("%s: load fail!\n", placement.path);
+			delete m2File;
+			continue;
+		}
+
+		const uint32_t numVertices = (uint32_t)m2File->Vertices.size();
+		const bool skinned = m2File->Skeleton.getNumBones() > 0 && numVertices > 0 && numVertices < 65536 && m2File->Skeleton.isAnimated();
+
+		wowM2Geosets::getVisibilityMask(&m2File->SkinFile, SGeosetSelection(), mask);
+		wowM2Geosets::buildDrawRanges(&m2File->SkinFile, mask, indices, ranges);
+		const uint32_t numRanges = (uint32_t)ranges.size();
+		const uint32_t draws = skinned ? placement.count * numRanges : ((placement.count + 1023) / 1024) * numRanges;
+
+		printf("%s\n", placement.path);
+		printf("\tbones: %u, %s, nodes: %u, ranges: %u, draws: %u\n", m2File->Skeleton.getNumBones(),
+			skinned ? "skinned" : "instanced", placement.count, numRanges, draws);
+
+		(skinned ? totalSkinned : totalInstanced) += placement.count;
+		totalDraws += draws;
+		totalDrawsNoInstancing += placement.count * numRanges;
+		delete m2File;
+	}
+
+	printf("nodes: %u instanced, %u skinned, draws: %u (%u without instancing)\n", totalInstanced, totalSkinned,
+		totalDraws, totalDrawsNoInstancing);
+
+	delete wowEnv;
+	delete fs;
+}
+
+void testM2CookedLoad()
+{
+	CFileSystem* fs = new CFileSystem(R"(E:\World Of Warcraft)");
+	wowEnvironment* wowEnv = new wowEnvironment(fs);
+
+	if (!wowEnv->init("wow_classic"))
+	{
+		printf("init fail!\n");
+		delete wowEnv;
+		delete fs;
+		return;
+	}
+
+	const char* m2Files[] =
+	{
+		"Character\\HUMAN\\Male\\humanmale.m2",
+		"Character\\HUMAN\\Female\\humanfemale.m2",
+		"Character\\Orc\\Male\\orcmale.m2",
+		"Creature\\Wolf\\wolf.m2",
+	};
+
+	std::string cacheDir = fs->getWorkingDirectory();
+	normalizeDirName(cacheDir);
+	cacheDir += "Cache/m2test/";
+	cacheDir += wowEnv->getVersionString();
+	wowM2CookedCache cookedCache(fs, cacheDir.c_str());
+
+	//the first pass reads the casc files, the second also writes the blobs, the third reads the blobs
+	//with compression the cooked skeleton saves compressing the tracks again
+	const SSkeletonCompression compression = { 0.001f, 0.001f, 0.001f };
+	const SSkeletonCompression* compressions[] = { nullptr, &compression };
+	for (const SSkeletonCompression* comp : compressions)
+	{
+		uint32_t times[3] = { 0, 0, 0 };
+		for (const char* path : m2Files)
+		{
+			wowM2File* files[3];
+			for (uint32_t pass = 0; pass < 3; ++pass)
+			{
+				files[pass] = new wowM2File(wowEnv);
+				auto start = CSysChrono::getTimePointNow();
+				files[pass]->loadFile(path, comp, pass == 0 ? nullptr : &cookedCache);
+				times[pass] += CSysChrono::getDurationMicroseconds(start);
+			}
+
+			const wowM2File* ref = files[0];
+			const wowM2File* cooked = files[2];
+			bool same = ref->Vertices.size() == cooked->Vertices.size() &&
+				memcmp(ref->Vertices.data(), cooked->Vertices.data(), sizeof(SVertex_PNT2WA) * ref->Vertices.size()) == 0 &&
+				ref->SkinFile.Indices == cooked->SkinFile.Indices &&
+				ref->SkinFile.Geosets.size() == cooked->SkinFile.Geosets.size() &&
+				ref->Animations.size() == cooked->Animations.size() &&
+				ref->AnimFileIDs == cooked->AnimFileIDs &&
+				ref->Skeleton.getNumBones() == cooked->Skeleton.getNumBones();
+			for (size_t i = 0; same && i < ref->SkinFile.Geosets.size(); ++i)
+			{
+				const SGeoset& a = ref->SkinFile.Geosets[i];
+				const SGeoset& b = cooked->SkinFile.Geosets[i];
+				same = a.GeoID == b.GeoID && a.IStart == b.IStart && a.ICount == b.ICount && a.VStart == b.VStart &&
+					a.VCount == b.VCount && a.TextureUnits == b.TextureUnits;
+			}
+
+			//the cooked skeleton poses as the one built from the bones
+			const uint32_t numBones = ref->Skeleton.getNumBones();
+			std::vector<matrix4> m0(numBones), m1(numBones);
+			for (uint32_t a = 0; same && a < (uint32_t)ref->Animations.size(); ++a)
+			{
+				if (!ref->isAnimationLoaded(a))
+					continue;
+				for (uint32_t time = 0; same && time <= ref->Animations[a].timeLength; time += 50)
+				{
+					ref->Skeleton.evaluate(a, time, m0.data());
+					cooked->Skeleton.evaluate(a, time, m1.data());
+					same = memcmp(m0.data(), m1.data(), sizeof(matrix4) * numBones) == 0;
+				}
+			}
+			printf("%s: %s\n", path, same ? "same" : "DIFFERENT");
+
+			for (wowM2File* file : files)
+				delete file;
+		}
+
+		printf("compression %s, load: %u us, cook: %u us, cooked load: %u us\n", comp ? "on" : "off", times[0], times[1], times[2]);
+	}
+
+	delete wowEnv;
+	delete fs;
+}
+
+void testCollisionBVH()
+{
+	CFileSystem* fs = new CFileSystem(R"(E:\World Of Warcraft)");
+	wowEnvironment* wowEnv = new wowEnvironment(fs);
+
+	if (!wowEnv->init("wow_classic"))
+	{
+		printf("init fail!\n");
+		delete wowEnv;
+		delete fs;
+		return;
+	}
+
+	const char* m2Files[] =
+	{
+		"World\\Azeroth\\Elwynn\\PassiveDoodads\\Trees\\ElwynnTreeCanopy01.m2",
+		"World\\Generic\\Human\\Passive Doodads\\Barrel\\Barrel01.m2",
+	};
+
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	//rays from points around the box to points inside it
+	const uint32_t numRays = 20000;
+	auto runRays = [&](const char* name, const wowCollisionBVH& bvh)
+	{
+		const aabbox3df box = bvh.getBoundingBox();
+		const vector3df center = box.getCenter();
+		const vector3df size = box.MaxEdge - box.MinEdge;
+		auto randomPoint = [&](float scale)
+		{
+			return center + vector3df((unit(rng) - 0.5f) * size.x, (unit(rng) - 0.5f) * size.y, (unit(rng) - 0.5f) * size.z) * scale;
+		};
+
+		std::vector<vector3df> starts(numRays);
+		std::vector<vector3df> dirs(numRays);
+		for (uint32_t i = 0; i < numRays; ++i)
+		{
+			starts[i] = randomPoint(3.0f);
+			dirs[i] = randomPoint(1.0f) - starts[i];
+		}
+
+		std::vector<SCollisionHit> hits(numRays);
+		std::vector<bool> found(numRays);
+		auto start = CSysChrono::getTimePointNow();
+		for (uint32_t i = 0; i < numRays; ++i)
+			found[i] = bvh.rayCast(starts[i], dirs[i], 2.0f, hits[i]);
+		const uint32_t bvhTime = std::max(CSysChrono::getDurationMicroseconds(start), 1u);
+
+		uint32_t numHits = 0;
+		uint32_t numDiffs = 0;
+		start = CSysChrono::getTimePointNow();
+		for (uint32_t i = 0; i < numRays; ++i)
+		{
+			SCollisionHit hit;
+			const bool f = bvh.rayCastBruteForce(starts[i], dirs[i], 2.0f, hit);
+			if (f != found[i] || (f && hit.Distance != hits[i].Distance))
+				++numDiffs;
+			if (f)
+				++numHits;
+		}
+		const uint32_t bruteTime = std::max(CSysChrono::getDurationMicroseconds(start), 1u);
+
+		printf("%s: %u triangles, %u nodes, %u hits, %u diffs\n", name, bvh.getNumTriangles(), bvh.getNumNodes(), numHits, numDiffs);
+		printf("\tbvh: %.0f rays/s, brute force: %.0f rays/s\n", numRays * 1000000.0f / bvhTime, numRays * 1000000.0f / bruteTime);
+	};
+
+	for (const char* path : m2Files)
+	{
+		wowM2File* m2File = new wowM2File(wowEnv);
+		if (m2File->loadFile(path) && !m2File->CollisionBVH.empty())
+			runRays(path, m2File->CollisionBVH);
+		else
+			printf("%s: no bounding triangles\n", path);
+		delete m2File;
+	}
+
+	//triangle soup in a 20 unit cube, 16 bit indices
+	std::vector<vector3df> vertices;
+	std::vector<uint16_t> indices;
+	for (uint32_t i = 0; i < 20000; ++i)
+	{
+		const vector3df center(unit(rng) * 20.0f, unit(rng) * 20.0f, unit(rng) * 20.0f);
+		for (uint32_t k = 0; k < 3; ++k)
+		{
+			indices.push_back((uint16_t)vertices.size());
+			vertices.push_back(center + vector3df(unit(rng) - 0.5f, unit(rng) - 0.5f, unit(rng) - 0.5f));
+		}
+	}
+
+	wowCollisionBVH soup;
+	auto start = CSysChrono::getTimePointNow();
+	soup.build(vertices.data(), (uint32_t)vertices.size(), indices.data(), (uint32_t)indices.size());
+	printf("soup build: %u us\n", CSysChrono::getDurationMicroseconds(start));
+	runRays("soup", soup);
+
+	delete wowEnv;
+	delete fs;
+}
+
+void testWMOLoadBenchmark()
+{
+	CFileSystem* fs = new CFileSystem(R"(E:\World Of Warcraft)");
+	wowEnvironment* wowEnv = new wowEnvironment(fs);
+
+	if (!wowEnv->init("wow_classic"))
+	{
+		printf("init fail!\n");
+		delete wowEnv;
+		delete fs;
+		return;
+	}
+
+	const char* wmoFiles[] =
+	{
+		"World\\wmo\\kalimdor\\ogrimmar\\ogrimmar.wmo",
+		"World\\wmo\\Azeroth\\Buildings\\Stormwind\\Stormwind.wmo",
+	};
+
+	//a first load warms the file cache, then the passes alternate which one goes first and the best time is kept
+	const uint32_t numCores = std::max(1u, std::thread::hardware_concurrency());
+	const uint32_t numRounds = 4;
+	for (const char* path : wmoFiles)
+	{
+		uint32_t times[2] = { 0xffffffff, 0xffffffff };
+		uint32_t numGroups = 0;
+		uint32_t numFileIDs = 0;
+		for (uint32_t round = 0; round <= numRounds * 2; ++round)
+		{
+			//after the warm up, pairs of passes: 1 thread first in even pairs, all threads first in odd pairs
+			const uint32_t k = round - 1;
+			const uint32_t pass = round == 0 ? 1 : ((k & 1) ^ ((k >> 1) & 1));
+			wowWMOFile* wmoFile = new wowWMOFile(wowEnv);
+			auto start = CSysChrono::getTimePointNow();
+			if (!wmoFile->loadFile(path, pass == 0 ? 1 : 0))
+				printf("%s: load fail!\n", path);
+			const uint32_t time = CSysChrono::getDurationMicroseconds(start);
+			if (round > 0)
+				times[pass] = std::min(times[pass], time);
+			numGroups = (uint32_t)wmoFile->GroupList.size();
+			numFileIDs = (uint32_t)wmoFile->GroupFileIDs.size();
+			delete wmoFile;
+		}
+
+		printf("%s: %u groups, %u by file id, best of %u, 1 thread: %u us, %u threads: %u us, speedup %.2f\n", path, numGroups, numFileIDs,
+			numRounds, times[0], numCores, times[1], times[1] ? (float)times[0] / times[1] : 0.0f);
+	}
+
+	delete wowEnv;
+	delete fs;
+}
+
+//90 degree view, y up
+static frustum makeViewFrustum(const vector3df& pos, const vector3df& dir, float farDist)
+{
+	vector3df right = dir.crossProduct(vector3df(0, 1, 0));
+	right.normalize();
+	vector3df up = right.crossProduct(dir);
+	up.normalize();
+
+	frustum f;
+	f.setPlane(frustum::VF_LEFT, plane3df(pos, (dir + right).normalize()));
+	f.setPlane(frustum::VF_RIGHT, plane3df(pos, (dir - right).normalize()));
+	f.setPlane(frustum::VF_TOP, plane3df(pos, (dir - up).normalize()));
+	f.setPlane(frustum::VF_BOTTOM, plane3df(pos, (dir + up).normalize()));
+	f.setPlane(frustum::VF_NEAR, plane3df(pos + dir * 0.1f, dir));
+	f.setPlane(frustum::VF_FAR, plane3df(pos + dir * farDist, -dir));
+	return f;
+}
+
+void testWMOPortalCulling()
+{
+	CFileSystem* fs = new CFileSystem(R"(E:\World Of Warcraft)");
+	wowEnvironment* wowEnv = new wowEnvironment(fs);
+
+	if (!wowEnv->init("wow_classic"))
+	{
+		printf("init fail!\n");
+		delete wowEnv;
+		delete fs;
+		return;
+	}
+
+	const char* wmoFiles[] =
+	{
+		"World\\wmo\\kalimdor\\ogrimmar\\ogrimmar.wmo",
+		"World\\wmo\\Azeroth\\Buildings\\Stormwind\\Stormwind.wmo",
+	};
+
+	const vector3df dirs[] =
+	{
+		vector3df(1, 0, 0),
+		vector3df(-1, 0, 0),
+		vector3df(0, 0, 1),
+		vector3df(0, 0, -1),
+	};
+
+	for (const char* path : wmoFiles)
+	{
+		wowWMOFile* wmoFile = new wowWMOFile(wowEnv);
+		if (!wmoFile->loadFile(path))
+		{
+			printf("%s: load fail!\n", path);
+			delete wmoFile;
+			continue;
+		}
+
+		//cameras at the center of each indoor group, against frustum culling alone
+		wowWMOVisibility visibility(wmoFile);
+		uint32_t numViews = 0;
+		uint32_t numInGroup = 0;
+		uint64_t frustumGroups = 0, frustumBatches = 0;
+		uint64_t portalGroups = 0, portalBatches = 0;
+		uint32_t time = 0;
+		for (const SWMOGroup& group : wmoFile->GroupList)
+		{
+			if (!(group.flags & WMOGROUP_INDOOR))
+				continue;
+
+			const vector3df camPos = group.box.getCenter();
+			for (const vector3df& dir : dirs)
+			{
+				const frustum f = makeViewFrustum(camPos, dir, 1000.0f);
+
+				for (const SWMOGroup& g : wmoFile->GroupList)
+				{
+					if (!f.isInFrustum(g.box))
+						continue;
+					++frustumGroups;
+					for (const SWMOBatch& batch : g.batchList)
+					{
+						if (f.isInFrustum(batch.box))
+							++frustumBatches;
+					}
+				}
+
+				auto start = CSysChrono::getTimePointNow();
+				visibility.update(camPos, f);
+				time += CSysChrono::getDurationMicroseconds(start);
+
+				portalGroups += visibility.getVisibleGroups().size();
+				portalBatches += visibility.getNumVisibleBatches();
+				if (visibility.getCameraGroup() == (int32_t)group.index)
+					++numInGroup;
+				++numViews;
+			}
+		}
+
+		printf("%s: %u portals, %u views, camera group found %u\n", path, (uint32_t)wmoFile->PortalList.size(), numViews, numInGroup);
+		if (numViews)
+		{
+			printf("frustum: %.1f groups %.1f batches, portals: %.1f groups %.1f batches, %.1f us per view\n",
+				(float)frustumGroups / numViews, (float)frustumBatches / numViews,
+				(float)portalGroups / numViews, (float)portalBatches / numViews, (float)time / numViews);
+		}
+
+		delete wmoFile;
+	}
+
+	delete wowEnv;
+	delete fs;
+}
+
+void testWMOBsp()
+{
+	//a sphere cutting the plane of a triangle beside it and moving away never touches it
+	{
+		WMO::wmoBspNode node = { 4, { -1, -1 }, 1, 0, 0, 0.0f };
+		const uint16_t faces[] = { 0 };
+		const uint16_t indices[] = { 0, 1, 2 };
+		SVertex_PNCT2 vertices[3];
+		vertices[0].Pos.set(0, 0, 0);
+		vertices[1].Pos.set(10, 0, 0);
+		vertices[2].Pos.set(0, 0, 10);
+
+		wowWMOBsp bsp;
+		bsp.load(&node, 1, faces, 1, indices, 3, 3);
+
+		SCollisionHit hit;
+		const vector3df start(-1.0f, 0.2f, 1.0f);
+		const vector3df dir(-1.0f, -0.1f, 0.0f);
+		const bool swept = bsp.sweepSphere(vertices, start, dir, 10.0f, 0.5f, hit);
+		const bool bruteSwept = bsp.sweepSphereBruteForce(vertices, start, dir, 10.0f, 0.5f, hit);
+		printf("sweep away from a triangle: %s\n", !swept && !bruteSwept ? "no contact" : "contact, wrong!");
+	}
+
+	CFileSystem* fs = new CFileSystem(R"(E:\World Of Warcraft)");
+	wowEnvironment* wowEnv = new wowEnvironment(fs);
+
+	if (!wowEnv->init("wow_classic"))
+	{
+		printf("init fail!\n");
+		delete wowEnv;
+		delete fs;
+		return;
+	}
+
+	const char* path = "World\\wmo\\kalimdor\\ogrimmar\\ogrimmar.wmo";
+	wowWMOFile* wmoFile = new wowWMOFile(wowEnv);
+	if (!wmoFile->loadFile(path))
+	{
+		printf("%s: load fail!\n", path);
+		delete wmoFile;
+		delete wowEnv;
+		delete fs;
+		return;
+	}
+
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	//rays and sweeps from points in each group box, against all the bsp triangles
+	const uint32_t numQueries = 2000;
+	uint32_t numFaces = 0, numNodes = 0;
+	uint32_t rayHits = 0, rayDiffs = 0, sweepHits = 0, sweepDiffs = 0;
+	uint32_t rayTime = 0, rayBruteTime = 0, sweepTime = 0, sweepBruteTime = 0;
+	for (const SWMOGroup& group : wmoFile->GroupList)
+	{
+		const wowWMOBsp& bsp = group.bsp;
+		if (bsp.empty() || group.vertices.empty())
+			continue;
+
+		numFaces += bsp.getNumFaces();
+		numNodes += bsp.getNumNodes();
+
+		const vector3df size = group.box.getExtent();
+		std::vector<vector3df> starts(numQueries);
+		std::vector<vector3df> dirs(numQueries);
+		for (uint32_t i = 0; i < numQueries; ++i)
+		{
+			starts[i] = group.box.MinEdge + vector3df(unit(rng) * size.x, unit(rng) * size.y, unit(rng) * size.z);
+			dirs[i].set(unit(rng) - 0.5f, unit(rng) - 0.5f, unit(rng) - 0.5f);
+			dirs[i].normalize();
+		}
+
+		for (uint32_t i = 0; i < numQueries; ++i)
+		{
+			SCollisionHit hit, bruteHit;
+
+			auto start = CSysChrono::getTimePointNow();
+			const bool found = bsp.rayCast(group.vertices.data(), starts[i], dirs[i], 100.0f, hit);
+			rayTime += CSysChrono::getDurationMicroseconds(start);
+
+			start = CSysChrono::getTimePointNow();
+			const bool bruteFound = bsp.rayCastBruteForce(group.vertices.data(), starts[i], dirs[i], 100.0f, bruteHit);
+			rayBruteTime += CSysChrono::getDurationMicroseconds(start);
+
+			if (found != bruteFound || (found && hit.Distance != bruteHit.Distance))
+				++rayDiffs;
+			if (found)
+				++rayHits;
+
+			start = CSysChrono::getTimePointNow();
+			const bool swept = bsp.sweepSphere(group.vertices.data(), starts[i], dirs[i], 10.0f, 0.5f, hit);
+			sweepTime += CSysChrono::getDurationMicroseconds(start);
+
+			start = CSysChrono::getTimePointNow();
+			const bool bruteSwept = bsp.sweepSphereBruteForce(group.vertices.data(), starts[i], dirs[i], 10.0f, 0.5f, bruteHit);
+			sweepBruteTime += CSysChrono::getDurationMicroseconds(start);
+
+			if (swept != bruteSwept || (swept && hit.Distance != bruteHit.Distance))
+				++sweepDiffs;
+			if (swept)
+				++sweepHits;
+		}
+	}
+
+	printf("%s: %u bsp faces, %u nodes\n", path, numFaces, numNodes);
+	printf("\tray: %u hits, %u diffs, bsp %u us, brute force %u us\n", rayHits, rayDiffs, rayTime, rayBruteTime);
+	printf("\tsweep: %u hits, %u diffs, bsp %u us, brute force %u us\n", sweepHits, sweepDiffs, sweepTime, sweepBruteTime);
+
+	//group of points above the floor in each indoor group, the bsp against the smallest box
+	uint32_t numPoints = 0, numFound = 0, numBoxOnly = 0;
+	for (const SWMOGroup& group : wmoFile->GroupList)
+	{
+		if (!(group.flags & WMOGROUP_INDOOR) || group.bsp.empty())
+			continue;
+
+		const vector3df center = group.box.getCenter();
+		int32_t boxGroup = -1;
+		float boxVolume = 0;
+		for (const SWMOGroup& g : wmoFile->GroupList)
+		{
+			if ((g.flags & WMOGROUP_INDOOR) && g.box.isPointInside(center) && (boxGroup == -1 || g.box.getVolume() < boxVolume))
+			{
+				boxGroup = (int32_t)g.index;
+				boxVolume = g.box.getVolume();
+			}
+		}
+
+		const int32_t found = wmoFile->findGroup(center);
+		++numPoints;
+		if (found == (int32_t)group.index)
+			++numFound;
+		if (boxGroup == (int32_t)group.index)
+			++numBoxOnly;
+	}
+	printf("\tgroup centers: %u, own group by bsp %u, by smallest box %u\n", numPoints, numFound, numBoxOnly);
+
+	delete wmoFile;
+	delete wowEnv;
+	delete fs;
+}
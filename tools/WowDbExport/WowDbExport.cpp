@@ -0,0 +1,396 @@
+#include <crtdbg.h>
+#include <stdio.h>
+#include <vector>
+#include <string>
+#include <thread>
+
+#include "CFileSystem.h"
+#include "CWriteFile.h"
+#include "CMemFile.h"
+#include "CSysSync.h"
+#include "CSysThread.h"
+#include "CSysChrono.h"
+#include "wowEnvironment.h"
+#include "wowDatabase.h"
+#include "wowDbFile.h"
+#include "function.h"
+#include "stringext.h"
+
+#pragma comment(lib, "CascLib.lib")
+#pragma comment(lib, "pugixml.lib")
+
+//export every table in database.xml to csv and to a columnar binary file (.dbcol)
+//
+//.dbcol layout:
+//	char magic[4] 'DBCL', uint32 version, uint32 numRows, uint32 numChunks, uint32 numColumns
+//	columns: uint8 type, uint16 nameLength, char name[nameLength]
+//	chunks: uint32 numRows, for each column: uint32 size, data
+//		numeric column: numRows values of the column type
+//		string column: uint32 offsets[numRows + 1], chars
+
+#define EXPORT_CHUNK_ROWS		4096
+#define EXPORT_BUFFER_SIZE		(1 << 20)
+
+enum E_COLUMN_TYPE : uint8_t
+{
+	ECT_UINT32 = 0,
+	ECT_INT32,
+	ECT_UINT16,
+	ECT_UINT64,
+	ECT_FLOAT,
+	ECT_STRING,
+};
+
+struct SExportColumn
+{
+	std::string name;
+	E_COLUMN_TYPE type;
+};
+
+//collects small writes and sends them to the file in large blocks
+class CBufferedWriter
+{
+public:
+	explicit CBufferedWriter(CWriteFile* file) : File(file) { Buffer.reserve(EXPORT_BUFFER_SIZE); }
+	~CBufferedWriter() { flush(); }
+
+	void write(const void* data, uint32_t size)
+	{
+		if (Buffer.size() + size > EXPORT_BUFFER_SIZE)
+			flush();
+		if (size > EXPORT_BUFFER_SIZE)
+			File->writeBuffer(data, size);
+		else
+			Buffer.insert(Buffer.end(), (const char*)data, (const char*)data + size);
+	}
+
+	void write(const std::string& str) { write(str.data(), (uint32_t)str.size()); }
+
+	void flush()
+	{
+		if (!Buffer.empty())
+			File->writeBuffer(Buffer.data(), (uint32_t)Buffer.size());
+		Buffer.clear();
+	}
+
+private:
+	CWriteFile* File;
+	std::vector<char> Buffer;
+};
+
+struct SExportContext
+{
+	CFileSystem* fs;
+	const wowDatabase* wowDB;
+	std::string dir;
+	std::vector<std::string> tableNames;
+	atomic_type<uint32_t> nextTable;
+	atomic_type<uint32_t> numExported;
+	lock_type openLock;			//casc file reading is serialized, decoding is not
+};
+
+void exportAllTables(CFileSystem* fs, const wowDatabase* wowDB, uint32_t numThreads);
+bool exportTable(SExportContext* context, const char* name);
+
+int main(int argc, char* argv[])
+{
+#if defined(DEBUG) | defined(_DEBUG)
+	_CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
+#endif
+
+	const char* wowDir = argc > 1 ? argv[1] : R"(E:\World Of Warcraft)";
+	const char* product = argc > 2 ? argv[2] : "wow";
+
+	CFileSystem* fs = new CFileSystem(wowDir);
+	wowEnvironment* wowEnv = new wowEnvironment(fs);
+	wowDatabase* wowDB = new wowDatabase(wowEnv);
+
+	if (!wowEnv->init(product))
+	{
+		printf("init fail!\n");
+	}
+	else
+	{
+		printf("wowEnv init success! %s, %s, %s\n", wowEnv->getProduct(), wowEnv->getLocale(), wowEnv->getVersionString());
+
+		//only table struct, records are streamed from the files
+		if (!wowDB->init(false))
+			printf("wowDB init fail!\n");
+		else
+			exportAllTables(fs, wowDB, std::thread::hardware_concurrency());
+	}
+
+	delete wowDB;
+	delete wowEnv;
+	delete fs;
+
+	getchar();
+	return 0;
+}
+
+void exportAllTables(CFileSystem* fs, const wowDatabase* wowDB, uint32_t numThreads)
+{
+	SExportContext context;
+	context.fs = fs;
+	context.wowDB = wowDB;
+	context.dir = fs->getWorkingDirectory();
+	normalizeDirName(context.dir);
+	context.dir += "DatabaseExport/";
+	Q_MakeDirForFileName(context.dir.c_str());
+
+	for (const auto& kv : wowDB->getDBStructMap())
+		context.tableNames.push_back(kv.first);
+	context.nextTable = 0;
+	context.numExported = 0;
+
+	if (numThreads == 0)
+		numThreads = 1;
+
+	auto start = CSysChrono::getTimePointNow();
+
+	std::vector<thread_type> threads(numThreads);
+	for (uint32_t t = 0; t < numThreads; ++t)
+	{
+		INIT_THREAD(&threads[t], [](void* param)
+		{
+			SExportContext* context = static_cast<SExportContext*>(param);
+			while (true)
+			{
+				uint32_t index = context->nextTable++;
+				if (index >= (uint32_t)context->tableNames.size())
+					break;
+
+				const char* name = context->tableNames[index].c_str();
+				if (exportTable(context, name))
+					++context->numExported;
+				else
+					printf("export fail! %s\n", name);
+			}
+			return 0;
+		}, &context);
+	}
+
+	for (uint32_t t = 0; t < numThreads; ++t)
+	{
+		WAIT_THREAD(&threads[t]);
+		DESTROY_THREAD(&threads[t]);
+	}
+
+	printf("exported %u/%u tables in %u ms\n", (uint32_t)context.numExported, (uint32_t)context.tableNames.size(),
+		CSysChrono::getDurationMilliseconds(start));
+}
+
+static E_COLUMN_TYPE getColumnType(const std::string& type)
+{
+	if (type == "text")
+		return ECT_STRING;
+	else if (type == "float")
+		return ECT_FLOAT;
+	else if (type == "int")
+		return ECT_INT32;
+	else if (type == "uint16" || type == "byte")
+		return ECT_UINT16;
+	else if (type == "uint64")
+		return ECT_UINT64;
+	return ECT_UINT32;
+}
+
+static void appendCsvValue(std::string& line, const VAR_T& v)
+{
+	char tmp[32];
+	if (v.Is<std::string>())
+	{
+		const std::string& str = v.Get<std::string>();
+		line += '"';
+		for (char c : str)
+		{
+			if (c == '"')
+				line += '"';
+			line += c;
+		}
+		line += '"';
+		return;
+	}
+	else if (v.Is<float>())
+		Q_sprintf(tmp, 32, "%g", v.Get<float>());
+	else if (v.Is<int>())
+		Q_sprintf(tmp, 32, "%d", v.Get<int>());
+	else if (v.Is<uint16_t>())
+		Q_sprintf(tmp, 32, "%u", (uint32_t)v.Get<uint16_t>());
+	else if (v.Is<uint64_t>())
+		Q_sprintf(tmp, 32, "%llu", (unsigned long long)v.Get<uint64_t>());
+	else if (v.Is<uint32_t>())
+		Q_sprintf(tmp, 32, "%u", v.Get<uint32_t>());
+	else
+		tmp[0] = '\0';
+	line += tmp;
+}
+
+template <class T>
+static void appendColumnValue(std::vector<uint8_t>& data, T v)
+{
+	size_t pos = data.size();
+	data.resize(pos + sizeof(T));
+	memcpy(&data[pos], &v, sizeof(T));
+}
+
+bool exportTable(SExportContext* context, const char* name)
+{
+	const CTableStruct* table = context->wowDB->getDBStruct(name);
+	if (!table)
+		return false;
+
+	CMemFile* memFile;
+	{
+		CLock lock(context->openLock);
+		memFile = context->wowDB->loadDBMemFile(name);
+	}
+	if (!memFile)
+		return false;
+
+	const DBFile* file = DBFile::readDBFile(memFile);
+	if (!file)
+		return false;
+
+	//columns, arrays are expanded
+	std::vector<SExportColumn> columns;
+	for (const auto& field : table->fields)
+	{
+		uint32_t count = (field.isKey || field.isRelationshipData) ? 1 : field.arraySize;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			SExportColumn col;
+			col.name = count > 1 ? std_string_format("%s[%u]", field.name.c_str(), i) : field.name;
+			col.type = getColumnType(field.type);
+			columns.push_back(col);
+		}
+	}
+
+	std::string csvName = context->dir + name + ".csv";
+	std::string colName = context->dir + name + ".dbcol";
+	CWriteFile* csvFile = context->fs->createAndWriteFile(csvName.c_str(), true);
+	CWriteFile* colFile = context->fs->createAndWriteFile(colName.c_str(), true);
+	if (!csvFile || !colFile)
+	{
+		delete csvFile;
+		delete colFile;
+		delete file;
+		return false;
+	}
+
+	const uint32_t numColumns = (uint32_t)columns.size();
+	const uint32_t numRows = file->getRecordCount();
+	const uint32_t numChunks = (numRows + EXPORT_CHUNK_ROWS - 1) / EXPORT_CHUNK_ROWS;
+	{
+		CBufferedWriter csv(csvFile);
+		CBufferedWriter col(colFile);
+
+		//headers
+		std::string line;
+		for (uint32_t c = 0; c < numColumns; ++c)
+		{
+			if (c > 0)
+				line += ',';
+			line += columns[c].name;
+		}
+		line += "\r\n";
+		csv.write(line);
+
+		const uint32_t version = 1;
+		col.write("DBCL", 4);
+		col.write(&version, 4);
+		col.write(&numRows, 4);
+		col.write(&numChunks, 4);
+		col.write(&numColumns, 4);
+		for (const auto& c : columns)
+		{
+			uint16_t len = (uint16_t)c.name.length();
+			col.write(&c.type, 1);
+			col.write(&len, 2);
+			col.write(c.name.data(), len);
+		}
+
+		//chunks
+		std::vector<std::vector<uint8_t>> columnData(numColumns);
+		std::vector<std::vector<uint32_t>> stringOffsets(numColumns);
+		const VAR_T emptyValue;
+		for (uint32_t chunkStart = 0; chunkStart < numRows; chunkStart += EXPORT_CHUNK_ROWS)
+		{
+			uint32_t chunkRows = std::min((uint32_t)EXPORT_CHUNK_ROWS, numRows - chunkStart);
+			for (uint32_t c = 0; c < numColumns; ++c)
+			{
+				columnData[c].clear();
+				stringOffsets[c].clear();
+			}
+
+			for (uint32_t r = chunkStart; r < chunkStart + chunkRows; ++r)
+			{
+				const std::vector<VAR_T>& val = file->getRecordValue(r, table);
+
+				line.clear();
+				for (uint32_t c = 0; c < numColumns; ++c)
+				{
+					if (c > 0)
+						line += ',';
+
+					//a value not decoded is an empty cell and a zero, columns stay aligned
+					auto& data = columnData[c];
+					const VAR_T& v = c < (uint32_t)val.size() ? val[c] : emptyValue;
+					appendCsvValue(line, v);
+
+					switch (columns[c].type)
+					{
+					case ECT_STRING:
+						{
+							stringOffsets[c].push_back((uint32_t)data.size());
+							const std::string& str = v.Is<std::string>() ? v.Get<std::string>() : std::string();
+							data.insert(data.end(), str.begin(), str.end());
+						}
+						break;
+					case ECT_FLOAT:
+						appendColumnValue<float>(data, v.Is<float>() ? v.Get<float>() : 0.0f);
+						break;
+					case ECT_INT32:
+						appendColumnValue<int32_t>(data, v.Is<int>() ? v.Get<int>() : 0);
+						break;
+					case ECT_UINT16:
+						appendColumnValue<uint16_t>(data, v.Is<uint16_t>() ? v.Get<uint16_t>() : 0);
+						break;
+					case ECT_UINT64:
+						appendColumnValue<uint64_t>(data, v.Is<uint64_t>() ? v.Get<uint64_t>() : 0);
+						break;
+					default:
+						appendColumnValue<uint32_t>(data, v.Is<uint32_t>() ? v.Get<uint32_t>() : 0);
+						break;
+					}
+				}
+				line += "\r\n";
+				csv.write(line);
+			}
+
+			col.write(&chunkRows, 4);
+			for (uint32_t c = 0; c < numColumns; ++c)
+			{
+				if (columns[c].type == ECT_STRING)
+				{
+					auto& offsets = stringOffsets[c];
+					offsets.push_back((uint32_t)columnData[c].size());
+					uint32_t size = (uint32_t)(offsets.size() * sizeof(uint32_t) + columnData[c].size());
+					col.write(&size, 4);
+					col.write(offsets.data(), (uint32_t)(offsets.size() * sizeof(uint32_t)));
+				}
+				else
+				{
+					uint32_t size = (uint32_t)columnData[c].size();
+					col.write(&size, 4);
+				}
+				col.write(columnData[c].data(), (uint32_t)columnData[c].size());
+			}
+		}
+	}
+
+	delete csvFile;
+	delete colFile;
+	delete file;
+	return true;
+}